@@ -12,29 +12,35 @@
 @rem Compile 64-bit versions
 @set VSCMD_START_DIR=%CD%
 @call %VS_DIR%\VC\Auxiliary\Build\vcvars64.bat
-@cl /EHsc /Z7 /Fe"bin/iterate.exe" src/iterate.cpp
-@cl /EHsc /Z7 /Fe"bin/heat.exe" src/heat.cpp
-@cl /EHsc /Z7 /Fe"bin/magnetize.exe" src/magnetize.cpp
-@cl /EHsc /Z7 /Fe"bin/magnetize2.exe" src/magnetize2.cpp
-@cl /EHsc /Z7 /Fe"bin/metropolis.exe" src/metropolis.cpp
-@cl /EHsc /Z7 /Fe"bin/extract.exe" src/extract.cpp
-@cl /EHsc /Z7 /Fe"bin/mfm_aggregator.exe" src/mfm_aggregator.cpp
+@cl /EHsc /std:c++17 /Z7 /Fe"bin/iterate.exe" src/iterate.cpp
+@cl /EHsc /std:c++17 /Z7 /Fe"bin/heat.exe" src/heat.cpp
+@cl /EHsc /std:c++17 /Z7 /Fe"bin/magnetize.exe" src/magnetize.cpp
+@cl /EHsc /std:c++17 /Z7 /Fe"bin/magnetize2.exe" src/magnetize2.cpp
+@cl /EHsc /std:c++17 /Z7 /Fe"bin/metropolis.exe" src/metropolis.cpp
+@cl /EHsc /std:c++17 /Z7 /Fe"bin/extract.exe" src/extract.cpp
+@cl /EHsc /std:c++17 /Z7 /Fe"bin/mfm_aggregator.exe" src/mfm_aggregator.cpp
+@cl /EHsc /std:c++17 /Z7 /Fe"bin/mfm_image.exe" src/mfm_image.cpp
+@cl /EHsc /std:c++17 /Z7 /Fe"bin/msd_worker.exe" src/msd_worker.cpp
+@cl /EHsc /std:c++17 /Z7 /Fe"bin/msd_service.exe" src/msd_service.cpp
 
 
 @rem Compile 32-bit versions
 @set VSCMD_START_DIR=%CD%
 @call %VS_DIR%\VC\Auxiliary\Build\vcvars32.bat
-@cl /EHsc /Z7 /Fe"bin/iterate_x86.exe" src/iterate.cpp
-@cl /EHsc /Z7 /Fe"bin/heat_x86.exe" src/heat.cpp
-@cl /EHsc /Z7 /Fe"bin/magnetize_x86.exe" src/magnetize.cpp
-@cl /EHsc /Z7 /Fe"bin/magnetize2_x86.exe" src/magnetize2.cpp
-@cl /EHsc /Z7 /Fe"bin/metropolis_x86.exe" src/metropolis.cpp
-@cl /EHsc /Z7 /Fe"bin/extract_x86.exe" src/extract.cpp
-@cl /EHsc /Z7 /Fe"bin/mfm_aggregator_x86.exe" src/mfm_aggregator.cpp
+@cl /EHsc /std:c++17 /Z7 /Fe"bin/iterate_x86.exe" src/iterate.cpp
+@cl /EHsc /std:c++17 /Z7 /Fe"bin/heat_x86.exe" src/heat.cpp
+@cl /EHsc /std:c++17 /Z7 /Fe"bin/magnetize_x86.exe" src/magnetize.cpp
+@cl /EHsc /std:c++17 /Z7 /Fe"bin/magnetize2_x86.exe" src/magnetize2.cpp
+@cl /EHsc /std:c++17 /Z7 /Fe"bin/metropolis_x86.exe" src/metropolis.cpp
+@cl /EHsc /std:c++17 /Z7 /Fe"bin/extract_x86.exe" src/extract.cpp
+@cl /EHsc /std:c++17 /Z7 /Fe"bin/mfm_aggregator_x86.exe" src/mfm_aggregator.cpp
+@cl /EHsc /std:c++17 /Z7 /Fe"bin/mfm_image_x86.exe" src/mfm_image.cpp
+@cl /EHsc /std:c++17 /Z7 /Fe"bin/msd_worker_x86.exe" src/msd_worker.cpp
+@cl /EHsc /std:c++17 /Z7 /Fe"bin/msd_service_x86.exe" src/msd_service.cpp
 
 
 @rem Remove .obj file
-@del iterate.obj heat.obj magnetize.obj magnetize2.obj metropolis.obj extract.obj mfm_aggregator.obj
+@del iterate.obj heat.obj magnetize.obj magnetize2.obj metropolis.obj extract.obj mfm_aggregator.obj mfm_image.obj msd_worker.obj msd_service.obj
 
 
 @rem End of file
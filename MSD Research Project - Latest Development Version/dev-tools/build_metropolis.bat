@@ -11,12 +11,12 @@
 @rem Compile 64-bit versions
 @set VSCMD_START_DIR=%CD%
 @call %VS_DIR%\VC\Auxiliary\Build\vcvars64.bat
-@cl /EHsc /Fe"bin/metropolis.exe" src/metropolis.cpp
+@cl /EHsc /std:c++17 /Fe"bin/metropolis.exe" src/metropolis.cpp
 
 @rem Compile 32-bit versions
 @set VSCMD_START_DIR=%CD%
 @call %VS_DIR%\VC\Auxiliary\Build\vcvars32.bat
-@cl /EHsc /Fe"bin/metropolis_x86.exe" src/metropolis.cpp
+@cl /EHsc /std:c++17 /Fe"bin/metropolis_x86.exe" src/metropolis.cpp
 
 @rem Remove .obj file
 @del metropolis.obj
@@ -12,18 +12,50 @@
 @rem Compile 64-bit versions
 @set VSCMD_START_DIR=%CD%
 @call %VS_DIR%\VC\Auxiliary\Build\vcvars64.bat
-@cl /EHsc /Fe"bin/tests/test-setLocalM.exe" src/tests/test-setLocalM.cpp
+@cl /EHsc /std:c++17 /Fe"bin/tests/test-setLocalM.exe" src/tests/test-setLocalM.cpp
+@cl /EHsc /std:c++17 /Fe"bin/tests/record-sink-test.exe" src/tests/record-sink-test.cpp
+@cl /EHsc /std:c++17 /Fe"bin/tests/mfm-test.exe" src/tests/mfm-test.cpp
+@cl /EHsc /std:c++17 /Fe"bin/tests/dipolar-test.exe" src/tests/dipolar-test.cpp
+@cl /EHsc /std:c++17 /Fe"bin/tests/change-tracking-test.exe" src/tests/change-tracking-test.cpp
+@cl /EHsc /std:c++17 /Fe"bin/tests/async-run-test.exe" src/tests/async-run-test.cpp
+@cl /EHsc /std:c++17 /Fe"bin/tests/snapshot-test.exe" src/tests/snapshot-test.cpp
+@cl /EHsc /std:c++17 /Fe"bin/tests/batch-run-test.exe" src/tests/batch-run-test.cpp
+@cl /EHsc /std:c++17 /Fe"bin/tests/fast-msd-test.exe" src/tests/fast-msd-test.cpp
+@cl /EHsc /std:c++17 /DUDC_FLOAT_STATE /Fe"bin/tests/fast-msd-test_float.exe" src/tests/fast-msd-test.cpp
+@cl /EHsc /std:c++17 /Fe"bin/tests/topology-test.exe" src/tests/topology-test.cpp
+@cl /EHsc /std:c++17 /Fe"bin/tests/ising-msd-test.exe" src/tests/ising-msd-test.cpp
 
 
 @rem Compile 32-bit versions
 @set VSCMD_START_DIR=%CD%
 @call %VS_DIR%\VC\Auxiliary\Build\vcvars32.bat
-@cl /EHsc /Fe"bin/tests/test-setLocalM_x86.exe" src/tests/test-setLocalM.cpp
+@cl /EHsc /std:c++17 /Fe"bin/tests/test-setLocalM_x86.exe" src/tests/test-setLocalM.cpp
+@cl /EHsc /std:c++17 /Fe"bin/tests/record-sink-test_x86.exe" src/tests/record-sink-test.cpp
+@cl /EHsc /std:c++17 /Fe"bin/tests/mfm-test_x86.exe" src/tests/mfm-test.cpp
+@cl /EHsc /std:c++17 /Fe"bin/tests/dipolar-test_x86.exe" src/tests/dipolar-test.cpp
+@cl /EHsc /std:c++17 /Fe"bin/tests/change-tracking-test_x86.exe" src/tests/change-tracking-test.cpp
+@cl /EHsc /std:c++17 /Fe"bin/tests/async-run-test_x86.exe" src/tests/async-run-test.cpp
+@cl /EHsc /std:c++17 /Fe"bin/tests/snapshot-test_x86.exe" src/tests/snapshot-test.cpp
+@cl /EHsc /std:c++17 /Fe"bin/tests/batch-run-test_x86.exe" src/tests/batch-run-test.cpp
+@cl /EHsc /std:c++17 /Fe"bin/tests/fast-msd-test_x86.exe" src/tests/fast-msd-test.cpp
+@cl /EHsc /std:c++17 /DUDC_FLOAT_STATE /Fe"bin/tests/fast-msd-test_float_x86.exe" src/tests/fast-msd-test.cpp
+@cl /EHsc /std:c++17 /Fe"bin/tests/topology-test_x86.exe" src/tests/topology-test.cpp
+@cl /EHsc /std:c++17 /Fe"bin/tests/ising-msd-test_x86.exe" src/tests/ising-msd-test.cpp
 
 
 
 @rem Remove .obj file
 @del test-setLocalM.obj
+@del record-sink-test.obj
+@del mfm-test.obj
+@del dipolar-test.obj
+@del change-tracking-test.obj
+@del async-run-test.obj
+@del snapshot-test.obj
+@del batch-run-test.obj
+@del fast-msd-test.obj
+@del topology-test.obj
+@del ising-msd-test.obj
 
 
 @rem End of file
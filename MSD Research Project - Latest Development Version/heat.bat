@@ -2,6 +2,8 @@
 @rem  * model=CONTINUOUS_SPIN_MODEL|UP_DOWN_MODEL
 @rem  * reset=noop|reinitialize|randomize
 @rem  * mol_type=LINEAR|CIRCULAR|__PATH__.mmb
+@rem  * record_sink=memory|stats, optionally followed by :<decimation> (e.g. stats:10)
+@rem  * format=csv|csv-xyz|binary|binary-xyz ("-xyz" leaves out the norm, theta, and phi columns)
 @rem  */
 
 
@@ -9,6 +11,8 @@
 @set model=CONTINUOUS_SPIN_MODEL
 @set reset=noop
 @set mol_type=LINEAR
+@set record_sink=memory
+@set format=csv
 
 @set out_head=heat
 
@@ -48,7 +52,7 @@
 @date /t
 @time /t
 @echo ----------------------------------------
-bin\%prgm% %out_file% %model% %reset% %mol_type%
+bin\%prgm% %out_file% %model% %reset% %mol_type% %record_sink% %format%
 @echo ----------------------------------------
 @date /t
 @time /t
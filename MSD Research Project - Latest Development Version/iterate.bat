@@ -3,6 +3,8 @@
 @rem  * mol_type=LINEAR|CIRCULAR|__PATH__.mmb
 @rem  * randomize=0|1
 @rem  * seed=unique|<uint64>
+@rem  * record_sink=memory|stream, optionally followed by :<decimation> (e.g. stream:10)
+@rem  * format=csv|csv-xyz|binary|binary-xyz ("-xyz" leaves out the norm, theta, and phi columns; binary records go in <out_file>.bin)
 @rem  */
 
 
@@ -11,6 +13,8 @@
 @set mol_type=LINEAR
 @set randomize=1
 @set seed=0
+@set record_sink=memory
+@set format=csv
 
 @set input_file=parameters-iterate.txt
 @set out_head=iteration
@@ -51,7 +55,7 @@
 @date /t
 @time /t
 @echo ----------------------------------------
-bin\%prgm% %out_file% %model% %mol_type% %randomize% %seed% %input_file%
+bin\%prgm% %out_file% %model% %mol_type% %randomize% %seed% %input_file% %record_sink% %format%
 @echo ----------------------------------------
 @date /t
 @time /t
@@ -3,12 +3,18 @@
 # See: MSD-export.cpp
 #
 # Author: Christopher D'Angelo
-# Last Updated: November 30, 2022
-# Version: 1.2
+# Last Updated: October 18, 2026
+# Version: 1.5
 
 from ctypes import *
 from typing import *
 import os
+import random
+
+try:
+	import numpy as np  # only needed for the bulk (NumPy) accessors, e.g. MSD.getSpins()
+except ImportError:
+	np = None
 
 
 # Load DLL
@@ -58,6 +64,11 @@ def _boundsCheck(index, max, min = 0):
 	if index < min or index > max:
 		raise IndexError(f"Index ({index}) out of bounds. Must be between {min} (inclusive) and {max} (inclusive).")
 
+def _numpy():
+	if np is None:
+		raise ImportError("NumPy is required for the bulk accessors (e.g. MSD.getSpins)")
+	return np
+
 
 # public Types (and Globals) exposed by MSD.py library
 PI = c_double.in_dll(msd_clib, "PI").value
@@ -530,6 +541,12 @@ class MSD:
 	UP_DOWN_MODEL = c_void_p.in_dll(msd_clib, "UP_DOWN_MODEL")
 	CONTINUOUS_SPIN_MODEL = c_void_p.in_dll(msd_clib, "CONTINUOUS_SPIN_MODEL")
 
+	# regions, for the bulk accessors (e.g. getSpins)
+	ALL = c_uint.in_dll(msd_clib, "REGION_ALL").value
+	FM_L = c_uint.in_dll(msd_clib, "REGION_FM_L").value
+	FM_R = c_uint.in_dll(msd_clib, "REGION_FM_R").value
+	MOL = c_uint.in_dll(msd_clib, "REGION_MOL").value
+
 
 	# inner classes
 	class Parameters(_StructWithDict):
@@ -654,6 +671,104 @@ class MSD:
 			return copy
 		
 
+	class Run:
+		'''
+		A metropolis(N, freq) running on an internal thread (see MSD.startRun). Until it's over (i.e. wait() returns,
+		or running is False), only observe the MSD through the Run: done (iterations so far) and results.
+		'''
+		RUNNING = c_int.in_dll(msd_clib, "RUN_RUNNING").value
+		DONE = c_int.in_dll(msd_clib, "RUN_DONE").value
+		CANCELLED = c_int.in_dll(msd_clib, "RUN_CANCELLED").value
+		FAILED = c_int.in_dll(msd_clib, "RUN_FAILED").value  # the MSD threw an exception
+
+		def __init__(self, msd, N, freq):
+			self._msd = msd  # keep the MSD alive as long as the run
+			self._run = msd_clib.startRun(msd._msd, N, freq)
+			self.N = N
+
+		def __del__(self): msd_clib.destroyRun(self._run)  # cancels and waits
+
+		def __enter__(self): return self
+		def __exit__(self, *args): self.wait()
+
+		status = property(fget = lambda self: msd_clib.pollRun(self._run, None))
+		running = property(fget = lambda self: self.status == MSD.Run.RUNNING)
+		def _done(self):
+			done = c_ulonglong()
+			msd_clib.pollRun(self._run, byref(done))
+			return done.value
+
+		done = property(fget = _done)
+		results = property(fget = lambda self: msd_clib.getRunResults(self._run))  # at most a few thousand iterations old
+
+		def cancel(self): msd_clib.cancelRun(self._run)
+		def wait(self): return msd_clib.waitRun(self._run)  # returns the final status
+
+		def setSnapshots(self, on = True):
+			''' Turns snapshots of the spins and fluxes (see getSnapshot) on or off. Off by default, since they cost O(n). '''
+			msd_clib.setRunSnapshots(self._run, on)
+
+		def getSnapshot(self):
+			'''
+			The latest snapshot (at most 20 ms old) while running, without stopping the run:
+			(results, indices, spins, fluxes), where spins and fluxes are (n, 3) arrays in the same order as indices.
+			None if there isn't one yet (see setSnapshots).
+			'''
+			np = _numpy()
+			n = self._msd.n
+			results = MSD.Results()
+			indices = np.empty(n, dtype = np.uintc)
+			spins, fluxes = np.empty((n, 3)), np.empty((n, 3))
+			if not msd_clib.getRunSnapshot(self._run, byref(results), indices.ctypes.data_as(POINTER(c_uint)),
+					spins.ctypes.data_as(POINTER(c_double)), fluxes.ctypes.data_as(POINTER(c_double))):
+				return None
+			return (results, indices, spins, fluxes)
+
+
+	class BatchConfig(_StructWithDict):
+		'''
+		One simulation for MSD.runBatch: an MSD (like MSD(width, height, depth, molType = ..., molPosL = ..., ...)),
+		setParameters(parameters), setMolParameters(nodeParameters, edgeParameters), then, from the given seed,
+		randomize (or reinitialize), metropolis(t_eq), and metropolis(simCount, freq).
+		molType and flippingAlgorithm may be None for the defaults (LINEAR_MOL, CONTINUOUS_SPIN_MODEL).
+		Any other field may be given as a keyword, e.g. BatchConfig(11, 10, 10, seed = 7, simCount = 100000).
+		'''
+
+		def __init__(self, width, height, depth, molType = None, flippingAlgorithm = None, **kw):
+			# same defaults as MSD(width, height, depth)
+			self.width, self.height, self.depth = width, height, depth
+			self.molPosL, self.molPosR = (width - 1) // 2, width // 2
+			self.topL, self.bottomL, self.frontR, self.backR = 0, height - 1, 0, depth - 1
+			self.molType = None if molType is None else molType.value
+			self.flippingAlgorithm = None if flippingAlgorithm is None else flippingAlgorithm.value
+			self.parameters = MSD.Parameters()
+			self.nodeParameters, self.edgeParameters = Molecule.NodeParameters(), Molecule.EdgeParameters()
+			self.seed = random.getrandbits(32)
+			self.randomize = True
+			self.t_eq, self.simCount, self.freq = 0, 0, 0
+			super().__init__(**kw)
+
+	class BatchResult(_StructWithDict):
+		''' The outcome of one BatchConfig: final results, specific heat (c*), and susceptibility (x*). '''
+
+	# (set here, since the nested classes can't see Parameters and Results)
+	BatchConfig._fields_ = [
+		("width", c_uint), ("height", c_uint), ("depth", c_uint),
+		("molPosL", c_uint), ("molPosR", c_uint),
+		("topL", c_uint), ("bottomL", c_uint), ("frontR", c_uint), ("backR", c_uint),
+		("molType", c_void_p), ("flippingAlgorithm", c_void_p),
+		("parameters", Parameters),
+		("nodeParameters", Molecule.NodeParameters), ("edgeParameters", Molecule.EdgeParameters),
+		("seed", c_ulong), ("randomize", c_bool),
+		("t_eq", c_ulonglong), ("simCount", c_ulonglong), ("freq", c_ulonglong)
+		]
+	BatchResult._fields_ = [
+		("results", Results),
+		("c", c_double), ("cL", c_double), ("cR", c_double), ("cm", c_double), ("cmL", c_double), ("cmR", c_double), ("cLR", c_double),
+		("x", c_double), ("xL", c_double), ("xR", c_double), ("xm", c_double),
+		("failed", c_bool)  # e.g. invalid dimensions
+		]
+
 
 	# MSD Methods and Properties
 	def __init__(self, width, height, depth, \
@@ -769,6 +884,19 @@ class MSD:
 	def record(self, record):
 		n = len(record)
 		msd_clib.setRecord(self._msd, (MSD.Results * n)(*record), n)
+
+	def getRecordArray(self, copy = True):
+		'''
+		The record as a NumPy structured array (fields: t, M, ML, ..., ULR; each Vector has fields x, y, z).
+		If copy is False, the array is a view of the MSD's own record: no copying, but it is only valid
+		until the record changes (e.g. metropolis or reinitialize), or the MSD is destroyed.
+		'''
+		np = _numpy()
+		n = msd_clib.getRecordSize(self._msd)
+		if n == 0:
+			return np.zeros(0, dtype = np.dtype(MSD.Results))
+		arr = np.ctypeslib.as_array(msd_clib.getRecord(self._msd), shape = (n,))
+		return arr.copy() if copy else arr
 	
 	flippingAlgorithm = property(fset = lambda self, algo: msd_clib.setFlippingAlgorithm(self._msd, algo))
 
@@ -872,6 +1000,92 @@ class MSD:
 		else:
 			msd_clib.setLocalM_v(self._msd, x, y, z, spin, flux)
 	
+	# Bulk accessors (NumPy): one foreign call per array, instead of one (or more) per atom.
+	# region: MSD.ALL (default), MSD.FM_L, MSD.FM_R, or MSD.MOL. Atoms are in the same order as iter(msd).
+	def getRegionSize(self, region = ALL): return msd_clib.getRegionSize(self._msd, region)
+
+	def getIndices(self, region = ALL):
+		''' (n,) array of each atom's index '''
+		out = _numpy().empty(self.getRegionSize(region), dtype = np.uintc)
+		msd_clib.copyIndices(self._msd, region, out.ctypes.data_as(POINTER(c_uint)))
+		return out
+
+	def getPositions(self, region = ALL):
+		''' (n, 3) array of each atom's (x, y, z) '''
+		out = _numpy().empty((self.getRegionSize(region), 3), dtype = np.uintc)
+		msd_clib.copyPositions(self._msd, region, out.ctypes.data_as(POINTER(c_uint)), 3)
+		return out
+
+	def _copyVectors(self, copy, region, columns = 3, offset = 0, out = None):
+		if out is None:
+			out = _numpy().empty((self.getRegionSize(region), columns))
+		copy(self._msd, region, out[:, offset:].ctypes.data_as(POINTER(c_double)), columns)  # (starts at column "offset")
+		return out
+
+	def getSpins(self, region = ALL):
+		''' (n, 3) array of each atom's spin '''
+		return self._copyVectors(msd_clib.copySpins, region)
+
+	def getFluxes(self, region = ALL):
+		''' (n, 3) array of each atom's flux '''
+		return self._copyVectors(msd_clib.copyFluxes, region)
+
+	def getLocalMs(self, region = ALL):
+		''' (n, 3) array of each atom's local magnetization (spin + flux) '''
+		return self._copyVectors(msd_clib.copyLocalMs, region)
+
+	def getState(self, region = ALL):
+		''' (n, 9) array of each atom's spin, flux, and localM (as columns 0-2, 3-5, and 6-8) '''
+		out = self._copyVectors(msd_clib.copySpins, region, 9, 0)
+		self._copyVectors(msd_clib.copyFluxes, region, 9, 3, out)
+		return self._copyVectors(msd_clib.copyLocalMs, region, 9, 6, out)
+
+	def _view(self, view):
+		np = _numpy()
+		stride = c_size_t()
+		address = view(self._msd, byref(stride))
+		n, s = self.n, stride.value
+		buffer = (c_char * (n * s)).from_address(address)
+		buffer._msd = self  # keep the MSD (which owns the memory) alive as long as the view
+		arr = np.ndarray((n, 3), dtype = np.float64, buffer = buffer, strides = (s, 8))
+		arr.flags.writeable = False  # writes would bypass the MSD's energy and magnetization bookkeeping
+		return arr
+
+	def viewSpins(self):
+		'''
+		Zero-copy, read-only view of the FM_L and FM_R spins: an (n, 3) array, in the same order as getIndices().
+		Always up-to-date, with no copying. Mol. atoms are 0 (use getSpins(MSD.MOL) for the mol.).
+		'''
+		return self._view(msd_clib.viewSpins)
+
+	def viewFluxes(self):
+		''' Zero-copy, read-only view of the FM_L and FM_R fluxes. (See viewSpins.) '''
+		return self._view(msd_clib.viewFluxes)
+
+	# Change tracking: for sending only the atoms that changed since a previous frame (e.g. to a visualization).
+	# Each call to nextChangeFrame() or getDeltaFrame() ends a frame, and returns its token. Token 0 is before everything.
+	changeTracking = property(
+		fget = lambda self: msd_clib.getChangeTracking(self._msd),
+		fset = lambda self, on: msd_clib.setChangeTracking(self._msd, on) )
+
+	def nextChangeFrame(self): return msd_clib.nextChangeFrame(self._msd)
+
+	def getChangedIndices(self, token):
+		''' (n,) array of the indices of the atoms changed after the frame "token" (all of them if changeTracking is off) '''
+		out = _numpy().empty(msd_clib.getChangedCount(self._msd, token), dtype = np.uintc)
+		msd_clib.copyChangedIndices(self._msd, token, out.ctypes.data_as(POINTER(c_uint)))
+		return out
+
+	def getDeltaFrame(self, token):
+		'''
+		Binary delta frame (bytes) of the atoms changed after the frame "token", and ends the current frame.
+		The new token is in the frame's header (see StateFrame.h).
+		'''
+		size = msd_clib.getDeltaFrame(self._msd, token, None, 0)
+		buffer = (c_ubyte * size)()
+		msd_clib.getDeltaFrame(self._msd, token, buffer, size)
+		return bytes(buffer)
+
 	def __getitem__(self, idx):
 		if isinstance(idx, Iterable):
 			return (self.getSpin(*idx), self.getFlux(*idx))
@@ -920,6 +1134,23 @@ class MSD:
 			msd_clib.metropolis_o(self._msd, N)
 		else:
 			msd_clib.metropolis_r(self._msd, N, freq)
+
+	def startRun(self, N, freq = None):
+		''' Same as metropolis(N, freq), but returns right away: returns an MSD.Run to follow (or cancel) it. '''
+		return MSD.Run(self, N, 0 if freq is None else freq)
+
+	@staticmethod
+	def runBatch(configs, threadCount = 0):
+		'''
+		Runs each MSD.BatchConfig in configs on an internal pool of threadCount threads (0 means one per core),
+		and returns their outcomes as a NumPy structured array of MSD.BatchResult, in the same order.
+		The outcomes don't depend on threadCount.
+		'''
+		np = _numpy()
+		n = len(configs)
+		results = (MSD.BatchResult * n)()
+		msd_clib.runBatch((MSD.BatchConfig * n)(*configs), results, n, threadCount)
+		return np.frombuffer(results, dtype = np.dtype(MSD.BatchResult))
 	
 	specificHeat = property(fget = lambda self : msd_clib.specificHeat(self._msd))
 	specificHeat_L = property(fget = lambda self : msd_clib.specificHeat_L(self._msd))
@@ -997,6 +1228,21 @@ _sig(None, msd_clib.setFlux_v, [c_void_p] + 3 * [c_uint] + [POINTER(Vector)])
 _sig(None, msd_clib.setLocalM_i, [c_void_p, c_uint] + 2 * [POINTER(Vector)])
 _sig(None, msd_clib.setLocalM_v, [c_void_p] + 3 * [c_uint] + 2 * [POINTER(Vector)])
 
+_sig(c_size_t, msd_clib.getRegionSize, [c_void_p, c_uint])
+_sig(None, msd_clib.copyIndices, [c_void_p, c_uint, POINTER(c_uint)])
+_sig(None, msd_clib.copyPositions, [c_void_p, c_uint, POINTER(c_uint), c_size_t])
+_sig(None, msd_clib.copySpins, [c_void_p, c_uint, POINTER(c_double), c_size_t])
+_sig(None, msd_clib.copyFluxes, [c_void_p, c_uint, POINTER(c_double), c_size_t])
+_sig(None, msd_clib.copyLocalMs, [c_void_p, c_uint, POINTER(c_double), c_size_t])
+_sig(c_void_p, msd_clib.viewSpins, [c_void_p, POINTER(c_size_t)])
+_sig(c_void_p, msd_clib.viewFluxes, [c_void_p, POINTER(c_size_t)])
+_sig(None, msd_clib.setChangeTracking, [c_void_p, c_bool])
+_sig(c_bool, msd_clib.getChangeTracking, [c_void_p])
+_sig(c_ulonglong, msd_clib.nextChangeFrame, [c_void_p])
+_sig(c_size_t, msd_clib.getChangedCount, [c_void_p, c_ulonglong])
+_sig(None, msd_clib.copyChangedIndices, [c_void_p, c_ulonglong, POINTER(c_uint)])
+_sig(c_size_t, msd_clib.getDeltaFrame, [c_void_p, c_ulonglong, POINTER(c_ubyte), c_size_t])
+
 _sig(c_uint, msd_clib.getN, [c_void_p])
 _sig(c_uint, msd_clib.getNL, [c_void_p])
 _sig(c_uint, msd_clib.getNR, [c_void_p])
@@ -1028,6 +1274,15 @@ _sig(None, msd_clib.reinitialize, [c_void_p, c_bool])
 _sig(None, msd_clib.randomize, [c_void_p, c_bool])
 _sig(None, msd_clib.metropolis_o, [c_void_p, c_ulonglong])
 _sig(None, msd_clib.metropolis_r, [c_void_p] + 2 * [c_ulonglong])
+_sig(c_void_p, msd_clib.startRun, [c_void_p] + 2 * [c_ulonglong])
+_sig(c_int, msd_clib.pollRun, [c_void_p, POINTER(c_ulonglong)])
+_sig(MSD.Results, msd_clib.getRunResults, [c_void_p])
+_sig(None, msd_clib.cancelRun, [c_void_p])
+_sig(c_int, msd_clib.waitRun, [c_void_p])
+_sig(None, msd_clib.setRunSnapshots, [c_void_p, c_bool])
+_sig(c_bool, msd_clib.getRunSnapshot, [c_void_p, POINTER(MSD.Results), POINTER(c_uint)] + 2 * [POINTER(c_double)])
+_sig(None, msd_clib.destroyRun, [c_void_p])
+_sig(None, msd_clib.runBatch, [POINTER(MSD.BatchConfig), POINTER(MSD.BatchResult), c_size_t, c_uint])
 
 _sig(c_double, msd_clib.specificHeat, [c_void_p])
 _sig(c_double, msd_clib.specificHeat_L, [c_void_p])
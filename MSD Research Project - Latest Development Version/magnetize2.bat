@@ -3,6 +3,7 @@
 @rem  * randomize=0|1
 @rem  * startAtMaxB=0|1
 @rem  * mol_type=LINEAR|CIRCULAR|__PATH__.mmb
+@rem  * format=csv|csv-xyz|binary|binary-xyz ("-xyz" leaves out the norm, theta, and phi columns)
 @rem  */
 
 @rem // ---- Edit Here ----
@@ -10,6 +11,7 @@
 @set randomize=0
 @set startAtMaxB=0
 @set mol_type=LINEAR
+@set format=csv
 
 @set out_head=magnetization2
 
@@ -49,7 +51,7 @@
 @date /t
 @time /t
 @echo ----------------------------------------
-bin\%prgm% %out_file% %model% %randomize% %startAtMaxB% %mol_type%
+bin\%prgm% %out_file% %model% %randomize% %startAtMaxB% %mol_type% %format%
 @echo ----------------------------------------
 @date /t
 @time /t
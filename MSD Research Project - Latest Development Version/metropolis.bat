@@ -3,6 +3,7 @@
 @rem  * mode=RANDOMIZE|REINITIALIZE
 @rem  * mol_type=LINEAR|CIRCULAR|__PATH__.mmb
 @rem  * threadCount=<uint32 >= 1>
+@rem  * format=xml|columns
 @rem  */
 
 
@@ -11,6 +12,7 @@
 @set mode=RANDOMIZE
 @set mol_type=LINEAR
 @set threadCount=3
+@set format=xml
 
 @set paramFile=parameters-metropolis.txt
 @set out_head=metropolis
@@ -30,7 +32,7 @@
 @date /t
 @time /t
 @echo ----------------------------------------
-bin\%prgm% %paramFile% %out_file% %model% %mode% %mol_type% %threadCount%
+bin\%prgm% %paramFile% %out_file% %model% %mode% %mol_type% %threadCount% %format%
 @echo ----------------------------------------
 @date /t
 @time /t
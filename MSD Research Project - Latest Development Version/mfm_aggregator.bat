@@ -1,3 +1,15 @@
+@rem /** ---- Docs ----
+@rem  * inputs=(blank to paste data from an iterate output file)
+@rem  *       |iterate CSV, metropolis XML, or metropolis column files (quoted, space separated)
+@rem  */
+
+
+@rem // ---- Edit Here ----
+@set inputs=
+
+
+
+@rem ------ Don't Edit Below This ------
 @rem -- Find the next open file name
 @set id=0
 :INC_ID
@@ -9,7 +21,7 @@
 @date /t
 @time /t
 @echo ----------------------------------------
-bin\mfm_aggregator %out_file%
+bin\mfm_aggregator %out_file% %inputs%
 @echo ----------------------------------------
 @date /t
 @time /t
@@ -0,0 +1,38 @@
+@rem /** ---- Docs ----
+@rem  * lift=<double > 0> (height of the MFM tip above the device)
+@rem  * quantity=dHz|Hz
+@rem  * inputs=(blank to paste data from an iterate output file)
+@rem  *       |iterate CSV, metropolis XML, or metropolis column files (quoted, space separated)
+@rem  */
+
+
+@rem // ---- Edit Here ----
+@set lift=1
+@set quantity=dHz
+@set inputs=
+
+
+
+@rem ------ Don't Edit Below This ------
+@rem -- Find the next open file name
+@set id=0
+:INC_ID
+@set /a id=%id%+1
+@if %id% LEQ 0 goto STOP
+@set out_file="out\mfm_image, %date:~4,2%-%date:~7,2%-%date:~10,4%, %id%.csv"
+@if exist %out_file% goto INC_ID
+
+@date /t
+@time /t
+@echo ----------------------------------------
+bin\mfm_image %out_file% %lift% %quantity% %inputs%
+@echo ----------------------------------------
+@date /t
+@time /t
+@goto DONE
+
+:STOP
+@echo Error (%out_file%): No more possible file names exist!
+
+:DONE
+@pause
@@ -1,9 +1,13 @@
 @set py_port=80
 @set msd_host=localhost
 @set msd_port=8082
+@set service_port=8083
+
+@rem Run MSD Service (optional: runs every simulation in one process; remove to use a worker process each)
+@if exist bin\msd_service.exe @start bin\msd_service.exe %service_port%
 
 @rem Run MSD Server
-@start java -Xmx6G -cp bin msd_server.MSDServer %msd_host% %msd_port%
+@start java -Xmx6G -Dmsd.service=localhost:%service_port% -cp bin msd_server.MSDServer %msd_host% %msd_port%
 
 @rem Run HTTP Server
 @rem @start python -m http.server %py_port%
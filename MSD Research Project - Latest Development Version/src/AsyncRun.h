@@ -0,0 +1,207 @@
+/**
+ * @file AsyncRun.h
+ * @author Christopher D'Angelo
+ * @brief Contains udc::AsyncRun, which runs MSD::metropolis(N, freq) on its own thread,
+ *        with progress, cancellation, and the latest Results (and optionally spins and fluxes) available while it runs.
+ *        Used by MSD-export's startRun/pollRun/cancelRun/waitRun.
+ *
+ * @version 6.4
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2011-2026
+ */
+
+#ifndef UDC_ASYNC_RUN
+#define UDC_ASYNC_RUN
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include "MSD.h"
+#include "Snapshot.h"
+
+
+namespace udc {
+
+using std::atomic;
+using std::exception_ptr;
+using std::lock_guard;
+using std::mutex;
+using std::thread;
+
+
+/**
+ * @brief Runs msd.metropolis(N, freq) (or msd.metropolis(N) if freq is 0) on a new thread.
+ *
+ * The iterations are done in slices of at most SLICE, which give the same results as one call
+ * (including the record). Between slices, the run checks for cancel() and publishes its progress
+ * (getDone) and the latest Results (getResults), so there is nothing extra per iteration. If enabled
+ * (setSnapshots), it also publishes the spins and fluxes (getSnapshot) every so often (see SnapshotPublisher).
+ * Reading these never blocks the run.
+ *
+ * The msd must not be used by anyone else (including its record) until the run is over
+ * (i.e. wait() returns, or getStatus() != RUNNING). Destroying the AsyncRun cancels and waits for it.
+ */
+class AsyncRun {
+ public:
+	enum Status { RUNNING, DONE, CANCELLED, FAILED };  // FAILED: the msd threw (e.g. its RecordSink)
+
+	static constexpr unsigned long long SLICE = 1000;
+
+	AsyncRun(MSD &msd, unsigned long long N, unsigned long long freq = 0);
+	~AsyncRun();
+
+	Status getStatus() const;
+	unsigned long long getDone() const;  // iterations done so far
+	unsigned long long getN() const;
+
+	/** @return The Results at the end of the last slice (or at the start). */
+	MSD::Results getResults() const;
+
+	/** Turns the publishing of the spins and fluxes on or off (off by default). */
+	void setSnapshots(bool on);
+
+	/** @return false if no spins and fluxes have been published yet */
+	bool getSnapshot(MSDSnapshot &snapshot) const;
+
+	/** Stops the run at the end of the current slice. Doesn't wait for it. */
+	void cancel();
+
+	/**
+	 * Waits for the run to end.
+	 * If it FAILED, rethrows what the msd threw (only the first time: after that, it just returns FAILED).
+	 */
+	Status wait();
+
+ private:
+	MSD &msd;
+	const unsigned long long N, freq;
+
+	atomic<int> status;
+	atomic<bool> cancelled;
+	atomic<unsigned long long> done;
+
+	SnapshotPublisher publisher;
+
+	exception_ptr error;
+	mutex joinLock;
+	thread runner;
+
+	bool advance(unsigned long long n);  // false if cancelled
+	void record();
+	void run();  // body of the runner thread
+
+	AsyncRun(const AsyncRun &);  // do not use: not implemented!
+	AsyncRun& operator=(const AsyncRun &);  // do not use: not implemented!
+};
+
+
+//--------------------------------------------------------------------------------
+
+AsyncRun::AsyncRun(MSD &msd, unsigned long long N, unsigned long long freq)
+: msd(msd), N(N), freq(freq), status(RUNNING), cancelled(false), done(0) {
+	publisher.publish(msd);
+	runner = thread(&AsyncRun::run, this);
+}
+
+AsyncRun::~AsyncRun() {
+	cancel();
+	try {
+		wait();
+	} catch(...) {
+		// ignored
+	}
+}
+
+AsyncRun::Status AsyncRun::getStatus() const {
+	return (Status) status.load();
+}
+
+unsigned long long AsyncRun::getDone() const {
+	return done.load(std::memory_order_relaxed);
+}
+
+unsigned long long AsyncRun::getN() const {
+	return N;
+}
+
+MSD::Results AsyncRun::getResults() const {
+	MSD::Results r;
+	publisher.getResults(r);  // (always true: published by the constructor)
+	return r;
+}
+
+void AsyncRun::setSnapshots(bool on) {
+	publisher.setStates(on);
+}
+
+bool AsyncRun::getSnapshot(MSDSnapshot &snapshot) const {
+	return publisher.getSnapshot(snapshot);
+}
+
+void AsyncRun::cancel() {
+	cancelled.store(true, std::memory_order_relaxed);
+}
+
+AsyncRun::Status AsyncRun::wait() {
+	lock_guard<mutex> guard(joinLock);
+	if (runner.joinable()) {
+		runner.join();
+		if (error)
+			std::rethrow_exception(error);
+	}
+	return getStatus();
+}
+
+bool AsyncRun::advance(unsigned long long n) {
+	while (n > 0) {
+		if (cancelled.load(std::memory_order_relaxed))
+			return false;
+		unsigned long long k = std::min(n, SLICE);
+		msd.metropolis(k);
+		n -= k;
+		done.store(done.load(std::memory_order_relaxed) + k, std::memory_order_relaxed);
+		publisher.publish(msd);
+	}
+	return true;
+}
+
+// same as MSD::metropolis(N, freq)
+void AsyncRun::record() {
+	if (msd.recordSink == NULL)
+		msd.record.push_back(msd.getResults());
+	else
+		msd.recordSink->put(msd.getResults());
+}
+
+void AsyncRun::run() {
+	bool finished = false;
+	try {
+		if (freq == 0) {
+			finished = advance(N);
+		} else {
+			// same as MSD::metropolis(N, freq)
+			unsigned long long left = N;
+			while (true) {
+				record();
+				if (left >= freq) {
+					if (!advance(freq))
+						break;
+					left -= freq;
+				} else {
+					finished = advance(left);
+					break;
+				}
+			}
+		}
+	} catch(...) {
+		error = std::current_exception();
+	}
+	status = error ? FAILED : finished ? DONE : CANCELLED;
+}
+
+}  // end of namespace udc
+
+#endif
@@ -0,0 +1,137 @@
+/**
+ * @file BatchRun.h
+ * @author Christopher D'Angelo
+ * @brief Contains udc::runBatch, which runs many independent simulations (e.g. a parameter scan)
+ *        on a thread pool, and collects their final Results, specific heat, and susceptibility.
+ *        Used by MSD-export's runBatch (and so MSD.py's MSD.runBatch).
+ *
+ * @version 6.4
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2011-2026
+ */
+
+#ifndef UDC_BATCH_RUN
+#define UDC_BATCH_RUN
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include "MSD.h"
+#include "ThreadPool.h"
+
+
+namespace udc {
+
+using std::condition_variable;
+using std::lock_guard;
+using std::mutex;
+using std::unique_lock;
+
+
+/**
+ * One simulation of a batch: the same steps as the metropolis program.
+ * A plain struct, so that it can be filled in from C (or ctypes).
+ */
+struct BatchConfig {
+	unsigned int width, height, depth;
+	unsigned int molPosL, molPosR;
+	unsigned int topL, bottomL, frontR, backR;
+	const MSD::MolProtoFactory *molType;  // NULL means MSD::LINEAR_MOL
+	const MSD::FlippingAlgorithm *flippingAlgorithm;  // NULL means MSD::CONTINUOUS_SPIN_MODEL
+
+	MSD::Parameters parameters;
+	Molecule::NodeParameters nodeParameters;
+	Molecule::EdgeParameters edgeParameters;
+
+	unsigned long seed;
+	bool randomize;  // random initial state, else MSD::reinitialize
+	unsigned long long t_eq, simCount, freq;  // metropolis(t_eq), then metropolis(simCount, freq)
+};
+
+/** The outcome of one BatchConfig. */
+struct BatchResult {
+	MSD::Results results;  // at the end of the simulation
+	double c, cL, cR, cm, cmL, cmR, cLR;  // specific heat (from the record, so 0 if freq is 0)
+	double x, xL, xR, xm;  // magnetic susceptibility (same)
+	bool failed;  // e.g. invalid dimensions. If so, the rest is 0.
+};
+
+
+/** Runs one BatchConfig on this thread. */
+BatchResult runBatchConfig(const BatchConfig &config);
+
+/**
+ * Runs configs[0..count) on a pool of threadCount threads (0 means one per core), and waits for them all.
+ * results[i] is the outcome of configs[i], the same as runBatchConfig(configs[i]), whatever the number of threads.
+ */
+void runBatch(const BatchConfig *configs, BatchResult *results, size_t count, unsigned int threadCount = 0);
+
+
+//--------------------------------------------------------------------------------
+
+BatchResult runBatchConfig(const BatchConfig &config) {
+	BatchResult r = BatchResult();
+	try {
+		MSD msd(config.width, config.height, config.depth,
+				config.molType == NULL ? MSD::LINEAR_MOL : *config.molType, config.molPosL, config.molPosR,
+				config.topL, config.bottomL, config.frontR, config.backR);
+		msd.setParameters(config.parameters);
+		msd.setMolParameters(config.nodeParameters, config.edgeParameters);
+		if (config.flippingAlgorithm != NULL)
+			msd.flippingAlgorithm = *config.flippingAlgorithm;
+		msd.setSeed(config.seed);
+		if (config.randomize)
+			msd.randomize(false);
+		else
+			msd.reinitialize(false);
+
+		msd.metropolis(config.t_eq, 0);
+		msd.metropolis(config.simCount, config.freq);
+
+		r.results = msd.getResults();
+		r.c = msd.specificHeat();
+		r.cL = msd.specificHeat_L();
+		r.cR = msd.specificHeat_R();
+		r.cm = msd.specificHeat_m();
+		r.cmL = msd.specificHeat_mL();
+		r.cmR = msd.specificHeat_mR();
+		r.cLR = msd.specificHeat_LR();
+		r.x = msd.magneticSusceptibility();
+		r.xL = msd.magneticSusceptibility_L();
+		r.xR = msd.magneticSusceptibility_R();
+		r.xm = msd.magneticSusceptibility_m();
+	} catch(...) {
+		r = BatchResult();
+		r.failed = true;
+	}
+	return r;
+}
+
+void runBatch(const BatchConfig *configs, BatchResult *results, size_t count, unsigned int threadCount) {
+	if (count == 0)
+		return;
+	if (threadCount == 0)
+		threadCount = thread::hardware_concurrency();
+	threadCount = (unsigned int) std::min<size_t>(std::max(threadCount, 1u), count);
+
+	mutex lock;
+	condition_variable finished;
+	size_t left = count;  // guarded by lock
+	{
+		WorkStealingPool pool(threadCount);
+		for (size_t i = 0; i < count; i++)
+			pool.submit([&, i]() {
+				results[i] = runBatchConfig(configs[i]);  // (never throws)
+				lock_guard<mutex> guard(lock);
+				if (--left == 0)
+					finished.notify_one();
+			});
+		unique_lock<mutex> guard(lock);
+		finished.wait(guard, [&]() { return left == 0; });
+	}
+}
+
+}  // end of namespace udc
+
+#endif
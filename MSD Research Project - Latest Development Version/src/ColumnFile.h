@@ -0,0 +1,262 @@
+/**
+ * @file ColumnFile.h
+ * @author Christopher D'Angelo
+ * @brief Contains udc::ColumnFileWriter and udc::ColumnFileReader for the columnar binary
+ *        output of metropolis (an alternative to the XML output).
+ *
+ * @version 6.4
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2011-2026
+ */
+
+#ifndef UDC_COLUMN_FILE
+#define UDC_COLUMN_FILE
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+#include "udc.h"
+
+
+namespace udc {
+
+using std::string;
+using std::vector;
+using std::runtime_error;
+
+
+/*
+ * Layout of a column file (all numbers in native endianness):
+ *
+ *   [0]  8 byte magic string: COLUMN_FILE_MAGIC
+ *   [8]  uint64: row capacity, R (number of rows the file has room for)
+ *   [16] uint64: row count (number of rows written so far; updated after each row)
+ *   [24] uint64: snapshot size, S (number of doubles per snapshot; 0 until the first snapshot)
+ *   [32] uint64: data offset (start of the columns, aligned to 64 bytes)
+ *   [40] uint32: column count, C
+ *   [44] C times: uint8 kind ('p' for parameter, 'r' for result), uint32 length, name
+ *        uint32 length, info (free-form text, e.g. "width=10,height=10,...")
+ *
+ *   [data offset]                columns: C arrays of R doubles each (only the first "row count" are valid)
+ *   [data offset + C * R * 8]    snapshots: one array of S doubles per row
+ *
+ * Each column is contiguous, so a reader only has to touch the columns it uses.
+ */
+const char COLUMN_FILE_MAGIC[8] = { 'M', 'S', 'D', 'C', 'O', 'L', 'S', '\x01' };
+
+
+/**
+ * @brief Writes a column file one row at a time. The number of rows (capacity) must be known up front.
+ *        Each row is written into its place in every column, and the row count in the header is
+ *        updated after each row, so the file is always readable even if the program is stopped early.
+ */
+class ColumnFileWriter {
+ private:
+	std::fstream file;
+	uint64_t capacity, count, snapshotSize, dataOffset;
+	uint32_t columnCount;
+
+	template <typename T> void put(const T &value) {
+		file.write(reinterpret_cast<const char *>(&value), sizeof(T));
+	}
+
+	ColumnFileWriter(const ColumnFileWriter &);  // do not use: not implemented!
+	ColumnFileWriter& operator=(const ColumnFileWriter &);  // do not use: not implemented!
+
+ public:
+	/**
+	 * @param kinds Same length as names: 'p' (parameter) or 'r' (result) for each column.
+	 * @throw std::ios::failure if the file can't be written.
+	 */
+	ColumnFileWriter(const string &filename, const vector<string> &names, const vector<char> &kinds,
+	                 uint64_t capacity, const string &info = "");
+
+	uint64_t size() const { return count; }
+	uint64_t getCapacity() const { return capacity; }
+
+	/**
+	 * @brief Writes the next row: one value per column, and optionally a snapshot.
+	 *        Every row's snapshot must be the same size as the first one written.
+	 * @throw std::out_of_range if the file is full, or the snapshot size changed.
+	 */
+	void append(const double *values, const double *snapshot = NULL, uint64_t snapshotSize = 0);
+
+	void flush() { file.flush(); }
+};
+
+
+/**
+ * @brief Read-only, memory mapped view of a column file.
+ *        Columns are returned as plain arrays of doubles, pointing directly into the mapped file.
+ */
+class ColumnFileReader {
+ private:
+	MappedFile file;
+	const unsigned char *base;  // == file.data()
+
+	uint64_t capacity, count, snapshotSize, dataOffset;
+	vector<string> names;
+	vector<char> kinds;
+	string info;
+
+	ColumnFileReader(const ColumnFileReader &);  // do not use: not implemented!
+	ColumnFileReader& operator=(const ColumnFileReader &);  // do not use: not implemented!
+
+ public:
+	/** @throw std::runtime_error if the file can't be opened or isn't a column file. */
+	ColumnFileReader(const string &filename);
+
+	/** @return true if the given file starts with COLUMN_FILE_MAGIC. */
+	static bool isColumnFile(const string &filename);
+
+	uint64_t rows() const { return count; }
+	size_t columns() const { return names.size(); }
+	const string& name(size_t col) const { return names[col]; }
+	char kind(size_t col) const { return kinds[col]; }
+	const string& getInfo() const { return info; }
+
+	/** @return the index of the named column, or -1 if there isn't one. */
+	long find(const string &name) const;
+
+	/** @return rows() doubles. Does NO bounds checking. */
+	const double* column(size_t col) const;
+
+	uint64_t getSnapshotSize() const { return snapshotSize; }
+	/** @return getSnapshotSize() doubles for the given row, or NULL if there are no snapshots. */
+	const double* snapshot(uint64_t row) const;
+};
+
+
+//--------------------------------------------------------------------------------
+
+ColumnFileWriter::ColumnFileWriter(const string &filename, const vector<string> &names, const vector<char> &kinds,
+                                   uint64_t capacity, const string &info)
+: capacity(capacity), count(0), snapshotSize(0), dataOffset(0), columnCount(static_cast<uint32_t>(names.size())) {
+	file.exceptions(std::ios::badbit | std::ios::failbit);
+	file.open(filename, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+
+	file.write(COLUMN_FILE_MAGIC, sizeof(COLUMN_FILE_MAGIC));
+	put(capacity);
+	put(count);
+	put(snapshotSize);
+	put(dataOffset);  // place holder
+	put(columnCount);
+	for (size_t i = 0; i < names.size(); i++) {
+		put(static_cast<uint8_t>(kinds[i]));
+		put(static_cast<uint32_t>(names[i].size()));
+		file.write(names[i].data(), names[i].size());
+	}
+	put(static_cast<uint32_t>(info.size()));
+	file.write(info.data(), info.size());
+
+	// align the columns so they can be used directly as double arrays once mapped
+	dataOffset = (static_cast<uint64_t>(file.tellp()) + 63) / 64 * 64;
+	while (static_cast<uint64_t>(file.tellp()) < dataOffset)
+		file.put('\0');
+	file.seekp(32);
+	put(dataOffset);
+	file.flush();
+}
+
+void ColumnFileWriter::append(const double *values, const double *snapshot, uint64_t snapshotSize) {
+	if (count >= capacity)
+		throw std::out_of_range("ColumnFileWriter::append(): file is full");
+	if (snapshot != NULL) {
+		if (count == 0 && this->snapshotSize == 0) {
+			this->snapshotSize = snapshotSize;
+			file.seekp(24);
+			put(snapshotSize);
+		} else if (snapshotSize != this->snapshotSize) {
+			throw std::out_of_range("ColumnFileWriter::append(): snapshot size changed");
+		}
+	}
+
+	for (uint32_t c = 0; c < columnCount; c++) {
+		file.seekp(dataOffset + (c * capacity + count) * sizeof(double));
+		put(values[c]);
+	}
+	if (snapshot != NULL && snapshotSize > 0) {
+		file.seekp(dataOffset + (columnCount * capacity + count * snapshotSize) * sizeof(double));
+		file.write(reinterpret_cast<const char *>(snapshot), snapshotSize * sizeof(double));
+	}
+
+	// commit the row
+	count++;
+	file.seekp(16);
+	put(count);
+	file.flush();
+}
+
+
+ColumnFileReader::ColumnFileReader(const string &filename) : file(filename), base(file.data()) {
+	// read the header
+	const unsigned char *p = base, *end = base + file.size();
+	auto need = [&](uint64_t n) {
+		if (static_cast<uint64_t>(end - p) < n)
+			throw runtime_error("Corrupted column file (header): " + filename);
+	};
+	need(44);
+	if (memcmp(p, COLUMN_FILE_MAGIC, sizeof(COLUMN_FILE_MAGIC)) != 0)
+		throw runtime_error("Not a column file: " + filename);
+	p += sizeof(COLUMN_FILE_MAGIC);
+	uint32_t columnCount, len;
+	bread(capacity, p);
+	bread(count, p);
+	bread(snapshotSize, p);
+	bread(dataOffset, p);
+	bread(columnCount, p);
+	for (uint32_t c = 0; c < columnCount; c++) {
+		uint8_t k;
+		need(5);
+		bread(k, p);
+		bread(len, p);
+		need(len);
+		kinds.push_back(static_cast<char>(k));
+		names.push_back(string(reinterpret_cast<const char *>(p), len));
+		p += len;
+	}
+	need(4);
+	bread(len, p);
+	need(len);
+	info.assign(reinterpret_cast<const char *>(p), len);
+
+	// only trust the rows that actually made it into the file
+	uint64_t columnBytes = names.size() * capacity * sizeof(double);
+	if (count > capacity || dataOffset % sizeof(double) != 0 || dataOffset > file.size()
+			|| (count > 0 && !names.empty() && dataOffset + ((names.size() - 1) * capacity + count) * sizeof(double) > file.size()))
+		throw runtime_error("Corrupted column file (data): " + filename);
+	if (snapshotSize > 0 && dataOffset + columnBytes + count * snapshotSize * sizeof(double) > file.size())
+		snapshotSize = 0;  // snapshots are missing (e.g. the file was truncated), but the columns are still fine
+}
+
+bool ColumnFileReader::isColumnFile(const string &filename) {
+	std::ifstream in(filename, std::ios::binary);
+	char magic[sizeof(COLUMN_FILE_MAGIC)];
+	return in.read(magic, sizeof(magic)) && memcmp(magic, COLUMN_FILE_MAGIC, sizeof(magic)) == 0;
+}
+
+long ColumnFileReader::find(const string &name) const {
+	for (size_t c = 0; c < names.size(); c++)
+		if (names[c] == name)
+			return static_cast<long>(c);
+	return -1;
+}
+
+const double* ColumnFileReader::column(size_t col) const {
+	return reinterpret_cast<const double *>(base + dataOffset + col * capacity * sizeof(double));
+}
+
+const double* ColumnFileReader::snapshot(uint64_t row) const {
+	if (snapshotSize == 0)
+		return NULL;
+	return reinterpret_cast<const double *>(base + dataOffset + (names.size() * capacity + row * snapshotSize) * sizeof(double));
+}
+
+}  // end of namespace udc
+
+#endif
@@ -0,0 +1,133 @@
+/**
+ * @file Dipolar.h
+ * @author Christopher D'Angelo
+ * @brief Contains udc::DipolarField, which computes the long-range dipolar (demagnetizing) field
+ *        inside a lattice of magnetic moments as an FFT convolution. Used by MSD for its optional
+ *        dipolar energy term (see MSD::setDipolar).
+ *
+ * @version 6.4
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2011-2026
+ */
+
+#ifndef UDC_DIPOLAR
+#define UDC_DIPOLAR
+
+#include <cmath>
+#include <vector>
+#include "FFT.h"
+#include "Vector.h"
+#include "udc.h"
+
+
+namespace udc {
+
+/**
+ * @brief Computes the dipolar field at every site of a (width x height x depth) lattice of moments,
+ *        due to every other moment:
+ *   H_i = sum_{j != i} T(r_ij) m_j,  where T_ab(r) = (3 r_a r_b - delta_ab |r|^2) / |r|^5
+ * in lattice units, and without the mu_0 / 4 pi factor (the same convention as MFMImager).
+ *
+ * Instead of the O(N^2) direct sum, the three components of m are convolved with the six unique
+ * components of T using a zero-padded 3D FFT: O(N log N). T only depends on the geometry, so its
+ * transform is computed once, in the constructor. Memory: 9 complex arrays of the padded size
+ * (each dimension is padded to a power of 2, at least 2 * size - 1).
+ */
+class DipolarField {
+ public:
+	/** The 6 unique components of T(X, Y, Z): xx, yy, zz, xy, xz, yz. All 0 at the origin (no self-interaction). */
+	static void dipoleTensor(double X, double Y, double Z, double t[6]);
+
+ private:
+	unsigned int width, height, depth;
+	size_t px, py, pz;  // padded sizes
+	std::vector<Complex> kernels[6];  // FFT of each component of T
+
+ public:
+	DipolarField(unsigned int width, unsigned int height, unsigned int depth);
+
+	unsigned int getWidth() const { return width; }
+	unsigned int getHeight() const { return height; }
+	unsigned int getDepth() const { return depth; }
+
+	/**
+	 * @param moments width * height * depth moments, index (z * height + y) * width + x (the same as MSD).
+	 *                Sites which shouldn't contribute (empty, or excluded) should be Vector::ZERO.
+	 * @param field Set to the width * height * depth field vectors, same index.
+	 */
+	void compute(const Vector *moments, std::vector<Vector> &field) const;
+};
+
+
+//--------------------------------------------------------------------------------
+
+void DipolarField::dipoleTensor(double X, double Y, double Z, double t[6]) {
+	const double r2 = X * X + Y * Y + Z * Z;
+	if (r2 == 0) {
+		for (int c = 0; c < 6; c++)
+			t[c] = 0;
+		return;
+	}
+	const double r5 = r2 * r2 * sqrt(r2);
+	t[0] = (3 * X * X - r2) / r5;
+	t[1] = (3 * Y * Y - r2) / r5;
+	t[2] = (3 * Z * Z - r2) / r5;
+	t[3] = 3 * X * Y / r5;
+	t[4] = 3 * X * Z / r5;
+	t[5] = 3 * Y * Z / r5;
+}
+
+DipolarField::DipolarField(unsigned int width, unsigned int height, unsigned int depth)
+: width(width), height(height), depth(depth),
+  px(nextPow2(2 * (size_t) width - 1)), py(nextPow2(2 * (size_t) height - 1)), pz(nextPow2(2 * (size_t) depth - 1)) {
+	for (int c = 0; c < 6; c++)
+		kernels[c].assign(px * py * pz, Complex());
+	double t[6];
+	for (long Z = 1 - (long) depth; Z < (long) depth; Z++)
+		for (long Y = 1 - (long) height; Y < (long) height; Y++)
+			for (long X = 1 - (long) width; X < (long) width; X++) {
+				dipoleTensor(X, Y, Z, t);
+				// negative offsets wrap around (circular convolution, but the padding keeps it from overlapping)
+				size_t i = (((Z + pz) % pz) * py + (Y + py) % py) * px + (X + px) % px;
+				for (int c = 0; c < 6; c++)
+					kernels[c][i] = t[c];
+			}
+	for (int c = 0; c < 6; c++)
+		fft3D(kernels[c], px, py, pz);
+}
+
+void DipolarField::compute(const Vector *moments, std::vector<Vector> &field) const {
+	std::vector<Complex> m[3];  // FFT of m_x, m_y, m_z
+	for (int c = 0; c < 3; c++) {
+		m[c].assign(px * py * pz, Complex());
+		for (unsigned int z = 0; z < depth; z++)
+			for (unsigned int y = 0; y < height; y++)
+				for (unsigned int x = 0; x < width; x++) {
+					const Vector &v = moments[((size_t) z * height + y) * width + x];
+					m[c][(z * py + y) * px + x] = (c == 0 ? v.x : c == 1 ? v.y : v.z);
+				}
+		fft3D(m[c], px, py, pz);
+	}
+
+	// H_a = sum_b T_ab * m_b; T is symmetric: [a][b] -> index into kernels
+	const int T[3][3] = { { 0, 3, 4 }, { 3, 1, 5 }, { 4, 5, 2 } };
+	field.assign((size_t) width * height * depth, Vector::ZERO);
+	std::vector<Complex> h(px * py * pz);
+	for (int a = 0; a < 3; a++) {
+		const std::vector<Complex> &k0 = kernels[T[a][0]], &k1 = kernels[T[a][1]], &k2 = kernels[T[a][2]];
+		for (size_t i = 0; i < h.size(); i++)
+			h[i] = k0[i] * m[0][i] + k1[i] * m[1][i] + k2[i] * m[2][i];
+		fft3D(h, px, py, pz, true);
+		for (unsigned int z = 0; z < depth; z++)
+			for (unsigned int y = 0; y < height; y++)
+				for (unsigned int x = 0; x < width; x++) {
+					Vector &H = field[((size_t) z * height + y) * width + x];
+					(a == 0 ? H.x : a == 1 ? H.y : H.z) = h[(z * py + y) * px + x].real();
+				}
+	}
+}
+
+}  // end of namespace udc
+
+#endif
@@ -0,0 +1,108 @@
+/**
+ * @file FFT.h
+ * @author Christopher D'Angelo
+ * @brief Contains a small radix-2 FFT (1D, and separable 2D/3D) used for the FFT-based
+ *        dipolar convolutions: udc::MFMImager (see MFM.h) and udc::DipolarField (see Dipolar.h).
+ *
+ * @version 6.4
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2011-2026
+ */
+
+#ifndef UDC_FFT
+#define UDC_FFT
+
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "udc.h"
+
+
+namespace udc {
+
+typedef std::complex<double> Complex;
+
+
+/** @return the smallest power of 2 >= n (and >= 1). */
+size_t nextPow2(size_t n);
+
+/**
+ * @brief In-place, iterative radix-2 FFT of n (a power of 2) values, each "stride" elements apart.
+ *        The inverse transform includes the 1/n normalization.
+ * @throw std::invalid_argument if n isn't a power of 2.
+ */
+void fft(Complex *data, size_t n, bool inverse = false, size_t stride = 1);
+
+/**
+ * @brief In-place 3D FFT of an (nx x ny x nz) array, index (z * ny + y) * nx + x
+ *        (i.e. the same order as MSD's indices). Use nz = 1 for 2D. Each size must be a power of 2.
+ */
+void fft3D(std::vector<Complex> &data, size_t nx, size_t ny, size_t nz, bool inverse = false);
+
+
+//--------------------------------------------------------------------------------
+
+size_t nextPow2(size_t n) {
+	size_t p = 1;
+	while (p < n)
+		p <<= 1;
+	return p;
+}
+
+void fft(Complex *data, size_t n, bool inverse, size_t stride) {
+	if (n == 0 || (n & (n - 1)) != 0)
+		throw std::invalid_argument("fft(): size must be a power of 2");
+
+	// bit reversal permutation
+	for (size_t i = 1, j = 0; i < n; i++) {
+		size_t bit = n >> 1;
+		for (; j & bit; bit >>= 1)
+			j ^= bit;
+		j ^= bit;
+		if (i < j)
+			std::swap(data[i * stride], data[j * stride]);
+	}
+
+	// butterflies
+	for (size_t len = 2; len <= n; len <<= 1) {
+		const double angle = (inverse ? 2 : -2) * PI / len;
+		const Complex wLen(cos(angle), sin(angle));
+		for (size_t i = 0; i < n; i += len) {
+			Complex w(1, 0);
+			for (size_t k = 0; k < len / 2; k++) {
+				Complex &a = data[(i + k) * stride];
+				Complex &b = data[(i + k + len / 2) * stride];
+				const Complex t = b * w;
+				b = a - t;
+				a += t;
+				w *= wLen;
+			}
+		}
+	}
+
+	if (inverse)
+		for (size_t i = 0; i < n; i++)
+			data[i * stride] /= static_cast<double>(n);
+}
+
+void fft3D(std::vector<Complex> &data, size_t nx, size_t ny, size_t nz, bool inverse) {
+	for (size_t z = 0; z < nz; z++)
+		for (size_t y = 0; y < ny; y++)
+			fft(&data[(z * ny + y) * nx], nx, inverse, 1);
+	if (ny > 1)
+		for (size_t z = 0; z < nz; z++)
+			for (size_t x = 0; x < nx; x++)
+				fft(&data[z * ny * nx + x], ny, inverse, nx);
+	if (nz > 1)
+		for (size_t y = 0; y < ny; y++)
+			for (size_t x = 0; x < nx; x++)
+				fft(&data[y * nx + x], nz, inverse, nx * ny);
+}
+
+}  // end of namespace udc
+
+#endif
@@ -0,0 +1,275 @@
+/**
+ * @file JSON.h
+ * @author Christopher D'Angelo
+ * @brief Contains udc::JSON, a parsed JSON value (nlohmann::json, vendored in src/nlohmann), helpers to read one
+ *        as the types msd_worker needs, and udc::JSONWriter, for writing JSON straight into a string.
+ *        Used by msd_worker to talk to msd_server.
+ *
+ * @version 6.4
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2011-2026
+ */
+
+#ifndef UDC_JSON
+#define UDC_JSON
+
+#include <charconv>
+#include <cmath>
+#include <string>
+#include <string_view>
+#include "nlohmann/json.hpp"
+#include "Vector.h"
+#include "udc.h"
+
+
+namespace udc {
+
+using std::string_view;
+
+
+class JSONException : public UDCException {
+ public:
+	JSONException(const char *message) : UDCException(message) {}
+};
+
+
+/**
+ * @brief A parsed JSON value. Objects keep their members in document order.
+ *        JSON::parse(text) throws a JSON::parse_error (a std::exception) if text isn't a single, valid JSON value.
+ *        Integers are read exactly (e.g. 64-bit seeds).
+ */
+typedef nlohmann::ordered_json JSON;
+
+/** @return the member of json with the given key, or NULL if there isn't one (or json isn't an object). */
+const JSON* getMember(const JSON &json, string_view key);
+
+// These throw a JSONException if json isn't the right type
+bool asBool(const JSON &json);
+double asDouble(const JSON &json);
+unsigned long long asULL(const JSON &json);  // also throws if negative or not an integer (1e3 or 2.0 are fine)
+long long asLL(const JSON &json);  // also throws if not an integer
+const std::string& asString(const JSON &json);
+Vector asVector(const JSON &json);  // an array of 3 numbers
+
+
+/**
+ * @brief Appends compact JSON to a string. Commas are inserted automatically, e.g.
+ *   w.beginObject().key("t").value(t).key("M").value(M).endObject();
+ * Non-finite doubles are written as null. Doubles use the shortest text that reads back exactly.
+ * (A state can have millions of atoms, so it's written directly instead of being built as a JSON value first.)
+ */
+class JSONWriter {
+ private:
+	std::string &out;
+	bool needComma;
+
+	void separate();
+
+ public:
+	JSONWriter(std::string &out) : out(out), needComma(false) { /* empty */ }
+
+	JSONWriter& beginObject();
+	JSONWriter& endObject();
+	JSONWriter& beginArray();
+	JSONWriter& endArray();
+	JSONWriter& key(string_view key);
+
+	JSONWriter& null();
+	JSONWriter& value(bool b);
+	JSONWriter& value(double d);
+	JSONWriter& value(int i) { return value((long long) i); }
+	JSONWriter& value(unsigned int i) { return value((unsigned long long) i); }
+	JSONWriter& value(long i) { return value((long long) i); }
+	JSONWriter& value(unsigned long i) { return value((unsigned long long) i); }
+	JSONWriter& value(long long i);
+	JSONWriter& value(unsigned long long i);
+	JSONWriter& value(string_view s);
+	JSONWriter& value(const char *s) { return value(string_view(s)); }
+	JSONWriter& value(const Vector &v);  // [x, y, z]
+
+	/** Appends already formatted JSON as the next value. */
+	JSONWriter& raw(string_view json);
+};
+
+
+//--------------------------------------------------------------------------------
+
+const JSON* getMember(const JSON &json, string_view key) {
+	if (!json.is_object())
+		return NULL;
+	auto member = json.find(key);
+	return member == json.end() ? NULL : &*member;
+}
+
+bool asBool(const JSON &json) {
+	if (!json.is_boolean())
+		throw JSONException("JSON: expected a boolean");
+	return json.get<bool>();
+}
+
+double asDouble(const JSON &json) {
+	if (!json.is_number())
+		throw JSONException("JSON: expected a number");
+	return json.get<double>();
+}
+
+unsigned long long asULL(const JSON &json) {
+	if (!json.is_number())
+		throw JSONException("JSON: expected a number");
+	if (json.is_number_unsigned())
+		return json.get<unsigned long long>();
+	double number = json.get<double>();
+	if (json.is_number_float() && number >= 0 && number == std::floor(number) && number < 18446744073709551616.0)
+		return (unsigned long long) number;  // e.g. 1e3 or 2.0
+	throw JSONException("JSON: expected a non-negative integer");
+}
+
+long long asLL(const JSON &json) {
+	if (!json.is_number())
+		throw JSONException("JSON: expected a number");
+	if (json.is_number_unsigned()) {
+		unsigned long long i = json.get<unsigned long long>();
+		if (i <= 9223372036854775807ull)
+			return (long long) i;
+	} else if (json.is_number_integer()) {
+		return json.get<long long>();
+	} else {
+		double number = json.get<double>();
+		if (number == std::floor(number) && std::abs(number) < 9223372036854775808.0)
+			return (long long) number;
+	}
+	throw JSONException("JSON: expected an integer");
+}
+
+const std::string& asString(const JSON &json) {
+	if (!json.is_string())
+		throw JSONException("JSON: expected a string");
+	return json.get_ref<const std::string &>();
+}
+
+Vector asVector(const JSON &json) {
+	if (!json.is_array() || json.size() != 3)
+		throw JSONException("JSON: expected a vector, [x, y, z]");
+	return Vector(asDouble(json[0]), asDouble(json[1]), asDouble(json[2]));
+}
+
+
+void JSONWriter::separate() {
+	if (needComma)
+		out += ',';
+	needComma = true;
+}
+
+JSONWriter& JSONWriter::beginObject() {
+	separate();
+	out += '{';
+	needComma = false;
+	return *this;
+}
+
+JSONWriter& JSONWriter::endObject() {
+	out += '}';
+	needComma = true;
+	return *this;
+}
+
+JSONWriter& JSONWriter::beginArray() {
+	separate();
+	out += '[';
+	needComma = false;
+	return *this;
+}
+
+JSONWriter& JSONWriter::endArray() {
+	out += ']';
+	needComma = true;
+	return *this;
+}
+
+JSONWriter& JSONWriter::key(string_view key) {
+	value(key);
+	out += ':';
+	needComma = false;
+	return *this;
+}
+
+JSONWriter& JSONWriter::null() {
+	separate();
+	out += "null";
+	return *this;
+}
+
+JSONWriter& JSONWriter::value(bool b) {
+	separate();
+	out += b ? "true" : "false";
+	return *this;
+}
+
+JSONWriter& JSONWriter::value(double d) {
+	if (!std::isfinite(d))
+		return null();
+	separate();
+	char buf[32];
+	auto r = std::to_chars(buf, buf + sizeof(buf), d);
+	out.append(buf, r.ptr);
+	return *this;
+}
+
+JSONWriter& JSONWriter::value(long long i) {
+	separate();
+	char buf[24];
+	auto r = std::to_chars(buf, buf + sizeof(buf), i);
+	out.append(buf, r.ptr);
+	return *this;
+}
+
+JSONWriter& JSONWriter::value(unsigned long long i) {
+	separate();
+	char buf[24];
+	auto r = std::to_chars(buf, buf + sizeof(buf), i);
+	out.append(buf, r.ptr);
+	return *this;
+}
+
+JSONWriter& JSONWriter::value(string_view s) {
+	static const char HEX[] = "0123456789abcdef";
+	separate();
+	out += '"';
+	const char *start = s.data(), *end = s.data() + s.size();
+	for (const char *p = start; p != end; ++p) {
+		unsigned char c = (unsigned char) *p;
+		if (c >= 0x20 && c != '"' && c != '\\')
+			continue;
+		out.append(start, p);
+		start = p + 1;
+		switch (c) {
+			case '"':  out += "\\\""; break;
+			case '\\': out += "\\\\"; break;
+			case '\n': out += "\\n";  break;
+			case '\r': out += "\\r";  break;
+			case '\t': out += "\\t";  break;
+			default:
+				out += "\\u00";
+				out += HEX[c >> 4];
+				out += HEX[c & 0xF];
+		}
+	}
+	out.append(start, end);
+	out += '"';
+	return *this;
+}
+
+JSONWriter& JSONWriter::value(const Vector &v) {
+	return beginArray().value(v.x).value(v.y).value(v.z).endArray();
+}
+
+JSONWriter& JSONWriter::raw(string_view json) {
+	separate();
+	out += json;
+	return *this;
+}
+
+}  // end of namespace udc
+
+#endif
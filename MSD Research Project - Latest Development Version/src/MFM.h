@@ -0,0 +1,156 @@
+/**
+ * @file MFM.h
+ * @author Christopher D'Angelo
+ * @brief Contains udc::MFMImager, which simulates MFM (magnetic force microscope) images:
+ *        the dipolar stray field of a device's local magnetizations, above its surface,
+ *        computed as an FFT convolution.
+ *
+ * @version 6.4
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2011-2026
+ */
+
+#ifndef UDC_MFM
+#define UDC_MFM
+
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+#include "FFT.h"
+#include "Vector.h"
+#include "udc.h"
+
+
+namespace udc {
+
+/**
+ * @brief Computes the stray field of a (width x height x depth) lattice of magnetic moments on the plane
+ *        "lift" above its z = depth - 1 face, at each (x, y) lattice position (i.e. viewed along the z-axis).
+ *
+ * Each moment is treated as a point dipole, in lattice units, and without the mu_0 / 4 pi factor:
+ *   H(r) = 3 r (m . r) / |r|^5 - m / |r|^3
+ * The image is either H_z, or (the usual MFM contrast) its gradient dH_z/dz.
+ *
+ * Instead of the O(N^2) direct sum, each z-layer is convolved with the dipole kernel for its distance
+ * to the tip using zero-padded 2D FFTs, and the layers are summed in frequency space: O(N log N).
+ * The kernels only depend on the geometry, so they are computed once (and reused for every image)
+ * unless they would take more than MAX_CACHE_BYTES, in which case they are recomputed for each image.
+ */
+class MFMImager {
+ public:
+	enum Quantity { H_Z, DH_Z_DZ };
+
+	static const size_t MAX_CACHE_BYTES = 256 << 20;
+
+	/** The (x, y, z) coefficients of m for the given quantity, from a dipole at offset (X, Y, Z) from the tip. */
+	static void dipoleKernel(double X, double Y, double Z, Quantity quantity, double k[3]);
+
+ private:
+	unsigned int width, height, depth;
+	double lift;
+	Quantity quantity;
+	size_t px, py;  // padded sizes: powers of 2, at least 2 * width - 1 and 2 * height - 1
+	std::vector< std::vector<Complex> > kernels;  // [z * 3 + component]: FFT of the kernel for that layer (if cached)
+
+	void computeKernel(unsigned int z, int component, std::vector<Complex> &kernel) const;
+
+ public:
+	/** @throw std::invalid_argument if lift <= 0 (the tip has to be above the surface). */
+	MFMImager(unsigned int width, unsigned int height, unsigned int depth, double lift, Quantity quantity = DH_Z_DZ);
+
+	unsigned int getWidth() const { return width; }
+	unsigned int getHeight() const { return height; }
+	unsigned int getDepth() const { return depth; }
+	double getLift() const { return lift; }
+	Quantity getQuantity() const { return quantity; }
+
+	/**
+	 * @param moments width * height * depth moments, index (z * height + y) * width + x (the same as MSD).
+	 *                Empty sites should be Vector::ZERO.
+	 * @param image Set to width * height values, index y * width + x.
+	 */
+	void image(const Vector *moments, std::vector<double> &image) const;
+};
+
+
+//--------------------------------------------------------------------------------
+
+void MFMImager::dipoleKernel(double X, double Y, double Z, Quantity quantity, double k[3]) {
+	const double r2 = X * X + Y * Y + Z * Z;
+	const double r = sqrt(r2);
+	const double r3 = r2 * r, r5 = r3 * r2, r7 = r5 * r2;
+	if (quantity == H_Z) {
+		// H_z = 3 Z (m . r) / r^5 - m_z / r^3
+		k[0] = 3 * Z * X / r5;
+		k[1] = 3 * Z * Y / r5;
+		k[2] = 3 * Z * Z / r5 - 1 / r3;
+	} else {
+		// d/dZ of the above
+		k[0] = 3 * X / r5 - 15 * Z * Z * X / r7;
+		k[1] = 3 * Y / r5 - 15 * Z * Z * Y / r7;
+		k[2] = 9 * Z / r5 - 15 * Z * Z * Z / r7;
+	}
+}
+
+MFMImager::MFMImager(unsigned int width, unsigned int height, unsigned int depth, double lift, Quantity quantity)
+: width(width), height(height), depth(depth), lift(lift), quantity(quantity),
+  px(nextPow2(2 * (size_t) width - 1)), py(nextPow2(2 * (size_t) height - 1)) {
+	if (!(lift > 0))
+		throw std::invalid_argument("MFMImager: lift must be > 0");
+	if ((size_t) depth * 3 * px * py * sizeof(Complex) <= MAX_CACHE_BYTES) {
+		kernels.resize((size_t) depth * 3);
+		for (unsigned int z = 0; z < depth; z++)
+			for (int c = 0; c < 3; c++)
+				computeKernel(z, c, kernels[z * 3 + c]);
+	}
+}
+
+void MFMImager::computeKernel(unsigned int z, int component, std::vector<Complex> &kernel) const {
+	const double Z = (depth - 1 - z) + lift;  // distance from this layer up to the tip
+	kernel.assign(px * py, Complex());
+	double k[3];
+	for (long Y = 1 - (long) height; Y < (long) height; Y++)
+		for (long X = 1 - (long) width; X < (long) width; X++) {
+			dipoleKernel(X, Y, Z, quantity, k);
+			// negative offsets wrap around (circular convolution, but the padding keeps it from overlapping)
+			kernel[((Y + py) % py) * px + (X + px) % px] = k[component];
+		}
+	fft3D(kernel, px, py, 1);
+}
+
+void MFMImager::image(const Vector *moments, std::vector<double> &image) const {
+	std::vector<Complex> sum(px * py), layer, kernel;
+	for (unsigned int z = 0; z < depth; z++) {
+		const Vector *m = moments + (size_t) z * height * width;
+		bool empty = true;
+		for (size_t i = 0; empty && i < (size_t) width * height; i++)
+			empty = (m[i] == Vector::ZERO);
+		if (empty)
+			continue;
+		for (int c = 0; c < 3; c++) {
+			layer.assign(px * py, Complex());
+			for (unsigned int y = 0; y < height; y++)
+				for (unsigned int x = 0; x < width; x++) {
+					const Vector &v = m[y * width + x];
+					layer[y * px + x] = (c == 0 ? v.x : c == 1 ? v.y : v.z);
+				}
+			fft3D(layer, px, py, 1);
+			if (kernels.empty())
+				computeKernel(z, c, kernel);
+			const std::vector<Complex> &k = (kernels.empty() ? kernel : kernels[z * 3 + c]);
+			for (size_t i = 0; i < sum.size(); i++)
+				sum[i] += k[i] * layer[i];
+		}
+	}
+	fft3D(sum, px, py, 1, true);
+
+	image.resize((size_t) width * height);
+	for (unsigned int y = 0; y < height; y++)
+		for (unsigned int x = 0; x < width; x++)
+			image[y * width + x] = sum[y * px + x].real();
+}
+
+}  // end of namespace udc
+
+#endif
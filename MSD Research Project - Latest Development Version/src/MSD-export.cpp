@@ -6,13 +6,14 @@
  * 
  * 	Header version (declarations only): MSD-export.h
  * 
- * @version 1.2
- * @date 2022-12-7
+ * @version 1.5
+ * @date 2026-10-18
  * 
- * @copyright Copyright (c) 2022
+ * @copyright Copyright (c) 2022-2026
  */
 
 #include "MSD-export.h"
+#include <algorithm>
 #include <cstdlib>
 #include <vector>
 
@@ -27,6 +28,18 @@ const MSD::MolProtoFactory * const CIRCULAR_MOL = &MSD::CIRCULAR_MOL;
 const MSD::FlippingAlgorithm * const UP_DOWN_MODEL = &MSD::UP_DOWN_MODEL;
 const MSD::FlippingAlgorithm * const CONTINUOUS_SPIN_MODEL = &MSD::CONTINUOUS_SPIN_MODEL;
 
+// Regions, for the bulk accessors
+const uint REGION_ALL = 0;
+const uint REGION_FM_L = 1;
+const uint REGION_FM_R = 2;
+const uint REGION_MOL = 3;
+
+// Run statuses, for the asynchronous runs
+const int RUN_RUNNING = Run::RUNNING;
+const int RUN_DONE = Run::DONE;
+const int RUN_CANCELLED = Run::CANCELLED;
+const int RUN_FAILED = Run::FAILED;
+
 // MolProto Globals
 const char * const HEADER = MolProto::HEADER;
 const size_t HEADER_SIZE = MolProto::HEADER_SIZE;
@@ -83,7 +96,7 @@ MSD* createMSD_d(
 
 void destroyMSD(MSD *msd) { delete msd; }
 
-const MSD::Results* getRecord(const MSD *msd) { return &msd->record[0]; }
+const MSD::Results* getRecord(const MSD *msd) { return msd->record.data(); }
 size_t getRecordSize(const MSD *msd) { return msd->record.size(); }
 void setRecord(MSD *msd, const MSD::Results *record, size_t len) { msd->record = std::vector<MSD::Results>(record, record + len); }
 void setFlippingAlgorithm(MSD *msd, const MSD::FlippingAlgorithm *algo) { msd->flippingAlgorithm = *algo; }
@@ -112,6 +125,86 @@ void setFlux_v(MSD *msd, uint x, uint y, uint z, const Vector *flux) { msd->setF
 void setLocalM_i(MSD *msd, uint a, const Vector *spin, const Vector *flux) { msd->setLocalM(a, *spin, *flux); }
 void setLocalM_v(MSD *msd, uint x, uint y, uint z, const Vector *spin, const Vector *flux) { msd->setLocalM(x, y, z, *spin, *flux); }
 
+static bool inRegion(const MSD *msd, uint region, uint x) {
+	if (region == REGION_FM_L)  return x < msd->getMolPosL();
+	if (region == REGION_FM_R)  return x > msd->getMolPosR();
+	if (region == REGION_MOL)   return msd->getMolPosL() <= x && x <= msd->getMolPosR();
+	return true;  // REGION_ALL
+}
+
+// calls f(i, iter) for the i-th atom in the region
+template <typename F> static void forEachInRegion(const MSD *msd, uint region, F f) {
+	size_t i = 0;
+	for (MSDIter iter = msd->begin(); iter != msd->end(); ++iter)
+		if (inRegion(msd, region, iter.getX()))
+			f(i++, iter);
+}
+
+static void copyVector(const Vector &v, double *out) {
+	out[0] = v.x;
+	out[1] = v.y;
+	out[2] = v.z;
+}
+
+size_t getRegionSize(const MSD *msd, uint region) {
+	if (region == REGION_FM_L)  return msd->getNL();
+	if (region == REGION_FM_R)  return msd->getNR();
+	if (region == REGION_MOL)   return msd->getNm();
+	return msd->getN();
+}
+
+void copyIndices(const MSD *msd, uint region, uint *out) {
+	forEachInRegion(msd, region, [=](size_t i, const MSDIter &iter) { out[i] = iter.getIndex(); });
+}
+
+void copyPositions(const MSD *msd, uint region, uint *out, size_t stride) {
+	forEachInRegion(msd, region, [=](size_t i, const MSDIter &iter) {
+		out[i * stride] = iter.getX();
+		out[i * stride + 1] = iter.getY();
+		out[i * stride + 2] = iter.getZ();
+	});
+}
+
+void copySpins(const MSD *msd, uint region, double *out, size_t stride) {
+	forEachInRegion(msd, region, [=](size_t i, const MSDIter &iter) { copyVector(iter.getSpin(), out + i * stride); });
+}
+
+void copyFluxes(const MSD *msd, uint region, double *out, size_t stride) {
+	forEachInRegion(msd, region, [=](size_t i, const MSDIter &iter) { copyVector(iter.getFlux(), out + i * stride); });
+}
+
+void copyLocalMs(const MSD *msd, uint region, double *out, size_t stride) {
+	forEachInRegion(msd, region, [=](size_t i, const MSDIter &iter) { copyVector(iter.getLocalM(), out + i * stride); });
+}
+
+const Vector* viewSpins(const MSD *msd, size_t *stride) { return msd->getSpinData(*stride); }
+const Vector* viewFluxes(const MSD *msd, size_t *stride) { return msd->getFluxData(*stride); }
+
+void setChangeTracking(MSD *msd, bool on) { msd->setChangeTracking(on); }
+bool getChangeTracking(const MSD *msd) { return msd->getChangeTracking(); }
+ulonglong nextChangeFrame(MSD *msd) { return msd->nextChangeFrame(); }
+
+size_t getChangedCount(const MSD *msd, ulonglong token) {
+	vector<uint> changed;
+	msd->getChangedSince(token, changed);
+	return changed.size();
+}
+
+void copyChangedIndices(const MSD *msd, ulonglong token, uint *out) {
+	vector<uint> changed;
+	msd->getChangedSince(token, changed);
+	copy(changed.begin(), changed.end(), out);
+}
+
+size_t getDeltaFrame(MSD *msd, ulonglong token, uchar *out, size_t capacity) {
+	vector<uint> changed;
+	msd->getChangedSince(token, changed);
+	size_t size = deltaFrameSize(changed.size());
+	if (size <= capacity && out != NULL)
+		encodeDeltaFrame(*msd, changed, msd->nextChangeFrame(), out);
+	return size;
+}
+
 uint getN(const MSD *msd) { return msd->getN(); }
 uint getNL(const MSD *msd) { return msd->getNL(); }
 uint getNR(const MSD *msd) { return msd->getNR(); }
@@ -144,6 +237,47 @@ void randomize(MSD *msd, bool reseed) { msd->randomize(reseed); }
 void metropolis_o(MSD *msd, ulonglong N) { msd->metropolis(N); }
 void metropolis_r(MSD *msd, ulonglong N, ulonglong freq) { msd->metropolis(N, freq); }
 
+Run* startRun(MSD *msd, ulonglong N, ulonglong freq) { return new Run(*msd, N, freq); }
+
+int pollRun(const Run *run, ulonglong *done) {
+	int status = run->getStatus();  // (before getDone, so a finished run's count is final)
+	if (done != NULL)
+		*done = run->getDone();
+	return status;
+}
+
+MSD::Results getRunResults(const Run *run) { return run->getResults(); }
+void cancelRun(Run *run) { run->cancel(); }
+int waitRun(Run *run) {
+	try {
+		return run->wait();
+	} catch(...) {
+		return RUN_FAILED;  // (an exception can't cross the C ABI)
+	}
+}
+void setRunSnapshots(Run *run, bool on) { run->setSnapshots(on); }
+
+bool getRunSnapshot(const Run *run, MSD::Results *results, uint *indices, double *spins, double *fluxes) {
+	udc::MSDSnapshot snapshot;
+	if (!run->getSnapshot(snapshot))
+		return false;
+	if (results != NULL)
+		*results = snapshot.results;
+	for (size_t i = 0; i < snapshot.indices.size(); i++) {
+		if (indices != NULL)
+			indices[i] = snapshot.indices[i];
+		if (spins != NULL)
+			copyVector(snapshot.spins[i], spins + 3 * i);
+		if (fluxes != NULL)
+			copyVector(snapshot.fluxes[i], fluxes + 3 * i);
+	}
+	return true;
+}
+void destroyRun(Run *run) { delete run; }
+void runBatch(const BatchConfig *configs, BatchResult *results, size_t count, uint threadCount) {
+	udc::runBatch(configs, results, count, threadCount);
+}
+
 double specificHeat(const MSD *msd) { return msd->specificHeat(); }
 double specificHeat_L(const MSD *msd) { return msd->specificHeat_L(); }
 double specificHeat_R(const MSD *msd) { return msd->specificHeat_R(); }
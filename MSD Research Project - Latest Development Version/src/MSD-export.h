@@ -6,10 +6,10 @@
  * 
  * 	Definitions in MSD-extern.cpp
  * 
- * @version 1.2
- * @date 2022-12-7
+ * @version 1.5
+ * @date 2026-10-18
  * 
- * @copyright Copyright (c) 2022
+ * @copyright Copyright (c) 2022-2026
  */
 
 #ifndef MSD_EXPORT
@@ -18,6 +18,9 @@
 #include "udc.h"
 #include "Vector.h"
 #include "MSD.h"
+#include "StateFrame.h"
+#include "AsyncRun.h"
+#include "BatchRun.h"
 
 typedef unsigned char uchar;
 typedef unsigned int uint;
@@ -35,6 +38,9 @@ typedef MolProto::NodeIterable Nodes;
 typedef MolProto::EdgeIterable Edges;
 typedef MolProto::NodeIterator NodeIter;
 typedef MolProto::EdgeIterator EdgeIter;
+typedef udc::AsyncRun Run;
+typedef udc::BatchConfig BatchConfig;
+typedef udc::BatchResult BatchResult;
 
 #define C extern "C"
 #define DLL __declspec(dllexport)
@@ -47,6 +53,18 @@ C DLL const MSD::MolProtoFactory * const CIRCULAR_MOL;
 C DLL const MSD::FlippingAlgorithm * const UP_DOWN_MODEL;
 C DLL const MSD::FlippingAlgorithm * const CONTINUOUS_SPIN_MODEL;
 
+// Regions, for the bulk accessors
+C DLL const uint REGION_ALL;
+C DLL const uint REGION_FM_L;
+C DLL const uint REGION_FM_R;
+C DLL const uint REGION_MOL;
+
+// Run statuses, for the asynchronous runs
+C DLL const int RUN_RUNNING;
+C DLL const int RUN_DONE;
+C DLL const int RUN_CANCELLED;
+C DLL const int RUN_FAILED;  // the MSD threw an exception (e.g. its RecordSink)
+
 // MolProto Globals
 C DLL const char * const HEADER;
 C DLL const size_t HEADER_SIZE;
@@ -122,6 +140,33 @@ C DLL void setFlux_v(MSD *msd, uint x, uint y, uint z, const Vector *flux);
 C DLL void setLocalM_i(MSD *msd, uint a, const Vector *spin, const Vector *flux);
 C DLL void setLocalM_v(MSD *msd, uint x, uint y, uint z, const Vector *spin, const Vector *flux);
 
+// Bulk access (e.g. for NumPy): one call per array instead of one (or more) per atom.
+// Atoms are in the same order as MSDIter, filtered by region (one of the REGION_* globals).
+// Copies write atom i to out[i * stride], in units of the element type (uint or double), so stride >= 3
+// for positions and vectors (e.g. stride = 9 to interleave spin, flux, and localM into one array).
+C DLL size_t getRegionSize(const MSD *msd, uint region);
+C DLL void copyIndices(const MSD *msd, uint region, uint *out);
+C DLL void copyPositions(const MSD *msd, uint region, uint *out, size_t stride);
+C DLL void copySpins(const MSD *msd, uint region, double *out, size_t stride);
+C DLL void copyFluxes(const MSD *msd, uint region, double *out, size_t stride);
+C DLL void copyLocalMs(const MSD *msd, uint region, double *out, size_t stride);
+// Zero-copy, strided views of the FM_L and FM_R spins/fluxes: the k-th atom (in the order of copyIndices(msd, ALL, ...))
+// is at (const char *) view + k * (*stride) bytes. Mol. atoms are ZERO. (Empty sites aren't stored.)
+// Valid until the MSD is destroyed.
+C DLL const Vector* viewSpins(const MSD *msd, size_t *stride);
+C DLL const Vector* viewFluxes(const MSD *msd, size_t *stride);
+// Change tracking (see MSD::setChangeTracking), to send only the atoms that changed (e.g. to a visualization).
+// A token is returned each time a change frame is ended; token 0 is before everything.
+C DLL void setChangeTracking(MSD *msd, bool on);
+C DLL bool getChangeTracking(const MSD *msd);
+C DLL ulonglong nextChangeFrame(MSD *msd);  // ends the current frame, and returns its token
+C DLL size_t getChangedCount(const MSD *msd, ulonglong token);  // number of atoms changed after the frame "token"
+C DLL void copyChangedIndices(const MSD *msd, ulonglong token, uint *out);  // those atoms' indices, in MSDIter order
+// Writes a delta frame (see StateFrame.h) of the atoms changed after the frame "token", and ends the current frame.
+// Returns the frame's size in bytes. If that's more than capacity, nothing is written and the frame isn't ended
+// (so out may be NULL to get the size).
+C DLL size_t getDeltaFrame(MSD *msd, ulonglong token, uchar *out, size_t capacity);
+
 C DLL uint getN(const MSD *msd);
 C DLL uint getNL(const MSD *msd);
 C DLL uint getNR(const MSD *msd);
@@ -153,6 +198,25 @@ C DLL void reinitialize(MSD *msd, bool reseed);
 C DLL void randomize(MSD *msd, bool reseed);
 C DLL void metropolis_o(MSD *msd, ulonglong N);
 C DLL void metropolis_r(MSD *msd, ulonglong N, ulonglong freq);
+// Asynchronous runs: metropolis_r (or metropolis_o if freq is 0) on an internal thread, so the caller isn't blocked.
+// Until the run is over (i.e. waitRun returns, or pollRun returns something other than RUN_RUNNING), the MSD may
+// only be observed through the run: pollRun for progress, and getRunResults for the latest Results.
+// cancelRun stops the run within a few thousand iterations (and doesn't wait). destroyRun cancels and waits first.
+C DLL Run* startRun(MSD *msd, ulonglong N, ulonglong freq);  // allocates memory!
+C DLL int pollRun(const Run *run, ulonglong *done);  // returns the status; done (if not NULL) = iterations so far
+C DLL MSD::Results getRunResults(const Run *run);
+C DLL void cancelRun(Run *run);
+C DLL int waitRun(Run *run);  // returns the final status (never throws: a run that threw is RUN_FAILED)
+// Snapshots of the spins and fluxes while running: off by default, since each costs O(n) to publish (at most every 20 ms).
+// getRunSnapshot copies the latest one: its Results, and getN(msd) indices, spins, and fluxes (x, y, z) in MSDIter
+// order. Any of the pointers may be NULL. Returns false if none has been published yet. Never blocks the run.
+C DLL void setRunSnapshots(Run *run, bool on);
+C DLL bool getRunSnapshot(const Run *run, MSD::Results *results, uint *indices, double *spins, double *fluxes);
+C DLL void destroyRun(Run *run);
+// Batches: many independent simulations (e.g. a parameter scan) from one call, on an internal pool of threadCount
+// threads (0 means one per core). results[i] is the outcome of configs[i] (see BatchRun.h), and doesn't depend on
+// the number of threads. Blocks until they're all done.
+C DLL void runBatch(const BatchConfig *configs, BatchResult *results, size_t count, uint threadCount);
 
 C DLL double specificHeat(const MSD *msd);
 C DLL double specificHeat_L(const MSD *msd);
@@ -15,6 +15,7 @@
 
 #define UDC_MSD_VERSION "6.2a"
 
+#include <algorithm>
 #include <cstdlib>
 #include <cmath>
 #include <ctime>
@@ -27,6 +28,8 @@
 #include <stdexcept>
 #include <string>
 #include <vector>
+#include "Dipolar.h"
+#include "MFM.h"
 #include "Vector.h"
 #include "udc.h"
 #include "SparseArray.h"
@@ -55,6 +58,7 @@ using udc::PI;
 using udc::sq;
 using udc::Vector;
 using udc::SparseArray;
+using udc::SparseLayout;
 using udc::bread;
 using udc::bwrite;
 
@@ -488,6 +492,19 @@ class MSD {
 	 public:
 		MoleculeException(const char *message) : UDCException(message) {}
 	};
+
+	/**
+	 * Receives the Results recorded by MSD::metropolis(N, freq), once every "freq" iterations.
+	 * By default (i.e. MSD::recordSink == NULL), Results are appended to MSD::record instead.
+	 * See RecordSink.h for implementations (e.g. streaming to a file, or statistics only).
+	 */
+	class RecordSink {
+	 public:
+		virtual ~RecordSink() {}
+		virtual void put(const Results &) = 0;
+		virtual void clear() {}  // called by MSD::reinitialize() and MSD::randomize()
+		virtual void flush() {}  // blocks until all Results put so far have been handled
+	};
 	
 	static const FlippingAlgorithm UP_DOWN_MODEL;
 	static const FlippingAlgorithm CONTINUOUS_SPIN_MODEL;
@@ -499,6 +516,9 @@ class MSD {
 	static Vector initSpin; //initial spin of all atoms
 	static Vector initFlux; //initial spin fluctuation (direction only) for each atom
 	
+	// Only the sites in "indices" are stored (see MSD::init): the k-th one in slot k of spins, fluxes, mols, and changeFrames.
+	// "layout" maps each index (x, y, z) to its slot.
+	shared_ptr<const SparseLayout> layout;
 	SparseArray<Vector> spins;
 	SparseArray<Vector> fluxes;
 	Parameters parameters;
@@ -520,6 +540,17 @@ class MSD {
 	
 	std::vector<unsigned int> indices; // valid indices
 	std::vector<unsigned int> unique_mol_indices;  // valid indices for each unique mol. (x == molPosL)
+
+	// optional long-range dipolar term (see MSD::setDipolar)
+	double dipolarStrength;  // 0 means off
+	unsigned long long dipolarRefresh;  // metropolis iterations between refreshes. 0 means once per sweep (i.e. n)
+	unsigned long long dipolarCountdown;  // metropolis iterations until the next refresh
+	std::unique_ptr<DipolarField> dipolar;  // kept between refreshes, since it caches the kernel's FFT
+	std::vector<Vector> dipolarField;  // H at each index, as of the last refresh. Empty if off.
+	double dipolarUL, dipolarUR;  // the dipolar parts of results.UL and results.UR
+
+	std::vector<unsigned long long> changeFrames;  // the change frame in which each slot last changed. Empty if off.
+	unsigned long long changeFrame;  // the current change frame
 	
 	mt19937_64 prng; //pseudo random number generator
 	uniform_real_distribution<double> rand; //uniform probability density function on the interval [0, 1)
@@ -532,6 +563,9 @@ class MSD {
 	unsigned int z(unsigned int a) const;
 	
 	unsigned long genSeed(); //generates a new seed
+
+	void markChanged(unsigned int a);
+	void markAllChanged();
 	
 	MSD& operator=(const MSD&); //undefined, do not use!
 	MSD(const MSD &m); //undefined, do not use!
@@ -540,6 +574,7 @@ class MSD {
 	
  public:
 	std::vector<Results> record;
+	RecordSink *recordSink;  // where metropolis(N, freq) sends Results. NULL (default) means "record". Not owned by MSD.
 	FlippingAlgorithm flippingAlgorithm; //algorithm used to "flip" an atom in metropolis
 	
 	MSD(unsigned int width, unsigned int height, unsigned int depth,
@@ -563,6 +598,17 @@ class MSD {
 	void set_kT(double kT);
 	void setB(const Vector &B);
 
+	// Optional long-range dipolar (demagnetizing) interaction between all of the FM_L and FM_R local magnetizations:
+	//   U_dip = -(strength / 2) sum_i m_i * H_i;  H_i = the dipolar field of every other FM atom at i (see Dipolar.h)
+	// which is included in U, and in UL or UR (by the region of atom i). H is recomputed with an FFT, O(N log N),
+	// every "refresh" metropolis iterations (0 means once per sweep, i.e. every n iterations). In between,
+	// dU uses the last H, and each refresh corrects U for the drift. strength == 0 (default) turns it off.
+	void setDipolar(double strength, unsigned long long refresh = 0);
+	double getDipolarStrength() const;
+	unsigned long long getDipolarRefresh() const;
+	Vector getDipolarField(unsigned int a) const;  // H at index a, as of the last refresh. ZERO if off.
+	void refreshDipolar();  // recompute H and the dipolar energy now
+
 	const MolProto & getMolProto() const;
 	void setMolProto(const MolProto &proto);  // Note: the new MolProto must have the same "size" (number of nodes) as the previous MolProto.
 	void setMolParameters(const MolProto::NodeParameters &, const MolProto::EdgeParameters &);  // uniformally updates all mol. parameters
@@ -579,6 +625,21 @@ class MSD {
 	void setFlux(unsigned int x, unsigned int y, unsigned int z, const Vector &);
 	void setLocalM(unsigned int a, const Vector &, const Vector &);
 	void setLocalM(unsigned int x, unsigned int y, unsigned int z, const Vector &, const Vector &);
+
+	// Zero-copy access to the FM_L and FM_R spins and fluxes, e.g. for bindings (see MSD-export.h):
+	// the k-th atom (in the order of begin() to end()) is at (const char *) data + k * stride. Mol. atoms are ZERO.
+	// Valid for the lifetime of this MSD.
+	const Vector* getSpinData(size_t &stride) const;
+	const Vector* getFluxData(size_t &stride) const;
+
+	// Optional change tracking, e.g. for sending only what changed to a visualization (see MSD-export.h):
+	// every site remembers the last change frame in which its spin or flux changed. Rejected metropolis flips
+	// don't count. Off by default; turning it on marks every site as changed in the current frame.
+	void setChangeTracking(bool on);
+	bool getChangeTracking() const;
+	unsigned long long nextChangeFrame();  // ends the current frame, and returns a token for it
+	// the indices (in iteration order) changed after the frame "token" ended; token 0 means every index
+	void getChangedSince(unsigned long long token, std::vector<unsigned int> &changed) const;
 	
 	unsigned int getN() const;
 	unsigned int getNL() const;
@@ -643,6 +704,10 @@ class MSD {
 	double meanUmL() const;
 	double meanUmR() const;
 	double meanULR() const;
+
+	// Simulated MFM image of the current state (see MFM.h): the stray field of the local magnetizations,
+	// "lift" above the z = depth - 1 face. gradient ? dH_z/dz : H_z. Returns width * height values, index y * width + x.
+	std::vector<double> mfmImage(double lift, bool gradient = true) const;
 	
 	Iterator begin() const;
 	Iterator end() const;
@@ -1299,7 +1364,7 @@ void Molecule::Instance::setLocalM(unsigned int a, const Vector &spin, const Vec
 	// ---- update energy, U ----
 	// local energy
 	{	double deltaU = msdParams.B * deltaM
-		              + nodeParams.Am * ( Vector(sq(mag.x), sq(mag.y), sq(mag.z)) - Vector(sq(m.x), sq(m.y), sq(m.z)) )
+		              + nodeParams.Am.squareDiffDot(mag, m)
 		              + nodeParams.Je0m * ( spin * flux - s * f );
 		results.U -= deltaU;
 		results.Um -= deltaU;
@@ -1316,7 +1381,7 @@ void Molecule::Instance::setLocalM(unsigned int a, const Vector &spin, const Vec
 		              + edgeParams.Je1m * ( neighbor_f * deltaS + neighbor_s * deltaF )
 		              + edgeParams.Jeem * ( neighbor_f * deltaF )
 		              + edgeParams.bm * ( sq(neighbor_m * mag) - sq(neighbor_m * m) )
-		              + edgeParams.Dm * (edge.direction * deltaM.crossProduct(neighbor_m));  // uses edge.direction to solve anti-communative property of crossProduct
+		              + edge.direction * edgeParams.Dm.crossDot(deltaM, neighbor_m);  // uses edge.direction to solve anti-communative property of crossProduct
 		results.U -= deltaU;
 		results.Um -= deltaU;
 	}
@@ -1336,7 +1401,7 @@ void Molecule::Instance::setLocalM(unsigned int a, const Vector &spin, const Vec
 			              + msdParams.Je1mL * ( neighbor_f * deltaS + neighbor_s * deltaF )
 			              + msdParams.JeemL * ( neighbor_f * deltaF )
 			              + msdParams.bmL * ( sq(neighbor_m * mag) - sq(neighbor_m * m) )
-			              + msdParams.DmL * neighbor_m.crossProduct(deltaM);  // pos(neighbor_m) < pos(deltaM)
+			              + msdParams.DmL.crossDot(neighbor_m, deltaM);  // pos(neighbor_m) < pos(deltaM)
 			results.U -= deltaU;
 			results.UmL -= deltaU;
 		}
@@ -1351,7 +1416,7 @@ void Molecule::Instance::setLocalM(unsigned int a, const Vector &spin, const Vec
 			              + msdParams.Je1mR * ( neighbor_f * deltaS + neighbor_s * deltaF )
 			              + msdParams.JeemR * ( neighbor_f * deltaF )
 			              + msdParams.bmR * ( sq(neighbor_m * mag) - sq(neighbor_m * m) )
-			              + msdParams.DmR * deltaM.crossProduct(neighbor_m);  // pos(deltaM) < pos(neighbor_m)
+			              + msdParams.DmR.crossDot(deltaM, neighbor_m);  // pos(deltaM) < pos(neighbor_m)
 			results.U -= deltaU;
 			results.UmR -= deltaU;
 		}
@@ -1645,18 +1710,12 @@ void MSD::init(const MolProtoFactory *molProtoFactory) {
 	if (frontR > depth)     frontR = depth;
 	if (backR < frontR)     backR = frontR - 1;
 
-	spins.resize(width * height * depth);
-	fluxes.resize(width * height * depth);
-
 	FM_L_exists = (molPosL != 0);
 	FM_R_exists = (molPosR + 1 < width);
 	mol_exists = (molPosL <= molPosR);
 
-	if (mol_exists) {
-		mols.resize(width * height * depth);
-		if (molProtoFactory != NULL)
-			molProto = (*molProtoFactory)(molPosR - molPosL + 1);
-	}
+	if (mol_exists && molProtoFactory != NULL)
+		molProto = (*molProtoFactory)(molPosR - molPosL + 1);
 
 	seed = genSeed();
 	prng.seed(seed);
@@ -1670,8 +1729,6 @@ void MSD::init(const MolProtoFactory *molProtoFactory) {
 				if (topL <= y && y <= bottomL) {
 					a = index(x, y, z);
 					indices.push_back(a);
-					spins[a] = initSpin;
-					fluxes[a] = initFlux;
 					n++;
 					nL++;
 					if (x + 1 == molPosL) {
@@ -1683,12 +1740,10 @@ void MSD::init(const MolProtoFactory *molProtoFactory) {
 				}
 			// mol
 			if( mol_exists && (((y == topL || y == bottomL) && (frontR <= z && z <= backR)) || ((z == frontR || z == backR) && (topL <= y && y <= bottomL))) ) {
-				shared_ptr<Mol> mol = shared_ptr<Mol>(new Mol(molProto, *this, y, z, initSpin, initFlux));
 				unique_mol_indices.push_back(index(molPosL, y, z));  // store the indices for all unique Mol (Molecule::Instance) objects
 				for( unsigned int x = molPosL; x <= molPosR; x++ ) {
 					a = index(x, y, z);
 					indices.push_back(a);
-					mols[a] = mol;
 					n++;
 					n_m++;
 					if (x == molPosL && FM_L_exists)
@@ -1702,8 +1757,6 @@ void MSD::init(const MolProtoFactory *molProtoFactory) {
 				if (frontR <= z && z <= backR) {
 					a = index(x, y, z);
 					indices.push_back(a);
-					spins[a] = initSpin;
-					fluxes[a] = initFlux;
 					n++;
 					nR++;
 					if (x == molPosR + 1) {
@@ -1714,8 +1767,34 @@ void MSD::init(const MolProtoFactory *molProtoFactory) {
 					}
 				}
 		}
+
+	// allocate only the sites in "indices", i.e. none of the empty ones in the (width x height x depth) box
+	layout = shared_ptr<const SparseLayout>(new SparseLayout(width * height * depth, indices));
+	spins.resize(layout);
+	fluxes.resize(layout);
+	if (mol_exists)
+		mols.resize(layout);
+	for( unsigned int a : indices ) {
+		unsigned int x = this->x(a);
+		if( x < molPosL || x > molPosR ) {
+			spins[a] = initSpin;
+			fluxes[a] = initFlux;
+		}
+	}
+	for( unsigned int a : unique_mol_indices ) {
+		shared_ptr<Mol> mol = shared_ptr<Mol>(new Mol(molProto, *this, y(a), z(a), initSpin, initFlux));
+		for( unsigned int x = molPosL; x <= molPosR; x++ )
+			mols[a + (x - molPosL)] = mol;
+	}
 	
 	flippingAlgorithm = CONTINUOUS_SPIN_MODEL; // set default "flipping" algorithm
+	recordSink = NULL;  // by default, metropolis(N, freq) appends to "record"
+
+	dipolarStrength = 0;  // off by default
+	dipolarRefresh = dipolarCountdown = 0;
+	dipolarUL = dipolarUR = 0;
+
+	changeFrame = 1;  // so that token 0 is before every change
 
 	setParameters(parameters); // calculate initial state ("Results") for FM sections
 	setMolProto(molProto);     // calculate initial state ("Results") for mol. section
@@ -1782,15 +1861,21 @@ void MSD::setParameters(const MSD::Parameters &p) {
 	parameters = p;  // update to new parameters
 	
 	// ----- Spin and Spin Flux Magnitudes -----
+	const bool rescaleL = p.SL != p0.SL || p.FL != p0.FL;
+	const bool rescaleR = p.SR != p0.SR || p.FR != p0.FR;
 	for( auto iter = begin(); iter != end(); ++iter ) {
 		unsigned int i = iter.getIndex();
 		unsigned int x = iter.getX();
 		if( x < molPosL ) {
 			spins[i].normalize() *= parameters.SL;
 			fluxes[i] *= p0.FL != 0 ? parameters.FL / p0.FL : 0;
+			if( rescaleL )
+				markChanged(i);
 		} else if( x > molPosR ) {
 			spins[i].normalize() *= parameters.SR;
 			fluxes[i] *= p0.FR != 0 ? parameters.FR / p0.FR : 0;
+			if( rescaleR )
+				markChanged(i);
 		} // else, mol: do nothing (see: MSD::setMolProto)
 	}
 	
@@ -2047,6 +2132,11 @@ void MSD::setParameters(const MSD::Parameters &p) {
 	results.ULR -= parameters.DLR * dmi_LR;
 	 
 	results.U = results.UL + results.UR + results.Um + results.UmL + results.UmR + results.ULR;
+
+	// ----- Dipolar (see MSD::setDipolar) -----
+	dipolarUL = dipolarUR = 0;  // not included in UL and UR above
+	if( dipolarStrength != 0 )
+		refreshDipolar();
 }
 
 MSD::Results MSD::getResults() const {
@@ -2071,6 +2161,56 @@ void MSD::setB(const Vector &B) {
 	parameters.B = B;
 }
 
+void MSD::setDipolar(double strength, unsigned long long refresh) {
+	dipolarStrength = strength;
+	dipolarRefresh = refresh;
+	refreshDipolar();
+}
+
+double MSD::getDipolarStrength() const {
+	return dipolarStrength;
+}
+
+unsigned long long MSD::getDipolarRefresh() const {
+	return dipolarRefresh;
+}
+
+Vector MSD::getDipolarField(unsigned int a) const {
+	return a < dipolarField.size() ? dipolarField[a] : Vector::ZERO;
+}
+
+void MSD::refreshDipolar() {
+	double UL = 0, UR = 0;  // new dipolar energies
+	if( dipolarStrength == 0 ) {
+		dipolar.reset();
+		dipolarField.clear();
+	} else {
+		if( !dipolar )
+			dipolar.reset( new DipolarField(width, height, depth) );
+		// only FM_L and FM_R take part: the mol. is left out (as are empty sites)
+		std::vector<Vector> moments( (size_t) width * height * depth, Vector::ZERO );
+		for( unsigned int a : indices ) {
+			unsigned int x = this->x(a);
+			if( x < molPosL || x > molPosR )
+				moments[a] = getLocalM(a);
+		}
+		dipolar->compute( &moments[0], dipolarField );
+		for( unsigned int a : indices ) {
+			unsigned int x = this->x(a);
+			if( x < molPosL )
+				UL -= 0.5 * dipolarStrength * (moments[a] * dipolarField[a]);
+			else if( x > molPosR )
+				UR -= 0.5 * dipolarStrength * (moments[a] * dipolarField[a]);
+		}
+	}
+	results.UL += UL - dipolarUL;
+	results.UR += UR - dipolarUR;
+	results.U += (UL - dipolarUL) + (UR - dipolarUR);
+	dipolarUL = UL;
+	dipolarUR = UR;
+	dipolarCountdown = dipolarRefresh != 0 ? dipolarRefresh : (indices.empty() ? 1 : indices.size());
+}
+
 
 const MSD::MolProto & MSD::getMolProto() const {
 	return molProto;
@@ -2122,7 +2262,7 @@ void MSD::setMolProto(const MolProto &molProto) {
 
 			Vector m = s + f;
 			results.Um -= this->parameters.B * m;
-			results.Um -= parameters.Am * Vector(sq(m.x), sq(m.y), sq(m.z));
+			results.Um -= parameters.Am.squareDot(m);
 			results.Um -= parameters.Je0m * (s * f);
 		}
 
@@ -2157,7 +2297,7 @@ void MSD::setMolProto(const MolProto &molProto) {
 				results.Um -= parameters.Je1m * (s_i * f_j + f_i * s_j);
 				results.Um -= parameters.Jeem * (f_i * f_j);
 				results.Um -= parameters.bm * sq(m_i * m_j);
-				results.Um -= parameters.Dm * (edge.direction * m_i.crossProduct(m_j));
+				results.Um -= edge.direction * parameters.Dm.crossDot(m_i, m_j);
 			}
 		}
 	}
@@ -2181,7 +2321,7 @@ void MSD::setMolProto(const MolProto &molProto) {
 			results.UmL -= parameters.Je1mL * (s_i * f_j + f_i * s_j);
 			results.UmL -= parameters.JeemL * (f_i * f_j);
 			results.UmL -= parameters.bmL * sq(m_i * m_j);
-			results.UmL -= parameters.DmL * m_i.crossProduct(m_j);
+			results.UmL -= parameters.DmL.crossDot(m_i, m_j);
 		}
 
 		if (FM_R_exists) {
@@ -2198,7 +2338,7 @@ void MSD::setMolProto(const MolProto &molProto) {
 			results.UmR -= parameters.Je1mR * (s_i * f_j + f_i * s_j);
 			results.UmR -= parameters.JeemR * (f_i * f_j);
 			results.UmR -= parameters.bmR * sq(m_i * m_j);
-			results.UmR -= parameters.DmR * m_i.crossProduct(m_j);
+			results.UmR -= parameters.DmR.crossDot(m_i, m_j);
 		}
 	}
 
@@ -2208,6 +2348,14 @@ void MSD::setMolProto(const MolProto &molProto) {
 	results.MF = results.MFL + results.MFR + results.MFm;
 	results.M = results.MS + results.MF;
 	results.U += results.Um + results.UmR + results.UmL;
+
+	// the mol. spins and fluxes were rescaled (Sm, Fm)
+	if( !changeFrames.empty() )
+		for( unsigned int a : indices ) {
+			unsigned int x = this->x(a);
+			if( molPosL <= x && x <= molPosR )
+				markChanged(a);
+		}
 	
 	// Done: copy new mol. prototype to MSD::molProto field
 	this->molProto = molProto;
@@ -2252,6 +2400,55 @@ Vector MSD::getLocalM(unsigned int x, unsigned int y, unsigned int z) const {
 	return getLocalM( index(x, y, z) );
 }
 
+const Vector* MSD::getSpinData(size_t &stride) const {
+	stride = spins.stride();
+	return spins.data();
+}
+
+const Vector* MSD::getFluxData(size_t &stride) const {
+	stride = fluxes.stride();
+	return fluxes.data();
+}
+
+void MSD::markChanged(unsigned int a) {
+	if( !changeFrames.empty() )
+		changeFrames[layout->slot(a)] = changeFrame;
+}
+
+void MSD::markAllChanged() {
+	if( !changeFrames.empty() )
+		std::fill( changeFrames.begin(), changeFrames.end(), changeFrame );
+}
+
+void MSD::setChangeTracking(bool on) {
+	if( !on ) {
+		changeFrames.clear();
+		changeFrames.shrink_to_fit();
+	} else if( changeFrames.empty() ) {
+		changeFrames.assign( indices.size(), 0 );
+		markAllChanged();
+	}
+}
+
+bool MSD::getChangeTracking() const {
+	return !changeFrames.empty();
+}
+
+unsigned long long MSD::nextChangeFrame() {
+	return changeFrame++;
+}
+
+void MSD::getChangedSince(unsigned long long token, std::vector<unsigned int> &changed) const {
+	changed.clear();
+	if( changeFrames.empty() || token == 0 ) {
+		changed = indices;  // unknown, so everything
+		return;
+	}
+	for( unsigned int k = 0; k < indices.size(); k++ )
+		if( changeFrames[k] > token )
+			changed.push_back(indices[k]);
+}
+
 void MSD::setSpin(unsigned int a, const Vector &spin) {
 	setLocalM( a, spin, getFlux(a) );
 }
@@ -2275,6 +2472,7 @@ void MSD::setFlux(unsigned int x, unsigned int y, unsigned int z, const Vector &
 void MSD::setLocalM(unsigned int a, const Vector &spin, const Vector &flux) {
 	try {
 	
+	markChanged(a);
 	unsigned int x = this->x(a);
 	unsigned int y = this->y(a);
 	unsigned int z = this->z(a);
@@ -2311,12 +2509,19 @@ void MSD::setLocalM(unsigned int a, const Vector &spin, const Vector &flux) {
 		results.MFL += deltaF;
 		results.UL -= deltaU_B;
 		
-		{	double deltaU = parameters.AL * ( Vector(sq(mag.x), sq(mag.y), sq(mag.z)) - Vector(sq(m.x), sq(m.y), sq(m.z)) )
+		{	double deltaU = parameters.AL.squareDiffDot(mag, m)
 		                  + parameters.Je0L * ( spin * flux - s * f );
 			results.U -= deltaU;
 			results.UL -= deltaU;
 		}
 		
+		if( !dipolarField.empty() ) {
+			double deltaU = dipolarStrength * ( deltaM * dipolarField[a] );  // using the last H (see MSD::refreshDipolar)
+			results.U -= deltaU;
+			results.UL -= deltaU;
+			dipolarUL -= deltaU;
+		}
+		
 		// [5 neighbors stay only within FM_L: left, above, below, front, back]
 		if( x != 0 ) {
 			unsigned int a1 = index(x - 1, y, z);  // left neighbor
@@ -2327,7 +2532,7 @@ void MSD::setLocalM(unsigned int a, const Vector &spin, const Vector &flux) {
 						  + parameters.Je1L * ( neighbor_f * deltaS + neighbor_s * deltaF )
 						  + parameters.JeeL * ( neighbor_f * deltaF )
 			              + parameters.bL * ( sq(neighbor_m * mag) - sq(neighbor_m * m) )
-						  + parameters.DL * neighbor_m.crossProduct(deltaM);  // (a1 < a): right vector changed
+						  + parameters.DL.crossDot(neighbor_m, deltaM);  // (a1 < a): right vector changed
 			results.U -= deltaU;
 			results.UL -= deltaU;
 		} // else, x - 1 neighbor doesn't exist
@@ -2340,7 +2545,7 @@ void MSD::setLocalM(unsigned int a, const Vector &spin, const Vector &flux) {
 						  + parameters.Je1L * ( neighbor_f * deltaS + neighbor_s * deltaF )
 						  + parameters.JeeL * ( neighbor_f * deltaF )
 			              + parameters.bL * ( sq(neighbor_m * mag) - sq(neighbor_m * m) )
-						  + parameters.DL * neighbor_m.crossProduct(deltaM);  // (a1 < a): right vector changed
+						  + parameters.DL.crossDot(neighbor_m, deltaM);  // (a1 < a): right vector changed
 			results.U -= deltaU;
 			results.UL -= deltaU;
 		} // else, y - 1 neighbor doesn't exist
@@ -2353,7 +2558,7 @@ void MSD::setLocalM(unsigned int a, const Vector &spin, const Vector &flux) {
 						  + parameters.Je1L * ( neighbor_f * deltaS + neighbor_s * deltaF )
 						  + parameters.JeeL * ( neighbor_f * deltaF )
 			              + parameters.bL * ( sq(neighbor_m * mag) - sq(neighbor_m * m) )
-						  + parameters.DL * deltaM.crossProduct(neighbor_m);  // (a < a1): left vector changed
+						  + parameters.DL.crossDot(deltaM, neighbor_m);  // (a < a1): left vector changed
 			results.U -= deltaU;
 			results.UL -= deltaU;
 		} // else, y + 1 neighbor doesn't exist
@@ -2366,7 +2571,7 @@ void MSD::setLocalM(unsigned int a, const Vector &spin, const Vector &flux) {
 						  + parameters.Je1L * ( neighbor_f * deltaS + neighbor_s * deltaF )
 						  + parameters.JeeL * ( neighbor_f * deltaF )
 			              + parameters.bL * ( sq(neighbor_m * mag) - sq(neighbor_m * m) )
-						  + parameters.DL * neighbor_m.crossProduct(deltaM);  // (a1 < a): right vector changed
+						  + parameters.DL.crossDot(neighbor_m, deltaM);  // (a1 < a): right vector changed
 			results.U -= deltaU;
 			results.UL -= deltaU;
 		} // else, z - 1 neighbor doesn't exist
@@ -2379,7 +2584,7 @@ void MSD::setLocalM(unsigned int a, const Vector &spin, const Vector &flux) {
 						  + parameters.Je1L * ( neighbor_f * deltaS + neighbor_s * deltaF )
 						  + parameters.JeeL * ( neighbor_f * deltaF )
 			              + parameters.bL * ( sq(neighbor_m * mag) - sq(neighbor_m * m) )
-						  + parameters.DL * deltaM.crossProduct(neighbor_m);  // (a < a1): left vector changed
+						  + parameters.DL.crossDot(deltaM, neighbor_m);  // (a < a1): left vector changed
 			results.U -= deltaU;
 			results.UL -= deltaU;
 		} // else, z + 1 neighbor doesn't exist
@@ -2397,7 +2602,7 @@ void MSD::setLocalM(unsigned int a, const Vector &spin, const Vector &flux) {
 						              + parameters.Je1mL * ( neighbor_f * deltaS + neighbor_s * deltaF )
 						              + parameters.JeemL * ( neighbor_f * deltaF )
 						              + parameters.bmL * ( sq(neighbor_m * mag) - sq(neighbor_m * m) )
-									  + parameters.DmL * deltaM.crossProduct(neighbor_m);  // (a < a1): left vector changed
+									  + parameters.DmL.crossDot(deltaM, neighbor_m);  // (a < a1): left vector changed
 						results.U -= deltaU;
 						results.UmL -= deltaU;
 					} catch(const out_of_range &e) {} // x + 1 neighbor doesn't exist because it's in the buffer zone
@@ -2412,7 +2617,7 @@ void MSD::setLocalM(unsigned int a, const Vector &spin, const Vector &flux) {
 						              + parameters.Je1LR * ( neighbor_f * deltaS + neighbor_s * deltaF )
 						              + parameters.JeeLR * ( neighbor_f * deltaF )
 						              + parameters.bLR * ( sq(neighbor_m * mag) - sq(neighbor_m * m) )
-									  + parameters.DLR * deltaM.crossProduct(neighbor_m);  // (a < a1): left vector changed
+									  + parameters.DLR.crossDot(deltaM, neighbor_m);  // (a < a1): left vector changed
 						results.U -= deltaU;
 						results.ULR -= deltaU;
 					} catch(const out_of_range &e) {} // molPosR + 1 atom doesn't exist because we're not in the center
@@ -2426,7 +2631,7 @@ void MSD::setLocalM(unsigned int a, const Vector &spin, const Vector &flux) {
 				              + parameters.Je1L * ( neighbor_f * deltaS + neighbor_s * deltaF )
 				              + parameters.JeeL * ( neighbor_f * deltaF )
 				              + parameters.bL * ( sq(neighbor_m * mag) - sq(neighbor_m * m) )
-							  + parameters.DL * deltaM.crossProduct(neighbor_m);  // (a < a1): left vector changed
+							  + parameters.DL.crossDot(deltaM, neighbor_m);  // (a < a1): left vector changed
 				results.U -= deltaU;
 				results.UL -= deltaU;
 			}
@@ -2440,12 +2645,19 @@ void MSD::setLocalM(unsigned int a, const Vector &spin, const Vector &flux) {
 		results.MFR += deltaF;
 		results.UR -= deltaU_B;
 		
-		{	double deltaU = parameters.AR * ( Vector(sq(mag.x), sq(mag.y), sq(mag.z)) - Vector(sq(m.x), sq(m.y), sq(m.z)) )
+		{	double deltaU = parameters.AR.squareDiffDot(mag, m)
 			              + parameters.Je0R * ( spin * flux - s * f );
 			results.U -= deltaU;
 			results.UR -= deltaU;
 		}
 		
+		if( !dipolarField.empty() ) {
+			double deltaU = dipolarStrength * ( deltaM * dipolarField[a] );  // using the last H (see MSD::refreshDipolar)
+			results.U -= deltaU;
+			results.UR -= deltaU;
+			dipolarUR -= deltaU;
+		}
+		
 		// [5 neighbors stay only within FM_R: right, above, below, front, back]
 		if( x + 1 != width ) {
 			unsigned int a1 = index(x + 1, y, z);  // right neighbor
@@ -2456,7 +2668,7 @@ void MSD::setLocalM(unsigned int a, const Vector &spin, const Vector &flux) {
 			              + parameters.Je1R * ( neighbor_f * deltaS + neighbor_s * deltaF )
 			              + parameters.JeeR * ( neighbor_f * deltaF )
 			              + parameters.bR * ( sq(neighbor_m * mag) - sq(neighbor_m * m) )
-						  + parameters.DR * deltaM.crossProduct(neighbor_m);  // (a < a1): left vector changed
+						  + parameters.DR.crossDot(deltaM, neighbor_m);  // (a < a1): left vector changed
 			results.U -= deltaU;
 			results.UR -= deltaU;
 		} // else, x + 1 neighbor doesn't exist
@@ -2469,7 +2681,7 @@ void MSD::setLocalM(unsigned int a, const Vector &spin, const Vector &flux) {
 			              + parameters.Je1R * ( neighbor_f * deltaS + neighbor_s * deltaF )
 			              + parameters.JeeR * ( neighbor_f * deltaF )
 			              + parameters.bR * ( sq(neighbor_m * mag) - sq(neighbor_m * m) )
-						  + parameters.DR * neighbor_m.crossProduct(deltaM);  // (a1 < a): right vector changed
+						  + parameters.DR.crossDot(neighbor_m, deltaM);  // (a1 < a): right vector changed
 			results.U -= deltaU;
 			results.UR -= deltaU;
 		} // else, y - 1 neighbor doesn't exist
@@ -2482,7 +2694,7 @@ void MSD::setLocalM(unsigned int a, const Vector &spin, const Vector &flux) {
 			              + parameters.Je1R * ( neighbor_f * deltaS + neighbor_s * deltaF )
 			              + parameters.JeeR * ( neighbor_f * deltaF )
 			              + parameters.bR * ( sq(neighbor_m * mag) - sq(neighbor_m * m) )
-						  + parameters.DR * deltaM.crossProduct(neighbor_m);  // (a < a1): left vector changed
+						  + parameters.DR.crossDot(deltaM, neighbor_m);  // (a < a1): left vector changed
 			results.U -= deltaU;
 			results.UR -= deltaU;
 		} // else, y + 1 neighbor doesn't exist
@@ -2495,7 +2707,7 @@ void MSD::setLocalM(unsigned int a, const Vector &spin, const Vector &flux) {
 			              + parameters.Je1R * ( neighbor_f * deltaS + neighbor_s * deltaF )
 			              + parameters.JeeR * ( neighbor_f * deltaF )
 			              + parameters.bR * ( sq(neighbor_m * mag) - sq(neighbor_m * m) )
-						  + parameters.DR * neighbor_m.crossProduct(deltaM);  // (a1 < a): right vector changed
+						  + parameters.DR.crossDot(neighbor_m, deltaM);  // (a1 < a): right vector changed
 			results.U -= deltaU;
 			results.UR -= deltaU;
 		} // else, z - 1 neighbor doesn't exist
@@ -2508,7 +2720,7 @@ void MSD::setLocalM(unsigned int a, const Vector &spin, const Vector &flux) {
 			              + parameters.Je1R * ( neighbor_f * deltaS + neighbor_s * deltaF )
 			              + parameters.JeeR * ( neighbor_f * deltaF )
 			              + parameters.bR * ( sq(neighbor_m * mag) - sq(neighbor_m * m) )
-						  + parameters.DR * deltaM.crossProduct(neighbor_m);  // (a < a1): left vector changed
+						  + parameters.DR.crossDot(deltaM, neighbor_m);  // (a < a1): left vector changed
 			results.U -= deltaU;
 			results.UR -= deltaU;
 		} // else, z + 1 neighbor doesn't exist
@@ -2526,7 +2738,7 @@ void MSD::setLocalM(unsigned int a, const Vector &spin, const Vector &flux) {
 					              + parameters.Je1mR * ( neighbor_f * deltaS + neighbor_s * deltaF )
 					              + parameters.JeemR * ( neighbor_f * deltaF )
 					              + parameters.bmR * ( sq(neighbor_m * mag) - sq(neighbor_m * m) )
-								  + parameters.DmR * neighbor_m.crossProduct(deltaM);  // (a1 < a): right vector changed
+								  + parameters.DmR.crossDot(neighbor_m, deltaM);  // (a1 < a): right vector changed
 					results.U -= deltaU;
 					results.UmR -= deltaU;
 				} catch(const out_of_range &e) {} // x - 1 neighbor doesn't exist because it's in the buffer zone
@@ -2541,7 +2753,7 @@ void MSD::setLocalM(unsigned int a, const Vector &spin, const Vector &flux) {
 					              + parameters.Je1LR * ( neighbor_f * deltaS + neighbor_s * deltaF )
 					              + parameters.JeeLR * ( neighbor_f * deltaF )
 					              + parameters.bLR * ( sq(neighbor_m * mag) - sq(neighbor_m * m) )
-								  + parameters.DLR * neighbor_m.crossProduct(deltaM);  // (a1 < a): right vector changed
+								  + parameters.DLR.crossDot(neighbor_m, deltaM);  // (a1 < a): right vector changed
 					results.U -= deltaU;
 					results.ULR -= deltaU;
 				} catch(const out_of_range &e) {} // molPos - 1 atom doesn't exist because we're not in the center
@@ -2555,7 +2767,7 @@ void MSD::setLocalM(unsigned int a, const Vector &spin, const Vector &flux) {
 			              + parameters.Je1R * ( neighbor_f * deltaS + neighbor_s * deltaF )
 			              + parameters.JeeR * ( neighbor_f * deltaF )
 			              + parameters.bR * ( sq(neighbor_m * mag) - sq(neighbor_m * m) )
-						  + parameters.DR * neighbor_m.crossProduct(deltaM);  // (a1 < a): right vector changed
+						  + parameters.DR.crossDot(neighbor_m, deltaM);  // (a1 < a): right vector changed
 			results.U -= deltaU;
 			results.UR -= deltaU;
 		}
@@ -2704,6 +2916,8 @@ void MSD::reinitialize(bool reseed) {
 	for( auto i = begin(); i != end(); i++ )
 		setLocalM( i, initSpin, initFlux );
 	record.clear();
+	if( recordSink != NULL )
+		recordSink->clear();
 	setParameters(parameters);  // TODO: do we need this? Yes, but I think only because we
 	setMolProto(molProto);  // need to rescale Spin and Flux vectors to match S and F params
 	results.t = 0;
@@ -2718,6 +2932,8 @@ void MSD::randomize(bool reseed) {
 				Vector::sphericalForm(1, 2 * PI * rand(prng), asin(2 * rand(prng) - 1)),
 				Vector::sphericalForm(rand(prng), 2 * PI * rand(prng), asin(2 * rand(prng) - 1)) );
 	record.clear();
+	if( recordSink != NULL )
+		recordSink->clear();
 	setParameters(parameters);  // TODO: do we still need this? Yes. (See comment in MSD::reinitialize())
 	setMolProto(molProto);
 	results.t = 0;
@@ -2749,6 +2965,9 @@ void MSD::metropolis(unsigned long long N) {
 			inMol = true;
 		}
 
+		double dipolarUL0 = dipolarUL, dipolarUR0 = dipolarUR;  // in case we need to revert state
+		unsigned long long changeFrame0 = changeFrames.empty() ? 0 : changeFrames[layout->slot(a)];
+
 		//"flip" that atom
 		setLocalM( a, flippingAlgorithm(s, random),
 				Vector::sphericalForm(F * random(), 2 * PI * random(), asin(2 * random() - 1)) );
@@ -2769,6 +2988,15 @@ void MSD::metropolis(unsigned long long N) {
 				fluxes[a] = f;
 			}
 			results = r;
+			dipolarUL = dipolarUL0;
+			dipolarUR = dipolarUR0;
+			if( !changeFrames.empty() )
+				changeFrames[layout->slot(a)] = changeFrame0;  // (not a change)
+		}
+
+		if( dipolarStrength != 0 && --dipolarCountdown == 0 ) {
+			refreshDipolar();  // corrects U for the drift caused by using the last H
+			r = getResults();
 		}
 	}
 	results.t += N;
@@ -2780,7 +3008,10 @@ void MSD::metropolis(unsigned long long N, unsigned long long freq) {
 		return;
 	}
 	while(true) {
-		record.push_back( getResults() );
+		if( recordSink == NULL )
+			record.push_back( getResults() );
+		else
+			recordSink->put( getResults() );
 		if( N >= freq ) {
 			metropolis(freq);
 			N -= freq;
@@ -3304,6 +3535,15 @@ double MSD::meanULR() const {
 	return (0.5 / (record[record.size() - 1].t - record[0].t)) * s;
 }
 
+std::vector<double> MSD::mfmImage(double lift, bool gradient) const {
+	std::vector<Vector> moments((size_t) width * height * depth, Vector::ZERO);
+	for (unsigned int a : indices)
+		moments[a] = getLocalM(a);
+	std::vector<double> image;
+	MFMImager(width, height, depth, lift, gradient ? MFMImager::DH_Z_DZ : MFMImager::H_Z).image(&moments[0], image);
+	return image;
+}
+
 
 MSD::Iterator MSD::begin() const {
 	return Iterator(*this, 0);
@@ -0,0 +1,131 @@
+/**
+ * @file MappedFile.h
+ * @author Christopher D'Angelo
+ * @brief Contains udc::MappedFile, a read-only memory mapped view of a whole file.
+ *        Used for reading (possibly multi-gigabyte) metropolis output without copying it into memory.
+ *
+ * @version 6.4
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2011-2026
+ */
+
+#ifndef UDC_MAPPED_FILE
+#define UDC_MAPPED_FILE
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+
+namespace udc {
+
+using std::string;
+using std::runtime_error;
+
+
+/**
+ * @brief Read-only, memory mapped view of a file. The whole file is mapped at once,
+ *        and pages are only read from disk as they are touched.
+ */
+class MappedFile {
+ private:
+	const unsigned char *base;
+	uint64_t length;
+	#ifdef _WIN32
+		HANDLE fileHandle, mapHandle;
+	#endif
+
+	void close();
+
+	MappedFile(const MappedFile &);  // do not use: not implemented!
+	MappedFile& operator=(const MappedFile &);  // do not use: not implemented!
+
+ public:
+	/** @throw std::runtime_error if the file can't be opened or mapped (e.g. it's empty). */
+	MappedFile(const string &filename);
+	~MappedFile();
+
+	const unsigned char* data() const { return base; }
+	const char* chars() const { return reinterpret_cast<const char *>(base); }
+	uint64_t size() const { return length; }
+};
+
+
+//--------------------------------------------------------------------------------
+
+MappedFile::MappedFile(const string &filename) : base(NULL), length(0) {
+	#ifdef _WIN32
+		mapHandle = NULL;
+		fileHandle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+		                         OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (fileHandle == INVALID_HANDLE_VALUE)
+			throw runtime_error("Couldn't open file: " + filename);
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(fileHandle, &fileSize)) {
+			close();
+			throw runtime_error("Couldn't read file: " + filename);
+		}
+		length = fileSize.QuadPart;
+		if (length > 0) {
+			mapHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+			if (mapHandle != NULL)
+				base = static_cast<const unsigned char *>(MapViewOfFile(mapHandle, FILE_MAP_READ, 0, 0, 0));
+		}
+	#else
+		int fd = open(filename.c_str(), O_RDONLY);
+		if (fd < 0)
+			throw runtime_error("Couldn't open file: " + filename);
+		struct stat st;
+		if (fstat(fd, &st) == 0 && st.st_size > 0) {
+			length = st.st_size;
+			void *p = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+			base = (p == MAP_FAILED ? NULL : static_cast<const unsigned char *>(p));
+		}
+		::close(fd);  // the mapping stays valid
+	#endif
+	if (base == NULL) {
+		close();
+		throw runtime_error("Couldn't map file: " + filename);
+	}
+}
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+void MappedFile::close() {
+	#ifdef _WIN32
+		if (base != NULL)
+			UnmapViewOfFile(base);
+		if (mapHandle != NULL)
+			CloseHandle(mapHandle);
+		if (fileHandle != INVALID_HANDLE_VALUE)
+			CloseHandle(fileHandle);
+		mapHandle = NULL;
+		fileHandle = INVALID_HANDLE_VALUE;
+	#else
+		if (base != NULL)
+			munmap(const_cast<unsigned char *>(base), length);
+	#endif
+	base = NULL;
+}
+
+}  // end of namespace udc
+
+#endif
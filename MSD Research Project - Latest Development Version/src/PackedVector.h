@@ -0,0 +1,142 @@
+/**
+ * @file PackedVector.h
+ * @author Christopher D'Angelo
+ * @brief
+ * 	<p> Contains udc::PackedVector, a storage format for large arrays of Vectors (e.g. the spins and
+ * 	fluxes of a FastMSD): x, y, z, and a 0 pad, aligned so that one PackedVector<double> is exactly
+ * 	one AVX register (or one PackedVector<float> one SSE register), and never straddles a cache line. </p>
+ *
+ * 	<p> PackedVector is only for storage. Arithmetic is done in udc::Vector (i.e. double), so energies
+ * 	and magnetizations are always accumulated in double, even when the states are stored as float. </p>
+ *
+ * 	<p> udc::StateVector is the PackedVector that state arrays use: PackedVector<double>, or
+ * 	PackedVector<float> if UDC_FLOAT_STATE is defined (at compile time), which halves the memory
+ * 	(and bandwidth) per site. </p>
+ *
+ * 	<p> udc::PageAllocator allocates large arrays (of at least a 2 MiB huge page) aligned to a huge page,
+ * 	so the OS can back them with huge pages (fewer TLB misses), and smaller ones to a cache line. </p>
+ *
+ * @version 7.0
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2011-2026
+ */
+
+#ifndef UDC_PACKED_VECTOR
+#define UDC_PACKED_VECTOR
+
+#include <cstddef>
+#include <new>
+#include "Vector.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define UDC_PACKED_VECTOR_SSE2
+	#include <emmintrin.h>
+#endif
+
+
+namespace udc {
+
+template <typename T> struct alignas(4 * sizeof(T)) PackedVector {
+	typedef T Scalar;
+
+	T x, y, z;
+	T w;  // always 0
+
+	PackedVector();
+	PackedVector(const Vector &v);  // rounds each component to T
+
+	Vector toVector() const;
+
+	/** The Vector that would be stored, i.e. v with each component rounded to T. */
+	static Vector round(const Vector &v);
+};
+
+
+#ifdef UDC_FLOAT_STATE
+	typedef PackedVector<float> StateVector;
+#else
+	typedef PackedVector<double> StateVector;
+#endif
+
+
+/** A std::allocator for large arrays, e.g. std::vector<StateVector, PageAllocator<StateVector>>. */
+template <typename T> struct PageAllocator {
+	typedef T value_type;
+
+	static constexpr std::size_t CACHE_LINE = 64;
+	static constexpr std::size_t HUGE_PAGE = 2 * 1024 * 1024;
+
+	PageAllocator();
+	template <typename U> PageAllocator(const PageAllocator<U> &);
+
+	T* allocate(std::size_t count);
+	void deallocate(T *p, std::size_t count);
+
+	static std::size_t alignment(std::size_t count);
+};
+
+template <typename T, typename U> bool operator==(const PageAllocator<T> &, const PageAllocator<U> &);
+template <typename T, typename U> bool operator!=(const PageAllocator<T> &, const PageAllocator<U> &);
+
+
+//--------------------------------------------------------------------------------
+
+template <typename T> PackedVector<T>::PackedVector() : x(0), y(0), z(0), w(0) {
+}
+
+template <typename T> PackedVector<T>::PackedVector(const Vector &v)
+: x(static_cast<T>(v.x)), y(static_cast<T>(v.y)), z(static_cast<T>(v.z)), w(0) {
+}
+
+template <typename T> Vector PackedVector<T>::toVector() const {
+	return Vector(x, y, z);
+}
+
+template <typename T> Vector PackedVector<T>::round(const Vector &v) {
+	return PackedVector<T>(v).toVector();
+}
+
+#ifdef UDC_PACKED_VECTOR_SSE2
+// Explicitly, since GCC 12's SLP vectorizer (-O2) can drop a round trip from double to float and back
+template <> Vector PackedVector<float>::round(const Vector &v) {
+	const __m128d xy = _mm_cvtps_pd(_mm_cvtpd_ps(_mm_loadu_pd(&v.x)));
+	const __m128d z = _mm_cvtss_sd(_mm_setzero_pd(), _mm_cvtsd_ss(_mm_setzero_ps(), _mm_set_sd(v.z)));
+	Vector r;
+	_mm_storeu_pd(&r.x, xy);
+	_mm_store_sd(&r.z, z);
+	return r;
+}
+#endif
+
+
+template <typename T> PageAllocator<T>::PageAllocator() {
+}
+
+template <typename T> template <typename U> PageAllocator<T>::PageAllocator(const PageAllocator<U> &) {
+}
+
+template <typename T> T* PageAllocator<T>::allocate(std::size_t count) {
+	return static_cast<T *>(::operator new(count * sizeof(T), std::align_val_t(alignment(count))));
+}
+
+template <typename T> void PageAllocator<T>::deallocate(T *p, std::size_t count) {
+	::operator delete(p, std::align_val_t(alignment(count)));
+}
+
+template <typename T> std::size_t PageAllocator<T>::alignment(std::size_t count) {
+	const std::size_t a = count * sizeof(T) >= HUGE_PAGE ? HUGE_PAGE : CACHE_LINE;
+	return a >= alignof(T) ? a : alignof(T);
+}
+
+template <typename T, typename U> bool operator==(const PageAllocator<T> &, const PageAllocator<U> &) {
+	return true;
+}
+
+template <typename T, typename U> bool operator!=(const PageAllocator<T> &, const PageAllocator<U> &) {
+	return false;
+}
+
+}  // end of namespace udc
+
+#endif
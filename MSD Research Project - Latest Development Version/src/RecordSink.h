@@ -0,0 +1,482 @@
+/**
+ * @file RecordSink.h
+ * @author Christopher D'Angelo
+ * @brief Implementations of udc::MSD::RecordSink, which decide where the Results
+ *        recorded by udc::MSD::metropolis(N, freq) end up.
+ *
+ * @version 6.4
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2011-2026
+ */
+
+#ifndef UDC_RECORD_SINK
+#define UDC_RECORD_SINK
+
+#include <charconv>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "MSD.h"
+#include "ResultsWriter.h"
+
+
+namespace udc {
+
+using std::condition_variable;
+using std::exception_ptr;
+using std::invalid_argument;
+using std::lock_guard;
+using std::mutex;
+using std::ostream;
+using std::out_of_range;
+using std::string;
+using std::thread;
+using std::unique_lock;
+using std::vector;
+
+
+/**
+ * @brief Appends Results to a std::vector.
+ *        Same behavior as the default (i.e. MSD::recordSink == NULL), but can target any vector.
+ */
+class VectorRecordSink : public MSD::RecordSink {
+ private:
+	vector<MSD::Results> &record;
+
+ public:
+	VectorRecordSink(vector<MSD::Results> &record) : record(record) {}
+
+	void put(const MSD::Results &r) { record.push_back(r); }
+	void clear() { record.clear(); }
+};
+
+
+/**
+ * @brief Forwards only every "factor"-th Results (starting with the first) to another RecordSink.
+ *        Since Results carry their own time (t), statistics computed from the
+ *        forwarded Results are still properly time weighted, just more coarsely.
+ */
+class DecimatingRecordSink : public MSD::RecordSink {
+ private:
+	MSD::RecordSink &next;
+	unsigned long long factor;
+	unsigned long long count;
+
+ public:
+	DecimatingRecordSink(MSD::RecordSink &next, unsigned long long factor);
+
+	void put(const MSD::Results &);
+	void clear();
+	void flush();
+};
+
+
+/**
+ * @brief Keeps no record at all; only the running (trapezoidal) sums needed for
+ *        the mean, specific heat, and magnetic susceptibility.
+ *
+ * Each method gives the same result as the MSD method of the same name would have
+ * if the Results had been stored in MSD::record instead.
+ * Uses the MSD's current kT and region sizes, just like the MSD methods do.
+ */
+class StatisticsRecordSink : public MSD::RecordSink {
+ private:
+	struct ScalarSum {
+		double s, s2;
+	};
+
+	struct VectorSum {
+		Vector s;
+		double s2;
+	};
+
+	const MSD &msd;
+	size_t count;  // number of Results put since the last clear()
+	MSD::Results first, last;
+	VectorSum M, ML, MR, Mm, MS, MSL, MSR, MSm, MF, MFL, MFR, MFm;
+	ScalarSum U, UL, UR, Um, UmL, UmR, ULR;
+
+	static void accumulate(ScalarSum &, double u0, double u1, double dt);
+	static void accumulate(VectorSum &, const Vector &m0, const Vector &m1, double dt);
+
+	Vector mean(const VectorSum &, const Vector &firstValue) const;
+	double mean(const ScalarSum &, double firstValue) const;
+	double specificHeat(const ScalarSum &, unsigned int n) const;
+	double magneticSusceptibility(const VectorSum &, unsigned int n) const;
+
+ public:
+	StatisticsRecordSink(const MSD &msd);
+
+	void put(const MSD::Results &);
+	void clear();
+
+	size_t size() const;  // number of Results put since the last clear()
+	const MSD::Results& front() const;  // throws out_of_range if size() == 0
+	const MSD::Results& back() const;   // throws out_of_range if size() == 0
+
+	double specificHeat() const;
+	double specificHeat_L() const;
+	double specificHeat_R() const;
+	double specificHeat_m() const;
+	double specificHeat_mL() const;
+	double specificHeat_mR() const;
+	double specificHeat_LR() const;
+	double magneticSusceptibility() const;
+	double magneticSusceptibility_L() const;
+	double magneticSusceptibility_R() const;
+	double magneticSusceptibility_m() const;
+
+	// throw out_of_range if size() == 0 (same as the MSD methods when MSD::record is empty)
+	Vector meanM() const;
+	Vector meanML() const;
+	Vector meanMR() const;
+	Vector meanMm() const;
+	Vector meanMS() const;
+	Vector meanMSL() const;
+	Vector meanMSR() const;
+	Vector meanMSm() const;
+	Vector meanMF() const;
+	Vector meanMFL() const;
+	Vector meanMFR() const;
+	Vector meanMFm() const;
+	double meanU() const;
+	double meanUL() const;
+	double meanUR() const;
+	double meanUm() const;
+	double meanUmL() const;
+	double meanUmR() const;
+	double meanULR() const;
+};
+
+
+/**
+ * @brief Streams Results to an ostream from a background thread, so that
+ *        formatting and disk I/O overlap with the simulation.
+ *
+ * Results are collected into a "front" buffer. Once it is full, it is swapped with
+ * the "back" buffer, which the writer thread then empties into the ostream.
+ * put() only blocks if the writer thread is still busy with the previous buffer.
+ *
+ * Each Results becomes one row, as written by ResultsWriter::record(). No header is written;
+ * use ResultsWriter::recordColumnNames() on the same ostream beforehand if one is needed
+ * (required for ResultsWriter::BINARY).
+ *
+ * The ostream must not be used by anyone else until close() returns.
+ * Errors thrown by the ostream (e.g. ios::failure) are rethrown by flush() or close().
+ */
+class AsyncFileRecordSink : public MSD::RecordSink {
+ private:
+	ostream &out;
+	ResultsWriter rowWriter;  // only used by the writer thread
+	size_t bufferSize;
+
+	vector<MSD::Results> front;  // filled by put() (simulation thread)
+	vector<MSD::Results> back;   // emptied by the writer thread
+	bool backReady;  // true while the writer thread owns "back"
+	bool closing;
+	exception_ptr error;  // first exception thrown while writing
+
+	mutex lock;
+	condition_variable cv;
+	thread writer;
+
+	void handOff();  // give "front" to the writer thread
+	void run();      // body of the writer thread
+
+	AsyncFileRecordSink(const AsyncFileRecordSink &);  // do not use: not implemented!
+	AsyncFileRecordSink& operator=(const AsyncFileRecordSink &);  // do not use: not implemented!
+
+ public:
+	AsyncFileRecordSink(ostream &out, ResultsWriter::Format format = ResultsWriter::CSV, bool derived = true, size_t bufferSize = 4096);
+	~AsyncFileRecordSink();  // calls close(), but ignores any errors
+
+	void put(const MSD::Results &);
+	void flush();  // also flushes the ostream
+	void close();  // flush() then stop the writer thread. put() may not be called afterwards.
+};
+
+
+/**
+ * @brief Parses a command line record sink spec of the form "<type>[:<decimation>]",
+ *        e.g. "memory", "stats", or "stream:10".
+ *
+ * @param spec The argument to parse.
+ * @param type Set to the part before the ':'.
+ * @param decimation Set to the part after the ':', or 1 if there is none.
+ * @return false if the decimation factor isn't a positive integer.
+ */
+bool parseRecordSinkSpec(const string &spec, string &type, unsigned long long &decimation);
+
+
+//--------------------------------------------------------------------------------
+
+DecimatingRecordSink::DecimatingRecordSink(MSD::RecordSink &next, unsigned long long factor)
+: next(next), factor(factor), count(0) {
+	if (factor == 0)
+		throw invalid_argument("DecimatingRecordSink: factor must be positive");
+}
+
+void DecimatingRecordSink::put(const MSD::Results &r) {
+	if (count++ % factor == 0)
+		next.put(r);
+}
+
+void DecimatingRecordSink::clear() {
+	count = 0;
+	next.clear();
+}
+
+void DecimatingRecordSink::flush() {
+	next.flush();
+}
+
+
+StatisticsRecordSink::StatisticsRecordSink(const MSD &msd) : msd(msd) {
+	clear();
+}
+
+void StatisticsRecordSink::clear() {
+	count = 0;
+	first = last = MSD::Results();
+	M = ML = MR = Mm = MS = MSL = MSR = MSm = MF = MFL = MFR = MFm = VectorSum{Vector::ZERO, 0};
+	U = UL = UR = Um = UmL = UmR = ULR = ScalarSum{0, 0};
+}
+
+// Note: the following expressions must stay identical to the ones in MSD::specificHeat(),
+// MSD::magneticSusceptibility(), and MSD::mean*() so that the results are bit-for-bit the same.
+void StatisticsRecordSink::accumulate(ScalarSum &sum, double u0, double u1, double dt) {
+	double dU = u1 - u0;
+	sum.s += (u0 + u1) * dt;  // trapizoidal rule (1/2 factored out)
+	sum.s2 += ((dt/3 * dU + u0) * dU + sq(u0)) * dt;  // square of trapizoidal rule (linear interpolation)
+}
+
+void StatisticsRecordSink::accumulate(VectorSum &sum, const Vector &m0, const Vector &m1, double dt) {
+	Vector dM = m1 - m0;
+	sum.s += (m0 + m1) * dt;  // trapizoidal rule (1/2 factored out)
+	sum.s2 += ((dt/3 * dM + m0) * dM + m0 * m0) * dt;  // square of trapizoidal rule (linear interpolation)
+}
+
+void StatisticsRecordSink::put(const MSD::Results &r) {
+	if (count == 0) {
+		first = r;
+	} else {
+		double dt = r.t - last.t;
+		accumulate(M,   last.M,   r.M,   dt);
+		accumulate(ML,  last.ML,  r.ML,  dt);
+		accumulate(MR,  last.MR,  r.MR,  dt);
+		accumulate(Mm,  last.Mm,  r.Mm,  dt);
+		accumulate(MS,  last.MS,  r.MS,  dt);
+		accumulate(MSL, last.MSL, r.MSL, dt);
+		accumulate(MSR, last.MSR, r.MSR, dt);
+		accumulate(MSm, last.MSm, r.MSm, dt);
+		accumulate(MF,  last.MF,  r.MF,  dt);
+		accumulate(MFL, last.MFL, r.MFL, dt);
+		accumulate(MFR, last.MFR, r.MFR, dt);
+		accumulate(MFm, last.MFm, r.MFm, dt);
+		accumulate(U,   last.U,   r.U,   dt);
+		accumulate(UL,  last.UL,  r.UL,  dt);
+		accumulate(UR,  last.UR,  r.UR,  dt);
+		accumulate(Um,  last.Um,  r.Um,  dt);
+		accumulate(UmL, last.UmL, r.UmL, dt);
+		accumulate(UmR, last.UmR, r.UmR, dt);
+		accumulate(ULR, last.ULR, r.ULR, dt);
+	}
+	last = r;
+	count++;
+}
+
+size_t StatisticsRecordSink::size() const {
+	return count;
+}
+
+const MSD::Results& StatisticsRecordSink::front() const {
+	if (count == 0)
+		throw out_of_range("StatisticsRecordSink::front(): no Results");
+	return first;
+}
+
+const MSD::Results& StatisticsRecordSink::back() const {
+	if (count == 0)
+		throw out_of_range("StatisticsRecordSink::back(): no Results");
+	return last;
+}
+
+Vector StatisticsRecordSink::mean(const VectorSum &sum, const Vector &firstValue) const {
+	if (count == 0)
+		throw out_of_range("StatisticsRecordSink: can't take the mean of no Results");
+	if (count == 1)
+		return firstValue;
+	return (0.5 / (last.t - first.t)) * sum.s;
+}
+
+double StatisticsRecordSink::mean(const ScalarSum &sum, double firstValue) const {
+	if (count == 0)
+		throw out_of_range("StatisticsRecordSink: can't take the mean of no Results");
+	if (count == 1)
+		return firstValue;
+	return (0.5 / (last.t - first.t)) * sum.s;
+}
+
+double StatisticsRecordSink::specificHeat(const ScalarSum &sum, unsigned int n) const {
+	if (count <= 1)
+		return 0;  // <U^2> - <U>^2 == 0 if there is only 1 data point
+	double kT = msd.getParameters().kT;
+	double dt = last.t - first.t;
+	double avg = 0.5 * sum.s / dt;
+	double avgSq = sum.s2 / dt;
+	return (avgSq - sq(avg)) / (n * kT * kT);
+}
+
+double StatisticsRecordSink::magneticSusceptibility(const VectorSum &sum, unsigned int n) const {
+	if (count <= 1)
+		return 0;  // <M^2> - <M>^2 == 0 if there is only 1 data point
+	double kT = msd.getParameters().kT;
+	double dt = last.t - first.t;
+	Vector avg = 0.5 / dt * sum.s;
+	double avgSq = sum.s2 / dt;
+	return (avgSq - avg * avg) / (n * kT * kT);
+}
+
+double StatisticsRecordSink::specificHeat() const    { return specificHeat(U,   msd.getN());    }
+double StatisticsRecordSink::specificHeat_L() const  { return specificHeat(UL,  msd.getNL());   }
+double StatisticsRecordSink::specificHeat_R() const  { return specificHeat(UR,  msd.getNR());   }
+double StatisticsRecordSink::specificHeat_m() const  { return specificHeat(Um,  msd.getNm());   }
+double StatisticsRecordSink::specificHeat_mL() const { return specificHeat(UmL, msd.getNmL());  }
+double StatisticsRecordSink::specificHeat_mR() const { return specificHeat(UmR, msd.getNmR());  }
+double StatisticsRecordSink::specificHeat_LR() const { return specificHeat(ULR, msd.getNLR());  }
+
+double StatisticsRecordSink::magneticSusceptibility() const   { return magneticSusceptibility(M,  msd.getN());  }
+double StatisticsRecordSink::magneticSusceptibility_L() const { return magneticSusceptibility(ML, msd.getNL()); }
+double StatisticsRecordSink::magneticSusceptibility_R() const { return magneticSusceptibility(MR, msd.getNR()); }
+double StatisticsRecordSink::magneticSusceptibility_m() const { return magneticSusceptibility(Mm, msd.getNm()); }
+
+Vector StatisticsRecordSink::meanM() const   { return mean(M,   first.M);   }
+Vector StatisticsRecordSink::meanML() const  { return mean(ML,  first.ML);  }
+Vector StatisticsRecordSink::meanMR() const  { return mean(MR,  first.MR);  }
+Vector StatisticsRecordSink::meanMm() const  { return mean(Mm,  first.Mm);  }
+Vector StatisticsRecordSink::meanMS() const  { return mean(MS,  first.MS);  }
+Vector StatisticsRecordSink::meanMSL() const { return mean(MSL, first.MSL); }
+Vector StatisticsRecordSink::meanMSR() const { return mean(MSR, first.MSR); }
+Vector StatisticsRecordSink::meanMSm() const { return mean(MSm, first.MSm); }
+Vector StatisticsRecordSink::meanMF() const  { return mean(MF,  first.MF);  }
+Vector StatisticsRecordSink::meanMFL() const { return mean(MFL, first.MFL); }
+Vector StatisticsRecordSink::meanMFR() const { return mean(MFR, first.MFR); }
+Vector StatisticsRecordSink::meanMFm() const { return mean(MFm, first.MFm); }
+double StatisticsRecordSink::meanU() const   { return mean(U,   first.U);   }
+double StatisticsRecordSink::meanUL() const  { return mean(UL,  first.UL);  }
+double StatisticsRecordSink::meanUR() const  { return mean(UR,  first.UR);  }
+double StatisticsRecordSink::meanUm() const  { return mean(Um,  first.Um);  }
+double StatisticsRecordSink::meanUmL() const { return mean(UmL, first.UmL); }
+double StatisticsRecordSink::meanUmR() const { return mean(UmR, first.UmR); }
+double StatisticsRecordSink::meanULR() const { return mean(ULR, first.ULR); }
+
+
+AsyncFileRecordSink::AsyncFileRecordSink(ostream &out, ResultsWriter::Format format, bool derived, size_t bufferSize)
+: out(out), rowWriter(out, format, derived), bufferSize(bufferSize > 0 ? bufferSize : 1), backReady(false), closing(false) {
+	front.reserve(this->bufferSize);
+	back.reserve(this->bufferSize);
+	writer = thread(&AsyncFileRecordSink::run, this);
+}
+
+AsyncFileRecordSink::~AsyncFileRecordSink() {
+	try {
+		close();
+	} catch(...) {
+		// destructors must not throw
+	}
+}
+
+void AsyncFileRecordSink::put(const MSD::Results &r) {
+	front.push_back(r);
+	if (front.size() >= bufferSize)
+		handOff();
+}
+
+void AsyncFileRecordSink::handOff() {
+	unique_lock<mutex> guard(lock);
+	cv.wait(guard, [this]() { return !backReady; });
+	if (error)
+		std::rethrow_exception(error);
+	std::swap(front, back);  // Note: "back" was emptied by the writer thread, so "front" is now empty
+	backReady = true;
+	cv.notify_all();
+}
+
+void AsyncFileRecordSink::run() {
+	unique_lock<mutex> guard(lock);
+	while (true) {
+		cv.wait(guard, [this]() { return backReady || closing; });
+		if (!backReady)
+			break;  // closing, and nothing left to write
+		guard.unlock();
+		if (!error) {  // after an error, the remaining Results are dropped
+			try {
+				for (const MSD::Results &r : back) {
+					rowWriter.record(r);
+					rowWriter.endRow();
+				}
+				rowWriter.flush();
+			} catch(...) {
+				error = std::current_exception();  // Note: only read by others while !backReady
+			}
+		}
+		back.clear();
+		guard.lock();
+		backReady = false;
+		cv.notify_all();
+	}
+}
+
+void AsyncFileRecordSink::flush() {
+	if (!writer.joinable())
+		return;  // already closed
+	if (!front.empty())
+		handOff();
+	unique_lock<mutex> guard(lock);
+	cv.wait(guard, [this]() { return !backReady; });
+	if (error)
+		std::rethrow_exception(error);
+	out.flush();  // safe: the writer thread is idle
+}
+
+void AsyncFileRecordSink::close() {
+	if (!writer.joinable())
+		return;  // already closed
+	exception_ptr flushError;
+	try {
+		flush();
+	} catch(...) {
+		flushError = std::current_exception();
+	}
+	{	lock_guard<mutex> guard(lock);
+		closing = true;
+	}
+	cv.notify_all();
+	writer.join();
+	if (flushError)
+		std::rethrow_exception(flushError);
+}
+
+
+bool parseRecordSinkSpec(const string &spec, string &type, unsigned long long &decimation) {
+	size_t colon = spec.find(':');
+	type = spec.substr(0, colon);
+	decimation = 1;
+	if (colon == string::npos)
+		return true;
+	// (from_chars, unlike istream >>, doesn't accept a '-' and wrap it around to a huge factor)
+	const char *first = spec.data() + colon + 1, *last = spec.data() + spec.size();
+	std::from_chars_result r = std::from_chars(first, last, decimation);
+	return r.ec == std::errc() && r.ptr == last && decimation != 0;
+}
+
+}  // end of namespace udc
+
+#endif
@@ -0,0 +1,334 @@
+/**
+ * @file ResultsWriter.h
+ * @author Christopher D'Angelo
+ * @brief Contains udc::ResultsWriter, the buffered CSV (or binary) row writer
+ *        shared by the apps for writing udc::MSD::Results.
+ *
+ * @version 6.4
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2011-2026
+ */
+
+#ifndef UDC_RESULTS_WRITER
+#define UDC_RESULTS_WRITER
+
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "MSD.h"
+#include "Vector.h"
+#include "udc.h"
+
+
+namespace udc {
+
+using std::ostream;
+using std::string;
+
+
+/**
+ * @brief Writes rows of numbers (usually MSD::Results) to an ostream, either as CSV or as binary.
+ *
+ * Both the header and the rows are written cell by cell. In CSV mode, cells are separated by commas
+ * and formatted with std::to_chars (same text as the default ostream formatting, i.e. "%g") into a
+ * large buffer, which is only handed to the ostream when it fills up or on flush().
+ * An empty column name (i.e. a spacer) results in an empty CSV column, used to group columns visually.
+ *
+ * In BINARY mode, spacers and text() are ignored, and the layout is:
+ *   - 8 byte magic string: BINARY_MAGIC
+ *   - uint32: number of columns, C
+ *   - C times: uint32 length, followed by that many chars (the column name)
+ *   - uint32 length, followed by that many chars (the "info" given to endHeader())
+ *   - rows until EOF: C doubles each (native endianness), including integers like "t"
+ *
+ * The derived Vector columns (norm, theta, phi) are only computed and written if "derived" is true.
+ *
+ * If the ostream is shared with other code, call flush() before using the ostream directly.
+ */
+class ResultsWriter {
+ public:
+	enum Format { CSV, BINARY };
+
+	static const char BINARY_MAGIC[8];
+
+	/** Number of cells written by record(const MSD::Results &) (including spacers). */
+	static size_t recordColumnCount(bool derived);
+
+ private:
+	ostream &out;
+	Format format;
+	bool derived;
+	std::vector<char> buffer;
+	size_t used;  // bytes of "buffer" in use
+	bool rowStarted;  // (CSV) true once a cell has been written to the current row (or header)
+	std::vector<string> columns;  // (BINARY) non-spacer column names, written by endHeader()
+
+	void reserve(size_t n);  // makes sure there are at least n unused bytes in buffer
+	void separate();         // (CSV) writes ',' if this isn't the first cell in the row
+	void raw(const void *data, size_t size);
+
+	ResultsWriter(const ResultsWriter &);  // do not use: not implemented!
+	ResultsWriter& operator=(const ResultsWriter &);  // do not use: not implemented!
+
+ public:
+	ResultsWriter(ostream &out, Format format = CSV, bool derived = true, size_t bufferSize = 1 << 20);
+	~ResultsWriter();  // calls flush(), but ignores any errors
+
+	Format getFormat() const;
+	bool hasDerived() const;
+
+	// ---- Header ----
+	void columnName(const string &name);  // empty name means spacer
+	void vectorColumnNames(const string &name);  // e.g. name_x, name_y, name_z, name_norm, name_theta, name_phi
+	void resultsColumnNames(const string &prefix = "", const string &suffix = "");  // e.g. <prefix>M<suffix>_x, ..., <prefix>ULR<suffix>
+	void recordColumnNames();  // t, spacer, resultsColumnNames()
+	void endHeader(const string &info = "");  // (CSV) info is written as is, at the end of the header line
+
+	// ---- Rows ----
+	void value(double);
+	void value(unsigned long long);
+	void value(unsigned int);
+	void value(const Vector &);  // x, y, z, and (if derived) norm, theta, phi
+	void results(const MSD::Results &);  // all Vectors (each followed by a spacer) then all energies
+	void record(const MSD::Results &);   // t, spacer, results()
+	void spacer();
+	void spacers(size_t count);
+	void text(const string &);  // (CSV only) written as is, as its own cell
+	void endRow();
+
+	void flush();  // writes the buffer to the ostream (but doesn't flush the ostream itself)
+};
+
+
+/**
+ * @brief Parses a command line output format: "csv", "csv-xyz", "binary", or "binary-xyz".
+ *        The "-xyz" suffix leaves out the derived (norm, theta, phi) Vector columns.
+ * @return false if the format is unrecognized.
+ */
+bool parseResultsFormat(const string &s, ResultsWriter::Format &format, bool &derived);
+
+
+//--------------------------------------------------------------------------------
+
+const char ResultsWriter::BINARY_MAGIC[8] = { 'M', 'S', 'D', 'R', 'O', 'W', 'S', '\x01' };
+
+// Note: keep in the same order as MSD::Results
+static const char * const RESULTS_VECTOR_NAMES[] = { "M", "ML", "MR", "Mm", "MS", "MSL", "MSR", "MSm", "MF", "MFL", "MFR", "MFm" };
+static const char * const RESULTS_ENERGY_NAMES[] = { "U", "UL", "UR", "Um", "UmL", "UmR", "ULR" };
+
+size_t ResultsWriter::recordColumnCount(bool derived) {
+	return 2 + 12 * ((derived ? 6 : 3) + 1) + 7;
+}
+
+ResultsWriter::ResultsWriter(ostream &out, Format format, bool derived, size_t bufferSize)
+: out(out), format(format), derived(derived), buffer(bufferSize < 256 ? 256 : bufferSize), used(0),
+  rowStarted(false) {
+}
+
+ResultsWriter::~ResultsWriter() {
+	try {
+		flush();
+	} catch(...) {
+		// destructors must not throw
+	}
+}
+
+ResultsWriter::Format ResultsWriter::getFormat() const {
+	return format;
+}
+
+bool ResultsWriter::hasDerived() const {
+	return derived;
+}
+
+void ResultsWriter::reserve(size_t n) {
+	if (buffer.size() - used < n) {
+		flush();
+		if (buffer.size() < n)
+			buffer.resize(n);
+	}
+}
+
+void ResultsWriter::separate() {
+	if (rowStarted) {
+		reserve(1);
+		buffer[used++] = ',';
+	}
+	rowStarted = true;
+}
+
+void ResultsWriter::raw(const void *data, size_t size) {
+	reserve(size);
+	memcpy(&buffer[used], data, size);
+	used += size;
+}
+
+void ResultsWriter::columnName(const string &name) {
+	if (format == BINARY) {
+		if (!name.empty())
+			columns.push_back(name);
+	} else {
+		separate();
+		raw(name.data(), name.size());
+	}
+}
+
+void ResultsWriter::vectorColumnNames(const string &name) {
+	columnName(name + "_x");
+	columnName(name + "_y");
+	columnName(name + "_z");
+	if (derived) {
+		columnName(name + "_norm");
+		columnName(name + "_theta");
+		columnName(name + "_phi");
+	}
+}
+
+void ResultsWriter::resultsColumnNames(const string &prefix, const string &suffix) {
+	for (const char *name : RESULTS_VECTOR_NAMES) {
+		vectorColumnNames(prefix + name + suffix);
+		columnName("");
+	}
+	for (const char *name : RESULTS_ENERGY_NAMES)
+		columnName(prefix + name + suffix);
+}
+
+void ResultsWriter::recordColumnNames() {
+	columnName("t");
+	columnName("");
+	resultsColumnNames();
+}
+
+void ResultsWriter::endHeader(const string &info) {
+	if (format == BINARY) {
+		raw(BINARY_MAGIC, sizeof(BINARY_MAGIC));
+		uint32_t n = static_cast<uint32_t>(columns.size());
+		raw(&n, sizeof(n));
+		for (const string &name : columns) {
+			n = static_cast<uint32_t>(name.size());
+			raw(&n, sizeof(n));
+			raw(name.data(), name.size());
+		}
+		n = static_cast<uint32_t>(info.size());
+		raw(&n, sizeof(n));
+		raw(info.data(), info.size());
+		columns.clear();
+	} else {
+		raw(info.data(), info.size());
+		raw("\n", 1);
+	}
+	rowStarted = false;
+}
+
+void ResultsWriter::value(double x) {
+	if (format == BINARY) {
+		raw(&x, sizeof(x));
+	} else {
+		separate();
+		reserve(32);  // enough for any double in "%.6g" form (e.g. "-1.23457e-308")
+		char *first = &buffer[used];
+		used = std::to_chars(first, first + 32, x, std::chars_format::general, 6).ptr - &buffer[0];
+	}
+}
+
+void ResultsWriter::value(unsigned long long x) {
+	if (format == BINARY) {
+		double d = static_cast<double>(x);
+		raw(&d, sizeof(d));
+	} else {
+		separate();
+		reserve(24);
+		char *first = &buffer[used];
+		used = std::to_chars(first, first + 24, x).ptr - &buffer[0];
+	}
+}
+
+void ResultsWriter::value(unsigned int x) {
+	value(static_cast<unsigned long long>(x));
+}
+
+void ResultsWriter::value(const Vector &v) {
+	value(v.x);
+	value(v.y);
+	value(v.z);
+	if (derived) {
+		value(v.norm());
+		value(v.theta());
+		value(v.phi());
+	}
+}
+
+void ResultsWriter::results(const MSD::Results &r) {
+	for (const Vector *v : {&r.M, &r.ML, &r.MR, &r.Mm, &r.MS, &r.MSL, &r.MSR, &r.MSm, &r.MF, &r.MFL, &r.MFR, &r.MFm}) {
+		value(*v);
+		spacer();
+	}
+	for (double u : {r.U, r.UL, r.UR, r.Um, r.UmL, r.UmR, r.ULR})
+		value(u);
+}
+
+void ResultsWriter::record(const MSD::Results &r) {
+	value(r.t);
+	spacer();
+	results(r);
+}
+
+void ResultsWriter::spacer() {
+	if (format == CSV)
+		separate();
+}
+
+void ResultsWriter::spacers(size_t count) {
+	while (count-- > 0)
+		spacer();
+}
+
+void ResultsWriter::text(const string &s) {
+	if (format == CSV) {
+		separate();
+		raw(s.data(), s.size());
+	}
+}
+
+void ResultsWriter::endRow() {
+	if (format == CSV) {
+		reserve(1);
+		buffer[used++] = '\n';
+	}
+	rowStarted = false;
+}
+
+void ResultsWriter::flush() {
+	if (used > 0) {
+		out.write(&buffer[0], used);
+		used = 0;
+	}
+}
+
+
+bool parseResultsFormat(const string &s, ResultsWriter::Format &format, bool &derived) {
+	if (s == "csv") {
+		format = ResultsWriter::CSV;
+		derived = true;
+	} else if (s == "csv-xyz") {
+		format = ResultsWriter::CSV;
+		derived = false;
+	} else if (s == "binary") {
+		format = ResultsWriter::BINARY;
+		derived = true;
+	} else if (s == "binary-xyz") {
+		format = ResultsWriter::BINARY;
+		derived = false;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+}  // end of namespace udc
+
+#endif
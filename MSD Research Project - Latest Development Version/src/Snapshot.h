@@ -0,0 +1,192 @@
+/**
+ * @file Snapshot.h
+ * @author Christopher D'Angelo
+ * @brief Contains udc::SnapshotPublisher, which lets other threads read the Results (and optionally the spins
+ *        and fluxes) of an MSD while metropolis runs, without ever blocking the simulation thread.
+ *        Used by udc::AsyncRun (and so MSD-export's getRunResults and getRunSnapshot).
+ *
+ * @version 6.4
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2011-2026
+ */
+
+#ifndef UDC_SNAPSHOT
+#define UDC_SNAPSHOT
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include "MSD.h"
+
+
+namespace udc {
+
+using std::atomic;
+using std::lock_guard;
+using std::mutex;
+using std::vector;
+
+
+/**
+ * @brief A lock-free "triple buffer": one thread (the writer) publishes values of T, and other threads
+ *        read the latest one.
+ *
+ * The writer fills its own "back" buffer (write()), then swaps it with the "middle" buffer (publish()):
+ * one atomic exchange, which never waits. A reader swaps the middle buffer (if it's newer) with its own
+ * "front" buffer, then copies from the front buffer, which the writer never touches, so a read is always
+ * consistent (never torn). Readers only wait for each other (e.g. two UI threads), never for the writer.
+ *
+ * Buffers are reused, so e.g. vectors in T keep their capacity, and publishing doesn't allocate.
+ */
+template <typename T> class TripleBuffer {
+ public:
+	TripleBuffer();
+
+	/** (writer) The buffer to fill before calling publish(). It may contain an old value. */
+	T& write();
+
+	/** (writer) Makes the value in write() the latest. */
+	void publish();
+
+	/**
+	 * (reader) Copies the latest published value.
+	 * @return false if nothing has been published yet (and out is unchanged)
+	 */
+	bool read(T &out) const;
+
+ private:
+	static const unsigned int FRESH = 4;  // flag (with the index of the middle buffer): not read yet
+
+	T buffers[3];
+	mutable atomic<unsigned int> middle;  // index | FRESH (readers swap it too)
+	unsigned int back;            // only used by the writer
+	mutable unsigned int front;   // guarded by readLock
+	mutable bool published;       // guarded by readLock: front has a value
+	mutable mutex readLock;
+};
+
+
+/** An MSD's state at one point in a simulation. */
+struct MSDSnapshot {
+	MSD::Results results;
+	vector<unsigned int> indices;  // in MSD::Iterator order
+	vector<Vector> spins, fluxes;  // for each index
+};
+
+
+/**
+ * @brief Publishes an MSD's Results, and optionally its spins and fluxes, for other threads.
+ *
+ * The simulation thread calls publish(msd) now and then (e.g. between calls to metropolis(n), as AsyncRun
+ * does). Any thread may then call getResults() or getSnapshot().
+ *
+ * Results are small, so they are published every time. The spins and fluxes (MSDSnapshot) cost O(n) to copy,
+ * so they are only published if enabled (setStates), and at most once every "interval" seconds.
+ * Each MSDSnapshot is consistent: its Results are from when its spins and fluxes were copied.
+ */
+class SnapshotPublisher {
+ public:
+	SnapshotPublisher(bool states = false, double interval = 0.02);
+
+	/** (any thread) Turns the publishing of spins and fluxes on or off. */
+	void setStates(bool states);
+	bool getStates() const;
+
+	/** (simulation thread) */
+	void publish(const MSD &msd);
+
+	/** @return false if nothing has been published yet */
+	bool getResults(MSD::Results &results) const;
+
+	/** @return false if no spins and fluxes have been published yet (see setStates) */
+	bool getSnapshot(MSDSnapshot &snapshot) const;
+
+ private:
+	TripleBuffer<MSD::Results> results;
+	TripleBuffer<MSDSnapshot> snapshots;
+	atomic<bool> states;
+	const std::chrono::steady_clock::duration interval;
+	std::chrono::steady_clock::time_point last;  // last MSDSnapshot published (simulation thread only)
+	bool first;  // no MSDSnapshot published yet (simulation thread only)
+};
+
+
+//--------------------------------------------------------------------------------
+
+template <typename T> TripleBuffer<T>::TripleBuffer() : middle(1), back(0), front(2), published(false) {
+}
+
+template <typename T> T& TripleBuffer<T>::write() {
+	return buffers[back];
+}
+
+template <typename T> void TripleBuffer<T>::publish() {
+	// release: the reader who takes this buffer sees everything written to it
+	// acquire: the buffer we get back isn't still being read from
+	back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & ~FRESH;
+}
+
+template <typename T> bool TripleBuffer<T>::read(T &out) const {
+	lock_guard<mutex> guard(readLock);
+	if (middle.load(std::memory_order_relaxed) & FRESH) {
+		front = middle.exchange(front, std::memory_order_acq_rel) & ~FRESH;
+		published = true;
+	}
+	if (!published)
+		return false;
+	out = buffers[front];
+	return true;
+}
+
+
+SnapshotPublisher::SnapshotPublisher(bool states, double interval)
+: states(states), interval(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(interval))),
+  first(true) {
+}
+
+void SnapshotPublisher::setStates(bool states) {
+	this->states.store(states, std::memory_order_relaxed);
+}
+
+bool SnapshotPublisher::getStates() const {
+	return states.load(std::memory_order_relaxed);
+}
+
+void SnapshotPublisher::publish(const MSD &msd) {
+	results.write() = msd.getResults();
+	results.publish();
+
+	if (!states.load(std::memory_order_relaxed))
+		return;
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (!first && now - last < interval)
+		return;
+	first = false;
+	last = now;
+
+	MSDSnapshot &s = snapshots.write();
+	s.results = msd.getResults();
+	s.indices.clear();
+	s.spins.clear();
+	s.fluxes.clear();
+	for (MSD::Iterator i = msd.begin(); i != msd.end(); ++i) {
+		s.indices.push_back(i.getIndex());
+		s.spins.push_back(i.getSpin());
+		s.fluxes.push_back(i.getFlux());
+	}
+	snapshots.publish();
+}
+
+bool SnapshotPublisher::getResults(MSD::Results &r) const {
+	return results.read(r);
+}
+
+bool SnapshotPublisher::getSnapshot(MSDSnapshot &snapshot) const {
+	return snapshots.read(snapshot);
+}
+
+}  // end of namespace udc
+
+#endif
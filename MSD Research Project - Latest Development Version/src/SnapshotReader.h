@@ -0,0 +1,217 @@
+/**
+ * @file SnapshotReader.h
+ * @author Christopher D'Angelo
+ * @brief Reads device snapshots (the position, m, s, and f of every atom) from the output of
+ *        iterate (CSV) and metropolis (XML or column files). Used by mfm_aggregator and mfm_image.
+ *
+ * @version 6.4
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2011-2026
+ */
+
+#ifndef UDC_SNAPSHOT_READER
+#define UDC_SNAPSHOT_READER
+
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <istream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "ColumnFile.h"
+#include "MappedFile.h"
+#include "Vector.h"
+#include "XMLTag.h"
+
+
+namespace udc {
+
+using std::string;
+using std::string_view;
+using std::vector;
+
+
+struct SnapshotAtom {
+	int x, y, z;
+	Vector m, s, f;  // local magnetization, spin, and flux
+};
+
+/** Called once per snapshot, with a label (e.g. "file.xml, snapshot 3") and all of its atoms. */
+typedef std::function<void(const string &label, const vector<SnapshotAtom> &atoms)> SnapshotHandler;
+
+/**
+ * @brief Copied Excel data from an "iterate" output file, one atom per line:
+ *        x y z m_x m_y m_z s_x s_y s_z f_x f_y f_z. Bad lines (e.g. the header) are ignored.
+ *        Reads until EOF, then calls handle once with an empty label.
+ */
+void readPastedSnapshot(std::istream &in, const SnapshotHandler &handle);
+
+/**
+ * @brief Reads every snapshot in the given file, one at a time:
+ *        "iterate" CSV (one snapshot), or "metropolis" XML or column file (one snapshot per simulation).
+ *        Incomplete XML (e.g. metropolis is still running) is read up to the last complete snapshot.
+ * @throw std::runtime_error if the file can't be read, or has no snapshot columns (CSV).
+ */
+void readSnapshots(const string &filename, const SnapshotHandler &handle);
+
+
+//--------------------------------------------------------------------------------
+
+void readPastedSnapshot(std::istream &in, const SnapshotHandler &handle) {
+	vector<SnapshotAtom> atoms;
+	while (true) {
+		SnapshotAtom a;
+		in >> a.x >> a.y >> a.z;
+		in >> a.m.x >> a.m.y >> a.m.z;
+		in >> a.s.x >> a.s.y >> a.s.z;
+		in >> a.f.x >> a.f.y >> a.f.z;
+
+		if (in.eof())
+			break;
+
+		if (in.fail()) {
+			// ignore bad lines of data. Could be the header.
+			in.clear();
+			string line;
+			getline(in, line);
+			continue;
+		}
+
+		atoms.push_back(a);
+	}
+	handle("", atoms);
+}
+
+namespace snapshot_reader {
+
+	// splits a CSV line (without quoted fields) into at most maxCells cells
+	inline void splitCells(string_view line, vector<string_view> &cells, size_t maxCells) {
+		cells.clear();
+		while (cells.size() < maxCells) {
+			size_t comma = line.find(',');
+			cells.push_back(line.substr(0, comma));
+			if (comma == string_view::npos)
+				break;
+			line.remove_prefix(comma + 1);
+		}
+	}
+
+	inline bool parseNumber(string_view s, double &value) {
+		return !s.empty() && std::from_chars(s.data(), s.data() + s.size(), value).ec == std::errc();
+	}
+
+	// v: x, y, z, sx, sy, sz, fx, fy, fz, mx, my, mz (the order of metropolis' <loc> attributes and column file snapshots)
+	inline SnapshotAtom metropolisAtom(const double *v) {
+		SnapshotAtom a = { (int) v[0], (int) v[1], (int) v[2],
+		                   Vector(v[9], v[10], v[11]), Vector(v[3], v[4], v[5]), Vector(v[6], v[7], v[8]) };
+		return a;
+	}
+
+	// "iterate" CSV output: the snapshot is in the columns x, y, z, m_x, m_y, m_z, s_x, ..., f_z
+	inline void readIterateCSV(const string &filename, std::istream &in, const SnapshotHandler &handle) {
+		string line;
+		vector<string_view> cells;
+		size_t first = string::npos;  // column index of "x"
+		if (getline(in, line)) {
+			// (the info at the end of the header may contain quoted commas, but it comes after the snapshot columns)
+			splitCells(line, cells, line.size() + 1);
+			for (size_t i = 0; i + 2 < cells.size() && first == string::npos; i++)
+				if (cells[i] == "x" && cells[i + 1] == "y" && cells[i + 2] == "z")
+					first = i;
+		}
+		if (first == string::npos)
+			throw std::runtime_error("No snapshot (x, y, z, m_x, ...) columns in: " + filename);
+
+		vector<SnapshotAtom> atoms;
+		while (getline(in, line)) {
+			splitCells(line, cells, first + 12);
+			double v[12];
+			bool ok = (cells.size() == first + 12);
+			for (int i = 0; ok && i < 12; i++)
+				ok = parseNumber(cells[first + i], v[i]);
+			if (!ok)
+				continue;  // e.g. a record without a snapshot row next to it
+			SnapshotAtom a = { (int) v[0], (int) v[1], (int) v[2],
+			                   Vector(v[3], v[4], v[5]), Vector(v[6], v[7], v[8]), Vector(v[9], v[10], v[11]) };
+			atoms.push_back(a);
+		}
+		handle(filename, atoms);
+	}
+
+	// "metropolis" XML output: every <snapshot> of <loc x= y= z= sx= ... mz= /> elements
+	inline void readMetropolisXML(const string &filename, const SnapshotHandler &handle) {
+		const string_view SNAPSHOT_END = "</snapshot>";
+		const char * const NAMES[] = { "x", "y", "z", "sx", "sy", "sz", "fx", "fy", "fz", "mx", "my", "mz" };
+		MappedFile file(filename);
+		const char *text = file.chars(), *end = text + file.size();
+		XMLTag tag;
+		vector<SnapshotAtom> atoms;
+		size_t count = 0;
+		for (const char *p = findXMLTag("snapshot", text, end, end); p < end; p = findXMLTag("snapshot", p, end, end)) {
+			p = readXMLTag(p, end, tag);
+			size_t close = tag.selfClosing ? 0 : string_view(p, end - p).find(SNAPSHOT_END);
+			if (close == string_view::npos)
+				break;  // incomplete
+			const char *snapshotEnd = p + close;
+
+			atoms.clear();
+			for (const char *s = p; (s = static_cast<const char *>(memchr(s, '<', snapshotEnd - s))) != NULL; ) {
+				s = readXMLTag(s, snapshotEnd, tag);
+				if (tag.name != "loc")
+					continue;
+				double v[12];
+				bool ok = true;
+				for (int i = 0; ok && i < 12; i++)
+					ok = parseNumber(tag.attribute(NAMES[i]), v[i]);
+				if (ok)
+					atoms.push_back(metropolisAtom(v));
+			}
+			handle(filename + ", snapshot " + std::to_string(++count), atoms);
+			p = snapshotEnd;
+		}
+	}
+
+	// "metropolis" column file: one snapshot per row, 12 doubles per atom (same order as the XML)
+	inline void readMetropolisColumns(const string &filename, const SnapshotHandler &handle) {
+		ColumnFileReader file(filename);
+		vector<SnapshotAtom> atoms;
+		for (uint64_t row = 0; row < file.rows(); row++) {
+			const double *v = file.snapshot(row);
+			if (v == NULL)
+				break;
+			atoms.clear();
+			for (const double *vEnd = v + file.getSnapshotSize(); v + 12 <= vEnd; v += 12)
+				atoms.push_back(metropolisAtom(v));
+			handle(filename + ", snapshot " + std::to_string(row + 1), atoms);
+		}
+	}
+
+}  // end of namespace snapshot_reader
+
+void readSnapshots(const string &filename, const SnapshotHandler &handle) {
+	using namespace snapshot_reader;
+	if (ColumnFileReader::isColumnFile(filename)) {
+		readMetropolisColumns(filename, handle);
+		return;
+	}
+	std::ifstream in(filename);
+	if (!in)
+		throw std::runtime_error("Couldn't open input file: " + filename);
+	char first = '\0';
+	in >> first;
+	if (first == '<') {
+		in.close();
+		readMetropolisXML(filename, handle);
+	} else {
+		in.seekg(0);
+		readIterateCSV(filename, in, handle);
+	}
+}
+
+}  // end of namespace udc
+
+#endif
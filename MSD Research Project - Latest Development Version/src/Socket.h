@@ -0,0 +1,234 @@
+/**
+ * @file Socket.h
+ * @author Christopher D'Angelo
+ * @brief Contains udc::Socket, a minimal line-based TCP socket (Winsock or POSIX).
+ *        Used by msd_service to serve msd_server's simulations over localhost.
+ *
+ * @version 6.4
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2011-2026
+ */
+
+#ifndef UDC_SOCKET
+#define UDC_SOCKET
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+	#ifndef NOMINMAX
+		#define NOMINMAX  // keep std::min and std::max usable
+	#endif
+	#include <winsock2.h>
+	#include <ws2tcpip.h>
+	#pragma comment(lib, "Ws2_32.lib")
+#else
+	#include <arpa/inet.h>
+	#include <netinet/in.h>
+	#include <netinet/tcp.h>
+	#include <sys/socket.h>
+	#include <unistd.h>
+#endif
+
+
+namespace udc {
+
+using std::string;
+
+
+class SocketException : public std::runtime_error {
+ public:
+	SocketException(const string &message) : std::runtime_error(message) {}
+};
+
+
+/**
+ * @brief A TCP socket: either listening (Socket::listenLocal) or connected (Socket::accept).
+ *        Move only; closed when destroyed.
+ */
+class Socket {
+ public:
+#ifdef _WIN32
+	typedef SOCKET Handle;
+	static const Handle INVALID = INVALID_SOCKET;
+#else
+	typedef int Handle;
+	static const Handle INVALID = -1;
+#endif
+
+	/** Must be called once before any other socket is used (only needed on Windows). */
+	static void startup();
+
+	/** Listens on 127.0.0.1 only: the simulations are for local clients. */
+	static Socket listenLocal(unsigned short port);
+
+	Socket();
+	Socket(Socket &&);
+	Socket& operator=(Socket &&);
+	~Socket();
+
+	bool isOpen() const;
+
+	/** Waits for the next connection to this listening socket. */
+	Socket accept();
+
+	/**
+	 * Reads the next line (without the "\n" or "\r\n").
+	 * @return false if the connection was closed (or failed) first
+	 */
+	bool readLine(string &line);
+
+	/** Writes all of data. @throw SocketException if the connection was closed (or failed) */
+	void write(const char *data, size_t size);
+	void writeLine(const string &line);
+
+	/** Stops reading and writing: a readLine blocked on another thread returns false. */
+	void shutdown();
+	void close();
+
+ private:
+	Handle handle;
+	string buffer;  // read, but not yet returned by readLine
+	size_t start;   // of the unread part of buffer
+
+	explicit Socket(Handle handle);
+
+	Socket(const Socket &);  // do not use: not implemented!
+	Socket& operator=(const Socket &);  // do not use: not implemented!
+};
+
+
+//--------------------------------------------------------------------------------
+
+void Socket::startup() {
+#ifdef _WIN32
+	WSADATA data;
+	if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+		throw SocketException("WSAStartup failed");
+#endif
+}
+
+Socket Socket::listenLocal(unsigned short port) {
+	Socket s(::socket(AF_INET, SOCK_STREAM, 0));
+	if (!s.isOpen())
+		throw SocketException("Unable to create a socket");
+	int yes = 1;
+#ifndef _WIN32
+	setsockopt(s.handle, SOL_SOCKET, SO_REUSEADDR, (const char *) &yes, sizeof(yes));
+#endif
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (::bind(s.handle, (const sockaddr *) &addr, sizeof(addr)) != 0)
+		throw SocketException("Unable to bind to port " + std::to_string(port));
+	if (::listen(s.handle, SOMAXCONN) != 0)
+		throw SocketException("Unable to listen on port " + std::to_string(port));
+	return s;
+}
+
+Socket::Socket() : handle(INVALID), start(0) {
+}
+
+Socket::Socket(Handle handle) : handle(handle), start(0) {
+}
+
+Socket::Socket(Socket &&s) : handle(s.handle), buffer(std::move(s.buffer)), start(s.start) {
+	s.handle = INVALID;
+}
+
+Socket& Socket::operator=(Socket &&s) {
+	if (this != &s) {
+		close();
+		handle = s.handle;
+		buffer = std::move(s.buffer);
+		start = s.start;
+		s.handle = INVALID;
+	}
+	return *this;
+}
+
+Socket::~Socket() {
+	close();
+}
+
+bool Socket::isOpen() const {
+	return handle != INVALID;
+}
+
+Socket Socket::accept() {
+	Socket s(::accept(handle, NULL, NULL));
+	if (!s.isOpen())
+		throw SocketException("Unable to accept a connection");
+	int yes = 1;  // states are sent as soon as they're ready
+	setsockopt(s.handle, IPPROTO_TCP, TCP_NODELAY, (const char *) &yes, sizeof(yes));
+	return s;
+}
+
+bool Socket::readLine(string &line) {
+	while (true) {
+		size_t end = buffer.find('\n', start);
+		if (end != string::npos) {
+			line.assign(buffer, start, end - start);
+			start = end + 1;
+			if (!line.empty() && line.back() == '\r')
+				line.pop_back();
+			return true;
+		}
+		buffer.erase(0, start);
+		start = 0;
+		char data[4096];
+		int n = (int) ::recv(handle, data, sizeof(data), 0);
+		if (n <= 0)
+			return false;
+		buffer.append(data, n);
+	}
+}
+
+void Socket::write(const char *data, size_t size) {
+	while (size > 0) {
+		int chunk = size > (1 << 30) ? (1 << 30) : (int) size;
+#ifdef MSG_NOSIGNAL
+		int n = (int) ::send(handle, data, chunk, MSG_NOSIGNAL);
+#else
+		int n = (int) ::send(handle, data, chunk, 0);
+#endif
+		if (n <= 0)
+			throw SocketException("Connection closed");
+		data += n;
+		size -= n;
+	}
+}
+
+void Socket::writeLine(const string &line) {
+	write(line.data(), line.size());
+	write("\n", 1);
+}
+
+void Socket::shutdown() {
+	if (isOpen()) {
+#ifdef _WIN32
+		::shutdown(handle, SD_BOTH);
+#else
+		::shutdown(handle, SHUT_RDWR);
+#endif
+	}
+}
+
+void Socket::close() {
+	if (isOpen()) {
+#ifdef _WIN32
+		::closesocket(handle);
+#else
+		::close(handle);
+#endif
+		handle = INVALID;
+	}
+}
+
+}  // end of namespace udc
+
+#endif
@@ -1,11 +1,15 @@
 #ifndef UDC_HASHMAP
 #define UDC_HASHMAP
 
+#include <cstddef>
+#include <memory>
 #include <stdexcept>
+#include <vector>
 
 namespace udc {
 
 using std::out_of_range;
+using std::shared_ptr;
 
 template <typename T> struct SparseArrayValue {
 	bool set;
@@ -17,15 +21,44 @@ template <typename T> struct SparseArrayValue {
 	void clear();
 };
 
+/*
+ * The only indices (keys) a compact SparseArray can hold, each mapped to a dense slot: the i-th key to slot i.
+ * Every other index (less than capacity) maps to NONE. Can be shared by several SparseArrays.
+ */
+class SparseLayout {
+ private:
+	std::vector<unsigned int> slots;  // index -> slot, or NONE
+	std::vector<unsigned int> keys;   // slot -> index
+
+ public:
+	static constexpr unsigned int NONE = ~0u;
+
+	SparseLayout(unsigned int capacity, const std::vector<unsigned int> &keys);
+
+	unsigned int capacity() const { return (unsigned int) slots.size(); }
+	unsigned int size() const { return (unsigned int) keys.size(); }
+
+	// does NO bounds checking
+	unsigned int slot(unsigned int index) const { return slots[index]; }
+	unsigned int key(unsigned int slot) const { return keys[slot]; }
+};
+
 /*
  * A fixed-sized data structure, which maps (unsigned int -> value type, T).
  * Not all elements need to contain values.
  * Uses std::out_of_range exception.
+ *
+ * If given a SparseLayout (see resize), only the layout's indices are stored (densely, in slot order),
+ * so the other indices take no memory. (Creating an element at one of them is undefined behaviour.)
  */
 template <typename T> class SparseArray {
  private:
 	unsigned int _capacity;
 	SparseArrayValue<T> *values;
+	shared_ptr<const SparseLayout> layout;  // NULL if not compact
+
+	unsigned int slot(unsigned int index) const { return layout == NULL ? index : layout->slot(index); }
+	SparseArrayValue<T>* find(unsigned int index) const;  // NULL if out of range, or not in the layout
 
  public:
 	SparseArray() : _capacity(0), values(NULL) { /* empty */ }
@@ -37,11 +70,18 @@ template <typename T> class SparseArray {
 
 	unsigned int capacity() const { return _capacity; }
 	void resize(unsigned int capacity);  // will clear the array
+	void resize(shared_ptr<const SparseLayout> layout);  // will clear the array, and make it compact
+	const SparseLayout* getLayout() const { return layout.get(); }  // NULL if not compact
 
 	// does NO bounds checking
-	T& operator[](unsigned int index) { return values[index].create(); }  // creates an element at index if it has not yet been created
-	const T& operator[](unsigned int index) const { return values[index].value; }  // Undefined behaviour if index has not been set, or if out of bounds.
-	void clear(unsigned int index) { values[index].clear(); }  // has no effect if the element was not yet created
+	T& operator[](unsigned int index) { return values[slot(index)].create(); }  // creates an element at index if it has not yet been created
+	const T& operator[](unsigned int index) const { return values[slot(index)].value; }  // Undefined behaviour if index has not been set, or if out of bounds.
+	void clear(unsigned int index) { values[slot(index)].clear(); }  // has no effect if the element was not yet created
+
+	// for bulk (e.g. strided, zero-copy) reads: element i is at (const char *) data() + i * stride(), set or not.
+	// If compact, i is a slot (see getLayout), not an index.
+	const T* data() const { return values != NULL ? &values[0].value : NULL; }
+	static size_t stride() { return sizeof(SparseArrayValue<T>); }
 
 	// DOES bounds checking:
 	// throws an out_of_range exception if the given index is out of range or
@@ -61,37 +101,61 @@ template <typename T> void SparseArrayValue<T>::clear() {
 	value = value();
 }
 
+inline SparseLayout::SparseLayout(unsigned int capacity, const std::vector<unsigned int> &keys)
+: slots(capacity, NONE), keys(keys) {
+	for (unsigned int i = 0; i < keys.size(); i++) {
+		if (keys[i] >= capacity || slots[keys[i]] != NONE)
+			throw out_of_range("SparseLayout::SparseLayout(unsigned int, const vector<unsigned int> &): illegal or repeated index");
+		slots[keys[i]] = i;
+	}
+}
+
+template <typename T> SparseArrayValue<T>* SparseArray<T>::find(unsigned int index) const {
+	if (index >= capacity())
+		return NULL;
+	unsigned int s = slot(index);
+	return s != SparseLayout::NONE ? &values[s] : NULL;
+}
+
 template <typename T> void SparseArray<T>::resize(unsigned int capacity) {
 	delete[] values;
 	_capacity = capacity;
 	values = new SparseArrayValue<T>[capacity];
+	layout = NULL;
+}
+
+template <typename T> void SparseArray<T>::resize(shared_ptr<const SparseLayout> layout) {
+	delete[] values;
+	_capacity = layout->capacity();
+	values = new SparseArrayValue<T>[layout->size()];
+	this->layout = layout;
 }
 
 template <typename T> T& SparseArray<T>::at(unsigned int index) {
-	if (index < 0 || index >= capacity())
+	SparseArrayValue<T> *v = find(index);
+	if (v == NULL)
 		throw out_of_range("SparseArray::at(unsigned int): illegal index");
-	SparseArrayValue<T> &v = values[index];
-	if (!v.set)
+	if (!v->set)
 		throw out_of_range("SparseArray::at(unsigned int): index not yet set");
-	return v.value;
+	return v->value;
 }
 
 template <typename T> const T& SparseArray<T>::at(unsigned int index) const {
-	if (index < 0 || index >= capacity())
+	const SparseArrayValue<T> *v = find(index);
+	if (v == NULL)
 		throw out_of_range("SparseArray::at(unsigned int): illegal index");
-	const SparseArrayValue<T> &v = values[index];
-	if (!v.set)
+	if (!v->set)
 		throw out_of_range("SparseArray::at(unsigned int): index not yet set");
-	return v.value;
+	return v->value;
 }
 
 template <typename T> void SparseArray<T>::clearAt(unsigned int index) {
-	if (index < 0 || index >= capacity())
+	SparseArrayValue<T> *v = find(index);
+	if (v == NULL)
 		throw out_of_range("SparseArray::at(unsigned int): illegal index");
-	const SparseArrayValue<T> &v = values[index];
-	if (!v.set)
+	if (!v->set)
 		throw out_of_range("SparseArray::at(unsigned int): index not yet set");
-	v.clear();
+	v->clear();
 
 }
 
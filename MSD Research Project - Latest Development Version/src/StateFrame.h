@@ -0,0 +1,104 @@
+/**
+ * @file StateFrame.h
+ * @author Christopher D'Angelo
+ * @brief Binary encodings of an MSD's spins and fluxes, for streaming the state to a visualization:
+ *        a full frame of every atom, or a compact delta frame of just the atoms changed since a
+ *        previous frame (see MSD::setChangeTracking). Used by msd_worker and MSD-export.
+ *
+ * @version 6.4
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2011-2026
+ */
+
+#ifndef UDC_STATE_FRAME
+#define UDC_STATE_FRAME
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "MSD.h"
+
+
+namespace udc {
+
+/*
+ * Both frames are little-endian (i.e. native, on every platform we build for), and laid out so they can be
+ * read directly with typed arrays (e.g. JavaScript's Float64Array/Float32Array/Uint32Array, or numpy):
+ *
+ * Full frame (every atom, in MSD::Iterator order):
+ *   char[4] "MSDF", uint32 version (1), uint32 n, uint32 (unused, 0),
+ *   float64[n][6] (spin x, y, z, flux x, y, z), uint32[n] index
+ *
+ * Delta frame (only changed atoms, in MSD::Iterator order):
+ *   char[4] "MSDD", uint32 version (1), uint32 n, uint32 (unused, 0), uint64 token,
+ *   float32[n][6] (spin x, y, z, flux x, y, z), uint32[n] index
+ * where "token" identifies this frame: pass it as "since" for the next delta frame.
+ *
+ * In both, pos = (index % width, index / width % height, index / (width * height)), and localM = spin + flux.
+ */
+
+const size_t STATE_FRAME_HEADER_SIZE = 16;
+const size_t STATE_FRAME_ATOM_SIZE = 6 * sizeof(double) + sizeof(uint32_t);
+const size_t DELTA_FRAME_HEADER_SIZE = 24;
+const size_t DELTA_FRAME_ATOM_SIZE = 6 * sizeof(float) + sizeof(uint32_t);
+
+/** Replaces frame with a full frame of every atom. */
+void encodeStateFrame(const MSD &msd, std::vector<unsigned char> &frame);
+
+/** @return The size of a delta frame with n atoms. */
+inline size_t deltaFrameSize(size_t n) {
+	return DELTA_FRAME_HEADER_SIZE + n * DELTA_FRAME_ATOM_SIZE;
+}
+
+/**
+ * Writes a delta frame of the given atoms (e.g. from MSD::getChangedSince) to out,
+ * which must have room for deltaFrameSize(changed.size()) bytes.
+ */
+void encodeDeltaFrame(const MSD &msd, const std::vector<unsigned int> &changed, unsigned long long token, unsigned char *out);
+
+
+//--------------------------------------------------------------------------------
+
+void encodeStateFrame(const MSD &msd, std::vector<unsigned char> &frame) {
+	const uint32_t n = msd.getN();
+	frame.resize(STATE_FRAME_HEADER_SIZE + n * STATE_FRAME_ATOM_SIZE);
+	const uint32_t header[3] = { 1, n, 0 };  // version, n, (unused)
+	memcpy(frame.data(), "MSDF", 4);
+	memcpy(frame.data() + 4, header, sizeof(header));
+	unsigned char *vectors = frame.data() + STATE_FRAME_HEADER_SIZE;
+	unsigned char *indices = vectors + (size_t) n * 6 * sizeof(double);
+	for (MSD::Iterator i = msd.begin(); i != msd.end(); ++i) {
+		Vector spin = i.getSpin(), flux = i.getFlux();
+		const double v[6] = { spin.x, spin.y, spin.z, flux.x, flux.y, flux.z };
+		const uint32_t index = i.getIndex();
+		memcpy(vectors, v, sizeof(v));
+		memcpy(indices, &index, sizeof(index));
+		vectors += sizeof(v);
+		indices += sizeof(index);
+	}
+}
+
+void encodeDeltaFrame(const MSD &msd, const std::vector<unsigned int> &changed, unsigned long long token, unsigned char *out) {
+	const uint32_t n = (uint32_t) changed.size();
+	const uint32_t header[3] = { 1, n, 0 };  // version, n, (unused)
+	const uint64_t token64 = token;
+	memcpy(out, "MSDD", 4);
+	memcpy(out + 4, header, sizeof(header));
+	memcpy(out + 16, &token64, sizeof(token64));
+	unsigned char *vectors = out + DELTA_FRAME_HEADER_SIZE;
+	unsigned char *indices = vectors + (size_t) n * 6 * sizeof(float);
+	for (unsigned int a : changed) {
+		Vector spin = msd.getSpin(a), flux = msd.getFlux(a);
+		const float v[6] = { (float) spin.x, (float) spin.y, (float) spin.z, (float) flux.x, (float) flux.y, (float) flux.z };
+		const uint32_t index = a;
+		memcpy(vectors, v, sizeof(v));
+		memcpy(indices, &index, sizeof(index));
+		vectors += sizeof(v);
+		indices += sizeof(index);
+	}
+}
+
+}  // end of namespace udc
+
+#endif
@@ -0,0 +1,165 @@
+/**
+ * @file ThreadPool.h
+ * @author Christopher D'Angelo
+ * @brief Contains udc::WorkStealingPool, a fixed number of threads running short tasks.
+ *        Used by msd_service to share its cores between many simulations.
+ *
+ * @version 6.4
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2011-2026
+ */
+
+#ifndef UDC_THREAD_POOL
+#define UDC_THREAD_POOL
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace udc {
+
+using std::atomic;
+using std::condition_variable;
+using std::deque;
+using std::function;
+using std::lock_guard;
+using std::mutex;
+using std::thread;
+using std::unique_lock;
+using std::unique_ptr;
+using std::vector;
+
+
+/**
+ * @brief A fixed number of threads, each with its own queue of tasks.
+ *
+ * A task submitted by one of the pool's threads (e.g. the next slice of a long job) goes to the back of
+ * that thread's own queue, so it doesn't contend with the other threads; other tasks are dealt out
+ * round-robin. Each thread takes tasks from the front of its own queue (first in, first out, so a task which
+ * resubmits itself waits its turn behind the others), and when that's empty, steals from the front of
+ * the others' queues. So the pool stays busy as long as there are at least as many tasks as threads.
+ *
+ * Tasks must not throw. The destructor waits for the tasks that are already running, but drops the rest.
+ */
+class WorkStealingPool {
+ public:
+	typedef function<void()> Task;
+
+	/** @param threadCount 0 means one per core */
+	explicit WorkStealingPool(unsigned int threadCount = 0);
+	~WorkStealingPool();
+
+	void submit(Task task);
+
+	unsigned int size() const;
+
+ private:
+	struct Worker {
+		mutex lock;
+		deque<Task> tasks;
+		thread t;
+	};
+
+	vector< unique_ptr<Worker> > workers;
+	atomic<unsigned int> next;      // round-robin, for tasks from other threads
+	atomic<unsigned long long> pending;  // tasks submitted but not yet taken
+	bool stopping;                  // guarded by sleepLock
+	mutex sleepLock;
+	condition_variable wake;
+
+	static thread_local const WorkStealingPool *currentPool;
+	static thread_local unsigned int currentWorker;
+
+	bool take(unsigned int w, Task &task);  // from w's queue, else steal
+	void run(unsigned int w);  // body of worker thread w
+
+	WorkStealingPool(const WorkStealingPool &);  // do not use: not implemented!
+	WorkStealingPool& operator=(const WorkStealingPool &);  // do not use: not implemented!
+};
+
+
+//--------------------------------------------------------------------------------
+
+thread_local const WorkStealingPool *WorkStealingPool::currentPool = NULL;
+thread_local unsigned int WorkStealingPool::currentWorker = 0;
+
+WorkStealingPool::WorkStealingPool(unsigned int threadCount) : next(0), pending(0), stopping(false) {
+	if (threadCount == 0)
+		threadCount = thread::hardware_concurrency();
+	if (threadCount == 0)
+		threadCount = 1;
+	for (unsigned int w = 0; w < threadCount; w++)
+		workers.emplace_back(new Worker());
+	for (unsigned int w = 0; w < threadCount; w++)
+		workers[w]->t = thread(&WorkStealingPool::run, this, w);
+}
+
+WorkStealingPool::~WorkStealingPool() {
+	{
+		lock_guard<mutex> guard(sleepLock);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (auto &worker : workers)
+		worker->t.join();
+}
+
+void WorkStealingPool::submit(Task task) {
+	unsigned int w = currentPool == this ? currentWorker : next++ % workers.size();
+	{
+		// counted first (so pending never goes below 0), and under sleepLock so a thread about to sleep can't miss it
+		lock_guard<mutex> guard(sleepLock);
+		pending++;
+	}
+	{
+		lock_guard<mutex> guard(workers[w]->lock);
+		workers[w]->tasks.push_back(std::move(task));
+	}
+	wake.notify_one();
+}
+
+unsigned int WorkStealingPool::size() const {
+	return (unsigned int) workers.size();
+}
+
+bool WorkStealingPool::take(unsigned int w, Task &task) {
+	for (unsigned int i = 0; i < workers.size(); i++) {
+		Worker &worker = *workers[(w + i) % workers.size()];
+		lock_guard<mutex> guard(worker.lock);
+		if (!worker.tasks.empty()) {
+			task = std::move(worker.tasks.front());
+			worker.tasks.pop_front();
+			pending--;
+			return true;
+		}
+	}
+	return false;
+}
+
+void WorkStealingPool::run(unsigned int w) {
+	currentPool = this;
+	currentWorker = w;
+	Task task;
+	while (true) {
+		if (take(w, task)) {
+			task();
+			task = Task();  // release anything it holds before sleeping
+			continue;
+		}
+		unique_lock<mutex> guard(sleepLock);
+		wake.wait(guard, [this]() { return stopping || pending > 0; });
+		if (stopping)
+			return;
+	}
+}
+
+}  // end of namespace udc
+
+#endif
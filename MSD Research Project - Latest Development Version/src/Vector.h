@@ -3,10 +3,10 @@
  * @author Christopher D'Angelo
  * @brief Contains the udc::Vector class, and related operators.
  * 
- * @version 6.3
- * @date 2024-1-7
+ * @version 6.4
+ * @date 2026-10-18
  * 
- * @copyright Copyright (c) 2011-2024
+ * @copyright Copyright (c) 2011-2026
  */
 
 #ifndef UDC_VECTOR
@@ -73,7 +73,12 @@ class Vector {
 	double distance(const Vector &) const;
 	double dotProduct(const Vector &) const;
 	double angleBetween(const Vector &) const;
-	Vector crossProduct(Vector v) const;
+	Vector crossProduct(const Vector &v) const;
+
+	// Fused forms of recurring contractions (no temporary Vectors; same rounding as the long forms):
+	double crossDot(const Vector &b, const Vector &c) const;  // *this * b.crossProduct(c)
+	double squareDot(const Vector &v) const;  // *this * Vector(sq(v.x), sq(v.y), sq(v.z))
+	double squareDiffDot(const Vector &u, const Vector &v) const;  // *this * (Vector(sq(u.x), ...) - Vector(sq(v.x), ...))
 
 	Vector& operator +=(const Vector &);
 	Vector& operator -=(const Vector &);
@@ -386,10 +391,36 @@ double Vector::angleBetween(const Vector &v) const {
  * @return A new, thrid Vector: cross product, perpendicular to the two given
  * vectors, and with a magnatude equal to the product of their magnatudes.
  */
-Vector Vector::crossProduct(Vector v) const {
+Vector Vector::crossProduct(const Vector &v) const {
 	return Vector( y * v.z - z * v.y, z * v.x - x * v.z, x * v.y - y * v.x );
 }
 
+/**
+ * @brief Compute the scalar triple product: the dot product of this Vector
+ *        and the cross product of two others.
+ * 
+ * @return <code>*this * b.crossProduct(c)</code>, without the intermediate Vector.
+ */
+double Vector::crossDot(const Vector &b, const Vector &c) const {
+	return x * (b.y * c.z - b.z * c.y) + y * (b.z * c.x - b.x * c.z) + z * (b.x * c.y - b.y * c.x);
+}
+
+/**
+ * @brief Compute the dot product of this Vector and the component-wise square of another,
+ *        e.g. the anisotropy energy A * (m.x^2, m.y^2, m.z^2).
+ */
+double Vector::squareDot(const Vector &v) const {
+	return x * (v.x * v.x) + y * (v.y * v.y) + z * (v.z * v.z);
+}
+
+/**
+ * @brief Compute the dot product of this Vector and the difference of the component-wise
+ *        squares of two others, e.g. the change in anisotropy energy A * (mag^2 - m^2).
+ */
+double Vector::squareDiffDot(const Vector &u, const Vector &v) const {
+	return x * (u.x * u.x - v.x * v.x) + y * (u.y * u.y - v.y * v.y) + z * (u.z * u.z - v.z * v.z);
+}
+
 
 /**
  * @brief Mutate <code>this</code> Vector by adding another Vector to it.
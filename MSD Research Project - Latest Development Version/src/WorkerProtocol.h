@@ -0,0 +1,707 @@
+/**
+ * @file WorkerProtocol.h
+ * @author Christopher D'Angelo
+ * @brief The msd_worker protocol (see msd_worker.cpp) for one simulation, shared by msd_worker (one
+ *        simulation on stdin/stdout) and msd_service (many simulations over sockets, on a thread pool).
+ *
+ * Differences from MSDWorker.py: a non-finite double (e.g. the NaN magnetization of an empty region) is sent as
+ * null, where MSDWorker.py's json.dumps sends NaN, Infinity, or -Infinity. Those aren't JSON, so a client's
+ * JSON.parse rejects the whole line. Likewise, input must be strict JSON, whereas Python's json.loads also accepts
+ * NaN and Infinity. Otherwise, the values sent are the same (though e.g. 2.0 may be written as 2).
+ *
+ * @version 6.4
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2011-2026
+ */
+
+#ifndef UDC_WORKER_PROTOCOL
+#define UDC_WORKER_PROTOCOL
+
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "JSON.h"
+#include "MSD.h"
+#include "StateFrame.h"
+
+
+namespace udc {
+namespace worker {
+
+using std::string;
+using std::vector;
+using std::unique_ptr;
+using std::invalid_argument;
+
+
+string toUpper(string s) {
+	for (char &c : s)
+		c = toupper((unsigned char) c);
+	return s;
+}
+
+// a named double or Vector field of a parameters struct
+template <typename S> struct Field {
+	const char *name;
+	double S::*d;
+	Vector S::*v;
+};
+
+typedef MSD::Parameters P;
+typedef Molecule::NodeParameters NP;
+typedef Molecule::EdgeParameters EP;
+
+const Field<P> MSD_PARAMS[] = {
+	{ "kT", &P::kT, NULL }, { "B", NULL, &P::B },
+	{ "SL", &P::SL, NULL }, { "SR", &P::SR, NULL },
+	{ "FL", &P::FL, NULL }, { "FR", &P::FR, NULL },
+	{ "JL", &P::JL, NULL }, { "JR", &P::JR, NULL }, { "JmL", &P::JmL, NULL }, { "JmR", &P::JmR, NULL }, { "JLR", &P::JLR, NULL },
+	{ "Je0L", &P::Je0L, NULL }, { "Je0R", &P::Je0R, NULL },
+	{ "Je1L", &P::Je1L, NULL }, { "Je1R", &P::Je1R, NULL }, { "Je1mL", &P::Je1mL, NULL }, { "Je1mR", &P::Je1mR, NULL }, { "Je1LR", &P::Je1LR, NULL },
+	{ "JeeL", &P::JeeL, NULL }, { "JeeR", &P::JeeR, NULL }, { "JeemL", &P::JeemL, NULL }, { "JeemR", &P::JeemR, NULL }, { "JeeLR", &P::JeeLR, NULL },
+	{ "bL", &P::bL, NULL }, { "bR", &P::bR, NULL }, { "bmL", &P::bmL, NULL }, { "bmR", &P::bmR, NULL }, { "bLR", &P::bLR, NULL },
+	{ "AL", NULL, &P::AL }, { "AR", NULL, &P::AR },
+	{ "DL", NULL, &P::DL }, { "DR", NULL, &P::DR }, { "DmL", NULL, &P::DmL }, { "DmR", NULL, &P::DmR }, { "DLR", NULL, &P::DLR }
+};
+
+const Field<NP> MOL_NODE_PARAMS[] = {
+	{ "Sm", &NP::Sm, NULL }, { "Fm", &NP::Fm, NULL }, { "Je0m", &NP::Je0m, NULL }, { "Am", NULL, &NP::Am }
+};
+
+const Field<EP> MOL_EDGE_PARAMS[] = {
+	{ "Jm", &EP::Jm, NULL }, { "Je1m", &EP::Je1m, NULL }, { "Jeem", &EP::Jeem, NULL }, { "bm", &EP::bm, NULL }, { "Dm", NULL, &EP::Dm }
+};
+
+// true if kw has any of the fields
+template <typename S, size_t N> bool hasFields(const JSON &kw, const Field<S> (&fields)[N]) {
+	for (const Field<S> &f : fields)
+		if (getMember(kw, f.name) != NULL)
+			return true;
+	return false;
+}
+
+// only changes the fields that are in kw
+template <typename S, size_t N> void readFields(S &s, const JSON &kw, const Field<S> (&fields)[N]) {
+	for (const Field<S> &f : fields) {
+		const JSON *v = getMember(kw, f.name);
+		if (v == NULL)
+			continue;
+		if (f.d != NULL)
+			s.*f.d = asDouble(*v);
+		else
+			s.*f.v = asVector(*v);
+	}
+}
+
+template <typename S, size_t N> void writeFields(JSONWriter &w, const S &s, const Field<S> (&fields)[N]) {
+	w.beginObject();
+	for (const Field<S> &f : fields) {
+		w.key(f.name);
+		if (f.d != NULL)
+			w.value(s.*f.d);
+		else
+			w.value(s.*f.v);
+	}
+	w.endObject();
+}
+
+
+unsigned int getUInt(const JSON &kw, const char *key, unsigned int def) {
+	const JSON *v = getMember(kw, key);
+	return v == NULL ? def : (unsigned int) asULL(*v);
+}
+
+unsigned int requireUInt(const JSON &kw, const char *key) {
+	const JSON *v = getMember(kw, key);
+	if (v == NULL)
+		throw invalid_argument(string("Missing required key: ") + key);
+	return (unsigned int) asULL(*v);
+}
+
+bool getBool(const JSON &kw, const char *key, bool def) {
+	const JSON *v = getMember(kw, key);
+	return v == NULL ? def : asBool(*v);
+}
+
+const MSD::MolProtoFactory& molType(const string &t) {
+	string type = toUpper(t);
+	if (type == "LINEAR")
+		return MSD::LINEAR_MOL;
+	if (type == "CIRCULAR")
+		return MSD::CIRCULAR_MOL;
+	throw invalid_argument("Unrecognized molType: " + t);
+}
+
+const MSD::FlippingAlgorithm& flippingAlgorithm(const string &algo) {
+	string a = toUpper(algo);
+	if (a == "UP_DOWN_MODEL")
+		return MSD::UP_DOWN_MODEL;
+	if (a == "CONTINUOUS_SPIN_MODEL")
+		return MSD::CONTINUOUS_SPIN_MODEL;
+	throw invalid_argument("Unrecognized flippingAlgorithm: " + algo);
+}
+
+// how the atoms in a state are sent
+enum Format { JSON_FORMAT, BINARY_FORMAT, DELTA_FORMAT };
+
+Format format(const JSON &format) {
+	string f = toUpper(asString(format));
+	if (f == "JSON")
+		return JSON_FORMAT;
+	if (f == "BINARY")
+		return BINARY_FORMAT;
+	if (f == "DELTA")
+		return DELTA_FORMAT;
+	throw invalid_argument("Unrecognized format: " + asString(format));
+}
+
+
+/**
+ * Updates the msd parameters (including molProto parameters) as efficiently as possible.
+ * Only the parameters given in kw are changed; other keys are ignored.
+ */
+void setParameters(MSD &msd, const JSON &kw) {
+	bool fieldOnly = true;  // only kT and/or B?
+	if (kw.is_object())
+		for (const auto &member : kw.items())
+			if (member.key() != "kT" && member.key() != "B") {
+				fieldOnly = false;
+				break;
+			}
+
+	if (fieldOnly) {
+		if (const JSON *B = getMember(kw, "B"))
+			msd.setB(asVector(*B));
+		if (const JSON *kT = getMember(kw, "kT"))
+			msd.set_kT(asDouble(*kT));
+		return;
+	}
+
+	if (hasFields(kw, MSD_PARAMS)) {
+		MSD::Parameters p = msd.getParameters();
+		readFields(p, kw, MSD_PARAMS);
+		msd.setParameters(p);
+	}
+
+	// update nodes and edges one at a time in case their parameters are not uniform
+	bool nodes = hasFields(kw, MOL_NODE_PARAMS), edges = hasFields(kw, MOL_EDGE_PARAMS);
+	if (nodes || edges) {
+		MSD::MolProto molProto = msd.getMolProto();
+		if (nodes)
+			for (unsigned int node : molProto.getNodes()) {
+				NP p = molProto.getNodeParameters(node);
+				readFields(p, kw, MOL_NODE_PARAMS);
+				molProto.setNodeParameters(node, p);
+			}
+		if (edges) {
+			vector<bool> done;  // edges are directional, so each one is listed twice
+			auto iterable = molProto.getEdges();
+			for (auto edge = iterable.begin(); edge != iterable.end(); ++edge) {
+				unsigned int e = edge.getIndex();
+				if (e >= done.size())
+					done.resize(e + 1, false);
+				if (done[e])
+					continue;
+				done[e] = true;
+				EP p = edge.getParameters();
+				readFields(p, kw, MOL_EDGE_PARAMS);
+				molProto.setEdgeParameters(e, p);
+			}
+		}
+		msd.setMolProto(molProto);
+	}
+}
+
+
+// which parts of the state to send
+enum What { RESULTS = 1, PARAMETERS = 2, SEED = 4, MSD_STATE = 8, MOL = 16, ALL = 31 };
+
+What what(const JSON &list) {
+	if (!list.is_array())
+		throw invalid_argument("GET expects a JSON list");
+	if (list.empty())
+		return ALL;
+	int w = 0;
+	for (const JSON &item : list) {
+		const string &s = asString(item);
+		if (s == "results")          w |= RESULTS;
+		else if (s == "parameters")  w |= PARAMETERS;
+		else if (s == "seed")        w |= SEED;
+		else if (s == "msd")         w |= MSD_STATE;
+		else if (s == "mol")         w |= MOL;
+	}
+	return (What) w;
+}
+
+void appendBase64(string &out, const unsigned char *data, size_t size) {
+	static const char B64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	out.reserve(out.size() + (size + 2) / 3 * 4);
+	size_t i = 0;
+	for (; i + 2 < size; i += 3) {
+		unsigned long b = ((unsigned long) data[i] << 16) | ((unsigned long) data[i + 1] << 8) | data[i + 2];
+		out += B64[b >> 18];
+		out += B64[(b >> 12) & 63];
+		out += B64[(b >> 6) & 63];
+		out += B64[b & 63];
+	}
+	if (i < size) {
+		unsigned long b = (unsigned long) data[i] << 16;
+		if (i + 1 < size)
+			b |= (unsigned long) data[i + 1] << 8;
+		out += B64[b >> 18];
+		out += B64[(b >> 12) & 63];
+		out += i + 1 < size ? B64[(b >> 6) & 63] : '=';
+		out += '=';
+	}
+}
+
+/** Builds the state of the msd as a single line of JSON (see msd_worker.cpp). */
+class StateWriter {
+ private:
+	string line;
+	vector<unsigned char> frame;
+	vector<unsigned int> changed;
+	unsigned long long token = 0;  // of the last delta frame sent
+
+	string encoded;
+
+	void writeBase64(JSONWriter &w) {
+		encoded = '"';
+		appendBase64(encoded, frame.data(), frame.size());
+		encoded += '"';
+		w.raw(encoded);
+	}
+
+	void writeMSD(JSONWriter &w, const MSD &msd) {
+		w.key("msd").beginArray();
+		for (MSD::Iterator i = msd.begin(); i != msd.end(); ++i) {
+			Vector spin = i.getSpin(), flux = i.getFlux();
+			w.beginObject()
+				.key("index").value(i.getIndex())
+				.key("pos").beginArray().value(i.getX()).value(i.getY()).value(i.getZ()).endArray()
+				.key("spin").value(spin)
+				.key("flux").value(flux)
+				.key("localM").value(spin + flux)
+				.endObject();
+		}
+		w.endArray();
+	}
+
+	void writeFrame(JSONWriter &w, const MSD &msd) {
+		encodeStateFrame(msd, frame);
+		writeBase64(w.key("msdFrame"));
+	}
+
+	void writeDelta(JSONWriter &w, MSD &msd) {
+		msd.getChangedSince(token, changed);
+		token = msd.nextChangeFrame();
+		frame.resize(deltaFrameSize(changed.size()));
+		encodeDeltaFrame(msd, changed, token, frame.data());
+		writeBase64(w.key("msdDelta"));
+	}
+
+ public:
+	Format format = JSON_FORMAT;
+
+	void setFormat(MSD &msd, Format f) {
+		format = f;
+		msd.setChangeTracking(f == DELTA_FORMAT);
+		token = 0;  // the next delta has every atom
+	}
+
+	const string& write(MSD &msd, What what) {
+		line.clear();
+		JSONWriter w(line);
+		w.beginObject();
+
+		if (what & RESULTS) {
+			MSD::Results r = msd.getResults();
+			w.key("results").beginObject()
+				.key("t").value(r.t)
+				.key("M").value(r.M).key("ML").value(r.ML).key("MR").value(r.MR).key("Mm").value(r.Mm)
+				.key("MS").value(r.MS).key("MSL").value(r.MSL).key("MSR").value(r.MSR).key("MSm").value(r.MSm)
+				.key("MF").value(r.MF).key("MFL").value(r.MFL).key("MFR").value(r.MFR).key("MFm").value(r.MFm)
+				.key("U").value(r.U).key("UL").value(r.UL).key("UR").value(r.UR).key("Um").value(r.Um)
+				.key("UmL").value(r.UmL).key("UmR").value(r.UmR).key("ULR").value(r.ULR)
+				.endObject();
+		}
+
+		if (what & PARAMETERS)
+			writeFields(w.key("parameters"), msd.getParameters(), MSD_PARAMS);
+
+		if (what & SEED)
+			w.key("seed").value(msd.getSeed());
+
+		if (what & MSD_STATE) {
+			if (format == BINARY_FORMAT)
+				writeFrame(w, msd);
+			else if (format == DELTA_FORMAT)
+				writeDelta(w, msd);
+			else
+				writeMSD(w, msd);
+		}
+
+		if (what & MOL) {
+			const MSD::MolProto &molProto = msd.getMolProto();
+			w.key("mol").beginObject().key("nodes").beginArray();
+			auto nodes = molProto.getNodes();
+			for (auto node = nodes.begin(); node != nodes.end(); ++node) {
+				w.beginObject().key("index").value(node.getIndex()).key("parameters");
+				writeFields(w, node.getParameters(), MOL_NODE_PARAMS);
+				w.endObject();
+			}
+			w.endArray().key("edges").beginArray();
+			vector<bool> done;
+			auto edges = molProto.getEdges();
+			for (auto edge = edges.begin(); edge != edges.end(); ++edge) {
+				unsigned int e = edge.getIndex();
+				if (e >= done.size())
+					done.resize(e + 1, false);
+				if (done[e])
+					continue;
+				done[e] = true;
+				w.beginObject().key("index").value(e).key("parameters");
+				writeFields(w, edge.getParameters(), MOL_EDGE_PARAMS);
+				w.key("src").value(edge.src()).key("dest").value(edge.dest()).key("direction").value(edge.getDirection())
+					.endObject();
+			}
+			w.endArray().endObject();
+		}
+
+		w.endObject();
+		return line;
+	}
+};
+
+
+void sim(MSD &msd, unsigned long long n, double dkT, const Vector &dB) {
+	if (dkT == 0 && dB == Vector::ZERO) {
+		msd.metropolis(n);
+	} else {
+		MSD::Parameters p = msd.getParameters();
+		for (unsigned long long i = 0; i < n; i++) {
+			msd.metropolis(1);
+			p.kT += dkT;
+			p.B += dB;
+			msd.set_kT(p.kT);
+			msd.setB(p.B);
+		}
+	}
+}
+
+// Either randomize or reinitialize: by default, not randomized but reseeded. A given seed is used instead.
+void reset(MSD &msd, const JSON &kw) {
+	bool reseed = true;
+	if (const JSON *seed = getMember(kw, "seed")) {
+		msd.setSeed((unsigned long) asULL(*seed));
+		reseed = false;
+	} else {
+		reseed = getBool(kw, "reseed", true);
+	}
+	if (getBool(kw, "randomize", false))
+		msd.randomize(reseed);
+	else
+		msd.reinitialize(reseed);
+}
+
+unique_ptr<MSD> createMSD(const JSON &kw) {
+	unsigned int width = requireUInt(kw, "width");
+	unsigned int height = requireUInt(kw, "height");
+	unsigned int depth = requireUInt(kw, "depth");
+	unsigned int molPosL = getUInt(kw, "molPosL", (width - 1) / 2);
+	unsigned int molPosR = getUInt(kw, "molPosR", molPosL);
+	unsigned int topL = getUInt(kw, "topL", 0);
+	unsigned int bottomL = getUInt(kw, "bottomL", height - 1);
+	unsigned int frontR = getUInt(kw, "frontR", 0);
+	unsigned int backR = getUInt(kw, "backR", depth - 1);
+	if (const JSON *type = getMember(kw, "molType"))
+		return unique_ptr<MSD>(new MSD(width, height, depth, molType(asString(*type)), molPosL, molPosR, topL, bottomL, frontR, backR));
+	return unique_ptr<MSD>(new MSD(width, height, depth, molPosL, molPosR, topL, bottomL, frontR, backR));
+}
+
+
+
+/** Creates the msd from the init args (the first line), and applies the rest of the init config. */
+unique_ptr<MSD> init(const JSON &kw, StateWriter &state) {
+	unique_ptr<MSD> msd = createMSD(kw);
+	if (const JSON *algo = getMember(kw, "flippingAlgorithm"))
+		msd->flippingAlgorithm = flippingAlgorithm(asString(*algo));
+	setParameters(*msd, kw);
+	if (const JSON *seed = getMember(kw, "seed"))
+		msd->setSeed((unsigned long) asULL(*seed));
+	if (getBool(kw, "randomize", false))
+		msd->randomize(false);
+	if (const JSON *f = getMember(kw, "format"))
+		state.setFormat(*msd, format(*f));
+	return msd;
+}
+
+
+/**
+ * One simulation, driven a line of input at a time (onLine). Responses are given to "output".
+ *
+ * RUN is split into tasks, which are given to "schedule" to run: right away (msd_worker), or later on
+ * another thread (msd_service). Each task runs "sliceTime" seconds of iterations (or the rest of the chunk
+ * of "freq" iterations if sliceTime is 0), then schedules the next one, so a pool of threads can share
+ * its time fairly between many sessions. Input which arrives while a task is running is queued until
+ * the state it answers has been sent, except that a CANCEL answering that state stops the run after the
+ * current task.
+ *
+ * Thread safe: onLine, close, and the tasks may be called from different threads.
+ */
+class Session {
+ public:
+	typedef std::function<void(const string &)> Output;
+	typedef std::function<void()> Task;
+	typedef std::function<void(Task)> Scheduler;
+
+	Session(Output output, Scheduler schedule, double sliceTime = 0);
+
+	/**
+	 * Handles (or queues) the next line of input.
+	 * @return false once the session is over (after EXIT or close)
+	 * @throw std::exception (e.g. invalid JSON), after which the session should be closed
+	 */
+	bool onLine(const string &line);
+
+	/** Ends the session: any running task stops, and nothing more is output. */
+	void close();
+
+	bool isClosed() const;
+
+ private:
+	enum Phase { INIT, IDLE, ARGUMENT, REPLY, RUNNING, CLOSED };
+
+	Output output;
+	Scheduler schedule;
+	const double sliceTime;
+
+	mutable std::mutex mutex;  // guards everything below; not held while iterating
+	Phase phase;
+	string command;  // waiting for its argument
+	unique_ptr<MSD> msd;
+	StateWriter state;
+	std::deque<string> queued;  // input that came while RUNNING
+
+	// RUN
+	unsigned long long simCount;  // iterations left after the current chunk
+	unsigned long long freq;
+	double dkT;
+	Vector dB;
+	unsigned long long chunkLeft;  // iterations left in the current chunk
+	bool lastChunk;
+	unsigned long long sliceSize;  // iterations per task, to take about sliceTime
+	bool cancelled;
+
+	Task handle(const string &line);
+	void execute(const JSON &arg);
+	Task onReply(const string &line);
+	Task nextChunk();
+	Task slice();
+	void runSlice();
+};
+
+
+//--------------------------------------------------------------------------------
+
+Session::Session(Output output, Scheduler schedule, double sliceTime)
+: output(output), schedule(schedule), sliceTime(sliceTime), phase(INIT), simCount(0), freq(0), dkT(0),
+  chunkLeft(0), lastChunk(false), sliceSize(0), cancelled(false) {
+}
+
+bool Session::onLine(const string &line) {
+	Task task;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (phase == RUNNING) {
+			// too early: the first line answers the state at the end of this chunk
+			if (queued.empty() && toUpper(line) == "CANCEL")
+				cancelled = true;
+			queued.push_back(line);
+		} else {
+			task = handle(line);
+		}
+	}
+	if (task)
+		schedule(task);
+	return !isClosed();
+}
+
+void Session::close() {
+	std::lock_guard<std::mutex> lock(mutex);
+	phase = CLOSED;
+	cancelled = true;
+	queued.clear();
+}
+
+bool Session::isClosed() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return phase == CLOSED;
+}
+
+// @return the first task of a run, if the line starts (or continues) one
+Session::Task Session::handle(const string &line) {
+	switch (phase) {
+	case INIT:
+		// 1. Read init parameters as a single line of JSON
+		msd = init(JSON::parse(line), state);
+		phase = IDLE;
+		output("READY");
+		break;
+
+	case IDLE:
+		// 2. Read a command, then (except for EXIT) its argument
+		command = toUpper(line);
+		if (command == "EXIT") {
+			phase = CLOSED;
+			output("GOODBYE");
+		} else if (command == "SET" || command == "RUN" || command == "GET" || command == "RESET" || command == "FORMAT") {
+			phase = ARGUMENT;
+		} else {
+			std::cerr << "Unrecognized command: " << command << std::endl;
+		}
+		break;
+
+	case ARGUMENT:
+		phase = IDLE;
+		execute(JSON::parse(line));
+		break;
+
+	case REPLY:
+		return onReply(line);
+
+	case RUNNING:
+	case CLOSED:
+		break;
+	}
+	return Task();
+}
+
+void Session::execute(const JSON &arg) {
+	if (command == "SET") {
+		setParameters(*msd, arg);
+		output("DONE");
+
+	} else if (command == "RUN") {
+		// The state is sent after every "freq" iterations, then an input is expected before continuing:
+		// "CANCEL" ends the run early, anything else continues it.
+		const JSON *simCountArg = getMember(arg, "simCount");
+		if (simCountArg == NULL)
+			throw invalid_argument("Missing required key: simCount");
+		simCount = asULL(*simCountArg);
+		const JSON *freqArg = getMember(arg, "freq");
+		long long f = freqArg == NULL ? 0 : asLL(*freqArg);
+		freq = f <= 0 ? simCount : (unsigned long long) f;
+		const JSON *dkTArg = getMember(arg, "dkT");
+		dkT = dkTArg == NULL ? 0 : asDouble(*dkTArg);
+		const JSON *dBArg = getMember(arg, "dB");
+		dB = dBArg == NULL ? Vector::ZERO : asVector(*dBArg);
+		lastChunk = false;
+		sliceSize = 0;
+
+		phase = REPLY;
+		output(state.write(*msd, ALL));  // initial state
+
+	} else if (command == "GET") {
+		output(state.write(*msd, what(arg)));
+
+	} else if (command == "RESET") {
+		reset(*msd, arg);
+		output(state.write(*msd, SEED));
+
+	} else if (command == "FORMAT") {
+		state.setFormat(*msd, format(arg));
+		output("DONE");
+	}
+}
+
+// the input after a state: continue with the next chunk (if any), unless it's CANCEL
+Session::Task Session::onReply(const string &line) {
+	if (lastChunk || toUpper(line) == "CANCEL") {
+		phase = IDLE;
+		output("DONE");
+		return Task();
+	}
+	return nextChunk();
+}
+
+Session::Task Session::nextChunk() {
+	if (freq > 0 && simCount >= freq) {
+		chunkLeft = freq;
+		simCount -= freq;
+	} else if (simCount > 0) {
+		chunkLeft = simCount;
+		simCount = 0;
+		lastChunk = true;
+	} else {
+		phase = IDLE;
+		output("DONE");
+		return Task();
+	}
+	phase = RUNNING;
+	cancelled = false;
+	return slice();
+}
+
+Session::Task Session::slice() {
+	return [this]() { runSlice(); };
+}
+
+void Session::runSlice() {
+	unsigned long long n;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (phase != RUNNING)
+			return;
+		n = chunkLeft;
+		if (sliceTime > 0)
+			n = std::min(n, sliceSize == 0 ? 1000 : sliceSize);
+	}
+
+	// metropolis(a) then metropolis(b) is the same as metropolis(a + b), so slicing doesn't change the results
+	auto start = std::chrono::steady_clock::now();
+	sim(*msd, n, dkT, dB);
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	Task next;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (phase != RUNNING)
+			return;  // closed
+		chunkLeft -= n;
+		if (sliceTime > 0) {
+			double size = elapsed > 0 ? n * sliceTime / elapsed : 2.0 * n;
+			sliceSize = (unsigned long long) std::max(1.0, std::min(size, 2.0 * n));
+		}
+		if (chunkLeft > 0 && !cancelled) {
+			next = slice();
+		} else {
+			phase = REPLY;
+			output(state.write(*msd, ALL));
+			// catch up on the input that came while running, until another chunk starts
+			while (!next && !queued.empty() && phase != CLOSED) {
+				string line = std::move(queued.front());
+				queued.pop_front();
+				next = handle(line);
+			}
+			if (next && !queued.empty() && toUpper(queued.front()) == "CANCEL")
+				cancelled = true;
+		}
+	}
+	if (next)
+		schedule(next);
+}
+
+}  // end of namespace worker
+}  // end of namespace udc
+
+#endif
@@ -0,0 +1,136 @@
+/**
+ * @file XMLTag.h
+ * @author Christopher D'Angelo
+ * @brief Contains udc::XMLTag and udc::readXMLTag, for scanning the XML written by metropolis
+ *        directly out of a (memory mapped) file, without building a DOM.
+ *
+ * @version 6.4
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2011-2026
+ */
+
+#ifndef UDC_XML_TAG
+#define UDC_XML_TAG
+
+#include <algorithm>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+
+namespace udc {
+
+using std::string_view;
+
+
+/**
+ * @brief A single start, end, or empty-element tag. The names and values point directly into the
+ *        scanned text, so they are only valid as long as it is.
+ *
+ * This only handles what metropolis writes: no entities or CDATA, and nothing is validated.
+ */
+struct XMLTag {
+	string_view name;  // e.g. "var", or "/data" for an end tag
+	std::vector< std::pair<string_view, string_view> > attributes;  // (name, value)
+	bool selfClosing;
+
+	/** @return the value of the given attribute, or an empty string_view if there isn't one. */
+	string_view attribute(string_view attrName) const;
+};
+
+inline bool isXMLSpace(char c) {
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+/**
+ * @brief Reads the tag starting at p (which must point to a '<').
+ *        Comments, declarations, and processing instructions are returned with an empty name.
+ * @return A pointer just past the closing '>', or end if the tag is incomplete.
+ */
+const char* readXMLTag(const char *p, const char *end, XMLTag &tag);
+
+/**
+ * @brief Finds the first start tag with the given name (e.g. "data") that starts in [from, to).
+ *        The tag itself may continue past "to", up to "end".
+ * @return A pointer to its '<', or "to" if there isn't one.
+ */
+const char* findXMLTag(string_view name, const char *from, const char *to, const char *end);
+
+
+//--------------------------------------------------------------------------------
+
+string_view XMLTag::attribute(string_view attrName) const {
+	for (auto attr = attributes.begin(); attr != attributes.end(); attr++)
+		if (attr->first == attrName)
+			return attr->second;
+	return string_view();
+}
+
+const char* readXMLTag(const char *p, const char *end, XMLTag &tag) {
+	tag.name = string_view();
+	tag.attributes.clear();
+	tag.selfClosing = false;
+	p++;
+	if (p < end && (*p == '!' || *p == '?')) {
+		string_view rest(p, end - p);
+		bool comment = (rest.substr(0, 3) == "!--");
+		size_t close = comment ? rest.find("-->") : rest.find('>');
+		return close == string_view::npos ? end : p + close + (comment ? 3 : 1);
+	}
+
+	const char *nameStart = p;
+	while (p < end && !isXMLSpace(*p) && *p != '/' && *p != '>')
+		p++;
+	if (p < end && *p == '/' && p == nameStart)  // end tag, e.g. </data>
+		while (++p < end && !isXMLSpace(*p) && *p != '>');
+	tag.name = string_view(nameStart, p - nameStart);
+
+	while (p < end) {
+		if (isXMLSpace(*p)) {
+			p++;
+		} else if (*p == '>') {
+			return p + 1;
+		} else if (*p == '/') {
+			tag.selfClosing = true;
+			p++;
+		} else {
+			const char *keyStart = p;
+			while (p < end && *p != '=' && !isXMLSpace(*p) && *p != '>')
+				p++;
+			string_view key(keyStart, p - keyStart);
+			while (p < end && (isXMLSpace(*p) || *p == '='))
+				p++;
+			if (p >= end || (*p != '"' && *p != '\''))
+				continue;  // attribute without a value; ignore it
+			const char quote = *p++;
+			const char *valueStart = p;
+			while (p < end && *p != quote)
+				p++;
+			tag.attributes.push_back(std::make_pair(key, string_view(valueStart, p - valueStart)));
+			if (p < end)
+				p++;
+		}
+	}
+	return end;
+}
+
+const char* findXMLTag(string_view name, const char *from, const char *to, const char *end) {
+	if (from >= to)
+		return to;
+	// only search as far as a tag starting before "to" could reach
+	string_view text(from, std::min<size_t>(end - from, (to - from) + name.size() + 1));
+	for (size_t i = text.find(name); i != string_view::npos; i = text.find(name, i + 1)) {
+		const char *tag = from + i - 1;
+		if (tag >= to)
+			break;
+		const char *after = tag + 1 + name.size();
+		if (i > 0 && *tag == '<' && after < end && (isXMLSpace(*after) || *after == '>' || *after == '/'))
+			return tag;
+	}
+	return to;
+}
+
+}  // end of namespace udc
+
+#endif
@@ -1,3326 +1,1541 @@
 /**
- * @file MSD.h
+ * @file FastMSD.h
  * @author Christopher D'Angelo
  * @brief
- * 	<p> The core logic which all the apps use to run MSD simulations.
- *  Includes definitions and calculations. </p>
- * 
- * 	<p> This new version allows for
- * 	faster calculations leveraging inline __asm, intrincis, and AVX2.
- * 	It also supports a full graph/network approch to building the system,
- * 	and is therefore not restricted to lattic configurations, not does
- * 	it need special handing for the molecule. </p> 
- * 
+ * 	<p> Contains udc::FastMSD, a graph-based engine for MSD simulations. </p>
+ *
+ * 	<p> Every site is a node, and every bond an edge, of a compact (CSR) graph: flat arrays of
+ * 	indices and coupling constants instead of MSD::setLocalM's per-region branches (or pointers
+ * 	to Edges). So it isn't restricted to lattice configurations, nor does it need special handling
+ * 	for the molecule. The energy of each flip is summed over the node's edges with AVX-512, AVX2,
+ * 	or SSE2 intrinsics (<immintrin.h>), or plain C++, whichever is the best the CPU supports
+ * 	(chosen at runtime, so one build runs everywhere). </p>
+ *
+ * 	<p> Each site's spin and flux are stored together as udc::StateVectors (x, y, z, 0), so the
+ * 	kernels read a neighbor from one cache line (or half of one with UDC_FLOAT_STATE, see PackedVector.h).
+ * 	Energies and magnetizations are always accumulated in double. </p>
+ *
+ * 	<p> Terms of the Hamiltonian that are 0 everywhere (e.g. no DMI, biquadratic coupling, or flux)
+ * 	are left out: each kernel is a template over the terms it computes, and the instantiation for the
+ * 	coefficients (see FastMSD::Term) is chosen when they're set. Without flux (every F, and flux, 0), the flux
+ * 	isn't sampled at all. The results are identical to the general kernel's. </p>
+ *
+ * 	<p> Optionally (setCachedFields), each node keeps the effective field of its neighbors for each Bond:
+ * 	the sums of J s' + Je1 f', Je1 s' + Jee f', and m' x D over its edges, updated when a neighbor's flip
+ * 	is accepted. Then a trial costs a few dot products instead of a pass over the node's edges (only
+ * 	biquadratic coupling still needs one), which pays off when most trials are rejected. </p>
+ *
+ * 	<p> The nodes can be stored along a Morton (Z-order) or Hilbert curve through their positions
+ * 	(see FastMSD::Ordering), so that neighbors are usually near each other in memory, instead of a row
+ * 	(or a whole layer) apart. Nodes keep their numbers (e.g. for getSpin and setLocalM); only where
+ * 	they're stored changes. </p>
+ *
+ * 	<p> Optionally (setPool, experimental), metropolis is speculative and parallel: it draws the random
+ * 	numbers of a window of upcoming trials, builds and evaluates the trials at once on a
+ * 	udc::WorkStealingPool, then accepts or rejects them in order, evaluating again (serially) each one
+ * 	whose node or neighbors an earlier flip changed. So it still picks one random site at a time, with
+ * 	exactly the same trajectory as FastMSD's serial metropolis (which is MSD::metropolis' up to rounding). </p>
+ *
+ * 	<p> Built from an MSD, it has the same observable behaviour as MSD::metropolis: the same sites,
+ * 	Results, record, and (given the same seed) the same random choices, up to rounding.
+ * 	(With UDC_FLOAT_STATE, states are rounded to float, so the simulations soon differ.) </p>
+ *
  * @version 7.0
- * @date 2024-1-8
- * 
- * @copyright Copyright (c) 2011-2024
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2011-2026
  */
 
-#ifndef UDC_MSD
-#define UDC_MSD
+#ifndef UDC_FAST_MSD
+#define UDC_FAST_MSD
 
-#define UDC_MSD_VERSION "7.0"
-
-#include <cstdlib>
+#include <algorithm>
+#include <atomic>
 #include <cmath>
-#include <ctime>
-#include <cstring>
-#include <exception>
+#include <cstdint>
 #include <functional>
-#include <iostream>
 #include <memory>
 #include <random>
 #include <stdexcept>
-#include <string>
+#include <thread>
+#include <typeinfo>
+#include <utility>
 #include <vector>
-#include "Vector.h"
-#include "udc.h"
-#include "SparseArray.h"
+#include "../MSD.h"
+#include "../PackedVector.h"
+#include "../ThreadPool.h"
+#include "../udc.h"
+#include "../Vector.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+	#define UDC_FAST_MSD_X86
+	#include <immintrin.h>
+	#ifdef _MSC_VER
+		#include <intrin.h>  // __cpuid, __cpuidex
+	#endif
+#endif
+
+// Lets GCC and Clang compile a function for a newer instruction set than the rest of the program,
+// so that it can be chosen at runtime. (MSVC always allows intrinsics.)
+#if defined(UDC_FAST_MSD_X86) && (defined(__GNUC__) || defined(__clang__))
+	#define UDC_FAST_MSD_TARGET(isa) __attribute__((target(isa)))
+#else
+	#define UDC_FAST_MSD_TARGET(isa)
+#endif
 
 
 namespace udc {
 
-using std::bind;
 using std::function;
+using std::int32_t;
 using std::invalid_argument;
 using std::mt19937_64;
-using std::istream;
-using std::ostream;
-using std::streampos;
-using std::out_of_range;
-using std::ref;
-using std::string;
-using std::uniform_int_distribution;
 using std::uniform_real_distribution;
-using std::shared_ptr;
-using std::exception;
-using std::strcmp;
 
 using udc::E;
 using udc::PI;
 using udc::sq;
 using udc::Vector;
-using udc::SparseArray;
-using udc::bread;
-using udc::bwrite;
 
 
-class MSD;
+class FastMSD {
+ public:
+	typedef MSD::Parameters Parameters;
+	typedef MSD::Results Results;
+	typedef MSD::FlippingAlgorithm FlippingAlgorithm;
+	typedef MSD::RecordSink RecordSink;
 
-/**
- * An abstract molecule. Used in MSD.
- * A "Molecule" object only represents a prototype for a molecule design.
- * Use the instantiate() method to create a Molecule::Instance which has a unique spin state.
- */
-class Molecule {
-	friend class MSD;
-	friend class NodeIterable;
-	friend class NodeIterator;
-	friend class EdgeIterable;
-	friend class EdgeIterator;
+	/** The ways to sum the energy over a node's edges. Each gives the same results, up to rounding. */
+	enum Kernel { SCALAR, SSE2, AVX2, AVX512 };
+
+	/** Which part of Results a node's magnetization and local energy are added to. */
+	enum Region { FM_L, FM_R, MOL };
+
+	/** Which part of Results an edge's energy is added to: UL, UR, Um, UmL, UmR, or ULR. */
+	enum Bond { BOND_L, BOND_R, BOND_M, BOND_ML, BOND_MR, BOND_LR };
 
- public:
 	/**
-	 * Information about an edge between two Nodes. 
+	 * The terms that a kernel computes, as a bitmask. A term is left out if its coefficients are all 0
+	 * (in every NodeClass or EdgeClass): e.g. TERM_DMI if every D is ZERO. Without TERM_FLUX, every flux
+	 * is ZERO (so are the terms with Je0, Je1, and Jee), and stays ZERO: every F is 0.
 	 */
-	struct EdgeParameters {
-		// nearest-neighbor parameters
-		double Jm;    // spin * spin
-		double Je1m;  // spin * flux
-		double Jeem;  // flux * flux
-		double bm;    // Biquadratic Coupling
-		Vector Dm;    // Dzyaloshinskii-Moriya interaction (i.e. Skyrmions)
-
-		EdgeParameters();
+	enum Term {
+		TERM_J = 1, TERM_JE = 2 /* Je1 and Jee */, TERM_BIQUADRATIC = 4, TERM_DMI = 8, TERM_FLUX = 16,
+		TERM_ANISOTROPY = 32, TERM_JE0 = 64,
+		EDGE_TERMS = 31,  // the ones the kernels are templates over
+		ALL_TERMS = 127
 	};
 
-	/** local parameters */
-	struct NodeParameters {
-		double Sm, Fm;  // spin and spin fluctuation magnetude scalars
-		double Je0m;     // spin * flux (local)
-		Vector Am;      // Anisotropy
-
-		NodeParameters();
+	/**
+	 * Where nodes are stored: in the order the Graph lists them (e.g. MSD::Iterator order), or along a
+	 * space-filling curve through Graph::positions. Either way, the simulation is the same.
+	 */
+	enum Ordering { GRAPH_ORDER, MORTON_ORDER, HILBERT_ORDER };
+
+	/** Local parameters, shared by many nodes. */
+	struct NodeClass {
+		Region region;
+		double F;    // flux magnitude is uniform random in [0, F)
+		double Je0;  // spin * flux (local)
+		Vector A;    // Anisotropy
 	};
 
-	class DeserializationException : public UDCException {
-	 public:
-		DeserializationException(const char *message) : UDCException(message) {}
+	/** Bond parameters, shared by many edges. */
+	struct EdgeClass {
+		Bond bond;
+		double J, Je1, Jee, b;
+		Vector D;
 	};
 
- private:
-	struct Node;
-	struct Edge;
-
+	/**
+	 * The sites (nodes 0 to n - 1) and bonds. The edges of node i are offsets[i] to offsets[i + 1] - 1,
+	 * and each bond is stored twice: once for each of its nodes.
+	 * An edge's energy is: J s*s' + Je1 (s*f' + f*s') + Jee f*f' + b (m*m')^2 + direction D*(m x m'),
+	 * where ' is the neighbor, and direction is -1 for the other copy of the bond (and 0 for a loop).
+	 */
+	struct Graph {
+		std::vector<unsigned int> indices;    // node -> MSD index (a = (z * height + y) * width + x)
+		std::vector<unsigned int> nodeClass;  // node -> nodeClasses
+		std::vector<unsigned int> offsets;    // node -> its first edge (and offsets[n] == number of edges)
+		std::vector<unsigned int> neighbors;  // edge -> node
+		std::vector<unsigned int> edgeClass;  // edge -> edgeClasses
+		std::vector<double> direction;        // edge -> +1, -1, or 0
+		std::vector<NodeClass> nodeClasses;
+		std::vector<EdgeClass> edgeClasses;
+		std::vector<Vector> positions;        // node -> where it is (only for Orderings, so it may be empty)
+
+		/** The same sites (in MSD::Iterator order), bonds, and parameters as the given MSD. */
+		static Graph fromMSD(const MSD &msd);
 
-	struct Edge {
-		/**
-		 * The indices in the Molecule's EdgeParameter or Node array.
-		 * 
-		 * "nodeIndex" is the neighbor.
-		 * "selfIndex" is the source node (i.e. the node this edge is attached to).
-		 */
-		size_t edgeIndex, nodeIndex, selfIndex;
-		
 		/**
-		 * Tracks the direction of this edge. Used for non-communative operations,
-		 * e.g. Dzyaloshinskii-Moriya interaction (i.e. Skyrmions)
-		 * 
-		 * +1 if edge is outgoing: direction of edge points from "selfIndex" towards "nodeIndex".
-		 * -1 if edge is incoming: pointing from "nodeIndex" towards "selfIndex".
-		 *  0 if edge is a loop: nodeIndex == selfIndex.
+		 * The nodes along the given curve: order[k] is the k-th node. Positions are rounded to a grid
+		 * whose spacing is the shortest bond (e.g. the lattice constant of a simple cubic lattice).
+		 * @throw invalid_argument if there are nodes, but no positions
 		 */
-		double direction;
-
-		Edge(size_t edgeIndex, size_t nodeIndex, size_t selfIndex, double direction);
-	};
+		std::vector<unsigned int> order(Ordering ordering) const;
 
-	struct Node {
-		NodeParameters parameters;
-		std::vector<Edge> neighbors;
+		/** The same Graph, with node k of the result being node order[k] of this one. Keeps each node's edge order. */
+		Graph permuted(const std::vector<unsigned int> &order) const;
 
-		Node(const NodeParameters &parameters = NodeParameters());
+	 private:
+		static unsigned long long mortonKey(const unsigned int x[3], unsigned int bits);
+		static unsigned long long hilbertKey(unsigned int x[3], unsigned int bits);
 	};
 
- // ----- Molecule (prototype) fields and methods -----
- private:
-	std::vector<EdgeParameters> edgeParameters;   // array of edges
-	std::vector<Node> nodes;  // array of nodes (e.g. atoms) making up this Molecule
-	size_t leftLead, rightLead;  // the position of the nodes connected to the left FM and right FM, respectively.
-	size_t sSize;  // size of buffer (bytes) needed for serialization or deserizalization
-
- public:
-	static const char * const HEADER;  // safety header for (de)serizlization
-	static const size_t HEADER_SIZE;  // size of HEADER string (not including null-terminator, '\0'): strlen(HEADER)
-	static const unsigned int NOT_FOUND = (unsigned int) -1;  // -1 will be the maximum unsigned int
-
- public:
-	/**
-	 * Create a default molecule with no nodes or edges.
-	 * Both the left and right leads are initalize to 0.
-	 */
-	Molecule();
-
 	/**
-	 * Create a molecule with the given number of nodes, but no edges.
-	 * Both the left and right leads are initalized to 0.
-	 * 
-	 * May also supply a set of parameters to use for each node.
-	 * By default, the default node parameters are used.
+	 * Copies the MSD's sites, parameters, state, Results, seed, and flippingAlgorithm.
+	 * The random numbers restart from the seed, i.e. FastMSD's metropolis matches the MSD's after msd.setSeed(seed).
+	 * The MSD's dipolar field isn't supported.
+	 * To change parameters other than kT and B, change the MSD and build a new FastMSD.
 	 */
-	Molecule(size_t nodeCount, const NodeParameters &nodeParams = NodeParameters());
+	explicit FastMSD(const MSD &msd, Ordering ordering = GRAPH_ORDER);
 
-	// Molecule(const Molecule &other);        // use default copy-constructor
-	// bool operator=(const Molecule &other);  // use default assignment operator
-
- public:
-	void serialize(unsigned char *buffer) const;  // store this Molecule object into the given buffer
-	void deserialize(const unsigned char *buffer);  // reconstruct this Molecule object using the given buffer
-	size_t serializationSize() const;  // the size needed (in bytes) to serialize this Molecule object
+	/** Every spin and flux starts at ZERO. */
+	FastMSD(const Graph &graph, double kT, const Vector &B = Vector::ZERO, Ordering ordering = GRAPH_ORDER);
 
-	istream& read(istream &in);  // reads the serialized data from the given binary istream
-	ostream& write(ostream &out) const;  // writes the serialized data to the given binary ostream
-	static Molecule load(istream &in);  // same as read, but constructs and returns a new Molecule (MSD::MolProto) object
+	/** The best kernel the CPU supports. Used by default. */
+	static Kernel bestKernel();
+	static bool supports(Kernel kernel);
+	static const char* kernelName(Kernel kernel);
 
-	/**
-	 * Returns the new node's index.
-	 */
-	unsigned int createNode(const NodeParameters &parameters = NodeParameters());
+	Kernel getKernel() const;
+	void setKernel(Kernel kernel);  // @throw invalid_argument if the CPU doesn't support it
 
-	/**
-	 * (i.e. "n_m") 
-	 * Returns the number of nodes/atoms in this molecule.
-	 */
-	unsigned int nodeCount() const;
+	unsigned int getTerms() const;  // the Terms the kernel computes
+	bool isSpecialized() const;
+	void setSpecialized(bool specialized);  // false: always compute ALL_TERMS (the general kernel). Default true.
 
 	/**
-	 * Creates a connection (Edge) between the two given nodes, and
-	 * returns the new Edge's index.
-	 * 
-	 * Note: this method does not check if the two nodes are already connected.
-	 * It is possible to creates more then one edge connecting the same two nodes.
+	 * Whether trials use cached effective fields instead of the kernel (except for biquadratic coupling).
+	 * The results are the same up to rounding. The fields are recomputed from scratch after every n
+	 * accepted flips, so their rounding errors don't build up. Default false.
 	 */
-	unsigned int connectNodes(unsigned int nodeA, unsigned int nodeB, const EdgeParameters &parameters = EdgeParameters());
+	bool hasCachedFields() const;
+	void setCachedFields(bool cached);
 
 	/**
-	 * Search for and return the index of the edge connecting the given nodes if one exists,
-	 * or Molecule::NOT_FOUND if one doesn't.
+	 * Experimental: speculative parallel metropolis, on the given pool's threads (and the calling one). Up to "window"
+	 * trials at a time are drawn ahead, assuming each one will take its accept draw (i.e. dU > 0). The trials are then
+	 * accepted or rejected in order, and the window ends early at the first one drawn from the wrong place (i.e. after
+	 * an earlier one with dU <= 0), so the next window is only twice as long as the trials it used.
+	 *
+	 * In parallel: each trial's flip and flux (the trigonometry), its dU, and its acceptance probability. Serially:
+	 * the random numbers (one generator), the accept draws, commits, and any trial an earlier flip made stale. With an
+	 * unknown flippingAlgorithm (not UP_DOWN_MODEL or CONTINUOUS_SPIN_MODEL), where each trial starts in the random
+	 * numbers isn't known ahead, so the flips are drawn serially too, and only dU is parallel.
+	 * It only pays off on several cores, and with few stale trials (e.g. low kT): on one core it's slower than serial.
+	 *
+	 * The trajectory, Results, and random numbers are bit-identical to FastMSD's serial metropolis (not to
+	 * MSD::metropolis, which FastMSD only matches up to rounding: the statistics are the same, not the bits).
+	 * NULL (default) means serial. The pool isn't owned, and may be shared.
 	 */
-	unsigned int edgeIndex(unsigned int nodeA, unsigned int nodeB) const;
+	void setPool(WorkStealingPool *pool, unsigned int window = 256);
+	WorkStealingPool* getPool() const;
+	unsigned int getWindow() const;
 
-	EdgeParameters getEdgeParameters(unsigned int index) const;
-	void setEdgeParameters(unsigned int index, const EdgeParameters &p);
-	NodeParameters getNodeParameters(unsigned int index) const;
-	void setNodeParameters(unsigned int index, const NodeParameters &p);
-	void setAllParameters(const Molecule::NodeParameters &nodeParams, const Molecule::EdgeParameters &edgeParams);
+	Ordering getOrdering() const;
 
-	void setLeftLead(unsigned int node);
-	void setRightLead(unsigned int node);
-	void setLeads(unsigned int left, unsigned int right);
-	unsigned int getLeftLead() const;
-	unsigned int getRightLead() const;
-	void getLeads(unsigned int &left, unsigned int &right) const;
-
-	// Iterators
-	class NodeIterable;
-	class EdgeIterable;
-
-	NodeIterable getNodes() const;  // iterates over all nodes in the Molecule 
-	EdgeIterable getEdges() const;  // iterates over all the edges in the entire Molecule
-	EdgeIterable getAdjacencyList(unsigned int nodeIndex) const;  // iterates over the edges (i.e. adjacency list) of a given node
-	// Note: changes to the molecule invalidate all previously constructed Iterable or Iterator objects
+	unsigned int getN() const;
+	unsigned int getIndex(unsigned int node) const;  // in the MSD
 
-	class NodeIterator {
-		friend class NodeIterable;
+	Vector getSpin(unsigned int node) const;
+	Vector getFlux(unsigned int node) const;
+	Vector getLocalM(unsigned int node) const;
+	void setLocalM(unsigned int node, const Vector &spin, const Vector &flux);
 
-	 private:
-		const NodeIterable &iterable;
-		unsigned int idx;
-
-		NodeIterator(const NodeIterable &nodes, unsigned int idx);
-	
-	 public:
-		unsigned int getIndex() const;
-		NodeParameters getParameters() const;
-		EdgeIterable getNeighbors() const;
-
-		unsigned int operator*() const;
-		unsigned int operator[](int) const;
-		operator unsigned int() const;
-		
-		NodeIterator& operator++();
-		NodeIterator operator++(int);
-		NodeIterator& operator--();
-		NodeIterator operator--(int);
-		NodeIterator& operator+=(int);
-		NodeIterator& operator-=(int);
-		
-		NodeIterator operator+(int) const;
-		NodeIterator operator-(int) const;
-		
-		bool operator==(const NodeIterator &) const;
-		bool operator!=(const NodeIterator &) const;
-		bool operator>(const NodeIterator &) const;
-		bool operator<(const NodeIterator &) const;
-		bool operator>=(const NodeIterator &) const;
-		bool operator<=(const NodeIterator &) const;
-	};
+	Results getResults() const;
 
-	class NodeIterable {
-		friend class Molecule;
-		friend class NodeIterator;
+	/** Sums the Results of the current state from scratch (t is kept), e.g. to check for drift. */
+	Results computeResults() const;
 
-	 private:
-		const Molecule &mol;
-		unsigned int _begin;
-		unsigned int _end;
-	
-		NodeIterable(const Molecule &mol);
-	
-	 public:
-		NodeIterator begin() const;
-		NodeIterator end() const;
-		unsigned int size() const;
-	};
+	double get_kT() const;
+	void set_kT(double kT);
+	Vector getB() const;
+	void setB(const Vector &B);
 
-	class EdgeIterator {
-		friend class EdgeIterable;
+	void setSeed(unsigned long seed);
+	unsigned long getSeed() const;
 
-	 private:
-		const EdgeIterable &iterable;
-		unsigned int idx;  // idx of edges iterable. not nessesarily the same as the "edgeIndex" returned by Molecule::connectNodes
-
-		EdgeIterator(const EdgeIterable &edges, unsigned int idx);
-
-		const Edge& getEdge() const;  // helper method
-
-	 public:
-		unsigned int getIndex() const;
-		EdgeParameters getParameters() const;
-		unsigned int src() const;  // (index of) source node
-		unsigned int dest() const;  // (index of) destination node
-		double getDirection() const;  // direction of node: either 1.0, -1.0, or 0.0
-
-		unsigned int operator*() const;
-		unsigned int operator[](int) const;
-		operator unsigned int() const;
-		
-		EdgeIterator& operator++();
-		EdgeIterator operator++(int);
-		EdgeIterator& operator--();
-		EdgeIterator operator--(int);
-		EdgeIterator& operator+=(int);
-		EdgeIterator& operator-=(int);
-		
-		EdgeIterator operator+(int) const;
-		EdgeIterator operator-(int) const;
-		
-		bool operator==(const EdgeIterator &) const;
-		bool operator!=(const EdgeIterator &) const;
-		bool operator>(const EdgeIterator &) const;
-		bool operator<(const EdgeIterator &) const;
-		bool operator>=(const EdgeIterator &) const;
-		bool operator<=(const EdgeIterator &) const;
-	};
+	void metropolis(unsigned long long N);
+	void metropolis(unsigned long long N, unsigned long long freq);  // same as MSD::metropolis(N, freq)
 
-	class EdgeIterable {
-		friend class Molecule;
-		friend class EdgeIterator;
-	
-	 private:
-		const Molecule &mol;
-		std::vector<Edge> edges;
-
-		EdgeIterable(const Molecule &);
-		EdgeIterable(const Molecule &, unsigned int node);
-	
-	 public:
-		EdgeIterator begin() const;
-		EdgeIterator end() const;
-		unsigned int size() const;
-	};
+	std::vector<Results> record;
+	RecordSink *recordSink;  // where metropolis(N, freq) sends Results. NULL (default) means "record". Not owned.
+	FlippingAlgorithm flippingAlgorithm;
 
- // ----- Molecule::Instance stuff -----
  private:
-	/**
-	 * Represents an actuallized instance of the prototype Molecule,
-	 * and contains state information for each part/atom of the molecule.
-	 */
-	class Instance {
-		friend class Molecule;
-		friend class MSD;
-	
-	 private:
-		const Molecule &prototype;  // contains a reference to the the Molecular structure and parameters
-		MSD &msd;  // a reference to the MSD this Molecule::Instace is attached to
-		unsigned int y, z;  // the (x,y,z) position of this Molecule::Instance. Note: the mol's x position is determined by msd.molPosL, msd.molPosR.  
-		std::vector<Vector> spins;  // states of each "Node"
-		std::vector<Vector> fluxes;
-
-		/**
-		 * All spins start up (Sm * Vector::J), and all fluxes start at 0 (Vector::ZERO) by default.
-		 * 
-		 * Instances should be created after the Molecule (prototype) has been configured.
-		 * If the parent Molecule (prototype) object is modified after this method is called,
-		 * the previously existing Instance objects returned by those calls may be invalid;
-		 * they should be discarded and new Instance objects should be created.
-		 * 
-		 * Changs to NodeParameters or EdgeParameters are okay; however,
-		 * the energy of the attached MSD will need to be recalculated externally.
-		 * 
-		 * (TL;DR modifying the Molecule object after invoking instantiate leads to undefined behavior.)
-		 * 
-		 * @param prototype: the Molecule prototype for which this object is an instance of.
-		 * @param msd: The MSD which this Mol is attached.
-		 * @param y: The y-cordinate for this Mol within the MSD.
-		 * @param z: The z-cordinate for this Mol within the MSD.
-		 * @param initSpin: (Default value: Vector::J) the initial spin of all of the nodes in this instance.
-		 * 	This vector will be scaled based on prototype.nodes[i].parameters.Sm (for all nodes, i).
-		 * @param initFlux: (Default value: Vector::ZERO) the inital flux of all the nodes in this instance.
-		 * 	This vector will be scaled based on prototype.nodes[i].parameters.Fm (for all nodes, i) if and only if
-		 * 	it's magnetude is too large.
-		 */
-		Instance(const Molecule &prototype, MSD &msd, unsigned int y, unsigned int z,
-				const Vector &initSpin = Vector::J, const Vector &initFlux = Vector::ZERO);
-		Instance(const Instance &other);
-
-		Instance& operator=(const Instance &other);  // copies the spin/flux states
-	
-	 public:
-		void setLocalM(unsigned int a, const Vector &spin, const Vector &flux);
-		void setSpin(unsigned int a, const Vector &spin);
-		void setFlux(unsigned int a, const Vector &flux);
-		Vector getSpin(unsigned int a) const;
-		Vector getFlux(unsigned int a) const;
-		void getLocalM(unsigned int a, Vector &spin, Vector &flux) const;
-	};
-
-	/**
-	 * @see Molecule::Instance::Instance(const Molecule &, MSD &, unsigned int, unsigned int)
-	 */
-	Instance instantiate(MSD &msd, unsigned int y, unsigned int z) const;
-};
-
+	// Below, nodes are numbered by where they're stored: node i (of the public methods) is stored at slot[i].
+	unsigned int n;
+	Ordering ordering;
+	std::vector<unsigned int> slot;
+	std::vector<unsigned int> indices;
+	std::vector<unsigned int> nodeClass;
+	std::vector<NodeClass> nodeClasses;
+
+	// the spin of node i is state[2 * i], and its flux state[2 * i + 1].
+	// So, as a flat array of Scalar, component c of the spin is at 8 * i + c, and of the flux at 8 * i + 4 + c.
+	typedef StateVector::Scalar Scalar;
+	std::vector<StateVector, PageAllocator<StateVector>> state;
+
+	// the edges of node i are begin[i] to begin[i] + degree[i] - 1, then padding up to begin[i + 1],
+	// so every node has a multiple of PAD edges. Padding points back at node i, and has all 0 coefficients.
+	static const unsigned int PAD = 8;
+	std::vector<unsigned int> begin, degree;
+	std::vector<int32_t> neighbors;  // (signed for the gather instructions)
+	std::vector<double> J, Je1, Jee, b, Dx, Dy, Dz;  // (D times the edge's direction)
+	std::vector<unsigned char> bond;
+
+	// the Bond of all of node i's edges (so the SIMD kernels can sum them in their lanes), or MIXED_BONDS
+	static const unsigned char MIXED_BONDS = 0xFF;
+	std::vector<unsigned char> nodeBond;
+
+	double kT;
+	Vector B;
+	Results results;
 
-/**
- * An abstract Molecular Spintronic Device.
- */
-class MSD {
- public:
-	typedef Molecule MolProto;
-	typedef Molecule::Instance Mol;
-	typedef function<MolProto (unsigned int)> MolProtoFactory;
-	typedef function<Vector (const Vector &, function<double()>)> FlippingAlgorithm;
-	
-	// needed so these methods can update energy and magnetization of the MSD
-	friend void Mol::setLocalM(unsigned int a, const Vector &spin, const Vector &flux);
-	friend void Mol::setSpin(unsigned int a, const Vector &spin);
-	friend void Mol::setFlux(unsigned int a, const Vector &flux);
-
-	struct Parameters {
-		double kT;  // Temperature
-		Vector B;  // Magnetic field
-		double SL, SR;  // spin magnitudes
-		double FL, FR;  // Spin fluctuation constants, flux.norm() = uniform random between [0, F)
-		double JL, JR, JmL, JmR, JLR;  // Heisenberg exchange coupling between s_i and s_j: local spin and neighboring spins
-		double Je0L, Je0R;  // Exchange coupling between s_i and f_i: local spin and local flux vector
-		double Je1L, Je1R, Je1mL, Je1mR, Je1LR;  // Exchange coupling between s_i and f_j: local spin and neighboring flux vectors
-		double JeeL, JeeR, JeemL, JeemR, JeeLR;  // Exchange coupling between f_i and f_j: local flux and neighboring flux vectors
-		double bL, bR, bmL, bmR, bLR;  // Biquadratic Coupling
-		Vector AL, AR;  // Anisotropy
-		Vector DL, DR, DmL, DmR, DLR;  // Dzyaloshinskii-Moriya interaction (i.e. Skyrmions)
-		
-		Parameters();
-		
-		bool operator==(const Parameters &) const;
-		bool operator!=(const Parameters &) const;
+	mt19937_64 prng;
+	uniform_real_distribution<double> rand;
+	unsigned long seed;
+	std::vector<double> drawn;  // random numbers drawn ahead (by a window), to be used before any new ones
+	size_t drawnPos;            // the next one of them
+
+	typedef void (*SumEdges)(const FastMSD &, unsigned int, const double *, double *);
+	Kernel kernel;
+	bool specialized;
+	unsigned int terms;
+	SumEdges sumEdges;
+	SumEdges sumBiquadratic;  // (for cached fields) the kernel with only TERM_BIQUADRATIC, and TERM_FLUX
+
+	// the effective fields of the neighbors of node i, for each of its Bonds, are fields[fieldBegin[i]] to
+	// fields[fieldBegin[i + 1] - 1]. (Empty if !cached.) Edge e of node i changes fields[twinField[e]] of its neighbor.
+	struct Field {
+		Vector hS;  // sum of J s' + Je1 f' (dotted with deltaS)
+		Vector hF;  // sum of Je1 s' + Jee f' (dotted with deltaF)
+		Vector hM;  // sum of m' x D (dotted with deltaM)
+		unsigned int bond;
 	};
-	
-	struct Results {
-		unsigned long long t;  // time, i.e. current iteration
-		Vector M, ML, MR, Mm;  // Magnetization
-		Vector MS, MSL, MSR, MSm;  // Magnetization due to spin only (no flux)
-		Vector MF, MFL, MFR, MFm;  // Magnetization due to flux only (no spin) 
-		double U, UL, UR, Um, UmL, UmR, ULR;  // Internal Energy
-		
-		Results();
-		
-		bool operator==(const Results &) const;
-		bool operator!=(const Results &) const;
-	};
-	
-	class Iterator {
-		friend class MSD;
-		
-	 private:
-		const MSD &msd;
-		unsigned int i;  // index in msd::indicies
-		
-		Iterator(const MSD &, unsigned int i);
-		
-	 public:
-		unsigned int getIndex() const;
-		unsigned int getX() const;
-		unsigned int getY() const;
-		unsigned int getZ() const;
-		
-		Vector getSpin() const;
-		Vector getFlux() const;
-		Vector getLocalM() const;
-		
-		Vector operator*() const;
-		Vector operator[](int) const;
-		operator unsigned int() const;
-		
-		Iterator& operator++();
-		Iterator operator++(int);
-		Iterator& operator--();
-		Iterator operator--(int);
-		Iterator& operator+=(int);
-		Iterator& operator-=(int);
-		
-		Iterator operator+(int) const;
-		Iterator operator-(int) const;
-		
-		bool operator==(const Iterator &) const;
-		bool operator!=(const Iterator &) const;
-		bool operator>(const Iterator &) const;
-		bool operator<(const Iterator &) const;
-		bool operator>=(const Iterator &) const;
-		bool operator<=(const Iterator &) const;
+	bool cached;
+	std::vector<Field> fields;
+	std::vector<unsigned int> fieldBegin, twinField;
+	unsigned int flipsSinceRefresh;
+
+	// a flip: see propose(), trial(), and commit()
+	struct Trial {
+		unsigned int node;
+		Vector spin, flux;
+		double U[6];  // energy change for each Bond, as positive terms (i.e. U -= U[bond])
 	};
 
-	class MoleculeException : public UDCException {
-	 public:
-		MoleculeException(const char *message) : UDCException(message) {}
+	// a Trial of a window (see setPool): its random numbers are drawn[begin] to drawn[draw], the last being the accept draw
+	struct Speculation {
+		Trial trial;
+		size_t begin, draw;
+		double dU;
+		double p;  // the acceptance probability, if dU > 0
 	};
-	
-	static const FlippingAlgorithm UP_DOWN_MODEL;
-	static const FlippingAlgorithm CONTINUOUS_SPIN_MODEL;
-	
-	static const MolProtoFactory LINEAR_MOL;
-	static const MolProtoFactory CIRCULAR_MOL;
-
- private:
-	static Vector initSpin; //initial spin of all atoms
-	static Vector initFlux; //initial spin fluctuation (direction only) for each atom
-	
-	SparseArray<Vector> spins;
-	SparseArray<Vector> fluxes;
-	Parameters parameters;
-	Results results;
-	unsigned int width, height, depth;
-	unsigned int molPosL, molPosR;
-	unsigned int topL, bottomL, frontR, backR;  // "inner sizes/boundaries"
-	
-	MolProto molProto;                  // Contains the prototype for the molecule instances
-	SparseArray<shared_ptr<Mol>> mols;  // Contains the molecule instances. Uses the same indexing as spins and fluxes.
-	                                    // Note: Mol the same Mol object is pointed for all x where y,z remain constant.
-	
-	// number of atoms in both the entire device (n) and in each region (nL, nR, etc.)
-	// n_mL, n_mR, mLR are defined as twice the number of bonds since these regions exist only as an interaction between two regions.
-	unsigned int n, nL, nR, n_m, n_mL, n_mR, nLR;
-
-	// flags for each region to remember if they exist based on given dimensions and inner bounds
-	bool FM_L_exists, FM_R_exists, mol_exists;
-	
-	std::vector<unsigned int> indices; // valid indices
-	std::vector<unsigned int> unique_mol_indices;  // valid indices for each unique mol. (x == molPosL)
-	
-	mt19937_64 prng; //pseudo random number generator
-	uniform_real_distribution<double> rand; //uniform probability density function on the interval [0, 1)
-	unsigned long seed; //store seed so that every run can follow the same sequence
-	unsigned char seed_count; //to help keep seeds from repeating because of temporal proximity
-	
-	unsigned int index(unsigned int x, unsigned int y, unsigned int z) const;
-	unsigned int x(unsigned int a) const;
-	unsigned int y(unsigned int a) const;
-	unsigned int z(unsigned int a) const;
-	
-	unsigned long genSeed(); //generates a new seed
-	
-	MSD& operator=(const MSD&); //undefined, do not use!
-	MSD(const MSD &m); //undefined, do not use!
-
-	void init(const MolProtoFactory *molProtoFactory = NULL);
-	
- public:
-	std::vector<Results> record;
-	FlippingAlgorithm flippingAlgorithm; //algorithm used to "flip" an atom in metropolis
-	
-	MSD(unsigned int width, unsigned int height, unsigned int depth,
-			const MolProto &molProto, unsigned int molPosL,
-			unsigned int topL, unsigned int bottomL, unsigned int frontR, unsigned int backR);
-	MSD(unsigned int width, unsigned int height, unsigned int depth,
-			const MolProtoFactory &molType, unsigned int molPosL, unsigned int molPosR,
-			unsigned int topL, unsigned int bottomL, unsigned int frontR, unsigned int backR);
-	MSD(unsigned int width, unsigned int height, unsigned int depth,
-			unsigned int molPosL, unsigned int molPosR,
-			unsigned int topL, unsigned int bottomL, unsigned int frontR, unsigned int backR);
-	MSD(unsigned int width, unsigned int height, unsigned int depth,
-			unsigned int heightL, unsigned depthR);
-	MSD(unsigned int width, unsigned int height, unsigned int depth);
-	
-	
-	Parameters getParameters() const;
-	void setParameters(const Parameters &);
-	Results getResults() const;
-	
-	void set_kT(double kT);
-	void setB(const Vector &B);
+	WorkStealingPool *pool;
+	unsigned int windowSize;
+	unsigned int speculated;  // how many trials the next window draws: twice as many as the last one used, up to windowSize
+	std::vector<Speculation> window;
+	std::vector<unsigned long long> changedIn;  // node -> the last window in which a flip of it was accepted
+	unsigned long long windowCount;
+
+	void init(const Graph &graph, Ordering ordering);
+	Vector spinAt(unsigned int i) const;
+	Vector fluxAt(unsigned int i) const;
+	void chooseTerms(bool flux);  // the Terms of the coefficients, and TERM_FLUX if flux (or any F != 0)
+	bool hasFlux() const;  // is any flux != ZERO
+	unsigned int fieldIndex(unsigned int node, unsigned int bond) const;
+	void refreshFields();  // sums every Field from scratch
+
+	// the random numbers Vector::sphericalForm(F * random(), ...) would take (so the simulation doesn't change), and ZERO
+	static Vector noFlux(const function<double()> &random);
+
+	double nextRandom();  // the next of drawn, or else a new one
+	double drawnAt(size_t k);  // drawn[k], drawing new ones up to it if needed
+
+	void propose(Trial &t, unsigned int node, Vector spin, Vector flux) const;
+	void propose(Trial &t, const function<double()> &random) const;  // a random node and flip, the same as MSD::metropolis
+	double trial(Trial &t) const;  // sets t.U, and returns the change in U
+	void commit(const Trial &t);
+
+	unsigned int drawsPerTrial() const;  // random numbers per trial (including the accept draw), or 0 if not known ahead
+	void metropolisParallel(unsigned long long N);
+	void evaluateWindow(unsigned int count, bool proposing);  // window[0] to window[count - 1] (and their Trials), in parallel
+	void evaluate(Speculation &x) const;  // its dU and p
+	bool stale(unsigned int node) const;  // did a flip of node, or one of its neighbors, change it during this window
+
+	static Vector& regionM(Results &r, Region region);
+	static Vector& regionMS(Results &r, Region region);
+	static Vector& regionMF(Results &r, Region region);
+	static double& bondU(Results &r, unsigned int bond);
+
+	// Kernels: add each of the node's edge energies to dU[bond]. d = deltaS, deltaF, deltaM, m, mag (x, y, z each).
+	// TERMS: the EDGE_TERMS to compute.
+	template <unsigned int TERMS> static void sumEdgesScalar(const FastMSD &msd, unsigned int node, const double *d, double *dU);
+#ifdef UDC_FAST_MSD_X86
+	template <unsigned int TERMS> UDC_FAST_MSD_TARGET("sse2")
+	static void sumEdgesSSE2(const FastMSD &msd, unsigned int node, const double *d, double *dU);
+	template <unsigned int TERMS> UDC_FAST_MSD_TARGET("avx2,fma")
+	static void sumEdgesAVX2(const FastMSD &msd, unsigned int node, const double *d, double *dU);
+	template <unsigned int TERMS> UDC_FAST_MSD_TARGET("avx512f")
+	static void sumEdgesAVX512(const FastMSD &msd, unsigned int node, const double *d, double *dU);
+
+	// gather component p[8 * j] of each neighbor j, as double
+	UDC_FAST_MSD_TARGET("avx2,fma") static __m256d gather4(const double *p, __m128i j);
+	UDC_FAST_MSD_TARGET("avx2,fma") static __m256d gather4(const float *p, __m128i j);
+	UDC_FAST_MSD_TARGET("avx512f") static __m512d gather8(const double *p, __m256i j);
+	UDC_FAST_MSD_TARGET("avx512f") static __m512d gather8(const float *p, __m256i j);
+#endif
 
-	const MolProto & getMolProto() const;
-	void setMolProto(const MolProto &proto);  // Note: the new MolProto must have the same "size" (number of nodes) as the previous MolProto.
-	void setMolParameters(const MolProto::NodeParameters &, const MolProto::EdgeParameters &);  // uniformally updates all mol. parameters
-
-	Vector getSpin(unsigned int a) const;
-	Vector getSpin(unsigned int x, unsigned int y, unsigned int z) const;
-	Vector getFlux(unsigned int a) const;
-	Vector getFlux(unsigned int x, unsigned int y, unsigned int z) const;
-	Vector getLocalM(unsigned int a) const;
-	Vector getLocalM(unsigned int x, unsigned int y, unsigned int z) const;
-	void setSpin(unsigned int a, const Vector &);
-	void setSpin(unsigned int x, unsigned int y, unsigned int z, const Vector &);
-	void setFlux(unsigned int a, const Vector &);
-	void setFlux(unsigned int x, unsigned int y, unsigned int z, const Vector &);
-	void setLocalM(unsigned int a, const Vector &, const Vector &);
-	void setLocalM(unsigned int x, unsigned int y, unsigned int z, const Vector &, const Vector &);
-	
-	unsigned int getN() const;
-	unsigned int getNL() const;
-	unsigned int getNR() const;
-	unsigned int getNm() const;
-	unsigned int getNmL() const;
-	unsigned int getNmR() const;
-	unsigned int getNLR() const;
-	unsigned int getWidth() const;
-	unsigned int getHeight() const;
-	unsigned int getDepth() const;
-	void getDimensions(unsigned int &width, unsigned int &height, unsigned int &depth) const;
-	unsigned int getMolPosL() const;
-	unsigned int getMolPosR() const;
-	void getMolPos(unsigned int &molPosL, unsigned int &molPosR) const;
-	unsigned int getTopL() const;
-	unsigned int getBottomL() const;
-	unsigned int getFrontR() const;
-	unsigned int getBackR() const;
-	void getInnerBounds(unsigned int &topL, unsigned int &bottomL, unsigned int &frontR, unsigned int &backR) const;
-	bool getFM_L_exists() const;
-	bool getFM_R_exists() const;
-	bool getMol_exists() const;
-	void getRegions(bool &FM_L_exists, bool &FM_R_exists, bool &mol_exists) const;
-	
-	void setSeed(unsigned long seed);  // change the seed of the prng, and restart the pseudo-random sequence
-	unsigned long getSeed() const;  // get the seed currently being used
-
-	void reinitialize(bool reseed = true); //reseed iff you want a new seed, true by default
-	void randomize(bool reseed = true); //similar to reinitialize, but initial state is random
-	void metropolis(unsigned long long N);
-	void metropolis(unsigned long long N, unsigned long long freq);
-	
-	double specificHeat() const;
-	double specificHeat_L() const;
-	double specificHeat_R() const;
-	double specificHeat_m() const;
-	double specificHeat_mL() const;
-	double specificHeat_mR() const;
-	double specificHeat_LR() const;
-	double magneticSusceptibility() const;
-	double magneticSusceptibility_L() const;
-	double magneticSusceptibility_R() const;
-	double magneticSusceptibility_m() const;
-	
-	Vector meanM() const;
-	Vector meanML() const;
-	Vector meanMR() const;
-	Vector meanMm() const;
-	Vector meanMS() const;
-	Vector meanMSL() const;
-	Vector meanMSR() const;
-	Vector meanMSm() const;
-	Vector meanMF() const;
-	Vector meanMFL() const;
-	Vector meanMFR() const;
-	Vector meanMFm() const;
-	double meanU() const;
-	double meanUL() const;
-	double meanUR() const;
-	double meanUm() const;
-	double meanUmL() const;
-	double meanUmR() const;
-	double meanULR() const;
-	
-	Iterator begin() const;
-	Iterator end() const;
+	// the instantiation of the kernel for the EDGE_TERMS in terms
+	template <unsigned int... TERMS>
+	static SumEdges kernelFor(Kernel kernel, unsigned int terms, std::integer_sequence<unsigned int, TERMS...>);
 };
 
-ostream& operator <<(ostream &out, const MSD::Parameters &p);
-ostream& operator <<(ostream &out, const MSD::Results &r);
-
 
 //--------------------------------------------------------------------------------
-ostream& operator <<(ostream &out, const MSD::Parameters &p) {
-	return out
-		<< "kT = " << p.kT << '\n' << "B = " << p.B << "\n\n"
-
-		<< "SL = " << p.SL << '\n' << "SR = " << p.SR << '\n'
-		<< "FL = " << p.FL << '\n' << "FR = " << p.FR << "\n\n"
-		
-		<< "JL  = " << p.JL  << '\n' << "JR  = " << p.JR  << '\n'
-		<< "JmL = " << p.JmL << '\n' << "JmR = " << p.JmR << '\n' << "JLR = " << p.JLR << "\n\n"
-		
-		<< "Je0L  = " << p.Je0L  << '\n' << "Je0R  = " << p.Je0R  << '\n'
-		<< "Je1L  = " << p.Je1L  << '\n' << "Je1R  = " << p.Je1R  << '\n'
-		<< "Je1mL = " << p.Je1mL << '\n' << "Je1mR = " << p.Je1mR << '\n' << "Je1LR = " << p.Je1LR << "\n"
-		<< "JeeL  = " << p.JeeL  << '\n' << "JeeR  = " << p.JeeR  << '\n'
-		<< "JeemL = " << p.JeemL << '\n' << "JeemR = " << p.JeemR << '\n' << "JeeLR = " << p.JeeLR << "\n\n"
-		
-		<< "bL  = " << p.bL  << '\n' << "bR  = " << p.bR  << '\n'
-		<< "bmL = " << p.bmL << '\n' << "bmR = " << p.bmR << '\n' << "bLR = " << p.bLR << "\n\n"
-		
-		<< "AL = " << p.AL << '\n' << "AR = " << p.AR << "\n\n"
-		
-		<< "DL  = " << p.DL  << '\n' << "DR  = " << p.DR  << '\n'
-		<< "DmL = " << p.DmL << '\n' << "DmR = " << p.DmR << '\n' << "DLR = " << p.DLR << '\n';
-}
-
-ostream& operator <<(ostream &out, const MSD::Results &r) {
-	return out
-		<< "t   = " << r.t   << "\n\n"
-		<< "M   = " << r.M   << '\n' << "ML  = " << r.ML  << '\n' << "MR  = " << r.MR  << '\n' << "Mm  = " << r.Mm  << "\n\n"
-		<< "MS  = " << r.MS  << '\n' << "MSL = " << r.MSL << '\n' << "MSR = " << r.MSR << '\n' << "MSm = " << r.MSm << "\n\n"
-		<< "MF  = " << r.MF  << '\n' << "MFL = " << r.MFL << '\n' << "MFR = " << r.MFR << '\n' << "MFm = " << r.MFm << "\n\n"
-		<< "U   = " << r.U   << '\n' << "UL  = " << r.UL  << '\n' << "UR  = " << r.UR  << '\n' << "Um  = " << r.Um  << '\n'
-		<< "UmL = " << r.UmL << '\n' << "UmR = " << r.UmR << '\n' << "ULR = " << r.ULR << '\n';
-}
-
-
-Molecule::EdgeParameters::EdgeParameters()
-: Jm(1), Je1m(0), Jeem(0), bm(0), Dm(Vector::ZERO)
-{}
-
-Molecule::NodeParameters::NodeParameters()
-: Sm(1), Fm(0), Je0m(0), Am(Vector::ZERO)
-{}
-
-Molecule::Edge::Edge(size_t eIdx, size_t nIdx, size_t sIdx, double dir)
-: edgeIndex(eIdx), nodeIndex(nIdx), selfIndex(sIdx), direction(dir)
-{}
-
-Molecule::Node::Node(const NodeParameters &parameters) : parameters(parameters) {
-}
-
-const char * const Molecule::HEADER = "MMB";
-const size_t Molecule::HEADER_SIZE = 3;  // compile-time constant of strlen(HEADER)
-
-// 2 size_t's for the leads, and 1 for each block length (nodeParams, and edgeParams)
-Molecule::Molecule() : leftLead(0), rightLead(0), sSize(HEADER_SIZE + 4 * sizeof(size_t)) {
-}
-
-Molecule::Molecule(size_t nodeCount, const NodeParameters &nodeParams)
-: nodes(nodeCount), leftLead(0), rightLead(0),
-  sSize(HEADER_SIZE + 4 * sizeof(size_t) + nodeCount * (6 * sizeof(double) + sizeof(size_t)))
-{
-	for (Node &node : nodes)
-		node.parameters = nodeParams;
-}
-
-void Molecule::serialize(unsigned char *buffer) const {
-	// "MMB" (MSD mol. binary) header (for safety)
-	for (size_t i = 0; i < HEADER_SIZE; i++)
-		bwrite(HEADER[i], buffer);
-	
-	// First write the edge-parameters section
-	bwrite(edgeParameters.size(), buffer);
-	for (const EdgeParameters &eParam : edgeParameters) {
-		bwrite(eParam.Jm, buffer);  // order must be correct (must match Molecule::deserialize)
-		bwrite(eParam.Je1m, buffer);
-		bwrite(eParam.Jeem, buffer);
-		bwrite(eParam.bm, buffer);
-		bwrite(eParam.Dm.x, buffer);
-		bwrite(eParam.Dm.y, buffer);
-		bwrite(eParam.Dm.z, buffer);
-	}
 
-	// Second, write the node-parameters section
-	bwrite(nodes.size(), buffer);
-	for (const Node &node : nodes) {
-		bwrite(node.parameters.Sm, buffer);  // Order must be correct (must match Molecule::deserialize)
-		bwrite(node.parameters.Fm, buffer);
-		bwrite(node.parameters.Je0m, buffer);
-		bwrite(node.parameters.Am.x, buffer);
-		bwrite(node.parameters.Am.y, buffer);
-		bwrite(node.parameters.Am.z, buffer);
-	}
-
-	// Thridly, write the adjacency section
-	for (const Node &node : nodes) {
-		bwrite(node.neighbors.size(), buffer);
-		for (const Edge &edge : node.neighbors) {
-			bwrite(edge.edgeIndex, buffer);
-			bwrite(edge.nodeIndex, buffer);
-			bwrite(edge.direction, buffer);
+FastMSD::Graph FastMSD::Graph::fromMSD(const MSD &msd) {
+	unsigned int width, height, depth, molPosL, molPosR;
+	msd.getDimensions(width, height, depth);
+	msd.getMolPos(molPosL, molPosR);
+	unsigned int topL, bottomL, frontR, backR;
+	msd.getInnerBounds(topL, bottomL, frontR, backR);
+	bool FM_L_exists, FM_R_exists, mol_exists;
+	msd.getRegions(FM_L_exists, FM_R_exists, mol_exists);
+	const MSD::Parameters p = msd.getParameters();
+	const MSD::MolProto &mol = msd.getMolProto();
+
+	// the classes: FM_L, FM_R, then each node of the molecule; L, R, mL, mR, LR, then each edge of the molecule
+	const unsigned int L = 0, R = 1, ML = 2, MR = 3, LR = 4, MOL_NODES = 2, MOL_EDGES = 5;
+	Graph g;
+	g.nodeClasses.push_back({ FM_L, p.FL, p.Je0L, p.AL });
+	g.nodeClasses.push_back({ FM_R, p.FR, p.Je0R, p.AR });
+	g.edgeClasses.push_back({ BOND_L, p.JL, p.Je1L, p.JeeL, p.bL, p.DL });
+	g.edgeClasses.push_back({ BOND_R, p.JR, p.Je1R, p.JeeR, p.bR, p.DR });
+	g.edgeClasses.push_back({ BOND_ML, p.JmL, p.Je1mL, p.JeemL, p.bmL, p.DmL });
+	g.edgeClasses.push_back({ BOND_MR, p.JmR, p.Je1mR, p.JeemR, p.bmR, p.DmR });
+	g.edgeClasses.push_back({ BOND_LR, p.JLR, p.Je1LR, p.JeeLR, p.bLR, p.DLR });
+	if (mol_exists) {
+		for (unsigned int k = 0; k < mol.nodeCount(); k++) {
+			Molecule::NodeParameters np = mol.getNodeParameters(k);
+			g.nodeClasses.push_back({ MOL, np.Fm, np.Je0m, np.Am });
+		}
+		const Molecule::EdgeIterable edges = mol.getEdges();
+		for (auto e = edges.begin(); e != edges.end(); ++e) {
+			Molecule::EdgeParameters ep = e.getParameters();
+			if (g.edgeClasses.size() <= MOL_EDGES + e.getIndex())
+				g.edgeClasses.resize(MOL_EDGES + e.getIndex() + 1);
+			g.edgeClasses[MOL_EDGES + e.getIndex()] = { BOND_M, ep.Jm, ep.Je1m, ep.Jeem, ep.bm, ep.Dm };
 		}
 	}
 
-	// Lastly write "extra stuff"
-	bwrite(leftLead, buffer);
-	bwrite(rightLead, buffer);
-}
-
-void Molecule::deserialize(const unsigned char *buffer) {
-	const unsigned char *buffer_start = buffer;
-
-	// Read "MMB" header (for saftey)
-	char header[HEADER_SIZE + 1];
-	for (size_t i = 0; i < HEADER_SIZE; i++)
-		bread(header[i], buffer);
-	header[HEADER_SIZE] = '\0';
-	
-	if (strcmp(HEADER, header) != 0)
-		throw DeserializationException((string("Missing header: ") + string(HEADER)).c_str());
-
-	// First read edges
-	size_t edgeCount;
-	bread(edgeCount, buffer);  // First the number of edges is read.
-	edgeParameters.erase(edgeParameters.begin(), edgeParameters.end());
-	edgeParameters.reserve(edgeCount);
-	for (size_t i = 0; i < edgeCount; i++) {
-		EdgeParameters eParam;
-		bread(eParam.Jm, buffer);    // Then each edge's parameters are read.
-		bread(eParam.Je1m, buffer);  // (Take careful note of the order in which the fields are stored.)
-		bread(eParam.Jeem, buffer);
-		bread(eParam.bm, buffer);
-		bread(eParam.Dm.x, buffer);
-		bread(eParam.Dm.y, buffer);
-		bread(eParam.Dm.z, buffer);
-		edgeParameters.push_back(eParam);
-	}
+	// MSD index -> node
+	const unsigned int NONE = (unsigned int) -1;
+	std::vector<unsigned int> node((size_t) width * height * depth, NONE);
+	for (MSD::Iterator i = msd.begin(); i != msd.end(); ++i) {
+		node[i.getIndex()] = (unsigned int) g.indices.size();
+		g.indices.push_back(i.getIndex());
+		g.positions.push_back(Vector(i.getX(), i.getY(), i.getZ()));
+	}
+
+	// the same bonds as MSD::setLocalM and Molecule::Instance::setLocalM
+	for (unsigned int i = 0; i < g.indices.size(); i++) {
+		const unsigned int a = g.indices[i];
+		const unsigned int x = a % width, y = a / width % height, z = a / width / height;
+		auto index = [&](unsigned int x, unsigned int y, unsigned int z) { return (z * height + y) * width + x; };
+		// adds an edge to the site at MSD index a1, if there is one. The direction is by MSD index.
+		auto connect = [&](unsigned int a1, unsigned int edgeClass) {
+			if (a1 < node.size() && node[a1] != NONE) {
+				g.neighbors.push_back(node[a1]);
+				g.edgeClass.push_back(edgeClass);
+				g.direction.push_back(a < a1 ? 1 : -1);
+			}
+		};
 
-	// Then read nodes (in two "sweeps")
-	size_t nodeCount;
-	udc::bread(nodeCount, buffer);  // Next the number of nodes is read.
-	nodes.erase(nodes.begin(), nodes.end());
-	nodes.reserve(nodeCount);
-	for (size_t i = 0; i < nodeCount; i++) {
-		Node node;
-		bread(node.parameters.Sm, buffer);  // For each node, we read its (local) parameter fields.
-		bread(node.parameters.Fm, buffer);  // (Take careful note of the order in which the fields are stored.)
-		bread(node.parameters.Je0m, buffer);
-		bread(node.parameters.Am.x, buffer);
-		bread(node.parameters.Am.y, buffer);
-		bread(node.parameters.Am.z, buffer);
-		nodes.push_back(node);
+		g.offsets.push_back((unsigned int) g.neighbors.size());
+		if (x < molPosL) {
+			g.nodeClass.push_back(L);
+			if (x != 0)
+				connect(index(x - 1, y, z), L);
+			if (y != topL)
+				connect(index(x, y - 1, z), L);
+			if (y != bottomL)
+				connect(index(x, y + 1, z), L);
+			if (z != 0)
+				connect(index(x, y, z - 1), L);
+			if (z + 1 != depth)
+				connect(index(x, y, z + 1), L);
+			if (x + 1 != width) {
+				if (x + 1 == molPosL) {
+					if (mol_exists)
+						connect(index(molPosL + mol.getLeftLead(), y, z), ML);
+					if (FM_R_exists)
+						connect(index(molPosR + 1, y, z), LR);
+				} else {
+					connect(index(x + 1, y, z), L);
+				}
+			}
+		} else if (x > molPosR) {
+			g.nodeClass.push_back(R);
+			if (x + 1 != width)
+				connect(index(x + 1, y, z), R);
+			if (y != 0)
+				connect(index(x, y - 1, z), R);
+			if (y + 1 != height)
+				connect(index(x, y + 1, z), R);
+			if (z != frontR)
+				connect(index(x, y, z - 1), R);
+			if (z != backR)
+				connect(index(x, y, z + 1), R);
+			if (x - 1 == molPosR) {
+				if (mol_exists)
+					connect(index(molPosL + mol.getRightLead(), y, z), MR);
+				if (FM_L_exists && molPosL != 0)
+					connect(index(molPosL - 1, y, z), LR);
+			} else {
+				connect(index(x - 1, y, z), R);
+			}
+		} else {
+			const unsigned int k = x - molPosL;
+			g.nodeClass.push_back(MOL_NODES + k);
+			const Molecule::EdgeIterable edges = mol.getAdjacencyList(k);
+			for (auto e = edges.begin(); e != edges.end(); ++e) {
+				g.neighbors.push_back(node[index(molPosL + e.dest(), y, z)]);
+				g.edgeClass.push_back(MOL_EDGES + e.getIndex());
+				g.direction.push_back(e.getDirection());
+			}
+			if (k == mol.getLeftLead() && FM_L_exists)
+				connect(index(molPosL - 1, y, z), ML);
+			if (k == mol.getRightLead() && FM_R_exists)
+				connect(index(molPosR + 1, y, z), MR);
+		}
 	}
-	for (size_t i = 0; i < nodeCount; i++) {
-		Node &node = nodes[i];
-		size_t neighborCount;
-		bread(neighborCount, buffer);  // ("Spweep" 2) Again for each node, get the number of neighbors this time.
-		node.neighbors.reserve(neighborCount);
-		for (size_t j = 0; j < neighborCount; j++) {
-			size_t eIndex, nIndex;
-			double direction;
-			bread(eIndex, buffer);  // Finally we read each (edge index, node index, direction) triplet for this node.
-			bread(nIndex, buffer);
-			bread(direction, buffer);
-			Edge edge(eIndex, nIndex, i, direction);
-			node.neighbors.push_back(edge);
+	g.offsets.push_back((unsigned int) g.neighbors.size());
+	return g;
+}
+
+std::vector<unsigned int> FastMSD::Graph::order(Ordering ordering) const {
+	const unsigned int n = (unsigned int) indices.size();
+	std::vector<unsigned int> order(n);
+	for (unsigned int i = 0; i < n; i++)
+		order[i] = i;
+	if (ordering == GRAPH_ORDER || n == 0)
+		return order;
+	if (positions.size() != n)
+		throw invalid_argument("FastMSD::Graph::order: the nodes have no positions");
+
+	// the grid: spacing h (the shortest bond), from the lowest corner, with at most 21 bits per axis
+	Vector low = positions[0], high = positions[0];
+	for (const Vector &p : positions) {
+		low = Vector(std::min(low.x, p.x), std::min(low.y, p.y), std::min(low.z, p.z));
+		high = Vector(std::max(high.x, p.x), std::max(high.y, p.y), std::max(high.z, p.z));
+	}
+	const double size = std::max(high.x - low.x, std::max(high.y - low.y, high.z - low.z));
+	const unsigned int MAX = (1u << 21) - 1;
+	double h = 0;
+	for (unsigned int i = 0; i < n; i++)
+		for (unsigned int e = offsets[i]; e < offsets[i + 1]; e++) {
+			const double d = positions[i].distance(positions[neighbors[e]]);
+			if (d > 0 && (h == 0 || d < h))
+				h = d;
+		}
+	if (h == 0 || size / h > MAX)
+		h = size > 0 ? size / MAX : 1;
+	unsigned int bits = 1;
+	while (bits < 21 && size / h + 0.5 >= (double) (1u << bits))
+		bits++;
+
+	std::vector<unsigned long long> key(n);
+	for (unsigned int i = 0; i < n; i++) {
+		const Vector p = (positions[i] - low) * (1 / h);
+		unsigned int x[3] = {
+			std::min(MAX, (unsigned int) (p.x + 0.5)), std::min(MAX, (unsigned int) (p.y + 0.5)), std::min(MAX, (unsigned int) (p.z + 0.5))
+		};
+		key[i] = ordering == MORTON_ORDER ? mortonKey(x, bits) : hilbertKey(x, bits);
+	}
+	std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) { return key[a] < key[b]; });
+	return order;
+}
+
+FastMSD::Graph FastMSD::Graph::permuted(const std::vector<unsigned int> &order) const {
+	const unsigned int n = (unsigned int) indices.size();
+	std::vector<unsigned int> newNode(n);
+	for (unsigned int k = 0; k < n; k++)
+		newNode[order[k]] = k;
+
+	Graph g;
+	g.nodeClasses = nodeClasses;
+	g.edgeClasses = edgeClasses;
+	for (unsigned int k = 0; k < n; k++) {
+		const unsigned int i = order[k];
+		g.indices.push_back(indices[i]);
+		g.nodeClass.push_back(nodeClass[i]);
+		if (!positions.empty())
+			g.positions.push_back(positions[i]);
+		g.offsets.push_back((unsigned int) g.neighbors.size());
+		for (unsigned int e = offsets[i]; e < offsets[i + 1]; e++) {
+			g.neighbors.push_back(newNode[neighbors[e]]);
+			g.edgeClass.push_back(edgeClass[e]);
+			g.direction.push_back(direction[e]);
 		}
 	}
-
-	// Lastly, we read the leads' positions
-	bread(leftLead, buffer);  // (Left lead first, then right lead.)
-	bread(rightLead, buffer);
-
-	sSize = buffer - buffer_start;
-}
-
-size_t Molecule::serializationSize() const {
-	return sSize;
-}
-
-istream& Molecule::read(istream &in) {
-	// get file size
-	in.seekg(0, in.end);
-	streampos size = in.tellg();
-	in.seekg(0, in.beg);
-
-	// read data into buffer
-	char *data = new char[size];
-	in.read(data, size);
-
-	// deserialize buffer
-	deserialize((unsigned char *) data);
-	delete [] data;
-
-	return in;
-}
-
-ostream& Molecule::write(ostream &out) const {
-	size_t size = serializationSize();
-	// std::cout << " -- Allocating...\n";  // DEBUG
-	unsigned char *data = new unsigned char[size];
-	// std::cout << " -- Serializing...\n";  // DEBUG
-	serialize(data);
-	// std::cout << " -- Writing...\n";  // DEBUG
-	out.write((char *) data, size);
-	delete [] data;
-	return out;
+	g.offsets.push_back((unsigned int) g.neighbors.size());
+	return g;
 }
 
-Molecule Molecule::load(istream &in) {
-	Molecule mol;
-	mol.read(in);
-	return mol;
+// the bits of x, y, and z interleaved (z-order)
+unsigned long long FastMSD::Graph::mortonKey(const unsigned int x[3], unsigned int bits) {
+	unsigned long long key = 0;
+	for (int b = bits - 1; b >= 0; b--)
+		for (unsigned int i = 0; i < 3; i++)
+			key = (key << 1) | ((x[i] >> b) & 1);
+	return key;
 }
 
-unsigned int Molecule::createNode(const NodeParameters &parameters) {
-	unsigned int index = nodes.size();
-
-	if (index >= NOT_FOUND)
-		throw out_of_range("Molecule::createNode: Can not create node because the maximum number of nodes has been reached");
-	
-	Node node(parameters);
-	nodes.push_back(node);
-
-	// SERIALIZATION_SIZE of NODE_PARAMETERS,
-	// plus 1 size_t for size of adjacency list
-	sSize += 6 * sizeof(double) + sizeof(size_t);
-
-	return index;
-}
-
-unsigned int Molecule::nodeCount() const {
-	return nodes.size();
-}
-
-unsigned int Molecule::connectNodes(unsigned int a, unsigned int b, const EdgeParameters &parameters) {
-	size_t index = edgeParameters.size();
-
-	{
-		if (index == NOT_FOUND)
-			throw out_of_range("Molecule::connectNodes: Can not create edge because the maximum number of edges has been reached");
-		
-		size_t nodeCount = nodes.size();
-		if (a >= nodeCount || b >= nodeCount)
-			throw out_of_range("Molecule::connectNodes: Invalid node index");
+// J. Skilling, "Programming the Hilbert curve", AIP Conf. Proc. 707 (2004): x is transposed
+// (in place) so that interleaving its bits, as for mortonKey, gives the distance along the curve.
+unsigned long long FastMSD::Graph::hilbertKey(unsigned int x[3], unsigned int bits) {
+	const unsigned int M = 1u << (bits - 1);
+	for (unsigned int q = M; q > 1; q >>= 1) {
+		const unsigned int p = q - 1;
+		for (unsigned int i = 0; i < 3; i++) {
+			if (x[i] & q) {
+				x[0] ^= p;  // invert
+			} else {
+				const unsigned int t = (x[0] ^ x[i]) & p;  // exchange
+				x[0] ^= t;
+				x[i] ^= t;
+			}
+		}
 	}
-
-	edgeParameters.push_back(parameters);
-
-	bool isLoop = (a == b);
-	double dir = (isLoop ? 0 : +1);
-
-	// attach edge: a -> b
-	Edge edgeA(index, b, a, dir);
-	nodes[a].neighbors.push_back(edgeA);
-
-	// 7 double's for EdgeParameters,
-	// and a triplet of (size_t, size_t, double) for the the first entree in the adjacency lists
-	sSize += 7 * sizeof(double) + 2 * sizeof(size_t) + sizeof(double);
-
-	if (!isLoop) {  // only duplicate edge if it's not a self connected edge
-		// attach edge: b -> a
-		Edge edgeB(index, a, b, -dir);
-		nodes[b].neighbors.push_back(edgeB);
-
-		// a second triplet of (size_t, size_t, double) for the second entree in the adjacency lists
-		sSize += 2 * sizeof(size_t) + sizeof(double);
+	x[1] ^= x[0];  // Gray encode
+	x[2] ^= x[1];
+	unsigned int t = 0;
+	for (unsigned int q = M; q > 1; q >>= 1)
+		if (x[2] & q)
+			t ^= q - 1;
+	for (unsigned int i = 0; i < 3; i++)
+		x[i] ^= t;
+	return mortonKey(x, bits);
+}
+
+
+FastMSD::FastMSD(const MSD &msd, Ordering ordering) : kT(msd.getParameters().kT), B(msd.getParameters().B) {
+	if (msd.getDipolarStrength() != 0)
+		throw invalid_argument("FastMSD doesn't support the dipolar field");
+	init(Graph::fromMSD(msd), ordering);
+	for (unsigned int i = 0; i < n; i++) {
+		state[2 * i] = msd.getSpin(indices[i]);
+		state[2 * i + 1] = msd.getFlux(indices[i]);
+	}
+	results = msd.getResults();
+#ifdef UDC_FLOAT_STATE
+	results = computeResults();  // (of the rounded states)
+#endif
+	flippingAlgorithm = msd.flippingAlgorithm;
+	setSeed(msd.getSeed());
+	chooseTerms(hasFlux());
+}
+
+FastMSD::FastMSD(const Graph &graph, double kT, const Vector &B, Ordering ordering) : kT(kT), B(B) {
+	init(graph, ordering);
+	setSeed(std::random_device()());
+}
+
+void FastMSD::init(const Graph &graph, Ordering ordering) {
+	if (graph.indices.size() >= (1u << 28))
+		throw invalid_argument("FastMSD: too many sites");  // (8 * i must fit in the gather instructions' int32 indices)
+	n = (unsigned int) graph.indices.size();
+	this->ordering = ordering;
+	std::vector<unsigned int> order = graph.order(ordering);
+	slot.resize(n);
+	for (unsigned int k = 0; k < n; k++)
+		slot[order[k]] = k;
+	const Graph g = ordering == GRAPH_ORDER ? graph : graph.permuted(order);
+	indices = g.indices;
+	nodeClass = g.nodeClass;
+	nodeClasses = g.nodeClasses;
+	state.assign(2 * (size_t) n, StateVector());
+
+	begin.resize(n + 1);
+	degree.resize(n);
+	nodeBond.assign(n, 0);
+	for (unsigned int i = 0; i < n; i++) {
+		begin[i] = (unsigned int) neighbors.size();
+		degree[i] = g.offsets[i + 1] - g.offsets[i];
+		if (degree[i] != 0)
+			nodeBond[i] = (unsigned char) g.edgeClasses[g.edgeClass[g.offsets[i]]].bond;
+		for (unsigned int e = g.offsets[i]; e < g.offsets[i + 1]; e++) {
+			const EdgeClass &c = g.edgeClasses[g.edgeClass[e]];
+			const double dir = g.direction[e];
+			neighbors.push_back((int32_t) g.neighbors[e]);
+			J.push_back(c.J);
+			Je1.push_back(c.Je1);
+			Jee.push_back(c.Jee);
+			b.push_back(c.b);
+			Dx.push_back(dir * c.D.x);
+			Dy.push_back(dir * c.D.y);
+			Dz.push_back(dir * c.D.z);
+			bond.push_back((unsigned char) c.bond);
+			if (c.bond != nodeBond[i])
+				nodeBond[i] = MIXED_BONDS;
+		}
+		while ((neighbors.size() - begin[i]) % PAD != 0) {
+			neighbors.push_back((int32_t) i);
+			J.push_back(0);  Je1.push_back(0);  Jee.push_back(0);  b.push_back(0);
+			Dx.push_back(0);  Dy.push_back(0);  Dz.push_back(0);
+			bond.push_back(0);
+		}
 	}
+	begin[n] = (unsigned int) neighbors.size();
 
-	return index;
-}
-
-unsigned int Molecule::edgeIndex(unsigned int a, unsigned int b) const {
-	if (a >= nodes.size() || b >= nodes.size())
-		throw out_of_range("Molecule::edgeIndex: Invalid node index");
-
-	for (const Edge &edge : nodes[a].neighbors)
-		if (edge.nodeIndex == b)
-			return edge.edgeIndex;
-	return NOT_FOUND;
+	results = Results();
+	record.clear();
+	recordSink = NULL;
+	flippingAlgorithm = MSD::CONTINUOUS_SPIN_MODEL;
+	specialized = true;
+	terms = ALL_TERMS;
+	cached = false;
+	pool = NULL;
+	windowSize = 0;
+	changedIn.assign(n, 0);
+	windowCount = 0;
+	drawnPos = 0;
+	setKernel(bestKernel());
+	chooseTerms(false);  // (every flux is ZERO)
+}
+
+void FastMSD::chooseTerms(bool flux) {
+	for (const NodeClass &c : nodeClasses)
+		flux = flux || c.F != 0;
+	unsigned int t = flux ? TERM_FLUX : 0;
+	for (const NodeClass &c : nodeClasses) {
+		if (c.A != Vector::ZERO)
+			t |= TERM_ANISOTROPY;
+		if (c.Je0 != 0 && flux)
+			t |= TERM_JE0;
+	}
+	for (size_t e = 0; e < neighbors.size(); e++) {
+		if (J[e] != 0)
+			t |= TERM_J;
+		if ((Je1[e] != 0 || Jee[e] != 0) && flux)
+			t |= TERM_JE;
+		if (b[e] != 0)
+			t |= TERM_BIQUADRATIC;
+		if (Dx[e] != 0 || Dy[e] != 0 || Dz[e] != 0)
+			t |= TERM_DMI;
+	}
+	terms = specialized ? t : (unsigned int) ALL_TERMS;
+	setKernel(kernel);
+}
+
+bool FastMSD::hasFlux() const {
+	for (unsigned int i = 0; i < n; i++)
+		if (fluxAt(i) != Vector::ZERO)
+			return true;
+	return false;
+}
+
+
+FastMSD::Kernel FastMSD::bestKernel() {
+	for (Kernel k : { AVX512, AVX2, SSE2 })
+		if (supports(k))
+			return k;
+	return SCALAR;
+}
+
+bool FastMSD::supports(Kernel kernel) {
+#ifdef UDC_FAST_MSD_X86
+	struct CPU {
+		bool sse2, avx2, avx512;
+		CPU() {
+	#ifdef _MSC_VER
+			int r[4];
+			__cpuid(r, 0);
+			const int maxLeaf = r[0];
+			__cpuid(r, 1);
+			const bool fma = (r[2] & (1 << 12)) != 0, osxsave = (r[2] & (1 << 27)) != 0;
+			sse2 = (r[3] & (1 << 26)) != 0;
+			const unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;  // which registers the OS saves
+			bool avx2Flag = false, avx512Flag = false;
+			if (maxLeaf >= 7) {
+				__cpuidex(r, 7, 0);
+				avx2Flag = (r[1] & (1 << 5)) != 0;
+				avx512Flag = (r[1] & (1 << 16)) != 0;
+			}
+			avx2 = avx2Flag && fma && (xcr0 & 0x06) == 0x06;
+			avx512 = avx512Flag && (xcr0 & 0xE6) == 0xE6;
+	#else
+			__builtin_cpu_init();
+			sse2 = __builtin_cpu_supports("sse2");
+			avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+			avx512 = __builtin_cpu_supports("avx512f");
+	#endif
+		}
+	};
+	static const CPU cpu;
+	switch (kernel) {
+		case SSE2:   return cpu.sse2;
+		case AVX2:   return cpu.avx2;
+		case AVX512: return cpu.avx512;
+		default:     break;
+	}
+#endif
+	return kernel == SCALAR;
 }
 
-Molecule::EdgeParameters Molecule::getEdgeParameters(unsigned int index) const {
-	return edgeParameters.at(index);
+const char* FastMSD::kernelName(Kernel kernel) {
+	switch (kernel) {
+		case SSE2:   return "SSE2";
+		case AVX2:   return "AVX2";
+		case AVX512: return "AVX-512";
+		default:     return "scalar";
+	}
 }
 
-void Molecule::setEdgeParameters(unsigned int index, const Molecule::EdgeParameters &p) {
-	edgeParameters.at(index) = p;
+FastMSD::Kernel FastMSD::getKernel() const {
+	return kernel;
 }
 
-Molecule::NodeParameters Molecule::getNodeParameters(unsigned int index) const {
-	return nodes.at(index).parameters;
+void FastMSD::setKernel(Kernel kernel) {
+	if (!supports(kernel))
+		throw invalid_argument(std::string("This CPU doesn't support the ") + kernelName(kernel) + " kernel");
+	this->kernel = kernel;
+	sumEdges = kernelFor(kernel, terms & EDGE_TERMS, std::make_integer_sequence<unsigned int, EDGE_TERMS + 1>());
+	sumBiquadratic = kernelFor(kernel, terms & (TERM_BIQUADRATIC | TERM_FLUX), std::make_integer_sequence<unsigned int, EDGE_TERMS + 1>());
 }
 
-void Molecule::setNodeParameters(unsigned int index, const Molecule::NodeParameters &p) {
-	nodes.at(index).parameters = p;
+template <unsigned int... TERMS>
+FastMSD::SumEdges FastMSD::kernelFor(Kernel kernel, unsigned int terms, std::integer_sequence<unsigned int, TERMS...>) {
+	static const SumEdges scalar[] = { &sumEdgesScalar<TERMS>... };
+#ifdef UDC_FAST_MSD_X86
+	static const SumEdges sse2[] = { &sumEdgesSSE2<TERMS>... };
+	static const SumEdges avx2[] = { &sumEdgesAVX2<TERMS>... };
+	static const SumEdges avx512[] = { &sumEdgesAVX512<TERMS>... };
+	switch (kernel) {
+		case SSE2:   return sse2[terms];
+		case AVX2:   return avx2[terms];
+		case AVX512: return avx512[terms];
+		default:     break;
+	}
+#endif
+	return scalar[terms];
 }
 
-void Molecule::setAllParameters(const Molecule::NodeParameters &nodeParams, const Molecule::EdgeParameters &edgeParams) {
-	for (size_t i = 0; i < edgeParameters.size(); i++)
-		edgeParameters[i] = edgeParams;
-	for (size_t i = 0; i < nodes.size(); i++)
-		nodes[i].parameters = nodeParams;
+unsigned int FastMSD::getTerms() const {
+	return terms;
 }
 
-void Molecule::setLeftLead(unsigned int node) {
-	leftLead = node;
+bool FastMSD::isSpecialized() const {
+	return specialized;
 }
 
-void Molecule::setRightLead(unsigned int node) {
-	rightLead = node;
+void FastMSD::setSpecialized(bool specialized) {
+	this->specialized = specialized;
+	chooseTerms(hasFlux());
 }
 
-void Molecule::setLeads(unsigned int left, unsigned int right) {
-	leftLead = left;
-	rightLead = right;
+bool FastMSD::hasCachedFields() const {
+	return cached;
 }
 
-unsigned int Molecule::getLeftLead() const {
-	return leftLead;
-}
+void FastMSD::setCachedFields(bool cached) {
+	this->cached = cached;
+	fields.clear();
+	fieldBegin.clear();
+	twinField.clear();
+	if (!cached)
+		return;
 
-unsigned int Molecule::getRightLead() const {
-	return rightLead;
+	// a Field for each Bond of a node's edges, or of its neighbors' edges to it
+	std::vector<unsigned char> bonds(n, 0);  // (bit mask)
+	for (unsigned int i = 0; i < n; i++)
+		for (unsigned int e = begin[i]; e < begin[i] + degree[i]; e++) {
+			bonds[i] |= 1 << bond[e];
+			bonds[neighbors[e]] |= 1 << bond[e];
+		}
+	fieldBegin.resize(n + 1);
+	for (unsigned int i = 0; i < n; i++) {
+		fieldBegin[i] = (unsigned int) fields.size();
+		for (unsigned int k = 0; k < 6; k++)
+			if (bonds[i] & (1 << k))
+				fields.push_back({ Vector::ZERO, Vector::ZERO, Vector::ZERO, k });
+	}
+	fieldBegin[n] = (unsigned int) fields.size();
+
+	twinField.assign(neighbors.size(), 0);
+	for (unsigned int i = 0; i < n; i++)
+		for (unsigned int e = begin[i]; e < begin[i] + degree[i]; e++)
+			twinField[e] = fieldIndex((unsigned int) neighbors[e], bond[e]);
+	refreshFields();
+}
+
+unsigned int FastMSD::fieldIndex(unsigned int node, unsigned int bond) const {
+	unsigned int k = fieldBegin[node];
+	while (fields[k].bond != bond)
+		k++;
+	return k;
+}
+
+void FastMSD::refreshFields() {
+	for (Field &h : fields)
+		h.hS = h.hF = h.hM = Vector::ZERO;
+	for (unsigned int i = 0; i < n; i++)
+		for (unsigned int e = begin[i]; e < begin[i] + degree[i]; e++) {
+			const unsigned int j = (unsigned int) neighbors[e];
+			const Vector ns = spinAt(j), nf = fluxAt(j);
+			Field &h = fields[fieldIndex(i, bond[e])];
+			h.hS += J[e] * ns + Je1[e] * nf;
+			h.hF += Je1[e] * ns + Jee[e] * nf;
+			h.hM += (ns + nf).crossProduct(Vector(Dx[e], Dy[e], Dz[e]));
+		}
+	flipsSinceRefresh = 0;
 }
 
-void Molecule::getLeads(unsigned int &left, unsigned int &right) const {
-	left = leftLead;
-	right = rightLead;
-}
 
-Molecule::NodeIterable Molecule::getNodes() const {
-	return Molecule::NodeIterable(*this);
+void FastMSD::setPool(WorkStealingPool *pool, unsigned int window) {
+	if (pool != NULL && window == 0)
+		throw invalid_argument("FastMSD::setPool: the window can't be empty");
+	this->pool = pool;
+	windowSize = pool != NULL ? window : 0;
+	speculated = windowSize;
+	this->window.resize(windowSize);
 }
 
-Molecule::EdgeIterable Molecule::getEdges() const {
-	return Molecule::EdgeIterable(*this);
+WorkStealingPool* FastMSD::getPool() const {
+	return pool;
 }
 
-Molecule::EdgeIterable Molecule::getAdjacencyList(unsigned int nodeIndex) const {
-	return Molecule::EdgeIterable(*this, nodeIndex);
+unsigned int FastMSD::getWindow() const {
+	return windowSize;
 }
 
-Molecule::NodeIterator::NodeIterator(const NodeIterable &nodes, unsigned int idx) : iterable(nodes), idx(idx) {
-}
 
-unsigned int Molecule::NodeIterator::getIndex() const {
-	return idx;
+FastMSD::Ordering FastMSD::getOrdering() const {
+	return ordering;
 }
 
-Molecule::NodeParameters Molecule::NodeIterator::getParameters() const {
-	return iterable.mol.getNodeParameters(getIndex());
+unsigned int FastMSD::getN() const {
+	return n;
 }
 
-Molecule::EdgeIterable Molecule::NodeIterator::getNeighbors() const {
-	return iterable.mol.getAdjacencyList(getIndex());
+unsigned int FastMSD::getIndex(unsigned int node) const {
+	return indices[slot.at(node)];
 }
 
-unsigned int Molecule::NodeIterator::operator*() const {
-	return getIndex();
+Vector FastMSD::getSpin(unsigned int node) const {
+	return spinAt(slot.at(node));
 }
 
-unsigned int Molecule::NodeIterator::operator[](int offset) const {
-	return *(*this + offset);
+Vector FastMSD::getFlux(unsigned int node) const {
+	return fluxAt(slot.at(node));
 }
 
-Molecule::NodeIterator::operator unsigned int() const {
-	return getIndex();
+Vector FastMSD::spinAt(unsigned int i) const {
+	return state[2 * (size_t) i].toVector();
 }
 
-Molecule::NodeIterator& Molecule::NodeIterator::operator++() {
-	++idx;
-	return *this;
+Vector FastMSD::fluxAt(unsigned int i) const {
+	return state[2 * (size_t) i + 1].toVector();
 }
 
-Molecule::NodeIterator Molecule::NodeIterator::operator++(int) {
-	Molecule::NodeIterator prev = *this;
-	++(*this);
-	return prev;
+Vector FastMSD::getLocalM(unsigned int node) const {
+	return getSpin(node) + getFlux(node);
 }
 
-Molecule::NodeIterator& Molecule::NodeIterator::operator--() {
-	--idx;
-	return *this;
+void FastMSD::setLocalM(unsigned int node, const Vector &spin, const Vector &flux) {
+	if (node >= n)
+		throw std::out_of_range("FastMSD::setLocalM: no such node");
+	if ((terms & TERM_FLUX) == 0 && flux != Vector::ZERO)
+		chooseTerms(true);
+	Trial t;
+	propose(t, slot[node], spin, flux);
+	trial(t);
+	commit(t);
 }
 
-Molecule::NodeIterator Molecule::NodeIterator::operator--(int) {
-	Molecule::NodeIterator prev = *this;
-	--(*this);
-	return prev;
+FastMSD::Results FastMSD::getResults() const {
+	return results;
 }
 
-Molecule::NodeIterator& Molecule::NodeIterator::operator+=(int offset) {
-	idx += offset;
-	return *this;
+FastMSD::Results FastMSD::computeResults() const {
+	Results r;
+	r.t = results.t;
+	for (unsigned int i = 0; i < n; i++) {
+		const NodeClass &c = nodeClasses[nodeClass[i]];
+		const Vector s = spinAt(i), f = fluxAt(i), m = s + f;
+		r.M += m;
+		r.MS += s;
+		r.MF += f;
+		regionM(r, c.region) += m;
+		regionMS(r, c.region) += s;
+		regionMF(r, c.region) += f;
+
+		double U = B * m + c.A.squareDot(m) + c.Je0 * (s * f);
+		r.U -= U;
+		bondU(r, c.region) -= U;  // (Region FM_L, FM_R, and MOL are BOND_L, BOND_R, and BOND_M)
+
+		for (unsigned int e = begin[i]; e < begin[i] + degree[i]; e++) {
+			const unsigned int j = (unsigned int) neighbors[e];
+			if (indices[j] <= indices[i])
+				continue;  // each bond once (and loops never)
+			const Vector ns = spinAt(j), nf = fluxAt(j), nm = ns + nf;
+			double U = J[e] * (ns * s) + Je1[e] * (nf * s + ns * f) + Jee[e] * (nf * f)
+			         + b[e] * sq(nm * m) + Vector(Dx[e], Dy[e], Dz[e]).crossDot(m, nm);
+			r.U -= U;
+			bondU(r, bond[e]) -= U;
+		}
+	}
+	return r;
 }
 
-Molecule::NodeIterator& Molecule::NodeIterator::operator-=(int offset) {
-	idx -= offset;
-	return *this;
+double FastMSD::get_kT() const {
+	return kT;
 }
 
-Molecule::NodeIterator Molecule::NodeIterator::operator+(int offset) const {
-	return Molecule::NodeIterator(iterable, idx + offset);
+void FastMSD::set_kT(double kT) {
+	this->kT = kT;
 }
 
-Molecule::NodeIterator Molecule::NodeIterator::operator-(int offset) const {
-	return Molecule::NodeIterator(iterable, idx - offset);
+Vector FastMSD::getB() const {
+	return B;
 }
 
-bool Molecule::NodeIterator::operator==(const NodeIterator &iter) const {
-	return idx == iter.idx;
+void FastMSD::setB(const Vector &B) {
+	// same as MSD::setB
+	Vector deltaB = B - this->B;
+	results.UL -= deltaB * results.ML;
+	results.UR -= deltaB * results.MR;
+	results.Um -= deltaB * results.Mm;
+	results.U = results.UL + results.UR + results.Um + results.UmL + results.UmR + results.ULR;
+	this->B = B;
 }
 
-bool Molecule::NodeIterator::operator!=(const NodeIterator &iter) const {
-	return !(*this == iter);
+void FastMSD::setSeed(unsigned long seed) {
+	this->seed = seed;
+	prng.seed(seed);
+	drawn.clear();
+	drawnPos = 0;
 }
 
-bool Molecule::NodeIterator::operator>(const NodeIterator &iter) const {
-	return idx < iter.idx;
+unsigned long FastMSD::getSeed() const {
+	return seed;
 }
 
-bool Molecule::NodeIterator::operator<(const NodeIterator &iter) const {
-	return idx > iter.idx;
-}
 
-bool Molecule::NodeIterator::operator>=(const NodeIterator &iter) const {
-	return !(*this < iter);
+void FastMSD::metropolis(unsigned long long N) {
+	if (n == 0) {
+		results.t += N;
+		return;
+	}
+	if (pool != NULL) {
+		metropolisParallel(N);
+		return;
+	}
+	function<double()> random = [this]() { return nextRandom(); };
+	Trial t;
+	for (unsigned long long i = 0; i < N; i++) {
+		propose(t, random);
+		double dU = trial(t);
+		if (dU <= 0 || random() < pow(E, -dU / kT))
+			commit(t);
+	}
+	results.t += N;
 }
 
-bool Molecule::NodeIterator::operator<=(const NodeIterator &iter) const {
-	return !(*this > iter);
+unsigned int FastMSD::drawsPerTrial() const {
+	// a node, the flip, a flux (see propose), and the accept draw
+	const std::type_info &type = flippingAlgorithm.target_type();
+	if (type == MSD::UP_DOWN_MODEL.target_type())
+		return 1 + 0 + 3 + 1;
+	if (type == MSD::CONTINUOUS_SPIN_MODEL.target_type())
+		return 1 + 2 + 3 + 1;
+	return 0;
+}
+
+void FastMSD::metropolisParallel(unsigned long long N) {
+	const unsigned int draws = drawsPerTrial();
+	size_t p;  // where random() reads from drawn
+	function<double()> random = [this, &p]() { return drawnAt(p++); };
+	unsigned long long i = 0;
+	while (i < N) {
+		// draw the window, assuming that each trial takes its accept draw
+		const unsigned int count = (unsigned int) std::min<unsigned long long>(speculated, N - i);
+		if (draws != 0) {
+			drawnAt(drawnPos + (size_t) count * draws - 1);  // (the generator is sequential)
+			for (unsigned int k = 0; k < count; k++) {
+				window[k].begin = drawnPos + (size_t) k * draws;
+				window[k].draw = window[k].begin + draws - 1;
+			}
+		} else {
+			p = drawnPos;
+			for (unsigned int k = 0; k < count; k++) {
+				Speculation &x = window[k];
+				x.begin = p;
+				propose(x.trial, random);
+				x.draw = p;
+				drawnAt(p++);
+			}
+		}
+		evaluateWindow(count, draws != 0);
+
+		// then accept or reject them in order, as the serial metropolis would
+		windowCount++;
+		bool refreshed = false;
+		unsigned int k = 0;
+		for (; k < count && window[k].begin == drawnPos; k++) {
+			Speculation &x = window[k];
+			if (refreshed || stale(x.trial.node)) {
+				if (changedIn[x.trial.node] == windowCount) {
+					p = x.begin;  // its spin changed, and so may its flip (see flippingAlgorithm)
+					propose(x.trial, random);
+					x.draw = p;
+				}
+				evaluate(x);
+			}
+			drawnPos = x.draw;
+			if (x.dU <= 0 || nextRandom() < x.p) {
+				commit(x.trial);
+				changedIn[x.trial.node] = windowCount;
+				refreshed = refreshed || (cached && flipsSinceRefresh == 0);  // (every Field changed)
+			}
+			i++;
+		}
+		speculated = std::max(1u, std::min(2 * k, windowSize));
+		drawn.erase(drawn.begin(), drawn.begin() + drawnPos);
+		drawnPos = 0;
+	}
+	results.t += N;
 }
 
-Molecule::NodeIterable::NodeIterable(const Molecule &mol)
-: mol(mol), _begin(0), _end(mol.nodeCount())
-{
-	/* empty */
+void FastMSD::evaluateWindow(unsigned int count, bool proposing) {
+	// the calling thread works too, so it doesn't wait for the pool's threads to wake up (or to finish other tasks).
+	// A late task finds nothing left to claim, so it never touches the window. Nothing is drawn here: the random
+	// numbers of the whole window already are, so drawn is only read.
+	struct Job {
+		std::atomic<unsigned int> next, done;
+	};
+	const unsigned int CHUNK = 8;
+	std::shared_ptr<Job> job(new Job());
+	job->next = job->done = 0;
+	auto work = [this, job, count, proposing]() {
+		size_t q;
+		function<double()> random = [this, &q]() { return drawn[q++]; };
+		unsigned int k;
+		while ((k = job->next.fetch_add(CHUNK)) < count) {
+			const unsigned int end = std::min(k + CHUNK, count);
+			for (unsigned int j = k; j < end; j++) {
+				if (proposing) {
+					q = window[j].begin;
+					propose(window[j].trial, random);
+				}
+				evaluate(window[j]);
+			}
+			job->done.fetch_add(end - k);
+		}
+	};
+	for (unsigned int w = 0; w < pool->size() && (w + 1) * CHUNK < count; w++)
+		pool->submit(work);
+	work();
+	while (job->done.load() < count)
+		std::this_thread::yield();
 }
 
-Molecule::NodeIterator Molecule::NodeIterable::begin() const {
-	return Molecule::NodeIterator(*this, _begin);
+void FastMSD::evaluate(Speculation &x) const {
+	x.dU = trial(x.trial);
+	x.p = x.dU > 0 ? pow(E, -x.dU / kT) : 1;
 }
 
-Molecule::NodeIterator Molecule::NodeIterable::end() const {
-	return Molecule::NodeIterator(*this, _end);
+bool FastMSD::stale(unsigned int node) const {
+	if (changedIn[node] == windowCount)
+		return true;
+	for (unsigned int e = begin[node]; e < begin[node] + degree[node]; e++)
+		if (changedIn[neighbors[e]] == windowCount)
+			return true;
+	return false;
 }
 
-unsigned int Molecule::NodeIterable::size() const {
-	return _end - _begin;
+Vector FastMSD::noFlux(const function<double()> &random) {
+	random();
+	random();
+	random();
+	return Vector::ZERO;
 }
 
-Molecule::EdgeIterator::EdgeIterator(const EdgeIterable &edges, unsigned idx) : iterable(edges), idx(idx) {
+double FastMSD::nextRandom() {
+	return drawnPos < drawn.size() ? drawn[drawnPos++] : rand(prng);
 }
 
-const Molecule::Edge& Molecule::EdgeIterator::getEdge() const {
-	return iterable.edges.at(idx);
+double FastMSD::drawnAt(size_t k) {
+	while (drawn.size() <= k)
+		drawn.push_back(rand(prng));
+	return drawn[k];
 }
 
-unsigned int Molecule::EdgeIterator::getIndex() const {
-	return getEdge().edgeIndex;
+void FastMSD::metropolis(unsigned long long N, unsigned long long freq) {
+	if (freq == 0) {
+		metropolis(N);
+		return;
+	}
+	while (true) {
+		if (recordSink == NULL)
+			record.push_back(getResults());
+		else
+			recordSink->put(getResults());
+		if (N >= freq) {
+			metropolis(freq);
+			N -= freq;
+		} else {
+			if (N != 0)
+				metropolis(N);
+			break;
+		}
+	}
 }
 
-Molecule::EdgeParameters Molecule::EdgeIterator::getParameters() const {
-	return iterable.mol.getEdgeParameters(getIndex());
-}
 
-unsigned int Molecule::EdgeIterator::src() const {
-	return getEdge().selfIndex;
+void FastMSD::propose(Trial &t, unsigned int node, Vector spin, Vector flux) const {
+	t.node = node;
+	t.spin = StateVector::round(spin);  // (the energy of the state that will be stored)
+	t.flux = StateVector::round(flux);
 }
 
-unsigned int Molecule::EdgeIterator::dest() const {
-	return getEdge().nodeIndex;
+void FastMSD::propose(Trial &t, const function<double()> &random) const {
+	// the same random numbers, in the same order, as MSD::metropolis
+	unsigned int node = slot[static_cast<unsigned int>(random() * n)];
+	Vector s = spinAt(node);
+	double F = nodeClasses[nodeClass[node]].F;
+	propose(t, node, flippingAlgorithm(s, random), (terms & TERM_FLUX) == 0 ? noFlux(random)
+			: Vector::sphericalForm(F * random(), 2 * PI * random(), asin(2 * random() - 1)));
 }
 
-double Molecule::EdgeIterator::getDirection() const {
-	return getEdge().direction;
-}
+double FastMSD::trial(Trial &t) const {
+	const unsigned int node = t.node;
+	const Vector spin = t.spin, flux = t.flux;
+	const NodeClass &c = nodeClasses[nodeClass[node]];
+	const Vector s = spinAt(node), f = fluxAt(node);
+	const Vector m = s + f, mag = spin + flux;
+	const Vector deltaS = spin - s, deltaF = flux - f, deltaM = mag - m;
 
-unsigned int Molecule::EdgeIterator::operator*() const {
-	return getIndex();
-}
+	for (double &u : t.U)
+		u = 0;
+	double u = B * deltaM;
+	if ((terms & TERM_ANISOTROPY) != 0)
+		u += c.A.squareDiffDot(mag, m);
+	if ((terms & TERM_JE0) != 0)
+		u += c.Je0 * (spin * flux - s * f);
+	t.U[c.region] = u;
 
-unsigned int Molecule::EdgeIterator::operator[](int offset) const {
-	return *(*this + offset);
-}
+	const double d[15] = {
+		deltaS.x, deltaS.y, deltaS.z,
+		deltaF.x, deltaF.y, deltaF.z,
+		deltaM.x, deltaM.y, deltaM.z,
+		m.x, m.y, m.z,
+		mag.x, mag.y, mag.z
+	};
+	if (!cached) {
+		sumEdges(*this, node, d, t.U);
+	} else {
+		for (unsigned int k = fieldBegin[node]; k < fieldBegin[node + 1]; k++) {
+			const Field &h = fields[k];
+			t.U[h.bond] += h.hS * deltaS + h.hF * deltaF + h.hM * deltaM;
+		}
+		if ((terms & TERM_BIQUADRATIC) != 0)
+			sumBiquadratic(*this, node, d, t.U);
+	}
 
-Molecule::EdgeIterator::operator unsigned int() const {
-	return getIndex();
-}
-		
-Molecule::EdgeIterator& Molecule::EdgeIterator::operator++() {
-	++idx;
-	return *this;
+	double deltaU = 0;
+	for (double u : t.U)
+		deltaU += u;
+	return -deltaU;
 }
 
-Molecule::EdgeIterator Molecule::EdgeIterator::operator++(int) {
-	Molecule::EdgeIterator prev = *this;
-	++(*this);
-	return prev;
-}
+void FastMSD::commit(const Trial &t) {
+	const unsigned int i = t.node;
+	const Region region = nodeClasses[nodeClass[i]].region;
+	const Vector s = spinAt(i), f = fluxAt(i);
+	const Vector deltaS = t.spin - s, deltaF = t.flux - f, deltaM = deltaS + deltaF;
 
-Molecule::EdgeIterator& Molecule::EdgeIterator::operator--() {
-	--idx;
-	return *this;
+	results.M += deltaM;
+	results.MS += deltaS;
+	results.MF += deltaF;
+	regionM(results, region) += deltaM;
+	regionMS(results, region) += deltaS;
+	regionMF(results, region) += deltaF;
+	for (unsigned int k = 0; k < 6; k++) {
+		results.U -= t.U[k];
+		bondU(results, k) -= t.U[k];
+	}
+
+	state[2 * (size_t) i] = t.spin;
+	state[2 * (size_t) i + 1] = t.flux;
+
+	if (cached) {
+		// the edge from each neighbor j back to i has the same coefficients, but -D: so m_i x -D is D x m_i
+		for (unsigned int e = begin[i]; e < begin[i] + degree[i]; e++) {
+			Field &h = fields[twinField[e]];
+			h.hS += J[e] * deltaS + Je1[e] * deltaF;
+			h.hF += Je1[e] * deltaS + Jee[e] * deltaF;
+			h.hM += Vector(Dx[e], Dy[e], Dz[e]).crossProduct(deltaM);
+		}
+		if (++flipsSinceRefresh >= n)
+			refreshFields();
+	}
 }
 
-Molecule::EdgeIterator Molecule::EdgeIterator::operator--(int) {
-	Molecule::EdgeIterator prev = *this;
-	--(*this);
-	return prev;
-}
 
-Molecule::EdgeIterator& Molecule::EdgeIterator::operator+=(int offset) {
-	idx += offset;
-	return *this;
+Vector& FastMSD::regionM(Results &r, Region region) {
+	return region == FM_L ? r.ML : region == FM_R ? r.MR : r.Mm;
 }
 
-Molecule::EdgeIterator& Molecule::EdgeIterator::operator-=(int offset) {
-	idx -= offset;
-	return *this;
+Vector& FastMSD::regionMS(Results &r, Region region) {
+	return region == FM_L ? r.MSL : region == FM_R ? r.MSR : r.MSm;
 }
 
-Molecule::EdgeIterator Molecule::EdgeIterator::operator+(int offset) const {
-	return Molecule::EdgeIterator(iterable, idx + offset);
+Vector& FastMSD::regionMF(Results &r, Region region) {
+	return region == FM_L ? r.MFL : region == FM_R ? r.MFR : r.MFm;
 }
 
-Molecule::EdgeIterator Molecule::EdgeIterator::operator-(int offset) const {
-	return Molecule::EdgeIterator(iterable, idx - offset);
+double& FastMSD::bondU(Results &r, unsigned int bond) {
+	switch (bond) {
+		case BOND_L:  return r.UL;
+		case BOND_R:  return r.UR;
+		case BOND_M:  return r.Um;
+		case BOND_ML: return r.UmL;
+		case BOND_MR: return r.UmR;
+		default:      return r.ULR;
+	}
 }
 
-bool Molecule::EdgeIterator::operator==(const EdgeIterator &iter) const {
-	return idx == iter.idx;
-}
 
-bool Molecule::EdgeIterator::operator!=(const EdgeIterator &iter) const {
-	return !(*this == iter);
-}
+// In each kernel, for each edge: (same as MSD::setLocalM)
+//   J (s' * deltaS) + Je1 (f' * deltaS + s' * deltaF) + Jee (f' * deltaF) + b ((m' * mag)^2 - (m' * m)^2) + D * (deltaM x m')
+// leaving out the terms that aren't in TERMS (and, without TERM_FLUX, reading only s', since f' is ZERO).
+// The SIMD kernels compute PAD / (lanes) groups of edges, and if all of the node's edges have the same Bond,
+// add up the groups in their lanes, then reduce them to one dU[bond] at the end.
 
-bool Molecule::EdgeIterator::operator>(const EdgeIterator &iter) const {
-	return idx > iter.idx;
-}
+template <unsigned int TERMS> void FastMSD::sumEdgesScalar(const FastMSD &msd, unsigned int node, const double *d, double *dU) {
+	const Vector deltaS(d[0], d[1], d[2]), deltaF(d[3], d[4], d[5]), deltaM(d[6], d[7], d[8]);
+	const Vector m(d[9], d[10], d[11]), mag(d[12], d[13], d[14]);
+	for (unsigned int e = msd.begin[node], end = e + msd.degree[node]; e < end; e++) {
+		const size_t j = (size_t) msd.neighbors[e];
+		const Vector ns = msd.state[2 * j].toVector();
+		const Vector nf = (TERMS & TERM_FLUX) != 0 ? msd.state[2 * j + 1].toVector() : Vector::ZERO;
+		const Vector nm = (TERMS & TERM_FLUX) != 0 ? ns + nf : ns;
+		double u = (TERMS & TERM_J) != 0 ? msd.J[e] * (ns * deltaS) : 0;
+		if constexpr ((TERMS & TERM_JE) != 0) {
+			u += msd.Je1[e] * (nf * deltaS + ns * deltaF);
+			u += msd.Jee[e] * (nf * deltaF);
+		}
+		if constexpr ((TERMS & TERM_BIQUADRATIC) != 0)
+			u += msd.b[e] * (sq(nm * mag) - sq(nm * m));
+		if constexpr ((TERMS & TERM_DMI) != 0)
+			u += Vector(msd.Dx[e], msd.Dy[e], msd.Dz[e]).crossDot(deltaM, nm);
+		dU[msd.bond[e]] += u;
+	}
+}
+
+#ifdef UDC_FAST_MSD_X86
+
+template <unsigned int TERMS> UDC_FAST_MSD_TARGET("sse2")
+void FastMSD::sumEdgesSSE2(const FastMSD &msd, unsigned int node, const double *d, double *dU) {
+	const __m128d dSx = _mm_set1_pd(d[0]), dSy = _mm_set1_pd(d[1]), dSz = _mm_set1_pd(d[2]);
+	const __m128d dFx = _mm_set1_pd(d[3]), dFy = _mm_set1_pd(d[4]), dFz = _mm_set1_pd(d[5]);
+	const __m128d dMx = _mm_set1_pd(d[6]), dMy = _mm_set1_pd(d[7]), dMz = _mm_set1_pd(d[8]);
+	const __m128d mx = _mm_set1_pd(d[9]), my = _mm_set1_pd(d[10]), mz = _mm_set1_pd(d[11]);
+	const __m128d magx = _mm_set1_pd(d[12]), magy = _mm_set1_pd(d[13]), magz = _mm_set1_pd(d[14]);
+	const __m128d zero = _mm_setzero_pd();
+	const Scalar *p = &msd.state[0].x;
+	const unsigned char nodeBond = msd.nodeBond[node];
+	__m128d sum = zero;  // (if nodeBond != MIXED_BONDS)
+	alignas(16) double terms[2];
+
+	for (unsigned int e = msd.begin[node], end = msd.begin[node + 1]; e < end; e += 2) {
+		const Scalar *s0 = p + 8 * msd.neighbors[e], *s1 = p + 8 * msd.neighbors[e + 1];  // (and the flux at + 4)
+		const __m128d nsx = _mm_set_pd(s1[0], s0[0]), nsy = _mm_set_pd(s1[1], s0[1]), nsz = _mm_set_pd(s1[2], s0[2]);
+		__m128d nfx = zero, nfy = zero, nfz = zero, nmx = nsx, nmy = nsy, nmz = nsz;
+		if constexpr ((TERMS & TERM_FLUX) != 0) {
+			nfx = _mm_set_pd(s1[4], s0[4]), nfy = _mm_set_pd(s1[5], s0[5]), nfz = _mm_set_pd(s1[6], s0[6]);
+			nmx = _mm_add_pd(nsx, nfx), nmy = _mm_add_pd(nsy, nfy), nmz = _mm_add_pd(nsz, nfz);
+		}
 
-bool Molecule::EdgeIterator::operator<(const EdgeIterator &iter) const {
-	return idx < iter.idx;
-}
+		#define UDC_DOT(ax, ay, az, bx, by, bz) \
+			_mm_add_pd(_mm_add_pd(_mm_mul_pd(ax, bx), _mm_mul_pd(ay, by)), _mm_mul_pd(az, bz))
+		__m128d t = zero;
+		if constexpr ((TERMS & TERM_J) != 0)
+			t = _mm_mul_pd(_mm_loadu_pd(&msd.J[e]), UDC_DOT(nsx, nsy, nsz, dSx, dSy, dSz));
+		if constexpr ((TERMS & TERM_JE) != 0) {
+			const __m128d fdS = UDC_DOT(nfx, nfy, nfz, dSx, dSy, dSz);
+			const __m128d sdF = UDC_DOT(nsx, nsy, nsz, dFx, dFy, dFz);
+			const __m128d fdF = UDC_DOT(nfx, nfy, nfz, dFx, dFy, dFz);
+			t = _mm_add_pd(t, _mm_mul_pd(_mm_loadu_pd(&msd.Je1[e]), _mm_add_pd(fdS, sdF)));
+			t = _mm_add_pd(t, _mm_mul_pd(_mm_loadu_pd(&msd.Jee[e]), fdF));
+		}
+		if constexpr ((TERMS & TERM_BIQUADRATIC) != 0) {
+			const __m128d mMag = UDC_DOT(nmx, nmy, nmz, magx, magy, magz);
+			const __m128d mM = UDC_DOT(nmx, nmy, nmz, mx, my, mz);
+			t = _mm_add_pd(t, _mm_mul_pd(_mm_loadu_pd(&msd.b[e]), _mm_sub_pd(_mm_mul_pd(mMag, mMag), _mm_mul_pd(mM, mM))));
+		}
+		if constexpr ((TERMS & TERM_DMI) != 0) {
+			const __m128d cx = _mm_sub_pd(_mm_mul_pd(dMy, nmz), _mm_mul_pd(dMz, nmy));
+			const __m128d cy = _mm_sub_pd(_mm_mul_pd(dMz, nmx), _mm_mul_pd(dMx, nmz));
+			const __m128d cz = _mm_sub_pd(_mm_mul_pd(dMx, nmy), _mm_mul_pd(dMy, nmx));
+			t = _mm_add_pd(t, UDC_DOT(_mm_loadu_pd(&msd.Dx[e]), _mm_loadu_pd(&msd.Dy[e]), _mm_loadu_pd(&msd.Dz[e]), cx, cy, cz));
+		}
+		#undef UDC_DOT
 
-bool Molecule::EdgeIterator::operator>=(const EdgeIterator &iter) const {
-	return !(*this < iter);
-}
+		if (nodeBond != MIXED_BONDS) {
+			sum = _mm_add_pd(sum, t);
+		} else {
+			_mm_store_pd(terms, t);
+			dU[msd.bond[e]] += terms[0];
+			dU[msd.bond[e + 1]] += terms[1];
+		}
+	}
+	if (nodeBond != MIXED_BONDS)
+		dU[nodeBond] += _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+}
+
+template <unsigned int TERMS> UDC_FAST_MSD_TARGET("avx2,fma")
+void FastMSD::sumEdgesAVX2(const FastMSD &msd, unsigned int node, const double *d, double *dU) {
+	const __m256d dSx = _mm256_set1_pd(d[0]), dSy = _mm256_set1_pd(d[1]), dSz = _mm256_set1_pd(d[2]);
+	const __m256d dFx = _mm256_set1_pd(d[3]), dFy = _mm256_set1_pd(d[4]), dFz = _mm256_set1_pd(d[5]);
+	const __m256d dMx = _mm256_set1_pd(d[6]), dMy = _mm256_set1_pd(d[7]), dMz = _mm256_set1_pd(d[8]);
+	const __m256d mx = _mm256_set1_pd(d[9]), my = _mm256_set1_pd(d[10]), mz = _mm256_set1_pd(d[11]);
+	const __m256d magx = _mm256_set1_pd(d[12]), magy = _mm256_set1_pd(d[13]), magz = _mm256_set1_pd(d[14]);
+	const __m256d zero = _mm256_setzero_pd();
+	const Scalar *p = &msd.state[0].x;
+	const unsigned char nodeBond = msd.nodeBond[node];
+	__m256d sum = zero;  // (if nodeBond != MIXED_BONDS)
+	alignas(32) double terms[4];
+
+	for (unsigned int e = msd.begin[node], end = msd.begin[node + 1]; e < end; e += 4) {
+		const __m128i j = _mm_slli_epi32(_mm_loadu_si128((const __m128i *) &msd.neighbors[e]), 3);  // 8 * neighbor
+		const __m256d nsx = gather4(p, j), nsy = gather4(p + 1, j), nsz = gather4(p + 2, j);
+		__m256d nfx = zero, nfy = zero, nfz = zero, nmx = nsx, nmy = nsy, nmz = nsz;
+		if constexpr ((TERMS & TERM_FLUX) != 0) {
+			nfx = gather4(p + 4, j), nfy = gather4(p + 5, j), nfz = gather4(p + 6, j);
+			nmx = _mm256_add_pd(nsx, nfx), nmy = _mm256_add_pd(nsy, nfy), nmz = _mm256_add_pd(nsz, nfz);
+		}
 
-bool Molecule::EdgeIterator::operator<=(const EdgeIterator &iter) const {
-	return !(*this > iter);
-}
+		#define UDC_DOT(ax, ay, az, bx, by, bz) \
+			_mm256_fmadd_pd(az, bz, _mm256_fmadd_pd(ay, by, _mm256_mul_pd(ax, bx)))
+		__m256d t = zero;
+		if constexpr ((TERMS & TERM_DMI) != 0) {
+			const __m256d cx = _mm256_fmsub_pd(dMy, nmz, _mm256_mul_pd(dMz, nmy));
+			const __m256d cy = _mm256_fmsub_pd(dMz, nmx, _mm256_mul_pd(dMx, nmz));
+			const __m256d cz = _mm256_fmsub_pd(dMx, nmy, _mm256_mul_pd(dMy, nmx));
+			t = UDC_DOT(_mm256_loadu_pd(&msd.Dx[e]), _mm256_loadu_pd(&msd.Dy[e]), _mm256_loadu_pd(&msd.Dz[e]), cx, cy, cz);
+		}
+		if constexpr ((TERMS & TERM_J) != 0)
+			t = _mm256_fmadd_pd(_mm256_loadu_pd(&msd.J[e]), UDC_DOT(nsx, nsy, nsz, dSx, dSy, dSz), t);
+		if constexpr ((TERMS & TERM_JE) != 0) {
+			const __m256d fdS = UDC_DOT(nfx, nfy, nfz, dSx, dSy, dSz);
+			const __m256d sdF = UDC_DOT(nsx, nsy, nsz, dFx, dFy, dFz);
+			const __m256d fdF = UDC_DOT(nfx, nfy, nfz, dFx, dFy, dFz);
+			t = _mm256_fmadd_pd(_mm256_loadu_pd(&msd.Je1[e]), _mm256_add_pd(fdS, sdF), t);
+			t = _mm256_fmadd_pd(_mm256_loadu_pd(&msd.Jee[e]), fdF, t);
+		}
+		if constexpr ((TERMS & TERM_BIQUADRATIC) != 0) {
+			const __m256d mMag = UDC_DOT(nmx, nmy, nmz, magx, magy, magz);
+			const __m256d mM = UDC_DOT(nmx, nmy, nmz, mx, my, mz);
+			t = _mm256_fmadd_pd(_mm256_loadu_pd(&msd.b[e]), _mm256_fmsub_pd(mMag, mMag, _mm256_mul_pd(mM, mM)), t);
+		}
+		#undef UDC_DOT
 
-Molecule::EdgeIterable::EdgeIterable(const Molecule &mol) : mol(mol) {
-	int sum = 0;
-	for (unsigned int node : mol.getNodes())
-		sum += mol.nodes.at(node).neighbors.size();
-	edges.reserve(sum);
-	for (unsigned int node : mol.getNodes()) {
-		auto neighbors = mol.nodes.at(node).neighbors;
-		edges.insert(edges.end(), neighbors.begin(), neighbors.end());
+		if (nodeBond != MIXED_BONDS) {
+			sum = _mm256_add_pd(sum, t);
+		} else {
+			_mm256_store_pd(terms, t);
+			for (unsigned int l = 0; l < 4; l++)
+				dU[msd.bond[e + l]] += terms[l];
+		}
 	}
-}
+	if (nodeBond != MIXED_BONDS) {
+		const __m128d h = _mm_add_pd(_mm256_castpd256_pd128(sum), _mm256_extractf128_pd(sum, 1));
+		dU[nodeBond] += _mm_cvtsd_f64(_mm_add_sd(h, _mm_unpackhi_pd(h, h)));
+	}
+}
+
+template <unsigned int TERMS> UDC_FAST_MSD_TARGET("avx512f")
+void FastMSD::sumEdgesAVX512(const FastMSD &msd, unsigned int node, const double *d, double *dU) {
+	const __m512d dSx = _mm512_set1_pd(d[0]), dSy = _mm512_set1_pd(d[1]), dSz = _mm512_set1_pd(d[2]);
+	const __m512d dFx = _mm512_set1_pd(d[3]), dFy = _mm512_set1_pd(d[4]), dFz = _mm512_set1_pd(d[5]);
+	const __m512d dMx = _mm512_set1_pd(d[6]), dMy = _mm512_set1_pd(d[7]), dMz = _mm512_set1_pd(d[8]);
+	const __m512d mx = _mm512_set1_pd(d[9]), my = _mm512_set1_pd(d[10]), mz = _mm512_set1_pd(d[11]);
+	const __m512d magx = _mm512_set1_pd(d[12]), magy = _mm512_set1_pd(d[13]), magz = _mm512_set1_pd(d[14]);
+	const __m512d zero = _mm512_setzero_pd();
+	const Scalar *p = &msd.state[0].x;
+	const unsigned char nodeBond = msd.nodeBond[node];
+	__m512d sum = zero;  // (if nodeBond != MIXED_BONDS)
+	alignas(64) double terms[8];
+
+	for (unsigned int e = msd.begin[node], end = msd.begin[node + 1]; e < end; e += 8) {
+		const __m256i j = _mm256_slli_epi32(_mm256_loadu_si256((const __m256i *) &msd.neighbors[e]), 3);  // 8 * neighbor
+		const __m512d nsx = gather8(p, j), nsy = gather8(p + 1, j), nsz = gather8(p + 2, j);
+		__m512d nfx = zero, nfy = zero, nfz = zero, nmx = nsx, nmy = nsy, nmz = nsz;
+		if constexpr ((TERMS & TERM_FLUX) != 0) {
+			nfx = gather8(p + 4, j), nfy = gather8(p + 5, j), nfz = gather8(p + 6, j);
+			nmx = _mm512_add_pd(nsx, nfx), nmy = _mm512_add_pd(nsy, nfy), nmz = _mm512_add_pd(nsz, nfz);
+		}
 
-Molecule::EdgeIterable::EdgeIterable(const Molecule &mol, unsigned int node) :mol(mol) {
-	edges = mol.nodes.at(node).neighbors;
-}
+		#define UDC_DOT(ax, ay, az, bx, by, bz) \
+			_mm512_fmadd_pd(az, bz, _mm512_fmadd_pd(ay, by, _mm512_mul_pd(ax, bx)))
+		__m512d t = zero;
+		if constexpr ((TERMS & TERM_DMI) != 0) {
+			const __m512d cx = _mm512_fmsub_pd(dMy, nmz, _mm512_mul_pd(dMz, nmy));
+			const __m512d cy = _mm512_fmsub_pd(dMz, nmx, _mm512_mul_pd(dMx, nmz));
+			const __m512d cz = _mm512_fmsub_pd(dMx, nmy, _mm512_mul_pd(dMy, nmx));
+			t = UDC_DOT(_mm512_loadu_pd(&msd.Dx[e]), _mm512_loadu_pd(&msd.Dy[e]), _mm512_loadu_pd(&msd.Dz[e]), cx, cy, cz);
+		}
+		if constexpr ((TERMS & TERM_J) != 0)
+			t = _mm512_fmadd_pd(_mm512_loadu_pd(&msd.J[e]), UDC_DOT(nsx, nsy, nsz, dSx, dSy, dSz), t);
+		if constexpr ((TERMS & TERM_JE) != 0) {
+			const __m512d fdS = UDC_DOT(nfx, nfy, nfz, dSx, dSy, dSz);
+			const __m512d sdF = UDC_DOT(nsx, nsy, nsz, dFx, dFy, dFz);
+			const __m512d fdF = UDC_DOT(nfx, nfy, nfz, dFx, dFy, dFz);
+			t = _mm512_fmadd_pd(_mm512_loadu_pd(&msd.Je1[e]), _mm512_add_pd(fdS, sdF), t);
+			t = _mm512_fmadd_pd(_mm512_loadu_pd(&msd.Jee[e]), fdF, t);
+		}
+		if constexpr ((TERMS & TERM_BIQUADRATIC) != 0) {
+			const __m512d mMag = UDC_DOT(nmx, nmy, nmz, magx, magy, magz);
+			const __m512d mM = UDC_DOT(nmx, nmy, nmz, mx, my, mz);
+			t = _mm512_fmadd_pd(_mm512_loadu_pd(&msd.b[e]), _mm512_fmsub_pd(mMag, mMag, _mm512_mul_pd(mM, mM)), t);
+		}
+		#undef UDC_DOT
 
-Molecule::EdgeIterator Molecule::EdgeIterable::begin() const {
-	return Molecule::EdgeIterator(*this, 0);
+		if (nodeBond != MIXED_BONDS) {
+			sum = _mm512_add_pd(sum, t);
+		} else {
+			_mm512_store_pd(terms, t);
+			for (unsigned int l = 0; l < 8; l++)
+				dU[msd.bond[e + l]] += terms[l];
+		}
+	}
+	if (nodeBond != MIXED_BONDS)
+		dU[nodeBond] += _mm512_reduce_add_pd(sum);
 }
 
-Molecule::EdgeIterator Molecule::EdgeIterable::end() const {
-	return Molecule::EdgeIterator(*this, edges.size());
+UDC_FAST_MSD_TARGET("avx2,fma") __m256d FastMSD::gather4(const double *p, __m128i j) {
+	return _mm256_i32gather_pd(p, j, 8);
 }
 
-unsigned int Molecule::EdgeIterable::size() const {
-	return edges.size();
+UDC_FAST_MSD_TARGET("avx2,fma") __m256d FastMSD::gather4(const float *p, __m128i j) {
+	return _mm256_cvtps_pd(_mm_i32gather_ps(p, j, 4));
 }
 
-Molecule::Instance::Instance(const Molecule &prototype, MSD &msd, unsigned int y, unsigned int z,
-		const Vector &initSpin, const Vector &initFlux)
-: prototype(prototype), msd(msd), y(y), z(z)
-{
-	const size_t N = prototype.nodes.size();
-
-	Vector s = initSpin;
-	s.normalize();
-	spins.reserve(N);
-	for (size_t i = 0; i < N; i++)
-		spins.push_back(s * prototype.nodes[i].parameters.Sm);
-	
-	if (initFlux == Vector::ZERO) {
-		fluxes.assign(N, Vector::ZERO);
-	} else {
-		Vector f = initFlux;
-		f.normalize();
-		fluxes.reserve(N);
-		for (size_t i = 0; i < N; i++) {
-			const double Fm = prototype.nodes[i].parameters.Fm;
-			fluxes.push_back(initFlux.normSq() <= sq(Fm) ? initFlux : f * Fm);
-		}
-	}
+UDC_FAST_MSD_TARGET("avx512f") __m512d FastMSD::gather8(const double *p, __m256i j) {
+	return _mm512_i32gather_pd(j, p, 8);
 }
 
-Molecule::Instance::Instance(const Instance &other)
-: prototype(other.prototype), msd(other.msd), y(y), z(z), spins(other.spins), fluxes(other.fluxes)
-{}
-
-Molecule::Instance& Molecule::Instance::operator=(const Molecule::Instance &other) {
-	this->spins = other.spins;
-	this->fluxes = other.fluxes;
-	return *this;
-}
-
-void Molecule::Instance::setLocalM(unsigned int a, const Vector &spin, const Vector &flux) {
-	Vector &s = spins.at(a);   // previous spin
-	Vector &f = fluxes.at(a);  // previous flux
-
-	Vector m = s + f;          // previous local mag.
-	Vector mag = spin + flux;  // new local mag.
-
-	Vector deltaS = spin - s;
-	Vector deltaF = flux - f;
-	Vector deltaM = mag - m;
-
-	const Node &node = prototype.nodes[a];
-	const MSD::Parameters &msdParams = msd.parameters;
-	const NodeParameters &nodeParams = node.parameters;
-
-	MSD::Results &results = msd.results;
-
-	// ---- update magnetization, M ----
-	results.M += deltaM;
-	results.MS += deltaS;
-	results.MF += deltaF;
-
-	results.Mm += deltaM;
-	results.MSm += deltaS;
-	results.MFm += deltaF;
-
-	// ---- update energy, U ----
-	// local energy
-	{	double deltaU = msdParams.B * deltaM
-		              + nodeParams.Am * ( Vector(sq(mag.x), sq(mag.y), sq(mag.z)) - Vector(sq(m.x), sq(m.y), sq(m.z)) )
-		              + nodeParams.Je0m * ( spin * flux - s * f );
-		results.U -= deltaU;
-		results.Um -= deltaU;
-	}
-
-	// energy from edges (i.e. bonds)
-	for (const Edge &edge : node.neighbors) {
-		unsigned int a1 = edge.nodeIndex;  // index of neighbor
-		Vector neighbor_s = spins[a1];
-		Vector neighbor_f = fluxes[a1];
-		Vector neighbor_m = neighbor_s + neighbor_f;
-		const EdgeParameters &edgeParams = prototype.edgeParameters[edge.edgeIndex];
-		double deltaU = edgeParams.Jm * ( neighbor_s * deltaS )
-		              + edgeParams.Je1m * ( neighbor_f * deltaS + neighbor_s * deltaF )
-		              + edgeParams.Jeem * ( neighbor_f * deltaF )
-		              + edgeParams.bm * ( sq(neighbor_m * mag) - sq(neighbor_m * m) )
-		              + edgeParams.Dm * (edge.direction * deltaM.crossProduct(neighbor_m));  // uses edge.direction to solve anti-communative property of crossProduct
-		results.U -= deltaU;
-		results.Um -= deltaU;
-	}
-
-	// energy from leads
-	if (msd.mol_exists) {
-		const auto &msdSpins = msd.spins;
-		const auto &msdFluxes = msd.fluxes;
-
-		// left lead
-		if (a == prototype.leftLead && msd.FM_L_exists) {
-			unsigned int a1 = msd.index(msd.molPosL - 1, y, z);
-			Vector neighbor_s = msdSpins[a1];
-			Vector neighbor_f = msdFluxes[a1];
-			Vector neighbor_m = neighbor_s + neighbor_f;
-			double deltaU = msdParams.JmL * ( neighbor_s * deltaS )
-			              + msdParams.Je1mL * ( neighbor_f * deltaS + neighbor_s * deltaF )
-			              + msdParams.JeemL * ( neighbor_f * deltaF )
-			              + msdParams.bmL * ( sq(neighbor_m * mag) - sq(neighbor_m * m) )
-			              + msdParams.DmL * neighbor_m.crossProduct(deltaM);  // pos(neighbor_m) < pos(deltaM)
-			results.U -= deltaU;
-			results.UmL -= deltaU;
-		}
-
-		// right lead
-		if (a == prototype.rightLead && msd.FM_R_exists) {
-			unsigned int a1 = msd.index(msd.molPosR + 1, y, z);
-			Vector neighbor_s = msdSpins[a1];
-			Vector neighbor_f = msdFluxes[a1];
-			Vector neighbor_m = neighbor_s + neighbor_f;
-			double deltaU = msdParams.JmR * ( neighbor_s * deltaS )
-			              + msdParams.Je1mR * ( neighbor_f * deltaS + neighbor_s * deltaF )
-			              + msdParams.JeemR * ( neighbor_f * deltaF )
-			              + msdParams.bmR * ( sq(neighbor_m * mag) - sq(neighbor_m * m) )
-			              + msdParams.DmR * deltaM.crossProduct(neighbor_m);  // pos(deltaM) < pos(neighbor_m)
-			results.U -= deltaU;
-			results.UmR -= deltaU;
-		}
-	}
-
-	// ---- Done: update spin and flux values ----
-	s = spin;
-	f = flux;
-}
-
-void Molecule::Instance::setSpin(unsigned int a, const Vector &spin) {
-	setLocalM(a, spin, getFlux(a));
-}
-
-void Molecule::Instance::setFlux(unsigned int a, const Vector &flux) {
-	setLocalM(a, getSpin(a), flux);
-}
-
-Vector Molecule::Instance::getSpin(unsigned int a) const {
-	return spins.at(a);
-}
-
-Vector Molecule::Instance::getFlux(unsigned int a) const {
-	return fluxes.at(a);
-}
-
-void Molecule::Instance::getLocalM(unsigned int a, Vector &spin, Vector &flux) const {
-	spin = spins.at(a);
-	flux = fluxes.at(a);
-}
-
-Molecule::Instance Molecule::instantiate(MSD &msd, unsigned int y, unsigned int z) const {
-	return Instance(*this, msd, y, z);
-}
-
-
-MSD::Parameters::Parameters()
-: kT(0.25), B(Vector::ZERO),
-  SL(1), SR(1), FL(0), FR(0),
-  JL(1), JR(1), JmL(1), JmR(-1), JLR(0),
-  Je0L(0), Je0R(0),
-  Je1L(0), Je1R(0), Je1mL(0), Je1mR(0), Je1LR(0),
-  JeeL(0), JeeR(0), JeemL(0), JeemR(0), JeeLR(0),
-  bL(0), bR(0), bmL(0), bmR(0), bLR(0),
-  AL(Vector::ZERO), AR(Vector::ZERO),
-  DL(Vector::ZERO), DR(Vector::ZERO), DmL(Vector::ZERO), DmR(Vector::ZERO), DLR(Vector::ZERO) {
-}
-
-bool MSD::Parameters::operator==(const Parameters &p) const {
-	return  kT == p.kT
-		&&  B  == p.B
-
-	    &&  SL    == p.SL    &&  SR    == p.SR
-	    &&  FL    == p.FL    &&  FR    == p.FR
-	    &&  JL    == p.JL    &&  JR    == p.JR    &&  JmL   == p.JmL    &&  JmR  == p.JmR     &&  JLR   == p.JLR
-		&&  Je0L  == p.Je0L  &&  Je0R  == p.Je0R
-		&&  Je1L  == p.Je1L  &&  Je1R  == p.Je1R  &&  Je1mL == p.Je1mL  &&  Je1mR == p.Je1mR  &&  Je1LR == p.Je1LR
-		&&  JeeL  == p.JeeL  &&  JeeR  == p.JeeR  &&  JeemL == p.JeemL  &&  JeemR == p.JeemR  &&  JeeLR == p.JeeLR
-	    &&  bL    == p.bL    &&  bR    == p.bR    &&  bmL   == p.bmL    &&  bmR   == p.bmR    &&  bLR   == p.bLR
-	    &&  AL    == p.AL    &&  AR    == p.AR
-	    &&  DL    == p.DL    &&  DR    == p.DR    &&  DmL   == p.DmL    &&  DmR   == p.DmR    &&  DLR   == p.DLR;
-}
-
-bool MSD::Parameters::operator!=(const Parameters &p) const {
-	return !(*this == p);
-}
-
-
-MSD::Results::Results()
-: t(0), M(Vector::ZERO), ML(Vector::ZERO), MR(Vector::ZERO), Mm(Vector::ZERO),
-  MS(Vector::ZERO), MSL(Vector::ZERO), MSR(Vector::ZERO), MSm(Vector::ZERO),
-  MF(Vector::ZERO), MFL(Vector::ZERO), MFR(Vector::ZERO), MFm(Vector::ZERO),
-  U(0), UL(0), UR(0), Um(0), UmL(0), UmR(0), ULR(0) {
-}
-
-bool MSD::Results::operator==(const Results &r) const {
-	return t == r.t
-
-	    &&  M   == r.M    &&  ML  == r.ML   &&  MR  == r.MR   &&  Mm  == r.Mm
-		&&  MS  == r.MS   &&  MSL == r.MSL  &&  MSR == r.MSR  &&  MSm == r.MSm
-		&&  MF  == r.MF   &&  MFL == r.MFL  &&  MFR == r.MFR  &&  MFm == r.MFm
-	    &&  U   == r.U    &&  UL  == r.UL   &&  UR  == r.UR   &&  Um  == r.Um  &&  UmL == r.UmL  &&  UmR == r.UmR  &&  ULR == r.ULR;
-}
-
-bool MSD::Results::operator!=(const Results &r) const {
-	return !(*this == r);
-}
-
-
-MSD::Iterator::Iterator(const MSD &msd, unsigned int i) : msd(msd), i(i) {
-}
-
-unsigned int MSD::Iterator::getIndex() const {
-	return msd.indices.at(i);
-}
-
-unsigned int MSD::Iterator::getX() const {
-	return msd.x( getIndex() );
-}
-
-unsigned int MSD::Iterator::getY() const {
-	return msd.y( getIndex() );
-}
-
-unsigned int MSD::Iterator::getZ() const {
-	return msd.z( getIndex() );
-}
-
-Vector MSD::Iterator::getSpin() const {
-	return msd.getSpin( this->getIndex() );
-}
-
-Vector MSD::Iterator::getFlux() const {
-	return msd.getFlux( this->getIndex() );
-}
-
-Vector MSD::Iterator::getLocalM() const {
-	return msd.getLocalM( this->getIndex() );
-}
-
-Vector MSD::Iterator::operator*() const {
-	return getLocalM();
-}
-
-Vector MSD::Iterator::operator[](int n) const {
-	return *(*this + n);
-}
-
-MSD::Iterator::operator unsigned int() const {
-	return getIndex();
-}
-
-MSD::Iterator& MSD::Iterator::operator++() {
-	if (i >= msd.indices.size())
-		throw out_of_range("can't increment MSD::Iterator == msd.end()");
-	++i;
-	return *this;
-}
-
-MSD::Iterator MSD::Iterator::operator++(int) {
-	Iterator prev = *this;
-	++(*this);
-	return prev;
-}
-
-MSD::Iterator& MSD::Iterator::operator--() {
-	if (i <= 0)
-		throw out_of_range("can't decrement MSD::Iterator == msd.begin()");
-	--i;
-	return *this;
-}
-
-MSD::Iterator MSD::Iterator::operator--(int) {
-	Iterator prev = *this;
-	--(*this);
-	return prev;
-}
-
-MSD::Iterator& MSD::Iterator::operator+=(int n) {
-	if( n < 0 )
-		return *this -= -n;
-	
-	unsigned int sum = i + n; 
-	if (sum > msd.indices.size())
-		throw out_of_range("can't increment past msd.end()");
-	i = sum;
-	return *this;
-}
-
-MSD::Iterator& MSD::Iterator::operator-=(int n) {
-	if( n < 0 )
-		return *this += -n;
-	
-	if (n > i)
-		throw out_of_range("can't decrement past msd.begin()");
-	i -= n;
-	return *this;
-}
-
-MSD::Iterator MSD::Iterator::operator+(int n) const {
-	Iterator iter = *this;
-	iter += n;
-	return iter;
-}
-
-MSD::Iterator MSD::Iterator::operator-(int n) const {
-	Iterator iter = *this;
-	iter -= n;
-	return iter;
-}
-
-bool MSD::Iterator::operator==(const Iterator &iter) const {
-	if( &msd != &iter.msd )
-		throw invalid_argument("must compare two iterators from the same MSD");
-	return i == iter.i;
-}
-
-bool MSD::Iterator::operator!=(const Iterator &iter) const {
-	return !(*this == iter);
-}
-
-bool MSD::Iterator::operator>(const Iterator &iter) const {
-	if( &msd != &iter.msd )
-		throw invalid_argument("must compare two iterators from the same MSD");
-	return i > iter.i;
-}
-
-bool MSD::Iterator::operator<(const Iterator &iter) const {
-	if( &msd != &iter.msd )
-		throw invalid_argument("must compare two iterators from the same MSD");
-	return i < iter.i;
-}
-
-bool MSD::Iterator::operator>=(const Iterator &iter) const {
-	return !(*this < iter);
-}
-
-bool MSD::Iterator::operator<=(const Iterator &iter) const {
-	return !(*this > iter);
-}
-
-
-const MSD::FlippingAlgorithm MSD::UP_DOWN_MODEL = [](const Vector &spin, function<double()> rand) {
-	return -spin;
-};
-
-const MSD::FlippingAlgorithm MSD::CONTINUOUS_SPIN_MODEL = [](const Vector &spin, function<double()> rand) {
-	return Vector::sphericalForm( spin.norm(), 2 * PI * rand(), asin(2 * rand() - 1) );
-};
-
-const MSD::MolProtoFactory MSD::LINEAR_MOL = [](unsigned int nodeCount) {
-	MolProto mol(nodeCount);
-	for (unsigned int i = 1; i < nodeCount; i++)
-		mol.connectNodes(i - 1, i);
-	mol.setLeads(0, nodeCount - 1);
-	return mol;
-};
-
-const MSD::MolProtoFactory MSD::CIRCULAR_MOL = [](unsigned int nodeCount) {
-	MolProto mol(nodeCount);
-	for (unsigned int i = 1; i < nodeCount; i++)
-		mol.connectNodes(i - 1, i);
-	if (nodeCount >= 2)
-		mol.connectNodes(nodeCount - 1, 0);
-	mol.setLeads(0, nodeCount / 2);
-	return mol;
-};
-
-
-Vector MSD::initSpin = Vector::J;
-Vector MSD::initFlux = Vector::ZERO;
-
-
-unsigned int MSD::index(unsigned int x, unsigned int y, unsigned int z) const {
-	return (z * height + y) * width + x;
-}
-
-unsigned int MSD::x(unsigned int a) const {
-	return a % width;
-}
-
-unsigned int MSD::y(unsigned int a) const {
-	return a % (width * height) / width;
-}
-
-unsigned int MSD::z(unsigned int a) const {
-	return a / (width * height);
-}
-
-
-unsigned long MSD::genSeed() {
-	return (  static_cast<unsigned long>(time(NULL))      << 16 )
-	     | ( (static_cast<unsigned long>(clock()) & 0xFF) << 8  )
-	     | ( (static_cast<unsigned long>(seed_count++) & 0xFF) );
-}
-
-
-// Note: "molProtoFactory" is a pointer so that it can be NULL
-void MSD::init(const MolProtoFactory *molProtoFactory) {
-	// preconditions:
-	if (width == 0)         width = 1;
-	if (height == 0)        height = 1;
-	if (depth == 0)         depth = 1;
-	if (molPosR >= width)   molPosR = width - 1;
-	if (molPosL > width)    molPosL = width;
-	if (molPosR < molPosL)  molPosR = molPosL - 1;
-	if (bottomL >= height)  bottomL = height - 1;
-	if (topL > height)      topL = height;
-	if (bottomL < topL)     topL = bottomL - 1;
-	if (backR >= depth)     backR = depth - 1;
-	if (frontR > depth)     frontR = depth;
-	if (backR < frontR)     backR = frontR - 1;
-
-	spins.resize(width * height * depth);
-	fluxes.resize(width * height * depth);
-
-	FM_L_exists = (molPosL != 0);
-	FM_R_exists = (molPosR + 1 < width);
-	mol_exists = (molPosL <= molPosR);
-
-	if (mol_exists) {
-		mols.resize(width * height * depth);
-		if (molProtoFactory != NULL)
-			molProto = (*molProtoFactory)(molPosR - molPosL + 1);
-	}
-
-	seed = genSeed();
-	prng.seed(seed);
-	
-	n = nL = nR = n_m = n_mL = n_mR = nLR = 0;
-	unsigned int a;
-	for( unsigned int z = 0; z < depth; z++ )
-		for( unsigned int y = 0; y < height; y++ ) {
-			// left
-			for( unsigned int x = 0; x < molPosL; x++ )
-				if (topL <= y && y <= bottomL) {
-					a = index(x, y, z);
-					indices.push_back(a);
-					spins[a] = initSpin;
-					fluxes[a] = initFlux;
-					n++;
-					nL++;
-					if (x + 1 == molPosL) {
-						if (mol_exists)
-							n_mL++;
-						if (FM_R_exists)
-							nLR++;
-					}
-				}
-			// mol
-			if( mol_exists && (((y == topL || y == bottomL) && (frontR <= z && z <= backR)) || ((z == frontR || z == backR) && (topL <= y && y <= bottomL))) ) {
-				shared_ptr<Mol> mol = shared_ptr<Mol>(new Mol(molProto, *this, y, z, initSpin, initFlux));
-				unique_mol_indices.push_back(index(molPosL, y, z));  // store the indices for all unique Mol (Molecule::Instance) objects
-				for( unsigned int x = molPosL; x <= molPosR; x++ ) {
-					a = index(x, y, z);
-					indices.push_back(a);
-					mols[a] = mol;
-					n++;
-					n_m++;
-					if (x == molPosL && FM_L_exists)
-						n_mL++;
-					if (x == molPosR && FM_R_exists)
-						n_mR++;
-				}
-			}
-			// right
-			for( unsigned int x = molPosR + 1; x < width; x++ )
-				if (frontR <= z && z <= backR) {
-					a = index(x, y, z);
-					indices.push_back(a);
-					spins[a] = initSpin;
-					fluxes[a] = initFlux;
-					n++;
-					nR++;
-					if (x == molPosR + 1) {
-						if (mol_exists)
-							n_mR++;
-						if (FM_L_exists)
-							nLR++;
-					}
-				}
-		}
-	
-	flippingAlgorithm = CONTINUOUS_SPIN_MODEL; // set default "flipping" algorithm
-
-	setParameters(parameters); // calculate initial state ("Results") for FM sections
-	setMolProto(molProto);     // calculate initial state ("Results") for mol. section
-}
-
-MSD::MSD(unsigned int width, unsigned int height, unsigned int depth,
-		const MolProto &molProto, unsigned int molPosL,
-		unsigned int topL, unsigned int bottomL, unsigned int frontR, unsigned int backR)
-: width(width), height(height), depth(depth),
-		molPosL(molPosL), molPosR(molPosL + molProto.nodeCount() - 1),
-		topL(topL), bottomL(bottomL), frontR(frontR), backR(backR), molProto(molProto)
-{
-	init();
-}
-
-MSD::MSD(unsigned int width, unsigned int height, unsigned int depth,
-			const MolProtoFactory &molType, unsigned int molPosL, unsigned int molPosR,
-			unsigned int topL, unsigned int bottomL, unsigned int frontR, unsigned int backR)
-: width(width), height(height), depth(depth),
-		molPosL(molPosL), molPosR(molPosR),
-		topL(topL), bottomL(bottomL), frontR(frontR), backR(backR)
-{
-	init(&molType);
-}
-
-MSD::MSD(unsigned int width, unsigned int height, unsigned int depth,
-		unsigned int molPosL, unsigned int molPosR,
-		unsigned int topL, unsigned int bottomL, unsigned int frontR, unsigned int backR)
-: width(width), height(height), depth(depth),
-		molPosL(molPosL), molPosR(molPosR),
-		topL(topL), bottomL(bottomL), frontR(frontR), backR(backR)
-{
-	init(&LINEAR_MOL);
-}
-
-
-MSD::MSD(unsigned int width, unsigned int height, unsigned int depth,
-		unsigned int heightL, unsigned depthR)
-: width(width), height(height), depth(depth), molPosL((width - 1) / 2), molPosR((width - 1) / 2),
-		topL( (unsigned int) ceil((height - 1 - heightL) / 2.0) ),
-		bottomL( (unsigned int) floor((height - 1 + heightL) / 2.0) ),
-		frontR( (unsigned int) ceil((depth - 1 - depthR) / 2.0) ),
-		backR( (unsigned int) floor((depth - 1 + depthR) / 2.0) )
-{
-	init(&LINEAR_MOL);
-}
-
-
-MSD::MSD(unsigned int width, unsigned int height, unsigned int depth)
-: width(width), height(height), depth(depth), molPosL((width - 1) / 2), molPosR(width / 2),
-		topL(0), bottomL(height - 1), frontR(0), backR(depth - 1)
-{
-	init(&LINEAR_MOL);
-}
-
-MSD::Parameters MSD::getParameters() const {
-	return parameters;
-}
-
-// Molecule parameters can no longer be changed with MSD::setParameters().
-// Instead use MSD::setMolProto() to change mol type.
-void MSD::setParameters(const MSD::Parameters &p) {
-	MSD::Parameters p0 = parameters;  // old parameters
-	parameters = p;  // update to new parameters
-	
-	// ----- Spin and Spin Flux Magnitudes -----
-	for( auto iter = begin(); iter != end(); ++iter ) {
-		unsigned int i = iter.getIndex();
-		unsigned int x = iter.getX();
-		if( x < molPosL ) {
-			spins[i].normalize() *= parameters.SL;
-			fluxes[i] *= p0.FL != 0 ? parameters.FL / p0.FL : 0;
-		} else if( x > molPosR ) {
-			spins[i].normalize() *= parameters.SR;
-			fluxes[i] *= p0.FR != 0 ? parameters.FR / p0.FR : 0;
-		} // else, mol: do nothing (see: MSD::setMolProto)
-	}
-	
-	// ----- Magnetization, Anisotropy, and other local phenomenon -----
-	results.MSL = results.MSR = results.MFL = results.MFR = Vector::ZERO;
-	Vector anisotropy_L = Vector::ZERO, anisotropy_R = Vector::ZERO;
-	double couple_e0_L = 0, couple_e0_R = 0;  // sum(s_i * f_i)
-	for( auto iter = begin(); iter != end(); ++iter ) {
-		unsigned int x = iter.getX();
-		Vector s = iter.getSpin();
-		Vector f = iter.getFlux();
-		Vector localM = s + f;
-		if( x < molPosL ) {
-			results.MSL += s;
-			results.MFL += f;
-			anisotropy_L.x += sq( localM.x );
-			anisotropy_L.y += sq( localM.y );
-			anisotropy_L.z += sq( localM.z );
-			couple_e0_L += s * f;
-		} else if( x > molPosR ) {
-			results.MSR += s;
-			results.MFR += f;
-			anisotropy_R.x += sq( localM.x );
-			anisotropy_R.y += sq( localM.y );
-			anisotropy_R.z += sq( localM.z );
-			couple_e0_R += s * f;
-		} // else, mol: do nothing (see: MSD::setMolProto)
-	}
-	results.MS = results.MSL + results.MSR + results.MSm;  // aggregate spins
-	results.MF = results.MFL + results.MFR + results.MFm;  // aggregate fluxes
-	results.ML = results.MSL + results.MFL;  // aggregate Left FM
-	results.MR = results.MSR + results.MFR;  // aggregate Right FM
-	results.M = results.ML + results.MR + results.Mm;  // aggregate total
-	
-
-	// ----- Internal Energy -----
-	// left section (FM_L)
-	double couple_ss_L = 0;  // sum(s_i * s_j)
-	double couple_e1_L = 0;  // sum(s_i * f_j)
-	double couple_ee_L = 0;  // sum(f_i * f_j)
-	double biquad_L = 0;
-	Vector dmi_L = Vector::ZERO;  // sum(m_i x m_j);  where x is cross product, and i < j
-	for( unsigned int z = 0; z < depth; z++ )
-		for( unsigned int y = topL; y <= bottomL; y++ )
-			for( unsigned int x = 0; x < molPosL; x++ ) {
-				unsigned int a = index(x, y, z);
-				Vector s = getSpin(a);
-				Vector f = getFlux(a);
-				Vector m = s + f;
-				if( x + 1 < molPosL ) {
-					unsigned int neighbor = index(x + 1, y, z);
-					Vector spin = getSpin(neighbor);
-					Vector flux = getFlux(neighbor);
-					Vector mag = spin + flux;
-					couple_ss_L += s * spin;
-					couple_e1_L += s * flux;
-					couple_e1_L += f * spin;
-					couple_ee_L += f * flux;
-					biquad_L += sq(m * mag);
-					dmi_L += m.crossProduct(mag);
-				}
-				if( y + 1 <= bottomL ) {
-					unsigned int neighbor = index(x, y + 1, z);
-					Vector spin = getSpin(neighbor);
-					Vector flux = getFlux(neighbor);
-					Vector mag = spin + flux;
-					couple_ss_L += s * spin;
-					couple_e1_L += s * flux;
-					couple_e1_L += f * spin;
-					couple_ee_L += f * flux;
-					biquad_L += sq(m * mag);
-					dmi_L += m.crossProduct(mag);
-				}
-				if( z + 1 < depth ) {
-					unsigned int neighbor = index(x, y, z + 1);
-					Vector spin = getSpin(neighbor);
-					Vector flux = getFlux(neighbor);
-					Vector mag = spin + flux;
-					couple_ss_L += s * spin;
-					couple_e1_L += s * flux;
-					couple_e1_L += f * spin;
-					couple_ee_L += f * flux;
-					biquad_L += sq(m * mag);
-					dmi_L += m.crossProduct(mag);
-				}
-			}
-	results.UL = 0;
-	results.UL -= parameters.JL * couple_ss_L;
-	results.UL -= parameters.Je0L * couple_e0_L;
-	results.UL -= parameters.Je1L * couple_e1_L;
-	results.UL -= parameters.JeeL * couple_ee_L;
-	results.UL -= parameters.B * results.ML;
-	results.UL -= parameters.AL * anisotropy_L;
-	results.UL -= parameters.bL * biquad_L;
-	results.UL -= parameters.DL * dmi_L;
-	
-	// right section (FM_R)
-	double couple_ss_R = 0;  // sum(s_i * s_j)
-	double couple_e1_R = 0;  // sum(s_i * f_j)
-	double couple_ee_R = 0;  // sum(f_i * f_j)
-	double biquad_R = 0;
-	Vector dmi_R = Vector::ZERO;  // sum(m_i x m_j);  where x is cross product, and i < j
-	for( unsigned int z = frontR; z <= backR; z++ )
-		for( unsigned int y = 0; y < height; y++ )
-			for( unsigned int x = molPosR + 1; x < width; x++ ) {
-				unsigned int a = index(x, y, z);
-				Vector s = getSpin(a);
-				Vector f = getFlux(a);
-				Vector m = s + f;
-				if( x + 1 < width ) {
-					unsigned int neighbor = index(x + 1, y, z);
-					Vector spin = getSpin(neighbor);
-					Vector flux = getFlux(neighbor);
-					Vector mag = spin + flux;
-					couple_ss_R += s * spin;
-					couple_e1_R += s * flux;
-					couple_e1_R += f * spin;
-					couple_ee_R += f * flux;
-					biquad_R += sq(m * mag);
-					dmi_R += m.crossProduct(mag);
-				}
-				if( y + 1 < height ) {
-					unsigned int neighbor = index(x, y + 1, z);
-					Vector spin = getSpin(neighbor);
-					Vector flux = getFlux(neighbor);
-					Vector mag = spin + flux;
-					couple_ss_R += s * spin;
-					couple_e1_R += s * flux;
-					couple_e1_R += f * spin;
-					couple_ee_R += f * flux;
-					biquad_R += sq(m * mag);
-					dmi_R += m.crossProduct(mag);
-				}
-				if( z + 1 <= backR ) {
-					unsigned int neighbor = index(x, y, z + 1);
-					Vector spin = getSpin(neighbor);
-					Vector flux = getFlux(neighbor);
-					Vector mag = spin + flux;
-					couple_ss_R += s * spin;
-					couple_e1_R += s * flux;
-					couple_e1_R += f * spin;
-					couple_ee_R += f * flux;
-					biquad_R += sq(m * mag);
-					dmi_R += m.crossProduct(mag);
-				}
-			}
-	results.UR = 0;
-	results.UR -= parameters.JR * couple_ss_R;
-	results.UR -= parameters.Je0R * couple_e0_R;
-	results.UR -= parameters.Je1R * couple_e1_R;
-	results.UR -= parameters.JeeR * couple_ee_R;
-	results.UR -= parameters.B * results.MR;
-	results.UR -= parameters.AR * anisotropy_R;
-	results.UR -= parameters.bR * biquad_R;
-	results.UR -= parameters.DR * dmi_R;
-
-	// no need to re-compute results.Um (see: MSD::setMolProto)
-	
-	// "mL" secttion (coupling between FM_L and mol.)
-	double couple_ss_mL = 0;  // sum(s_i * s_j)
-	double couple_e1_mL = 0;  // sum(s_i * f_j)
-	double couple_ee_mL = 0;  // sum(f_i * f_j)
-	double biquad_mL = 0;
-	Vector dmi_mL = Vector::ZERO;  // sum(m_i x m_j);  where x is cross product, and i < j
-	const unsigned int x1 = molPosL - 1; // only useful if( molPosL != 0 ); i.e. FM_L_exists
-	if( FM_L_exists && mol_exists )
-		for( unsigned int y = topL; y <= bottomL; y++ )
-			for( unsigned int z = frontR; z <= backR; z++ )
-				if( y == topL || z == frontR || y == bottomL || z == backR ) {
-					unsigned int a = index(x1, y, z);
-					Vector s = getSpin(a);
-					Vector f = getFlux(a);
-					Vector m = s + f;
-					unsigned int neighbor = index(molPosL + molProto.leftLead, y, z);
-					Vector spin = getSpin(neighbor);
-					Vector flux = getFlux(neighbor);
-					Vector mag = spin + flux;
-					couple_ss_mL += s * spin;
-					couple_e1_mL += s * flux;
-					couple_e1_mL += f * spin;
-					couple_ee_mL += f * flux;
-					biquad_mL += sq(m * mag);
-					dmi_mL += m.crossProduct(mag);  // location(m)=x1 in FM_L < location(mag)=molPosL + leftLead in mol.
-				}
-	results.UmL = 0;
-	results.UmL -= parameters.JmL * couple_ss_mL;
-	results.UmL -= parameters.Je1mL * couple_e1_mL;
-	results.UmL -= parameters.JeemL * couple_ee_mL;
-	results.UmL -= parameters.bmL * biquad_mL;
-	results.UmL -= parameters.DmL * dmi_mL;
-	
-	// "mR" section (coupling between mol. and FM_R)
-	double couple_ss_mR = 0;  // sum(s_i * s_j)
-	double couple_e1_mR = 0;  // sum(s_i * f_j)
-	double couple_ee_mR = 0;  // sum(f_i * f_j)
-	double biquad_mR = 0;
-	Vector dmi_mR = Vector::ZERO;  // sum(m_i x m_j);  where x is cross product, and i < j
-	const unsigned int x2 = molPosR + 1; // only useful if( molPosR != width - 1 ); i.e. FM_R_exists
-	if( FM_R_exists && mol_exists )
-		for( unsigned int y = topL; y <= bottomL; y++ )
-			for( unsigned int z = frontR; z <= backR; z++ )
-				if( y == topL || z == frontR || y == bottomL || z == backR ) {
-					unsigned int a = index(molPosL + molProto.rightLead, y, z);
-					Vector s = getSpin(a);
-					Vector f = getFlux(a);
-					Vector m = s + f;
-					unsigned int neighbor = index(x2, y, z);
-					Vector spin = getSpin(neighbor);
-					Vector flux = getFlux(neighbor);
-					Vector mag = spin + flux;
-					couple_ss_mR += s * spin;
-					couple_e1_mR += s * flux;
-					couple_e1_mR += f * spin;
-					couple_ee_mR += f * flux;
-					biquad_mR += sq(m * mag);
-					dmi_mR += m.crossProduct(mag); // location(m)=molPosL + rightLead in mol. < location(mag)=x2 in FM_R
-				}
-	results.UmR = 0;
-	results.UmR -= parameters.JmR * couple_ss_mR;
-	results.UmR -= parameters.Je1mR * couple_e1_mR;
-	results.UmR -= parameters.JeemR * couple_ee_mR;
-	results.UmR -= parameters.bmR * biquad_mR;
-	results.UmR -= parameters.DmR * dmi_mR;
-	
-	// "LR" section (coupling between FM_L and FM_R)
-	double couple_ss_LR = 0;  // sum(s_i * s_j)
-	double couple_e1_LR = 0;  // sum(s_i * f_j)
-	double couple_ee_LR = 0;  // sum(f_i * f_j)
-	double biquad_LR = 0;
-	Vector dmi_LR = Vector::ZERO;  // sum(m_i x m_j);  where x is cross product, and i < j
-	if( FM_L_exists && FM_R_exists )
-		for( unsigned int z = frontR; z <= backR; z++ )
-			for( unsigned int y = topL; y <= bottomL; y++ ) {
-				unsigned int a = index(x1, y, z);
-				Vector s = getSpin(a);
-				Vector f = getFlux(a);
-				Vector m = s + f;
-				unsigned int neighbor = index(x2, y, z);
-				Vector spin = getSpin(neighbor);
-				Vector flux = getFlux(neighbor);
-				Vector mag = spin + flux;
-				couple_ss_LR += s * spin;
-				couple_e1_LR += s * flux;
-				couple_e1_LR += f * spin;
-				couple_ee_LR += f * flux;
-				biquad_LR += sq(m * mag);
-				dmi_LR += m.crossProduct(mag); // location(m) = x1 in FM_L < location(mag) = x2 in FM_R
-			}
-	results.ULR = 0;
-	results.ULR -= parameters.JLR * couple_ss_LR;
-	results.ULR -= parameters.Je1LR * couple_e1_LR;
-	results.ULR -= parameters.JeeLR * couple_ee_LR;
-	results.ULR -= parameters.bLR * biquad_LR;
-	results.ULR -= parameters.DLR * dmi_LR;
-	 
-	results.U = results.UL + results.UR + results.Um + results.UmL + results.UmR + results.ULR;
-}
-
-MSD::Results MSD::getResults() const {
-	return results;
-}
-
-
-void MSD::set_kT(double kT) {
-	// kT doesn't effect energy (U)
-	parameters.kT = kT;
-}
-
-void MSD::setB(const Vector &B) {
-	// optimized energy recalculation when only changing magnetic field
-	Vector deltaB = B - parameters.B;
-	
-	results.UL -= deltaB * results.ML;
-	results.UR -= deltaB * results.MR;
-	results.Um -= deltaB * results.Mm;
-	results.U = results.UL + results.UR + results.Um + results.UmL + results.UmR + results.ULR;
-	
-	parameters.B = B;
-}
-
-
-const MSD::MolProto & MSD::getMolProto() const {
-	return molProto;
-}
-
-void MSD::setMolProto(const MolProto &molProto) {
-	const unsigned int nodeCount = this->molProto.nodeCount();
-	if (molProto.nodeCount() != nodeCount)
-		throw MSD::MoleculeException("Can not change the number of nodes in the molecule after MSD creation. Must create a new MSD.");
-
-	// ----- remove energy caused by previous mol. and leads from aggregate: U -----
-	results.U -= results.Um + results.UmL + results.UmR;
-
-	// ----- reset some Results -----
-	results.MSm = results.MFm = Vector::ZERO;
-	results.Um = results.UmL = results.UmR = 0;
-
-	// NodeParameters: Sm, Fm, Je0m, Am
-	// ----- Update spin and flux Vectors (Sm, Fm), and Calculate local Energy and Magnetization (B, Je0m, Am) -----
-	for (unsigned int a : unique_mol_indices) {
-		unsigned int y = this->y(a);
-		unsigned int z = this->z(a);
-
-		// Note: because Mol::prototype is a reference (acting like a pointer), it must refer to the global field: this->molProto
-		// This field will be updated to the new molProto before this function returns
-		shared_ptr<Mol> oldMol = mols[a];
-		shared_ptr<Mol> mol = shared_ptr<Mol>(new Mol(this->molProto, *this, y, z, initSpin, initFlux));
-		
-		for (unsigned int n = 0; n < nodeCount; n++) {
-			Vector &s = mol->spins[n];
-			Vector &f = mol->fluxes[n];
-
-			const auto &parameters = molProto.nodes[n].parameters;
-
-			// scale spin Vector
-			s = oldMol->spins[n].normalize() * parameters.Sm;
-			
-			// scale flux Vector
-			{	double oldFm = this->molProto.nodes[n].parameters.Fm;
-				f = oldFm != 0 ? oldMol->fluxes[n] * (parameters.Fm / oldFm) : Vector::ZERO;
-			}
-
-			// store new Mol (Molecule::Instance) over old one. old pointer should be destructed!
-			mols[index(molPosL + n, y, z)] = mol;
-
-			// calculate "Results"
-			results.MSm += s;
-			results.MFm += f;
-
-			Vector m = s + f;
-			results.Um -= this->parameters.B * m;
-			results.Um -= parameters.Am * Vector(sq(m.x), sq(m.y), sq(m.z));
-			results.Um -= parameters.Je0m * (s * f);
-		}
-
-		// delete oldMol;  // not needed because of shared_ptr
-	}
-
-	// EdgeParameters: Jm, Je1m, Jeem, bm, Dm
-	// ----- Calculate bond energy (Jm, Je1m, Jeem, bm, Dm) -----
-	for (unsigned int a : unique_mol_indices) {
-		const Mol &mol = *mols[a];
-
-		for (unsigned int n = 0; n < nodeCount; n++) {  // for each node
-			Vector s_i = mol.spins[n];
-			Vector f_i = mol.fluxes[n];
-			Vector m_i = s_i + f_i;
-
-			for (auto &edge : molProto.nodes[n].neighbors) {  // for each edge of node
-				// skip if(selfIndex > nodeIndex) to avoid duplicating calculations
-				// since each edge exists twice: once in each direction.
-				// Also, ignore "loops" (edges which connect to themselves).
-				if (edge.selfIndex >= edge.nodeIndex)
-					continue;
-				
-				auto parameters = molProto.edgeParameters[edge.edgeIndex];
-
-				Vector s_j = mol.spins[edge.nodeIndex];
-				Vector f_j = mol.fluxes[edge.nodeIndex];
-				Vector m_j = s_j + f_j;
-
-				// calculate "Results"
-				results.Um -= parameters.Jm * (s_i * s_j);
-				results.Um -= parameters.Je1m * (s_i * f_j + f_i * s_j);
-				results.Um -= parameters.Jeem * (f_i * f_j);
-				results.Um -= parameters.bm * sq(m_i * m_j);
-				results.Um -= parameters.Dm * (edge.direction * m_i.crossProduct(m_j));
-			}
-		}
-	}
-
-	// ----- Calculate energy at leads (*mL, *mR) -----
-	for (unsigned int a : unique_mol_indices) {
-		unsigned int y = this->y(a);
-		unsigned int z = this->z(a);
-
-		if (FM_L_exists) {
-			unsigned int FML_idx = index(molPosL - 1, y, z);
-			unsigned int mol_idx = index(molPosL + molProto.leftLead, y, z);
-			Vector s_i = getSpin(FML_idx);
-			Vector f_i = getFlux(FML_idx);
-			Vector m_i = s_i + f_i;
-			Vector s_j = getSpin(mol_idx);
-			Vector f_j = getFlux(mol_idx);
-			Vector m_j = s_j + f_j;
-
-			results.UmL -= parameters.JmL * (s_i * s_j);
-			results.UmL -= parameters.Je1mL * (s_i * f_j + f_i * s_j);
-			results.UmL -= parameters.JeemL * (f_i * f_j);
-			results.UmL -= parameters.bmL * sq(m_i * m_j);
-			results.UmL -= parameters.DmL * m_i.crossProduct(m_j);
-		}
-
-		if (FM_R_exists) {
-			unsigned int FMR_idx = index(molPosR + 1, y, z);
-			unsigned int mol_idx = index(molPosL + molProto.rightLead, y, z);
-			Vector s_i = getSpin(mol_idx);
-			Vector f_i = getFlux(mol_idx);
-			Vector m_i = s_i + f_i;
-			Vector s_j = getSpin(FMR_idx);
-			Vector f_j = getFlux(FMR_idx);
-			Vector m_j = s_j + f_j;
-
-			results.UmR -= parameters.JmR * (s_i * s_j);
-			results.UmR -= parameters.Je1mR * (s_i * f_j + f_i * s_j);
-			results.UmR -= parameters.JeemR * (f_i * f_j);
-			results.UmR -= parameters.bmR * sq(m_i * m_j);
-			results.UmR -= parameters.DmR * m_i.crossProduct(m_j);
-		}
-	}
-
-	// ----- update aggregate energy (U) and magnetizations (Mm, MS, MF, M) -----
-	results.Mm = results.MSm + results.MFm;
-	results.MS = results.MSL + results.MSR + results.MSm;
-	results.MF = results.MFL + results.MFR + results.MFm;
-	results.M = results.MS + results.MF;
-	results.U += results.Um + results.UmR + results.UmL;
-	
-	// Done: copy new mol. prototype to MSD::molProto field
-	this->molProto = molProto;
-}
-
-void MSD::setMolParameters(const MolProto::NodeParameters &nodeParams, const MolProto::EdgeParameters &edgeParams) {
-	MolProto molProto = this->molProto;
-	molProto.setAllParameters(nodeParams, edgeParams);
-	setMolProto(molProto);  // update Results (i.e. energy and magnetization)
-}
-
-
-Vector MSD::getSpin(unsigned int a) const {
-	unsigned int x = this->x(a);
-	return (x < molPosL || x > molPosR) ? spins.at(a) : mols.at(a)->spins[x - molPosL];
-}
-
-Vector MSD::getSpin(unsigned int x, unsigned int y, unsigned int z) const {
-	if( x >= width || y >= height || z >= depth )
-		throw out_of_range("(x,y,z) coordinate not in range");
-	return getSpin( index(x, y, z) );
-}
-
-Vector MSD::getFlux(unsigned int a) const {
-	unsigned int x = this->x(a);
-	return (x < molPosL || x > molPosR) ? fluxes.at(a) : mols.at(a)->fluxes[x - molPosL];
-}
-
-Vector MSD::getFlux(unsigned int x, unsigned int y, unsigned int z) const {
-	if( x >= width || y >= height || z >= depth )
-		throw out_of_range("(x,y,z) coordinate not in range");
-	return getFlux( index(x, y, z) );
-}
-
-Vector MSD::getLocalM(unsigned int a) const {
-	return getSpin(a) + getFlux(a);
-}
-
-Vector MSD::getLocalM(unsigned int x, unsigned int y, unsigned int z) const {
-	if( x >= width || y >= height || z >= depth )
-		throw out_of_range("(x,y,z) coordinate not in range");
-	return getLocalM( index(x, y, z) );
-}
-
-void MSD::setSpin(unsigned int a, const Vector &spin) {
-	setLocalM( a, spin, getFlux(a) );
-}
-
-void MSD::setSpin(unsigned int x, unsigned int y, unsigned int z, const Vector &spin) {
-	if( x >= width || y >= height || z >= depth )
-		throw out_of_range("(x,y,z) coordinate not in range");
-	setSpin( index(x, y, z), spin );
-}
-
-void MSD::setFlux(unsigned int a, const Vector &flux) {
-	setLocalM( a, getSpin(a), flux );
-}
-
-void MSD::setFlux(unsigned int x, unsigned int y, unsigned int z, const Vector &flux) {
-	if( x >= width || y >= height || z >= depth )
-		throw out_of_range("(x,y,z) coordinate not in range");
-	setFlux( index(x, y, z), flux );
-}
-
-void MSD::setLocalM(unsigned int a, const Vector &spin, const Vector &flux) {
-	try {
-	
-	unsigned int x = this->x(a);
-	unsigned int y = this->y(a);
-	unsigned int z = this->z(a);
-
-	// if position "a" is within the mol., bybass this function and call Mol::setLocalM instead. 
-	if (molPosL <= x && x <= molPosR) {
-		mols.at(a)->setLocalM(x - molPosL, spin, flux);
-		return;
-	}
-	// else, we are definately in one of the FMs
-
-	Vector &s = spins.at(a); //previous spin
-	Vector &f = fluxes.at(a); //previous spin fluctuation
-	
-	Vector m = s + f; // previous local magnetization
-	Vector mag = spin + flux; // new local magnetization
-	
-	Vector deltaS = spin - s;
-	Vector deltaF = flux - f;
-	Vector deltaM = mag - m;
-	results.M += deltaM;
-	results.MS += deltaS;
-	results.MF += deltaF;
-	
-	// delta U's are actually negative, simply grouping the negatives in front of each energy coefficient into deltaU -= ... (instead of +=)
-	double deltaU_B = parameters.B * deltaM;
-	results.U -= deltaU_B;
-	
-	// ----- left section (FM_L) -----
-	if( x < molPosL ) {
-	
-		results.ML += deltaM;
-		results.MSL += deltaS;
-		results.MFL += deltaF;
-		results.UL -= deltaU_B;
-		
-		{	double deltaU = parameters.AL * ( Vector(sq(mag.x), sq(mag.y), sq(mag.z)) - Vector(sq(m.x), sq(m.y), sq(m.z)) )
-		                  + parameters.Je0L * ( spin * flux - s * f );
-			results.U -= deltaU;
-			results.UL -= deltaU;
-		}
-		
-		// [5 neighbors stay only within FM_L: left, above, below, front, back]
-		if( x != 0 ) {
-			unsigned int a1 = index(x - 1, y, z);  // left neighbor
-			Vector neighbor_s = getSpin(a1);
-			Vector neighbor_f = getFlux(a1);
-			Vector neighbor_m = neighbor_s + neighbor_f;
-			double deltaU = parameters.JL * ( neighbor_s * deltaS )
-						  + parameters.Je1L * ( neighbor_f * deltaS + neighbor_s * deltaF )
-						  + parameters.JeeL * ( neighbor_f * deltaF )
-			              + parameters.bL * ( sq(neighbor_m * mag) - sq(neighbor_m * m) )
-						  + parameters.DL * neighbor_m.crossProduct(deltaM);  // (a1 < a): right vector changed
-			results.U -= deltaU;
-			results.UL -= deltaU;
-		} // else, x - 1 neighbor doesn't exist
-		if( y != topL ) {
-			unsigned int a1 = index(x, y - 1, z);  // above neighbor
-			Vector neighbor_s = getSpin(a1);
-			Vector neighbor_f = getFlux(a1);
-			Vector neighbor_m = neighbor_s + neighbor_f;
-			double deltaU = parameters.JL * ( neighbor_s * deltaS )
-						  + parameters.Je1L * ( neighbor_f * deltaS + neighbor_s * deltaF )
-						  + parameters.JeeL * ( neighbor_f * deltaF )
-			              + parameters.bL * ( sq(neighbor_m * mag) - sq(neighbor_m * m) )
-						  + parameters.DL * neighbor_m.crossProduct(deltaM);  // (a1 < a): right vector changed
-			results.U -= deltaU;
-			results.UL -= deltaU;
-		} // else, y - 1 neighbor doesn't exist
-		if( y != bottomL ) {
-			unsigned int a1 = index(x, y + 1, z);  // below neighbor
-			Vector neighbor_s = getSpin(a1);
-			Vector neighbor_f = getFlux(a1);
-			Vector neighbor_m = neighbor_s + neighbor_f;
-			double deltaU = parameters.JL * ( neighbor_s * deltaS )
-						  + parameters.Je1L * ( neighbor_f * deltaS + neighbor_s * deltaF )
-						  + parameters.JeeL * ( neighbor_f * deltaF )
-			              + parameters.bL * ( sq(neighbor_m * mag) - sq(neighbor_m * m) )
-						  + parameters.DL * deltaM.crossProduct(neighbor_m);  // (a < a1): left vector changed
-			results.U -= deltaU;
-			results.UL -= deltaU;
-		} // else, y + 1 neighbor doesn't exist
-		if( z != 0 ) {
-			unsigned int a1 = index(x, y, z - 1);  // front neighbor
-			Vector neighbor_s = getSpin(a1);
-			Vector neighbor_f = getFlux(a1);
-			Vector neighbor_m = neighbor_s + neighbor_f;
-			double deltaU = parameters.JL * ( neighbor_s * deltaS )
-						  + parameters.Je1L * ( neighbor_f * deltaS + neighbor_s * deltaF )
-						  + parameters.JeeL * ( neighbor_f * deltaF )
-			              + parameters.bL * ( sq(neighbor_m * mag) - sq(neighbor_m * m) )
-						  + parameters.DL * neighbor_m.crossProduct(deltaM);  // (a1 < a): right vector changed
-			results.U -= deltaU;
-			results.UL -= deltaU;
-		} // else, z - 1 neighbor doesn't exist
-		if( z + 1 != depth ) {
-			unsigned int a1 = index(x, y, z + 1);  // back neighbor
-			Vector neighbor_s = getSpin(a1);
-			Vector neighbor_f = getFlux(a1);
-			Vector neighbor_m = neighbor_s + neighbor_f;
-			double deltaU = parameters.JL * ( neighbor_s * deltaS )
-						  + parameters.Je1L * ( neighbor_f * deltaS + neighbor_s * deltaF )
-						  + parameters.JeeL * ( neighbor_f * deltaF )
-			              + parameters.bL * ( sq(neighbor_m * mag) - sq(neighbor_m * m) )
-						  + parameters.DL * deltaM.crossProduct(neighbor_m);  // (a < a1): left vector changed
-			results.U -= deltaU;
-			results.UL -= deltaU;
-		} // else, z + 1 neighbor doesn't exist
-		
-		// [2 neighbors may leave FM_L: right, LR (direct coupling)]
-		if( x + 1 != width )  // do these neighbors exist?
-			if( x + 1 == molPosL ) {  // are we next to the mol.?
-				if( mol_exists )
-					try {
-						unsigned int a1 = index(molPosL + molProto.leftLead, y, z);  // right neighbor (in mol.)
-						Vector neighbor_s = getSpin(a1);
-						Vector neighbor_f = getFlux(a1);
-						Vector neighbor_m = neighbor_s + neighbor_f;
-						double deltaU = parameters.JmL * ( neighbor_s * deltaS )
-						              + parameters.Je1mL * ( neighbor_f * deltaS + neighbor_s * deltaF )
-						              + parameters.JeemL * ( neighbor_f * deltaF )
-						              + parameters.bmL * ( sq(neighbor_m * mag) - sq(neighbor_m * m) )
-									  + parameters.DmL * deltaM.crossProduct(neighbor_m);  // (a < a1): left vector changed
-						results.U -= deltaU;
-						results.UmL -= deltaU;
-					} catch(const out_of_range &e) {} // x + 1 neighbor doesn't exist because it's in the buffer zone
-				
-				if( FM_R_exists )
-					try {
-						unsigned int a1 = index(molPosR + 1, y, z);  // LR (direct coupling) neighbor
-						Vector neighbor_s = getSpin(a1);
-						Vector neighbor_f = getFlux(a1);
-						Vector neighbor_m = neighbor_s + neighbor_f;
-						double deltaU = parameters.JLR * ( neighbor_s * deltaS )
-						              + parameters.Je1LR * ( neighbor_f * deltaS + neighbor_s * deltaF )
-						              + parameters.JeeLR * ( neighbor_f * deltaF )
-						              + parameters.bLR * ( sq(neighbor_m * mag) - sq(neighbor_m * m) )
-									  + parameters.DLR * deltaM.crossProduct(neighbor_m);  // (a < a1): left vector changed
-						results.U -= deltaU;
-						results.ULR -= deltaU;
-					} catch(const out_of_range &e) {} // molPosR + 1 atom doesn't exist because we're not in the center
-				
-			} else {  // we are not next to the mol.
-				unsigned int a1 = index(x + 1, y, z);  // right neighbor (also in FM_L)
-				Vector neighbor_s = getSpin(a1);
-				Vector neighbor_f = getFlux(a1);
-				Vector neighbor_m = neighbor_s + neighbor_f;
-				double deltaU = parameters.JL * ( neighbor_s * deltaS )
-				              + parameters.Je1L * ( neighbor_f * deltaS + neighbor_s * deltaF )
-				              + parameters.JeeL * ( neighbor_f * deltaF )
-				              + parameters.bL * ( sq(neighbor_m * mag) - sq(neighbor_m * m) )
-							  + parameters.DL * deltaM.crossProduct(neighbor_m);  // (a < a1): left vector changed
-				results.U -= deltaU;
-				results.UL -= deltaU;
-			}
-		// else, x + 1 neighbor doesn't exist (because molPosL == width)
-	
-	// ----- right section (FM_R) -----
-	} else {  // x > molPosR
-	
-		results.MR += deltaM;
-		results.MSR += deltaS;
-		results.MFR += deltaF;
-		results.UR -= deltaU_B;
-		
-		{	double deltaU = parameters.AR * ( Vector(sq(mag.x), sq(mag.y), sq(mag.z)) - Vector(sq(m.x), sq(m.y), sq(m.z)) )
-			              + parameters.Je0R * ( spin * flux - s * f );
-			results.U -= deltaU;
-			results.UR -= deltaU;
-		}
-		
-		// [5 neighbors stay only within FM_R: right, above, below, front, back]
-		if( x + 1 != width ) {
-			unsigned int a1 = index(x + 1, y, z);  // right neighbor
-			Vector neighbor_s = getSpin(a1);
-			Vector neighbor_f = getFlux(a1);
-			Vector neighbor_m = neighbor_s + neighbor_f;
-			double deltaU = parameters.JR * ( neighbor_s * deltaS )
-			              + parameters.Je1R * ( neighbor_f * deltaS + neighbor_s * deltaF )
-			              + parameters.JeeR * ( neighbor_f * deltaF )
-			              + parameters.bR * ( sq(neighbor_m * mag) - sq(neighbor_m * m) )
-						  + parameters.DR * deltaM.crossProduct(neighbor_m);  // (a < a1): left vector changed
-			results.U -= deltaU;
-			results.UR -= deltaU;
-		} // else, x + 1 neighbor doesn't exist
-		if( y != 0 ) {
-			unsigned int a1 = index(x, y - 1, z);  // above neighbor
-			Vector neighbor_s = getSpin(a1);
-			Vector neighbor_f = getFlux(a1);
-			Vector neighbor_m = neighbor_s + neighbor_f;
-			double deltaU = parameters.JR * ( neighbor_s * deltaS )
-			              + parameters.Je1R * ( neighbor_f * deltaS + neighbor_s * deltaF )
-			              + parameters.JeeR * ( neighbor_f * deltaF )
-			              + parameters.bR * ( sq(neighbor_m * mag) - sq(neighbor_m * m) )
-						  + parameters.DR * neighbor_m.crossProduct(deltaM);  // (a1 < a): right vector changed
-			results.U -= deltaU;
-			results.UR -= deltaU;
-		} // else, y - 1 neighbor doesn't exist
-		if( y + 1 != height ) {
-			unsigned int a1 = index(x, y + 1, z);  // below neighbor
-			Vector neighbor_s = getSpin(a1);
-			Vector neighbor_f = getFlux(a1);
-			Vector neighbor_m = neighbor_s + neighbor_f;
-			double deltaU = parameters.JR * ( neighbor_s * deltaS )
-			              + parameters.Je1R * ( neighbor_f * deltaS + neighbor_s * deltaF )
-			              + parameters.JeeR * ( neighbor_f * deltaF )
-			              + parameters.bR * ( sq(neighbor_m * mag) - sq(neighbor_m * m) )
-						  + parameters.DR * deltaM.crossProduct(neighbor_m);  // (a < a1): left vector changed
-			results.U -= deltaU;
-			results.UR -= deltaU;
-		} // else, y + 1 neighbor doesn't exist
-		if( z != frontR ) {
-			unsigned int a1 = index(x, y, z - 1);  // front neighbor
-			Vector neighbor_s = getSpin(a1);
-			Vector neighbor_f = getFlux(a1);
-			Vector neighbor_m = neighbor_s + neighbor_f;
-			double deltaU = parameters.JR * ( neighbor_s * deltaS )
-			              + parameters.Je1R * ( neighbor_f * deltaS + neighbor_s * deltaF )
-			              + parameters.JeeR * ( neighbor_f * deltaF )
-			              + parameters.bR * ( sq(neighbor_m * mag) - sq(neighbor_m * m) )
-						  + parameters.DR * neighbor_m.crossProduct(deltaM);  // (a1 < a): right vector changed
-			results.U -= deltaU;
-			results.UR -= deltaU;
-		} // else, z - 1 neighbor doesn't exist
-		if( z != backR ) {
-			unsigned int a1 = index(x, y, z + 1);  // back neighbor
-			Vector neighbor_s = getSpin(a1);
-			Vector neighbor_f = getFlux(a1);
-			Vector neighbor_m = neighbor_s + neighbor_f;
-			double deltaU = parameters.JR * ( neighbor_s * deltaS )
-			              + parameters.Je1R * ( neighbor_f * deltaS + neighbor_s * deltaF )
-			              + parameters.JeeR * ( neighbor_f * deltaF )
-			              + parameters.bR * ( sq(neighbor_m * mag) - sq(neighbor_m * m) )
-						  + parameters.DR * deltaM.crossProduct(neighbor_m);  // (a < a1): left vector changed
-			results.U -= deltaU;
-			results.UR -= deltaU;
-		} // else, z + 1 neighbor doesn't exist
-		
-		// [2 neighbors may leave FM_L: left, LR (direct coupling)]
-		// x != 0, because x > (unsigned molPosR) >= 0
-		if( x - 1 == molPosR ) {  // are we next to the mol.?
-			if( mol_exists )
-				try {
-					unsigned int a1 = index(molPosL + molProto.rightLead, y, z);  // left neighbor (in mol.)
-					Vector neighbor_s = getSpin(a1);
-					Vector neighbor_f = getFlux(a1);
-					Vector neighbor_m = neighbor_s + neighbor_f;
-					double deltaU = parameters.JmR * ( neighbor_s * deltaS )
-					              + parameters.Je1mR * ( neighbor_f * deltaS + neighbor_s * deltaF )
-					              + parameters.JeemR * ( neighbor_f * deltaF )
-					              + parameters.bmR * ( sq(neighbor_m * mag) - sq(neighbor_m * m) )
-								  + parameters.DmR * neighbor_m.crossProduct(deltaM);  // (a1 < a): right vector changed
-					results.U -= deltaU;
-					results.UmR -= deltaU;
-				} catch(const out_of_range &e) {} // x - 1 neighbor doesn't exist because it's in the buffer zone
-			
-			if( FM_L_exists )
-				try {
-					unsigned int a1 = index(molPosL - 1, y, z);  // LR (direct coupling) neighbor
-					Vector neighbor_s = getSpin(a1);
-					Vector neighbor_f = getFlux(a1);
-					Vector neighbor_m = neighbor_s + neighbor_f;
-					double deltaU = parameters.JLR * ( neighbor_s * deltaS )
-					              + parameters.Je1LR * ( neighbor_f * deltaS + neighbor_s * deltaF )
-					              + parameters.JeeLR * ( neighbor_f * deltaF )
-					              + parameters.bLR * ( sq(neighbor_m * mag) - sq(neighbor_m * m) )
-								  + parameters.DLR * neighbor_m.crossProduct(deltaM);  // (a1 < a): right vector changed
-					results.U -= deltaU;
-					results.ULR -= deltaU;
-				} catch(const out_of_range &e) {} // molPos - 1 atom doesn't exist because we're not in the center
-
-		} else {  // we are not next to the mol.
-			unsigned int a1 = index(x - 1, y, z);  // left neighbor (also in FM_R)
-			Vector neighbor_s = getSpin(a1);
-			Vector neighbor_f = getFlux(a1);
-			Vector neighbor_m = neighbor_s + neighbor_f;
-			double deltaU = parameters.JR * ( neighbor_s * deltaS )
-			              + parameters.Je1R * ( neighbor_f * deltaS + neighbor_s * deltaF )
-			              + parameters.JeeR * ( neighbor_f * deltaF )
-			              + parameters.bR * ( sq(neighbor_m * mag) - sq(neighbor_m * m) )
-						  + parameters.DR * neighbor_m.crossProduct(deltaM);  // (a1 < a): right vector changed
-			results.U -= deltaU;
-			results.UR -= deltaU;
-		}
-	
-	}
-	
-	// ----- update vectors -----
-	s = spin;
-	f = flux;
-
-	} catch(const out_of_range &ex) {
-		// For debugging. This exception should not happen in production!
-		std::cerr << "ERROR in MSD::setLocalM(unsigned int, udc::Vector, udc::Vector)\n";
-		std::cerr << a << " == (" << x(a) << ", " << y(a) << ", " << z(a) << ")\n";
-		std::cerr << ex.what() << "\n\n";
-		std::cerr << "topL=" << topL << ", bottomL=" << bottomL << ", frontR=" << frontR << ", backR=" << backR << '\n';
-		std::cerr << "Valid Indicies:\n";
-		for (auto iter = indices.begin(); iter != indices.end(); ++iter)
-			std::cerr << *iter << " == (" << x(*iter) << ", " << y(*iter) << ", " << z(*iter) << ")\n";
-		exit(200);
-	}
-}
-
-void MSD::setLocalM(unsigned int x, unsigned int y, unsigned int z, const Vector &spin, const Vector &flux) {
-	if( x >= width || y >= height || z >= depth )
-		throw out_of_range("(x,y,z) coordinate not in range");
-	setLocalM( index(x, y, z), spin, flux );
-}
-
-
-unsigned int MSD::getN() const {
-	return n;
-}
-
-unsigned int MSD::getNL() const {
-	return nL;
-}
-
-unsigned int MSD::getNR() const {
-	return nR;
-}
-
-unsigned int MSD::getNm() const {
-	return n_m;
-}
-
-unsigned int MSD::getNmL() const {
-	return n_mL;
-}
-
-unsigned int MSD::getNmR() const {
-	return n_mR;
-}
-
-unsigned int MSD::getNLR() const {
-	return nLR;
-}
-
-unsigned int MSD::getWidth() const {
-	return width;
-}
-
-unsigned int MSD::getHeight() const {
-	return height;
-}
-
-unsigned int MSD::getDepth() const {
-	return depth;
-}
-
-void MSD::getDimensions(unsigned int &width, unsigned int &height, unsigned int &depth) const {
-	width = this->width;
-	height = this->height;
-	depth = this->depth;
-}
-
-unsigned int MSD::getMolPosL() const {
-	return molPosL;
-}
-
-unsigned int MSD::getMolPosR() const {
-	return molPosR;
-}
-
-void MSD::getMolPos(unsigned int &molPosL, unsigned int &molPosR) const {
-	molPosL = this->molPosL;
-	molPosR = this->molPosR;
-}
-
-unsigned int MSD::getTopL() const {
-	return topL;
-}
-
-unsigned int MSD::getBottomL() const {
-	return bottomL;
-}
-
-unsigned int MSD::getFrontR() const {
-	return frontR;
-}
-
-unsigned int MSD::getBackR() const {
-	return backR;
-}
-
-void MSD::getInnerBounds(unsigned int &topL, unsigned int &bottomL, unsigned int &frontR, unsigned int &backR) const{
-	topL = this->topL;
-	bottomL = this->bottomL;
-	frontR = this->frontR;
-	backR = this->backR;
-}
-
-bool MSD::getFM_L_exists() const {
-	return FM_L_exists;
-}
-
-bool MSD::getFM_R_exists() const {
-	return FM_R_exists;
-}
-
-bool MSD::getMol_exists() const {
-	return mol_exists;
-}
-
-void MSD::getRegions(bool &FM_L_exists, bool &FM_R_exists, bool &mol_exists) const {
-	FM_L_exists = this->FM_L_exists;
-	FM_R_exists = this->FM_R_exists;
-	mol_exists = this->mol_exists;
-}
-
-
-void MSD::setSeed(unsigned long seed) {
-	this->seed = seed;
-	prng.seed(seed);
-}
-
-unsigned long MSD::getSeed() const {
-	return seed;
-}
-
-
-void MSD::reinitialize(bool reseed) {
-	if( reseed )
-		seed = genSeed();
-	prng.seed(seed);
-	for( auto i = begin(); i != end(); i++ )
-		setLocalM( i, initSpin, initFlux );
-	record.clear();
-	setParameters(parameters);  // TODO: do we need this? Yes, but I think only because we
-	setMolProto(molProto);  // need to rescale Spin and Flux vectors to match S and F params
-	results.t = 0;
-}
-
-void MSD::randomize(bool reseed) {
-	if( reseed )
-		seed = genSeed();
-	prng.seed(seed);
-	for( auto i = begin(); i != end(); i++ )
-		setLocalM( i,  // TODO: this calculation isn't uniform. It favors F close to 0
-				Vector::sphericalForm(1, 2 * PI * rand(prng), asin(2 * rand(prng) - 1)),
-				Vector::sphericalForm(rand(prng), 2 * PI * rand(prng), asin(2 * rand(prng) - 1)) );
-	record.clear();
-	setParameters(parameters);  // TODO: do we still need this? Yes. (See comment in MSD::reinitialize())
-	setMolProto(molProto);
-	results.t = 0;
-}
-
-void MSD::metropolis(unsigned long long N) {
-	function<double()> random = bind( rand, ref(prng) );
-	Results r = getResults(); //get the energy of the system
-	//start loop (will iterate N times)
-	for( unsigned long long i = 0; i < N; i++ ) {
-		unsigned int a = indices[static_cast<unsigned int>( random() * indices.size() )]; //pick an atom (pseudo) randomly
-		Vector s = getSpin(a);  // TODO: do we need the bounds checking?
-		Vector f = getFlux(a);  // TODO: do we need the bounds checking?
-		
-		// remeber if we are in a mol. in case we need to revert state
-		bool inMol = false;
-		unsigned int n;  // only defined if isMol==true
-
-		// pick the correct F coeficient to determine new flux magnitude
-		unsigned int x = this->x(a);
-		double F;
-		if (x < molPosL) {
-			F = parameters.FL;
-		} else if (x > molPosR) {
-			F = parameters.FR;
-		} else {
-			n = x - molPosL;
-			F = molProto.getNodeParameters(n).Fm;  // TODO: do we need the bounds checking?
-			inMol = true;
-		}
-
-		//"flip" that atom
-		setLocalM( a, flippingAlgorithm(s, random),
-				Vector::sphericalForm(F * random(), 2 * PI * random(), asin(2 * random() - 1)) );
-		
-		Results r2 = getResults(); //get the energy of the system (for the new state)
-		double dU = r2.U - r.U;  // delta-U (change in energy)
-		if( dU <= 0 || random() < pow( E, -dU / parameters.kT ) ) {
-			//either the new system requires less energy or external energy (kT) is disrupting it
-			r = r2; //in either case we keep the new system
-		} else {
-			//neither thing (above) happened so we revert the system
-			if (inMol) {
-				shared_ptr<Mol> mol = mols[a];
-				mol->spins[n] = s;
-				mol->fluxes[n] = f;
-			} else {
-				spins[a] = s; //revert the system by flipping the atom back
-				fluxes[a] = f;
-			}
-			results = r;
-		}
-	}
-	results.t += N;
-}
-
-void MSD::metropolis(unsigned long long N, unsigned long long freq) {
-	if( freq == 0 ) {
-		metropolis(N);
-		return;
-	}
-	while(true) {
-		record.push_back( getResults() );
-		if( N >= freq ) {
-			metropolis(freq);
-			N -= freq;
-		} else {
-			if( N != 0 )
-				metropolis(N);
-			break;
-		}
-	}
-}
-
-
-double MSD::specificHeat() const {
-	if (record.size() <= 1) {
-		return 0;  // <U^2> - <U>^2 == 0 if there is only 1 data point
-	}
-
-	const Results *r0 = &record.at(0);
-	double s = 0, s2 = 0;
-	for( size_t i = 1; i < record.size(); i++ ) {
-		const Results *r1 = &record[i];
-		
-		double dU = r1->U - r0->U;
-		double dt = r1->t - r0->t;
-		s += (r0->U + r1->U) * dt;  // trapizoidal rule (1/2 factored out)
-		s2 += ((dt/3 * dU + r0->U) * dU + sq(r0->U)) * dt;  // square of trapizoidal rule (linear interpolation)
-
-		r0 = r1;
-	}
-	// Note: r0 = & last record
-	double dt = r0->t - record[0].t;
-	double avg = 0.5 * s / dt;
-	double avgSq = s2 / dt;
-
-	return (avgSq - sq(avg)) / (n * parameters.kT * parameters.kT);
-}
-
-double MSD::specificHeat_L() const {
-	if (record.size() <= 1) {
-		return 0;  // <U^2> - <U>^2 == 0 if there is only 1 data point
-	}
-
-	const Results *r0 = &record.at(0);
-	double s = 0, s2 = 0;
-	for( size_t i = 1; i < record.size(); i++ ) {
-		const Results *r1 = &record[i];
-		
-		double dU = r1->UL - r0->UL;
-		double dt = r1->t - r0->t;
-		s += (r0->UL + r1->UL) * dt;  // trapizoidal rule (1/2 factored out)
-		s2 += ((dt/3 * dU + r0->UL) * dU + sq(r0->UL)) * dt;  // square of trapizoidal rule (linear interpolation)
-
-		r0 = r1;
-	}
-	// Note: r0 = & last record
-	double dt = r0->t - record[0].t;
-	double avg = 0.5 * s / dt;
-	double avgSq = s2 / dt;
-
-	return (avgSq - sq(avg)) / (nL * parameters.kT * parameters.kT);
-}
-
-double MSD::specificHeat_R() const {
-	if (record.size() <= 1) {
-		return 0;  // <U^2> - <U>^2 == 0 if there is only 1 data point
-	}
-
-	const Results *r0 = &record.at(0);
-	double s = 0, s2 = 0;
-	for( size_t i = 1; i < record.size(); i++ ) {
-		const Results *r1 = &record[i];
-		
-		double dU = r1->UR - r0->UR;
-		double dt = r1->t - r0->t;
-		s += (r0->UR + r1->UR) * dt;  // trapizoidal rule (1/2 factored out)
-		s2 += ((dt/3 * dU + r0->UR) * dU + sq(r0->UR)) * dt;  // square of trapizoidal rule (linear interpolation)
-
-		r0 = r1;
-	}
-	// Note: r0 = & last record
-	double dt = r0->t - record[0].t;
-	double avg = 0.5 * s / dt;
-	double avgSq = s2 / dt;
-
-	return (avgSq - sq(avg)) / (nR * parameters.kT * parameters.kT);
-}
-
-double MSD::specificHeat_m() const {
-	if (record.size() <= 1) {
-		return 0;  // <U^2> - <U>^2 == 0 if there is only 1 data point
-	}
-
-	const Results *r0 = &record.at(0);
-	double s = 0, s2 = 0;
-	for( size_t i = 1; i < record.size(); i++ ) {
-		const Results *r1 = &record[i];
-		
-		double dU = r1->Um - r0->Um;
-		double dt = r1->t - r0->t;
-		s += (r0->Um + r1->Um) * dt;  // trapizoidal rule (1/2 factored out)
-		s2 += ((dt/3 * dU + r0->Um) * dU + sq(r0->Um)) * dt;  // square of trapizoidal rule (linear interpolation)
-
-		r0 = r1;
-	}
-	// Note: r0 = & last record
-	double dt = r0->t - record[0].t;
-	double avg = 0.5 * s / dt;
-	double avgSq = s2 / dt;
-
-	return (avgSq - sq(avg)) / (n_m * parameters.kT * parameters.kT);
-}
-
-double MSD::specificHeat_mL() const {
-	if (record.size() <= 1) {
-		return 0;  // <U^2> - <U>^2 == 0 if there is only 1 data point
-	}
-
-	const Results *r0 = &record.at(0);
-	double s = 0, s2 = 0;
-	for( size_t i = 1; i < record.size(); i++ ) {
-		const Results *r1 = &record[i];
-		
-		double dU = r1->UmL - r0->UmL;
-		double dt = r1->t - r0->t;
-		s += (r0->UmL + r1->UmL) * dt;  // trapizoidal rule (1/2 factored out)
-		s2 += ((dt/3 * dU + r0->UmL) * dU + sq(r0->UmL)) * dt;  // square of trapizoidal rule (linear interpolation)
-
-		r0 = r1;
-	}
-	// Note: r0 = & last record
-	double dt = r0->t - record[0].t;
-	double avg = 0.5 * s / dt;
-	double avgSq = s2 / dt;
-
-	return (avgSq - sq(avg)) / (n_mL * parameters.kT * parameters.kT);
-}
-
-double MSD::specificHeat_mR() const {
-	if (record.size() <= 1) {
-		return 0;  // <U^2> - <U>^2 == 0 if there is only 1 data point
-	}
-
-	const Results *r0 = &record.at(0);
-	double s = 0, s2 = 0;
-	for( size_t i = 1; i < record.size(); i++ ) {
-		const Results *r1 = &record[i];
-		
-		double dU = r1->UmR - r0->UmR;
-		double dt = r1->t - r0->t;
-		s += (r0->UmR + r1->UmR) * dt;  // trapizoidal rule (1/2 factored out)
-		s2 += ((dt/3 * dU + r0->UmR) * dU + sq(r0->UmR)) * dt;  // square of trapizoidal rule (linear interpolation)
-
-		r0 = r1;
-	}
-	// Note: r0 = & last record
-	double dt = r0->t - record[0].t;
-	double avg = 0.5 * s / dt;
-	double avgSq = s2 / dt;
-
-	return (avgSq - sq(avg)) / (n_mR * parameters.kT * parameters.kT);
-}
-
-double MSD::specificHeat_LR() const {
-	if (record.size() <= 1) {
-		return 0;  // <U^2> - <U>^2 == 0 if there is only 1 data point
-	}
-
-	const Results *r0 = &record.at(0);
-	double s = 0, s2 = 0;
-	for( size_t i = 1; i < record.size(); i++ ) {
-		const Results *r1 = &record[i];
-		
-		double dU = r1->ULR - r0->ULR;
-		double dt = r1->t - r0->t;
-		s += (r0->ULR + r1->ULR) * dt;  // trapizoidal rule (1/2 factored out)
-		s2 += ((dt/3 * dU + r0->ULR) * dU + sq(r0->ULR)) * dt;  // square of trapizoidal rule (linear interpolation)
-
-		r0 = r1;
-	}
-	// Note: r0 = & last record
-	double dt = r0->t - record[0].t;
-	double avg = 0.5 * s / dt;
-	double avgSq = s2 / dt;
-
-	return (avgSq - sq(avg)) / (nLR * parameters.kT * parameters.kT);
-}
-
-double MSD::magneticSusceptibility() const {
-	if (record.size() <= 1) {
-		return 0;  // <U^2> - <U>^2 == 0 if there is only 1 data point
-	}
-
-	const Results *r0 = &record.at(0);
-	Vector s = Vector::ZERO;
-	double s2 = 0;
-	for( size_t i = 1; i < record.size(); i++ ) {
-		const Results *r1 = &record[i];
-		
-		Vector dM = r1->M - r0->M;
-		double dt = r1->t - r0->t;
-		s += (r0->M + r1->M) * dt;  // trapizoidal rule (1/2 factored out)
-		s2 += ((dt/3 * dM + r0->M) * dM + r0->M * r0->M) * dt;  // square of trapizoidal rule (linear interpolation)
-
-		r0 = r1;
-	}
-	// Note: r0 = & last record
-	double dt = r0->t - record[0].t;
-	Vector avg = 0.5 / dt * s;
-	double avgSq = s2 / dt;
-
-	return (avgSq - avg * avg) / (n * parameters.kT * parameters.kT);
-}
-
-double MSD::magneticSusceptibility_L() const {
-	if (record.size() <= 1) {
-		return 0;  // <U^2> - <U>^2 == 0 if there is only 1 data point
-	}
-
-	const Results *r0 = &record.at(0);
-	Vector s = Vector::ZERO;
-	double s2 = 0;
-	for( size_t i = 1; i < record.size(); i++ ) {
-		const Results *r1 = &record[i];
-		
-		Vector dM = r1->ML - r0->ML;
-		double dt = r1->t - r0->t;
-		s += (r0->ML + r1->ML) * dt;  // trapizoidal rule (1/2 factored out)
-		s2 += ((dt/3 * dM + r0->ML) * dM + r0->ML * r0->ML) * dt;  // square of trapizoidal rule (linear interpolation)
-
-		r0 = r1;
-	}
-	// Note: r0 = & last record
-	double dt = r0->t - record[0].t;
-	Vector avg = 0.5 / dt * s;
-	double avgSq = s2 / dt;
-
-	return (avgSq - avg * avg) / (nL * parameters.kT * parameters.kT);
-}
-
-double MSD::magneticSusceptibility_R() const {
-	if (record.size() <= 1) {
-		return 0;  // <U^2> - <U>^2 == 0 if there is only 1 data point
-	}
-
-	const Results *r0 = &record.at(0);
-	Vector s = Vector::ZERO;
-	double s2 = 0;
-	for( size_t i = 1; i < record.size(); i++ ) {
-		const Results *r1 = &record[i];
-		
-		Vector dM = r1->MR - r0->MR;
-		double dt = r1->t - r0->t;
-		s += (r0->MR + r1->MR) * dt;  // trapizoidal rule (1/2 factored out)
-		s2 += ((dt/3 * dM + r0->MR) * dM + r0->MR * r0->MR) * dt;  // square of trapizoidal rule (linear interpolation)
-
-		r0 = r1;
-	}
-	// Note: r0 = & last record
-	double dt = r0->t - record[0].t;
-	Vector avg = 0.5 / dt * s;
-	double avgSq = s2 / dt;
-
-	return (avgSq - avg * avg) / (nR * parameters.kT * parameters.kT);
-}
-
-double MSD::magneticSusceptibility_m() const {
-	if (record.size() <= 1) {
-		return 0;  // <U^2> - <U>^2 == 0 if there is only 1 data point
-	}
-
-	const Results *r0 = &record.at(0);
-	Vector s = Vector::ZERO;
-	double s2 = 0;
-	for( size_t i = 1; i < record.size(); i++ ) {
-		const Results *r1 = &record[i];
-		
-		Vector dM = r1->Mm - r0->Mm;
-		double dt = r1->t - r0->t;
-		s += (r0->Mm + r1->Mm) * dt;  // trapizoidal rule (1/2 factored out)
-		s2 += ((dt/3 * dM + r0->Mm) * dM + r0->Mm * r0->Mm) * dt;  // square of trapizoidal rule (linear interpolation)
-
-		r0 = r1;
-	}
-	// Note: r0 = & last record
-	double dt = r0->t - record[0].t;
-	Vector avg = 0.5 / dt * s;
-	double avgSq = s2 / dt;
-
-	return (avgSq - avg * avg) / (n_m * parameters.kT * parameters.kT);
-}
-
-
-Vector MSD::meanM() const {
-	if( record.size() <= 1 )
-		return record.at(0).M;
-	//compensates for t by using the trapezoidal rule; (and the same below)
-	Vector s = Vector::ZERO;
-	for( size_t i = 1; i < record.size(); i++ ) {
-		const Results &r0 = record[i - 1];
-		const Results &r1 = record[i];
-		s += (r1.t - r0.t) * (r0.M + r1.M);
-	}
-	return (0.5 / (record[record.size() - 1].t - record[0].t)) * s;
-}
-
-Vector MSD::meanML() const {
-	if( record.size() <= 1 )
-		return record.at(0).ML;
-	Vector s = Vector::ZERO;
-	for( size_t i = 1; i < record.size(); i++ ) {
-		const Results &r0 = record[i - 1];
-		const Results &r1 = record[i];
-		s += (r1.t - r0.t) * (r0.ML + r1.ML);
-	}
-	return (0.5 / (record[record.size() - 1].t - record[0].t)) * s;
-}
-
-Vector MSD::meanMR() const {
-	if( record.size() <= 1 )
-		return record.at(0).MR;
-	Vector s = Vector::ZERO;
-	for( size_t i = 1; i < record.size(); i++ ) {
-		const Results &r0 = record[i - 1];
-		const Results &r1 = record[i];
-		s += (r1.t - r0.t) * (r0.MR + r1.MR);
-	}
-	return (0.5 / (record[record.size() - 1].t - record[0].t)) * s;
-}
-
-Vector MSD::meanMm() const {
-	if( record.size() <= 1 )
-		return record.at(0).Mm;
-	Vector s = Vector::ZERO;
-	for( size_t i = 1; i < record.size(); i++ ) {
-		const Results &r0 = record[i - 1];
-		const Results &r1 = record[i];
-		s += (r1.t - r0.t) * (r0.Mm + r1.Mm);
-	}
-	return (0.5 / (record[record.size() - 1].t - record[0].t)) * s;
-}
-
-Vector MSD::meanMS() const {
-	if( record.size() <= 1 )
-		return record.at(0).MS;
-	//compensates for t by using the trapezoidal rule; (and the same below)
-	Vector s = Vector::ZERO;
-	for( size_t i = 1; i < record.size(); i++ ) {
-		const Results &r0 = record[i - 1];
-		const Results &r1 = record[i];
-		s += (r1.t - r0.t) * (r0.MS + r1.MS);
-	}
-	return (0.5 / (record[record.size() - 1].t - record[0].t)) * s;
-}
-
-Vector MSD::meanMSL() const {
-	if( record.size() <= 1 )
-		return record.at(0).MSL;
-	Vector s = Vector::ZERO;
-	for( size_t i = 1; i < record.size(); i++ ) {
-		const Results &r0 = record[i - 1];
-		const Results &r1 = record[i];
-		s += (r1.t - r0.t) * (r0.MSL + r1.MSL);
-	}
-	return (0.5 / (record[record.size() - 1].t - record[0].t)) * s;
-}
-
-Vector MSD::meanMSR() const {
-	if( record.size() <= 1 )
-		return record.at(0).MSR;
-	Vector s = Vector::ZERO;
-	for( size_t i = 1; i < record.size(); i++ ) {
-		const Results &r0 = record[i - 1];
-		const Results &r1 = record[i];
-		s += (r1.t - r0.t) * (r0.MSR + r1.MSR);
-	}
-	return (0.5 / (record[record.size() - 1].t - record[0].t)) * s;
-}
-
-Vector MSD::meanMSm() const {
-	if( record.size() <= 1 )
-		return record.at(0).MSm;
-	Vector s = Vector::ZERO;
-	for( size_t i = 1; i < record.size(); i++ ) {
-		const Results &r0 = record[i - 1];
-		const Results &r1 = record[i];
-		s += (r1.t - r0.t) * (r0.MSm + r1.MSm);
-	}
-	return (0.5 / (record[record.size() - 1].t - record[0].t)) * s;
-}
-
-Vector MSD::meanMF() const {
-	if( record.size() <= 1 )
-		return record.at(0).MF;
-	//compensates for t by using the trapezoidal rule; (and the same below)
-	Vector s = Vector::ZERO;
-	for( size_t i = 1; i < record.size(); i++ ) {
-		const Results &r0 = record[i - 1];
-		const Results &r1 = record[i];
-		s += (r1.t - r0.t) * (r0.MF + r1.MF);
-	}
-	return (0.5 / (record[record.size() - 1].t - record[0].t)) * s;
-}
-
-Vector MSD::meanMFL() const {
-	if( record.size() <= 1 )
-		return record.at(0).MFL;
-	Vector s = Vector::ZERO;
-	for( size_t i = 1; i < record.size(); i++ ) {
-		const Results &r0 = record[i - 1];
-		const Results &r1 = record[i];
-		s += (r1.t - r0.t) * (r0.MFL + r1.MFL);
-	}
-	return (0.5 / (record[record.size() - 1].t - record[0].t)) * s;
-}
-
-Vector MSD::meanMFR() const {
-	if( record.size() <= 1 )
-		return record.at(0).MFR;
-	Vector s = Vector::ZERO;
-	for( size_t i = 1; i < record.size(); i++ ) {
-		const Results &r0 = record[i - 1];
-		const Results &r1 = record[i];
-		s += (r1.t - r0.t) * (r0.MFR + r1.MFR);
-	}
-	return (0.5 / (record[record.size() - 1].t - record[0].t)) * s;
-}
-
-Vector MSD::meanMFm() const {
-	if( record.size() <= 1 )
-		return record.at(0).MFm;
-	Vector s = Vector::ZERO;
-	for( size_t i = 1; i < record.size(); i++ ) {
-		const Results &r0 = record[i - 1];
-		const Results &r1 = record[i];
-		s += (r1.t - r0.t) * (r0.MFm + r1.MFm);
-	}
-	return (0.5 / (record[record.size() - 1].t - record[0].t)) * s;
-}
-
-double MSD::meanU() const {
-	if( record.size() <= 1 )
-		return record.at(0).U;
-	double s = 0;
-	for( size_t i = 1; i < record.size(); i++ ) {
-		const Results &r0 = record[i - 1];
-		const Results &r1 = record[i];
-		s += (r1.t - r0.t) * (r0.U + r1.U);
-	}
-	return (0.5 / (record[record.size() - 1].t - record[0].t)) * s;
-}
-
-double MSD::meanUL() const {
-	if( record.size() <= 1 )
-		return record.at(0).UL;
-	double s = 0;
-	for( size_t i = 1; i < record.size(); i++ ) {
-		const Results &r0 = record[i - 1];
-		const Results &r1 = record[i];
-		s += (r1.t - r0.t) * (r0.UL + r1.UL);
-	}
-	return (0.5 / (record[record.size() - 1].t - record[0].t)) * s;
-}
-
-double MSD::meanUR() const {
-	if( record.size() <= 1 )
-		return record.at(0).UR;
-	double s = 0;
-	for( size_t i = 1; i < record.size(); i++ ) {
-		const Results &r0 = record[i - 1];
-		const Results &r1 = record[i];
-		s += (r1.t - r0.t) * (r0.UR + r1.UR);
-	}
-	return (0.5 / (record[record.size() - 1].t - record[0].t)) * s;
-}
-
-double MSD::meanUm() const {
-	if( record.size() <= 1 )
-		return record.at(0).Um;
-	double s = 0;
-	for( size_t i = 1; i < record.size(); i++ ) {
-		const Results &r0 = record[i - 1];
-		const Results &r1 = record[i];
-		s += (r1.t - r0.t) * (r0.Um + r1.Um);
-	}
-	return (0.5 / (record[record.size() - 1].t - record[0].t)) * s;
-}
-
-double MSD::meanUmL() const {
-	if( record.size() <= 1 )
-		return record.at(0).UmL;
-	double s = 0;
-	for( size_t i = 1; i < record.size(); i++ ) {
-		const Results &r0 = record[i - 1];
-		const Results &r1 = record[i];
-		s += (r1.t - r0.t) * (r0.UmL + r1.UmL);
-	}
-	return (0.5 / (record[record.size() - 1].t - record[0].t)) * s;
-}
-
-double MSD::meanUmR() const {
-	if( record.size() <= 1 )
-		return record.at(0).UmR;
-	double s = 0;
-	for( size_t i = 1; i < record.size(); i++ ) {
-		const Results &r0 = record[i - 1];
-		const Results &r1 = record[i];
-		s += (r1.t - r0.t) * (r0.UmR + r1.UmR);
-	}
-	return (0.5 / (record[record.size() - 1].t - record[0].t)) * s;
-}
-
-double MSD::meanULR() const {
-	if( record.size() <= 1 )
-		return record.at(0).ULR;
-	double s = 0;
-	for( size_t i = 1; i < record.size(); i++ ) {
-		const Results &r0 = record[i - 1];
-		const Results &r1 = record[i];
-		s += (r1.t - r0.t) * (r0.ULR + r1.ULR);
-	}
-	return (0.5 / (record[record.size() - 1].t - record[0].t)) * s;
-}
-
-
-MSD::Iterator MSD::begin() const {
-	return Iterator(*this, 0);
-}
-
-MSD::Iterator MSD::end() const {
-	return Iterator(*this, indices.size());
+UDC_FAST_MSD_TARGET("avx512f") __m512d FastMSD::gather8(const float *p, __m256i j) {
+	return _mm512_cvtps_pd(_mm256_i32gather_ps(p, j, 4));
 }
 
+#endif
 
-} //end of namespace
+}  // end of namespace udc
 
 #endif
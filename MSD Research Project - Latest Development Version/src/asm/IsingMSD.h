@@ -0,0 +1,665 @@
+/**
+ * @file IsingMSD.h
+ * @author Christopher D'Angelo
+ * @brief
+ * 	<p> Contains udc::IsingMSD, an engine for MSD::UP_DOWN_MODEL simulations without flux. Then every
+ * 	spin is +S or -S along one axis, forever, so each site is one bit (sigma = +1 or -1), and the only
+ * 	terms of the Hamiltonian that change are -J s*s' and -B*m. (The others, e.g. b (m*m')^2, anisotropy,
+ * 	and DMI, are constant, or 0, for parallel and antiparallel spins.) </p>
+ *
+ * 	<p> Sites are colored (like a checkerboard) so that no two neighbors have the same color, and each
+ * 	color's sites are packed 64 to a 64-bit word: a word of spins (1 is sigma = -1), and for each bond of
+ * 	the sites, a word of which ones are antiparallel to that neighbor, kept up-to-date as spins flip. </p>
+ *
+ * 	<p> Words of sites that are alike (the same S and region, and every bond with the same J S' and Bond)
+ * 	are multi-spin coded: 64 sites are tried at once, with bitwise operations. Their energy changes can
+ * 	only be 2 S (J S' (degree - 2 n) + sigma B*axis), where n is how many neighbors are antiparallel, so
+ * 	bit-sliced counters find each site's n, and each (n, sigma)'s acceptance probability is precomputed
+ * 	(the Boltzmann table). Each site's random number is compared with it one bit at a time, from the top,
+ * 	for all 64 sites at once, until every site is decided (usually after about 8 random words).
+ * 	Other sites (e.g. at the interfaces, or in the molecule) are tried one at a time, with a Boltzmann
+ * 	table for each pattern of antiparallel neighbors. </p>
+ *
+ * 	<p> Since 64 sites are tried at once, metropolis sweeps the sites color by color, instead of picking
+ * 	each one at random. So it has the same equilibrium (Boltzmann distribution) as MSD::metropolis, but not
+ * 	the same trajectory. Results (including t, the number of sites tried) are the same as an MSD's. </p>
+ *
+ * @version 7.0
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2011-2026
+ */
+
+#ifndef UDC_ISING_MSD
+#define UDC_ISING_MSD
+
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "FastMSD.h"
+#include "../MSD.h"
+#include "../Vector.h"
+
+#ifdef _MSC_VER
+	#include <intrin.h>  // __popcnt64
+#endif
+
+
+namespace udc {
+
+using std::invalid_argument;
+using std::mt19937_64;
+using std::uint64_t;
+
+using udc::sq;
+using udc::Vector;
+
+
+class IsingMSD {
+ public:
+	typedef MSD::Results Results;
+	typedef MSD::RecordSink RecordSink;
+
+	/** The most bonds a site can have. */
+	static const unsigned int MAX_DEGREE = 8;
+
+	/**
+	 * Copies the MSD's sites, parameters, state, Results, and seed. The MSD's flippingAlgorithm is assumed
+	 * to be MSD::UP_DOWN_MODEL.
+	 * @throw invalid_argument if any F or flux isn't 0, the spins aren't all +S or -S along one axis,
+	 * 	the MSD has a dipolar field, or a site has more than MAX_DEGREE bonds
+	 */
+	explicit IsingMSD(const MSD &msd);
+
+	unsigned int getN() const;
+	unsigned int getIndex(unsigned int node) const;  // in the MSD (nodes are in MSD::Iterator order)
+	unsigned int getColors() const;  // how many colors the sites needed (e.g. 2 for simple cubic)
+
+	Vector getAxis() const;
+	int getSigma(unsigned int node) const;  // +1 or -1: the spin is sigma * S * getAxis()
+	Vector getSpin(unsigned int node) const;
+	Vector getFlux(unsigned int node) const;  // always ZERO
+	Vector getLocalM(unsigned int node) const;
+	void flip(unsigned int node);
+	void randomize();  // every sigma +1 or -1 at random (doesn't change t)
+
+	Results getResults() const;
+
+	/** Sums the Results of the current state from scratch (t is kept), e.g. to check for drift. */
+	Results computeResults() const;
+
+	double get_kT() const;
+	void set_kT(double kT);
+	Vector getB() const;
+	void setB(const Vector &B);
+
+	void setSeed(unsigned long seed);
+	unsigned long getSeed() const;
+
+	/** Tries N sites: the next N of the sweep (which continues where the last call left off). */
+	void metropolis(unsigned long long N);
+	void metropolis(unsigned long long N, unsigned long long freq);  // same as MSD::metropolis(N, freq)
+
+	std::vector<Results> record;
+	RecordSink *recordSink;  // where metropolis(N, freq) sends Results. NULL (default) means "record". Not owned.
+
+ private:
+	FastMSD::Graph graph;  // (for computeResults)
+	unsigned int n;
+	Vector axis;
+	double kT;
+	Vector B;
+	Results results;
+
+	std::vector<double> S;                 // node -> spin magnitude
+	std::vector<unsigned char> region;     // node -> FastMSD::Region
+	std::vector<unsigned int> begin;       // node -> its first edge (and begin[n] == number of edges). Loops are left out.
+	std::vector<unsigned int> neighbors;   // edge -> node
+	std::vector<double> w;                 // edge -> J S' (so the bond's energy is -S w sigma sigma')
+	std::vector<unsigned char> bond;       // edge -> FastMSD::Bond
+	std::vector<unsigned int> twin;        // edge -> the neighbor's bit for this bond in "anti": 64 * word + bit
+
+	// Sites that are alike share a Boltzmann table. A pattern is: bit 0 set if sigma is -1, and bit k + 1 set if
+	// the site is antiparallel to the neighbor of its k-th edge. A site is accepted if dU <= 0 ("always"), or if a
+	// random 64-bit number is less than threshold (i.e. exp(-dU / kT) as a fraction of 2^64).
+	// A uniform Type (each edge has the same w and Bond) only needs a level for each (antiparallel count, sigma).
+	struct Type {
+		double S;
+		unsigned char region;
+		std::vector<double> w;
+		std::vector<unsigned char> bond;
+		bool uniform;
+		std::vector<bool> always;         // level (uniform: 2 * count + sigma bit) or pattern -> dU <= 0
+		std::vector<uint64_t> threshold;  // level or pattern -> accept if a random number is less
+	};
+	std::vector<Type> types;
+	std::vector<unsigned int> nodeType;
+
+	// 64 sites of one color. If uniform, they have the same Type, and are multi-spin coded.
+	struct Block {
+		bool uniform;
+		unsigned int type;
+		uint64_t valid;  // which bits have sites
+	};
+	std::vector<Block> blocks;               // color by color
+	std::vector<unsigned int> blockNodes;    // 64 * block + bit -> node
+	std::vector<unsigned int> blockOf;       // node -> block
+	std::vector<unsigned char> bitOf;        // node -> bit
+	std::vector<uint64_t> spins;             // block -> bit set if sigma is -1
+	std::vector<uint64_t> anti;              // MAX_DEGREE * block + k -> bit set if the site and the neighbor of its k-th edge are antiparallel
+	unsigned int colors;
+
+	// where the sweep is: the next block, and its sites already tried
+	unsigned int cursor;
+	uint64_t cursorDone;
+
+	mt19937_64 prng;
+	unsigned long seed;
+
+	void buildTables();  // for kT and B
+	uint64_t thresholdFor(double dU) const;
+
+	void tryUniform(unsigned int b, uint64_t mask);  // multi-spin coded
+	void trySites(unsigned int b, uint64_t mask);    // one at a time
+	void flipBits(unsigned int b, uint64_t bits);    // updates spins and anti, but not results
+	void flipResults(unsigned int node, double dU[6]);  // the Results after node flips (dU: each Bond's change in U)
+
+	static unsigned int popcount(uint64_t x);
+	static unsigned int lowestBit(uint64_t x);  // x != 0
+	static Vector& regionM(Results &r, unsigned int region);
+	static Vector& regionMS(Results &r, unsigned int region);
+	static double& bondU(Results &r, unsigned int bond);
+};
+
+
+//--------------------------------------------------------------------------------
+
+IsingMSD::IsingMSD(const MSD &msd)
+: graph(FastMSD::Graph::fromMSD(msd)), kT(msd.getParameters().kT), B(msd.getParameters().B), results(msd.getResults()) {
+	if (msd.getDipolarStrength() != 0)
+		throw invalid_argument("IsingMSD doesn't support the dipolar field");
+	for (const FastMSD::NodeClass &c : graph.nodeClasses)
+		if (c.F != 0)
+			throw invalid_argument("IsingMSD needs every F to be 0");
+	n = (unsigned int) graph.indices.size();
+	record.clear();
+	recordSink = NULL;
+
+	// each site's S, and sigma along the axis of the first nonzero spin
+	const MSD::Parameters p = msd.getParameters();
+	unsigned int width, height, depth, molPosL, molPosR;
+	msd.getDimensions(width, height, depth);
+	msd.getMolPos(molPosL, molPosR);
+	axis = Vector::J;
+	for (unsigned int i = 0; i < n; i++)
+		if (msd.getSpin(graph.indices[i]) != Vector::ZERO) {
+			axis = msd.getSpin(graph.indices[i]).normalize();
+			break;
+		}
+	std::vector<bool> down(n);
+	for (unsigned int i = 0; i < n; i++) {
+		const unsigned int a = graph.indices[i];
+		region.push_back((unsigned char) graph.nodeClasses[graph.nodeClass[i]].region);
+		S.push_back(region[i] == FastMSD::FM_L ? p.SL : region[i] == FastMSD::FM_R ? p.SR
+				: msd.getMolProto().getNodeParameters(a % width - molPosL).Sm);
+		const Vector s = msd.getSpin(a);
+		down[i] = s * axis < 0;
+		if ((s - (down[i] ? -S[i] : S[i]) * axis).norm() > 1e-9 * (1 + S[i]) || msd.getFlux(a) != Vector::ZERO)
+			throw invalid_argument("IsingMSD needs every spin to be +S or -S along one axis, and every flux to be 0");
+	}
+
+	// the edges, without loops (whose energy is constant)
+	for (unsigned int i = 0; i < n; i++) {
+		begin.push_back((unsigned int) neighbors.size());
+		for (unsigned int e = graph.offsets[i]; e < graph.offsets[i + 1]; e++) {
+			const unsigned int j = graph.neighbors[e];
+			if (j == i)
+				continue;
+			const FastMSD::EdgeClass &c = graph.edgeClasses[graph.edgeClass[e]];
+			neighbors.push_back(j);
+			w.push_back(c.J * S[j]);
+			bond.push_back((unsigned char) c.bond);
+		}
+		if (neighbors.size() - begin[i] > MAX_DEGREE)
+			throw invalid_argument("IsingMSD: a site has more than MAX_DEGREE bonds");
+	}
+	begin.push_back((unsigned int) neighbors.size());
+
+	// color greedily, then sort out the Types
+	std::vector<unsigned int> color(n);
+	colors = 0;
+	for (unsigned int i = 0; i < n; i++) {
+		std::vector<bool> used(MAX_DEGREE + 1, false);
+		for (unsigned int e = begin[i]; e < begin[i + 1]; e++)
+			if (neighbors[e] < i)
+				used[color[neighbors[e]]] = true;
+		color[i] = 0;
+		while (used[color[i]])
+			color[i]++;
+		colors = std::max(colors, color[i] + 1);
+	}
+	std::map<std::tuple<double, unsigned char, std::vector<double>, std::vector<unsigned char>>, unsigned int> typeIndex;
+	for (unsigned int i = 0; i < n; i++) {
+		Type t;
+		t.S = S[i];
+		t.region = region[i];
+		t.w.assign(w.begin() + begin[i], w.begin() + begin[i + 1]);
+		t.bond.assign(bond.begin() + begin[i], bond.begin() + begin[i + 1]);
+		t.uniform = true;
+		for (size_t k = 1; k < t.w.size(); k++)
+			t.uniform = t.uniform && t.w[k] == t.w[0] && t.bond[k] == t.bond[0];
+		auto key = std::make_tuple(t.S, t.region, t.w, t.bond);
+		auto found = typeIndex.find(key);
+		if (found == typeIndex.end()) {
+			found = typeIndex.emplace(key, (unsigned int) types.size()).first;
+			types.push_back(t);
+		}
+		nodeType.push_back(found->second);
+	}
+
+	// the Blocks: for each color, each uniform Type's sites, then the rest, 64 at a time
+	blockOf.resize(n);
+	bitOf.resize(n);
+	for (unsigned int c = 0; c < colors; c++) {
+		std::map<unsigned int, std::vector<unsigned int>> groups;  // uniform Type -> nodes, or (for the rest) types.size()
+		for (unsigned int i = 0; i < n; i++)
+			if (color[i] == c)
+				groups[types[nodeType[i]].uniform ? nodeType[i] : (unsigned int) types.size()].push_back(i);
+		for (const auto &g : groups)
+			for (size_t k = 0; k < g.second.size(); k += 64) {
+				const unsigned int b = (unsigned int) blocks.size();
+				blocks.push_back({ g.first != types.size(), g.first, 0 });
+				blockNodes.resize(64 * (blocks.size()), 0);
+				for (unsigned int bit = 0; bit < 64 && k + bit < g.second.size(); bit++) {
+					const unsigned int i = g.second[k + bit];
+					blocks[b].valid |= (uint64_t) 1 << bit;
+					blockNodes[64 * b + bit] = i;
+					blockOf[i] = b;
+					bitOf[i] = (unsigned char) bit;
+				}
+			}
+	}
+
+	// the state, and each edge's twin: the k-th edge from j to i, for the k-th edge from i to j
+	spins.assign(blocks.size(), 0);
+	anti.assign(MAX_DEGREE * blocks.size(), 0);
+	twin.resize(neighbors.size());
+	std::map<std::pair<unsigned int, unsigned int>, std::vector<unsigned int>> edgesBetween;  // (i, j) -> edges
+	for (unsigned int i = 0; i < n; i++)
+		for (unsigned int e = begin[i]; e < begin[i + 1]; e++)
+			edgesBetween[std::make_pair(i, neighbors[e])].push_back(e);
+	for (auto &between : edgesBetween) {
+		const unsigned int i = between.first.first, j = between.first.second;
+		const std::vector<unsigned int> &back = edgesBetween.at(std::make_pair(j, i));
+		for (size_t k = 0; k < between.second.size(); k++)
+			twin[between.second[k]] = 64 * (MAX_DEGREE * blockOf[j] + (back[k] - begin[j])) + bitOf[j];
+	}
+	for (unsigned int i = 0; i < n; i++) {
+		if (down[i])
+			spins[blockOf[i]] |= (uint64_t) 1 << bitOf[i];
+		for (unsigned int e = begin[i]; e < begin[i + 1]; e++)
+			if (down[i] != down[neighbors[e]])
+				anti[MAX_DEGREE * blockOf[i] + (e - begin[i])] |= (uint64_t) 1 << bitOf[i];
+	}
+
+	cursor = 0;
+	cursorDone = 0;
+	buildTables();
+	setSeed(msd.getSeed());
+}
+
+
+void IsingMSD::buildTables() {
+	const double Ba = B * axis;
+	for (Type &t : types) {
+		const unsigned int degree = (unsigned int) t.w.size();
+		const unsigned int size = t.uniform ? 2 * (degree + 1) : 2u << degree;
+		t.always.assign(size, false);
+		t.threshold.assign(size, 0);
+		for (unsigned int k = 0; k < size; k++) {
+			const double sigma = (k & 1) != 0 ? -1 : 1;
+			double dU = 2 * Ba * t.S * sigma;
+			if (t.uniform) {
+				if (degree != 0)
+					dU += 2 * t.S * t.w[0] * sigma * sigma * (degree - 2.0 * (k >> 1));
+			} else {
+				for (unsigned int e = 0; e < degree; e++)
+					dU += 2 * t.S * t.w[e] * ((k & (2u << e)) != 0 ? -1 : 1);
+			}
+			t.always[k] = dU <= 0;
+			t.threshold[k] = t.always[k] ? 0 : thresholdFor(dU);
+		}
+	}
+}
+
+uint64_t IsingMSD::thresholdFor(double dU) const {
+	const double p = exp(-dU / kT);  // (0 if kT is 0)
+	return p >= 1 ? ~(uint64_t) 0 : (uint64_t) ldexp(p, 64);
+}
+
+
+unsigned int IsingMSD::getN() const {
+	return n;
+}
+
+unsigned int IsingMSD::getIndex(unsigned int node) const {
+	return graph.indices.at(node);
+}
+
+unsigned int IsingMSD::getColors() const {
+	return colors;
+}
+
+Vector IsingMSD::getAxis() const {
+	return axis;
+}
+
+int IsingMSD::getSigma(unsigned int node) const {
+	return (spins[blockOf.at(node)] >> bitOf[node] & 1) != 0 ? -1 : 1;
+}
+
+Vector IsingMSD::getSpin(unsigned int node) const {
+	return (getSigma(node) * S[node]) * axis;
+}
+
+Vector IsingMSD::getFlux(unsigned int node) const {
+	if (node >= n)
+		throw std::out_of_range("IsingMSD::getFlux: no such node");
+	return Vector::ZERO;
+}
+
+Vector IsingMSD::getLocalM(unsigned int node) const {
+	return getSpin(node);
+}
+
+void IsingMSD::flip(unsigned int node) {
+	const unsigned int b = blockOf.at(node);
+	double dU[6] = { 0, 0, 0, 0, 0, 0 };
+	const double sigma = getSigma(node);
+	dU[region[node]] = 2 * (B * axis) * S[node] * sigma;  // (Region FM_L, FM_R, and MOL are BOND_L, BOND_R, and BOND_M)
+	for (unsigned int e = begin[node]; e < begin[node + 1]; e++)
+		dU[bond[e]] += 2 * S[node] * w[e] * sigma * getSigma(neighbors[e]);
+	flipResults(node, dU);
+	flipBits(b, (uint64_t) 1 << bitOf[node]);
+}
+
+void IsingMSD::randomize() {
+	for (unsigned int i = 0; i < n; i++)
+		if ((prng() & 1) != 0)
+			flip(i);
+}
+
+
+IsingMSD::Results IsingMSD::getResults() const {
+	return results;
+}
+
+IsingMSD::Results IsingMSD::computeResults() const {
+	// the same sums as FastMSD::computeResults, where every flux is ZERO
+	Results r;
+	r.t = results.t;
+	for (unsigned int i = 0; i < n; i++) {
+		const FastMSD::NodeClass &c = graph.nodeClasses[graph.nodeClass[i]];
+		const Vector m = getSpin(i);
+		r.M += m;
+		r.MS += m;
+		regionM(r, region[i]) += m;
+		regionMS(r, region[i]) += m;
+
+		double U = B * m + c.A.squareDot(m);
+		r.U -= U;
+		bondU(r, region[i]) -= U;
+
+		for (unsigned int e = graph.offsets[i]; e < graph.offsets[i + 1]; e++) {
+			const unsigned int j = graph.neighbors[e];
+			if (graph.indices[j] <= graph.indices[i])
+				continue;  // each bond once (and loops never)
+			const FastMSD::EdgeClass &ec = graph.edgeClasses[graph.edgeClass[e]];
+			const Vector nm = getSpin(j);
+			double U = ec.J * (nm * m) + ec.b * sq(nm * m) + (graph.direction[e] * ec.D).crossDot(m, nm);
+			r.U -= U;
+			bondU(r, ec.bond) -= U;
+		}
+	}
+	return r;
+}
+
+double IsingMSD::get_kT() const {
+	return kT;
+}
+
+void IsingMSD::set_kT(double kT) {
+	this->kT = kT;
+	buildTables();
+}
+
+Vector IsingMSD::getB() const {
+	return B;
+}
+
+void IsingMSD::setB(const Vector &B) {
+	// same as MSD::setB
+	Vector deltaB = B - this->B;
+	results.UL -= deltaB * results.ML;
+	results.UR -= deltaB * results.MR;
+	results.Um -= deltaB * results.Mm;
+	results.U = results.UL + results.UR + results.Um + results.UmL + results.UmR + results.ULR;
+	this->B = B;
+	buildTables();
+}
+
+void IsingMSD::setSeed(unsigned long seed) {
+	this->seed = seed;
+	prng.seed(seed);
+}
+
+unsigned long IsingMSD::getSeed() const {
+	return seed;
+}
+
+
+void IsingMSD::metropolis(unsigned long long N) {
+	results.t += N;
+	if (blocks.empty())
+		return;
+	while (N != 0) {
+		const Block &block = blocks[cursor];
+		uint64_t mask = block.valid & ~cursorDone;
+		if (popcount(mask) > N) {
+			uint64_t first = 0;  // the lowest N sites
+			for (unsigned long long k = 0; k < N; k++)
+				first |= (uint64_t) 1 << lowestBit(mask & ~first);
+			mask = first;
+		}
+		if (block.uniform)
+			tryUniform(cursor, mask);
+		else
+			trySites(cursor, mask);
+		N -= popcount(mask);
+		cursorDone |= mask;
+		if (cursorDone == block.valid) {
+			cursor = (cursor + 1) % (unsigned int) blocks.size();
+			cursorDone = 0;
+		}
+	}
+}
+
+void IsingMSD::metropolis(unsigned long long N, unsigned long long freq) {
+	if (freq == 0) {
+		metropolis(N);
+		return;
+	}
+	while (true) {
+		if (recordSink == NULL)
+			record.push_back(getResults());
+		else
+			recordSink->put(getResults());
+		if (N >= freq) {
+			metropolis(freq);
+			N -= freq;
+		} else {
+			if (N != 0)
+				metropolis(N);
+			break;
+		}
+	}
+}
+
+
+void IsingMSD::tryUniform(unsigned int b, uint64_t mask) {
+	const Type &t = types[blocks[b].type];
+	const unsigned int degree = (unsigned int) t.w.size();
+	const uint64_t s = spins[b];
+	const uint64_t *x = &anti[MAX_DEGREE * b];
+
+	// bit-sliced counters: the number of antiparallel neighbors of each site is (c3 c2 c1 c0) in binary
+	uint64_t c0 = 0, c1 = 0, c2 = 0, c3 = 0;
+	for (unsigned int k = 0; k < degree; k++) {
+		uint64_t carry = c0 & x[k];
+		c0 ^= x[k];
+		uint64_t carry1 = c1 & carry;
+		c1 ^= carry;
+		c3 |= c2 & carry1;
+		c2 ^= carry1;
+	}
+
+	// the sites at each level (2 * count + sigma bit), and which are accepted outright or still undecided
+	uint64_t level[2 * (MAX_DEGREE + 1)];
+	uint64_t accept = 0, undecided = 0;
+	for (unsigned int count = 0; count <= degree; count++) {
+		const uint64_t is = mask & ((count & 1) != 0 ? c0 : ~c0) & ((count & 2) != 0 ? c1 : ~c1)
+		                  & ((count & 4) != 0 ? c2 : ~c2) & ((count & 8) != 0 ? c3 : ~c3);
+		level[2 * count] = is & ~s;
+		level[2 * count + 1] = is & s;
+	}
+	const unsigned int levels = 2 * (degree + 1);
+	for (unsigned int k = 0; k < levels; k++) {
+		if (t.always[k])
+			accept |= level[k];
+		else if (t.threshold[k] != 0)
+			undecided |= level[k];
+	}
+
+	// each site's random number (r) against its threshold (p), one bit at a time from the top:
+	// the first bit where they differ decides r < p (and sites still undecided, r == p, are rejected)
+	for (int bit = 63; bit >= 0 && undecided != 0; bit--) {
+		uint64_t p = 0;
+		for (unsigned int k = 0; k < levels; k++)
+			if ((t.threshold[k] >> bit & 1) != 0)
+				p |= level[k];
+		const uint64_t r = prng();
+		accept |= undecided & p & ~r;
+		undecided &= ~(p ^ r);
+	}
+	if (accept == 0)
+		return;
+
+	// the Results: every site at a level has the same dU, and the same change in M
+	const double Ba = B * axis;
+	double dU = 0, dUregion = 0;
+	for (unsigned int k = 0; k < levels; k++) {
+		const unsigned int flipped = popcount(accept & level[k]);
+		if (flipped == 0)
+			continue;
+		const double sigma = (k & 1) != 0 ? -1 : 1;
+		if (degree != 0)
+			dU += flipped * 2 * t.S * t.w[0] * (degree - 2.0 * (k >> 1));
+		dUregion += flipped * 2 * Ba * t.S * sigma;
+	}
+	const Vector deltaM = (2.0 * t.S * ((double) popcount(accept & s) - (double) popcount(accept & ~s))) * axis;
+	results.M += deltaM;
+	results.MS += deltaM;
+	regionM(results, t.region) += deltaM;
+	regionMS(results, t.region) += deltaM;
+	if (degree != 0)
+		bondU(results, t.bond[0]) += dU;
+	bondU(results, t.region) += dUregion;
+	results.U += dU + dUregion;
+
+	flipBits(b, accept);
+}
+
+void IsingMSD::trySites(unsigned int b, uint64_t mask) {
+	const uint64_t *x = &anti[MAX_DEGREE * b];
+	while (mask != 0) {
+		const unsigned int bit = lowestBit(mask);
+		mask &= mask - 1;
+		const unsigned int node = blockNodes[64 * b + bit];
+		const Type &t = types[nodeType[node]];
+		unsigned int pattern = (unsigned int) (spins[b] >> bit & 1);
+		for (unsigned int k = 0; k < t.w.size(); k++)
+			pattern |= (unsigned int) (x[k] >> bit & 1) << (k + 1);
+		if (t.always[pattern] || (t.threshold[pattern] != 0 && prng() < t.threshold[pattern]))
+			flip(node);
+	}
+}
+
+void IsingMSD::flipBits(unsigned int b, uint64_t bits) {
+	spins[b] ^= bits;
+	for (uint64_t rest = bits; rest != 0; rest &= rest - 1) {
+		const unsigned int bit = lowestBit(rest);
+		const unsigned int node = blockNodes[64 * b + bit];
+		for (unsigned int e = begin[node]; e < begin[node + 1]; e++) {
+			anti[MAX_DEGREE * b + (e - begin[node])] ^= (uint64_t) 1 << bit;
+			anti[twin[e] / 64] ^= (uint64_t) 1 << (twin[e] % 64);
+		}
+	}
+}
+
+void IsingMSD::flipResults(unsigned int node, double dU[6]) {
+	const Vector deltaM = (-2.0 * getSigma(node) * S[node]) * axis;
+	results.M += deltaM;
+	results.MS += deltaM;
+	regionM(results, region[node]) += deltaM;
+	regionMS(results, region[node]) += deltaM;
+	for (unsigned int k = 0; k < 6; k++) {
+		results.U += dU[k];
+		bondU(results, k) += dU[k];
+	}
+}
+
+
+unsigned int IsingMSD::popcount(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+	return (unsigned int) __builtin_popcountll(x);
+#elif defined(_MSC_VER) && defined(_M_X64)
+	return (unsigned int) __popcnt64(x);
+#else
+	unsigned int count = 0;
+	for (; x != 0; x &= x - 1)
+		count++;
+	return count;
+#endif
+}
+
+unsigned int IsingMSD::lowestBit(uint64_t x) {
+	return popcount((x & (~x + 1)) - 1);
+}
+
+Vector& IsingMSD::regionM(Results &r, unsigned int region) {
+	return region == FastMSD::FM_L ? r.ML : region == FastMSD::FM_R ? r.MR : r.Mm;
+}
+
+Vector& IsingMSD::regionMS(Results &r, unsigned int region) {
+	return region == FastMSD::FM_L ? r.MSL : region == FastMSD::FM_R ? r.MSR : r.MSm;
+}
+
+double& IsingMSD::bondU(Results &r, unsigned int bond) {
+	switch (bond) {
+		case FastMSD::BOND_L:  return r.UL;
+		case FastMSD::BOND_R:  return r.UR;
+		case FastMSD::BOND_M:  return r.Um;
+		case FastMSD::BOND_ML: return r.UmL;
+		case FastMSD::BOND_MR: return r.UmR;
+		default:               return r.ULR;
+	}
+}
+
+}  // end of namespace udc
+
+#endif
@@ -0,0 +1,355 @@
+/**
+ * @file Topology.h
+ * @author Christopher D'Angelo
+ * @brief
+ * 	<p> Contains udc::Topology, which builds the sites and bonds of a udc::FastMSD (a FastMSD::Graph)
+ * 	for geometries other than MSD's simple-cubic FM_L/mol/FM_R box: bcc, fcc, and hcp lattices,
+ * 	multilayers (thin films), and meshes read from a site list and a bond list. </p>
+ *
+ * 	<p> Every site has a position and a node class (its region and local parameters), and every
+ * 	bond an edge class (its energy bucket and coupling constants). build() packs them into the
+ * 	CSR arrays that FastMSD's kernels use directly. </p>
+ *
+ * @version 7.0
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2011-2026
+ */
+
+#ifndef UDC_TOPOLOGY
+#define UDC_TOPOLOGY
+
+#include <algorithm>
+#include <cmath>
+#include <istream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "FastMSD.h"
+#include "../Vector.h"
+
+
+namespace udc {
+
+using std::floor;
+using std::invalid_argument;
+using std::istream;
+using std::istringstream;
+using std::out_of_range;
+using std::string;
+using std::vector;
+
+
+class Topology {
+ public:
+	typedef FastMSD::NodeClass NodeClass;
+	typedef FastMSD::EdgeClass EdgeClass;
+
+	/** Bravais lattices (and hcp) for addLattice. */
+	enum Lattice { SIMPLE_CUBIC, BCC, FCC, HCP };
+
+	/** Sites [begin, end), e.g. those added by one call to addLattice. */
+	struct Range {
+		unsigned int begin, end;
+	};
+
+	/** One layer of a multilayer: a lattice some unit cells thick (along z). */
+	struct Layer {
+		Lattice lattice;
+		double a;  // lattice constant
+		unsigned int thickness;  // in unit cells
+		unsigned int nodeClass, edgeClass;
+		unsigned int interfaceClass;  // edge class of the bonds to the layer below (unused for the first layer)
+		double interfaceCutoff;  // the longest bond to the layer below. 0 means the longer nearest-neighbor distance of the two
+	};
+
+	unsigned int addNodeClass(const NodeClass &c);
+	unsigned int addEdgeClass(const EdgeClass &c);
+
+	unsigned int addSite(const Vector &position, unsigned int nodeClass);
+	void addBond(unsigned int a, unsigned int b, unsigned int edgeClass);
+
+	/**
+	 * Adds a block of nx * ny * nz unit cells of the given lattice, with its first corner at origin,
+	 * and bonds each pair of nearest neighbors in it.
+	 * Unit cells are cubes of side a, except for HCP: a by a * sqrt(3) by c, with the ideal c = a * sqrt(8/3).
+	 * Sites are added in order of z, then y, then x (of the unit cell).
+	 */
+	Range addLattice(Lattice lattice, double a, unsigned int nx, unsigned int ny, unsigned int nz,
+			unsigned int nodeClass, unsigned int edgeClass, const Vector &origin = Vector::ZERO);
+
+	/**
+	 * Adds a bond between each site of A and each site of B that are at most "cutoff" apart (never a site to itself).
+	 * A and B may overlap, e.g. bondWithin(r, r, ...) bonds the sites of r with each other. Each pair is bonded once.
+	 */
+	void bondWithin(Range A, Range B, double cutoff, unsigned int edgeClass);
+
+	/**
+	 * Stacks layers (first at the bottom, i.e. at origin.z) of nx by ny unit cells (of each layer's own lattice),
+	 * and bonds each layer to the one below it.
+	 * @return the sites of each layer
+	 */
+	vector<Range> addMultilayer(const vector<Layer> &layers, unsigned int nx, unsigned int ny, const Vector &origin = Vector::ZERO);
+
+	/**
+	 * Reads sites: "x y z nodeClass" per line, then bonds: "a b edgeClass" per line, where a and b are
+	 * line numbers (from 0) in the site list. Blank lines, and everything after a '#', are ignored.
+	 * @return the new sites
+	 * @throw invalid_argument on a malformed line, an unknown class or site, or a site bonded to itself
+	 */
+	Range readMesh(istream &sites, istream &bonds);
+
+	unsigned int siteCount() const;
+	unsigned int bondCount() const;
+	Vector getPosition(unsigned int site) const;
+	unsigned int getNodeClass(unsigned int site) const;
+
+	/** The nearest-neighbor distance of a lattice with constant a. */
+	static double nearestNeighbor(Lattice lattice, double a);
+
+	/** The CSR graph for FastMSD(graph, kT, B). Site i is node i. */
+	FastMSD::Graph build() const;
+
+ private:
+	struct Bond {
+		unsigned int a, b, edgeClass;
+	};
+
+	vector<NodeClass> nodeClasses;
+	vector<EdgeClass> edgeClasses;
+	vector<Vector> positions;
+	vector<unsigned int> siteClass;
+	vector<Bond> bonds;
+
+	// (each line, without comments, that isn't blank)
+	template <typename F> static void readLines(istream &in, const char *what, F parse);
+};
+
+
+//--------------------------------------------------------------------------------
+
+unsigned int Topology::addNodeClass(const NodeClass &c) {
+	nodeClasses.push_back(c);
+	return (unsigned int) nodeClasses.size() - 1;
+}
+
+unsigned int Topology::addEdgeClass(const EdgeClass &c) {
+	edgeClasses.push_back(c);
+	return (unsigned int) edgeClasses.size() - 1;
+}
+
+unsigned int Topology::addSite(const Vector &position, unsigned int nodeClass) {
+	if (nodeClass >= nodeClasses.size())
+		throw out_of_range("Topology::addSite: no such node class");
+	positions.push_back(position);
+	siteClass.push_back(nodeClass);
+	return (unsigned int) positions.size() - 1;
+}
+
+void Topology::addBond(unsigned int a, unsigned int b, unsigned int edgeClass) {
+	if (a >= positions.size() || b >= positions.size())
+		throw out_of_range("Topology::addBond: no such site");
+	if (edgeClass >= edgeClasses.size())
+		throw out_of_range("Topology::addBond: no such edge class");
+	if (a == b)
+		throw invalid_argument("Topology::addBond: a site can't be bonded to itself");
+	bonds.push_back({ a, b, edgeClass });
+}
+
+double Topology::nearestNeighbor(Lattice lattice, double a) {
+	switch (lattice) {
+		case BCC: return a * sqrt(3.0) / 2;
+		case FCC: return a / sqrt(2.0);
+		default:  return a;  // SIMPLE_CUBIC, HCP
+	}
+}
+
+Topology::Range Topology::addLattice(Lattice lattice, double a, unsigned int nx, unsigned int ny, unsigned int nz,
+		unsigned int nodeClass, unsigned int edgeClass, const Vector &origin) {
+	// basis, in fractions of the unit cell
+	vector<Vector> basis;
+	Vector cell(a, a, a);
+	switch (lattice) {
+		case SIMPLE_CUBIC:
+			basis = { Vector(0, 0, 0) };
+			break;
+		case BCC:
+			basis = { Vector(0, 0, 0), Vector(0.5, 0.5, 0.5) };
+			break;
+		case FCC:
+			basis = { Vector(0, 0, 0), Vector(0.5, 0.5, 0), Vector(0.5, 0, 0.5), Vector(0, 0.5, 0.5) };
+			break;
+		case HCP:  // (orthohexagonal cell: two A sites, then two B sites)
+			cell = Vector(a, a * sqrt(3.0), a * sqrt(8.0 / 3.0));
+			basis = { Vector(0, 0, 0), Vector(0.5, 0.5, 0), Vector(0.5, 1.0 / 6, 0.5), Vector(0, 2.0 / 3, 0.5) };
+			break;
+		default:
+			throw invalid_argument("Topology::addLattice: unknown lattice");
+	}
+
+	Range r;
+	r.begin = siteCount();
+	for (unsigned int z = 0; z < nz; z++)
+		for (unsigned int y = 0; y < ny; y++)
+			for (unsigned int x = 0; x < nx; x++)
+				for (const Vector &p : basis)
+					addSite(origin + Vector((x + p.x) * cell.x, (y + p.y) * cell.y, (z + p.z) * cell.z), nodeClass);
+	r.end = siteCount();
+	bondWithin(r, r, nearestNeighbor(lattice, a) * (1 + 1e-6), edgeClass);
+	return r;
+}
+
+void Topology::bondWithin(Range A, Range B, double cutoff, unsigned int edgeClass) {
+	if (edgeClass >= edgeClasses.size())
+		throw out_of_range("Topology::bondWithin: no such edge class");
+	if (!(cutoff > 0))
+		return;
+
+	// cell list of B: only the 27 cells around a site can have sites within cutoff of it
+	typedef std::tuple<long long, long long, long long> Cell;
+	auto cellOf = [cutoff](const Vector &p) {
+		return Cell((long long) floor(p.x / cutoff), (long long) floor(p.y / cutoff), (long long) floor(p.z / cutoff));
+	};
+	std::map<Cell, vector<unsigned int>> cells;
+	for (unsigned int b = B.begin; b < B.end; b++)
+		cells[cellOf(positions[b])].push_back(b);
+
+	const double cutoffSq = cutoff * cutoff;
+	for (unsigned int a = A.begin; a < A.end; a++) {
+		Cell c = cellOf(positions[a]);
+		for (long long dz = -1; dz <= 1; dz++)
+			for (long long dy = -1; dy <= 1; dy++)
+				for (long long dx = -1; dx <= 1; dx++) {
+					auto iter = cells.find(Cell(std::get<0>(c) + dx, std::get<1>(c) + dy, std::get<2>(c) + dz));
+					if (iter == cells.end())
+						continue;
+					for (unsigned int b : iter->second) {
+						if (b == a || (A.begin <= b && b < A.end && B.begin <= a && a < B.end && b < a))
+							continue;  // (itself, or a pair that is found both ways and was already bonded)
+						if (positions[a].distanceSq(positions[b]) <= cutoffSq)
+							bonds.push_back({ a, b, edgeClass });
+					}
+				}
+	}
+}
+
+vector<Topology::Range> Topology::addMultilayer(const vector<Layer> &layers, unsigned int nx, unsigned int ny, const Vector &origin) {
+	vector<Range> ranges;
+	Vector o = origin;
+	for (size_t i = 0; i < layers.size(); i++) {
+		const Layer &l = layers[i];
+		ranges.push_back(addLattice(l.lattice, l.a, nx, ny, l.thickness, l.nodeClass, l.edgeClass, o));
+		double cellHeight = l.lattice == HCP ? l.a * sqrt(8.0 / 3.0) : l.a;
+		o.z += l.thickness * cellHeight;  // the next layer starts where this one's next unit cell would
+
+		if (i != 0) {
+			const Layer &below = layers[i - 1];
+			double cutoff = l.interfaceCutoff;
+			if (cutoff == 0)
+				cutoff = std::max(nearestNeighbor(l.lattice, l.a), nearestNeighbor(below.lattice, below.a)) * (1 + 1e-6);
+			bondWithin(ranges[i - 1], ranges[i], cutoff, l.interfaceClass);
+		}
+	}
+	return ranges;
+}
+
+template <typename F> void Topology::readLines(istream &in, const char *what, F parse) {
+	string line;
+	for (unsigned int n = 1; std::getline(in, line); n++) {
+		line = line.substr(0, line.find('#'));
+		if (line.find_first_not_of(" \t\r") == string::npos)
+			continue;
+		istringstream fields(line);
+		string rest;
+		if (!parse(fields) || (fields >> rest))
+			throw invalid_argument(string("Topology::readMesh: malformed ") + what + " on line " + std::to_string(n) + ": " + line);
+	}
+}
+
+Topology::Range Topology::readMesh(istream &sites, istream &bonds) {
+	Range r;
+	r.begin = siteCount();
+	try {
+		readLines(sites, "site", [&](istringstream &fields) {
+			Vector p;
+			unsigned int c;
+			if (!(fields >> p.x >> p.y >> p.z >> c))
+				return false;
+			addSite(p, c);
+			return true;
+		});
+		r.end = siteCount();
+		readLines(bonds, "bond", [&](istringstream &fields) {
+			unsigned int a, b, c;
+			if (!(fields >> a >> b >> c))
+				return false;
+			if (a >= r.end - r.begin || b >= r.end - r.begin)
+				throw out_of_range("no such site");
+			addBond(r.begin + a, r.begin + b, c);
+			return true;
+		});
+	} catch (const out_of_range &e) {
+		throw invalid_argument(string("Topology::readMesh: ") + e.what());
+	}
+	return r;
+}
+
+unsigned int Topology::siteCount() const {
+	return (unsigned int) positions.size();
+}
+
+unsigned int Topology::bondCount() const {
+	return (unsigned int) bonds.size();
+}
+
+Vector Topology::getPosition(unsigned int site) const {
+	return positions.at(site);
+}
+
+unsigned int Topology::getNodeClass(unsigned int site) const {
+	return siteClass.at(site);
+}
+
+FastMSD::Graph Topology::build() const {
+	const unsigned int n = siteCount();
+	FastMSD::Graph g;
+	g.nodeClasses = nodeClasses;
+	g.edgeClasses = edgeClasses;
+	g.nodeClass = siteClass;
+	g.positions = positions;
+	g.indices.resize(n);
+	for (unsigned int i = 0; i < n; i++)
+		g.indices[i] = i;
+
+	// counting sort of the two copies of each bond by site
+	g.offsets.assign(n + 1, 0);
+	for (const Bond &b : bonds) {
+		g.offsets[b.a + 1]++;
+		g.offsets[b.b + 1]++;
+	}
+	for (unsigned int i = 0; i < n; i++)
+		g.offsets[i + 1] += g.offsets[i];
+	g.neighbors.resize(g.offsets[n]);
+	g.edgeClass.resize(g.offsets[n]);
+	g.direction.resize(g.offsets[n]);
+	vector<unsigned int> next(g.offsets.begin(), g.offsets.end() - 1);
+	for (const Bond &b : bonds) {
+		const double direction = b.a < b.b ? 1 : -1;  // (by site, as in FastMSD::Graph::fromMSD)
+		unsigned int e = next[b.a]++;
+		g.neighbors[e] = b.b;
+		g.edgeClass[e] = b.edgeClass;
+		g.direction[e] = direction;
+		e = next[b.b]++;
+		g.neighbors[e] = b.a;
+		g.edgeClass[e] = b.edgeClass;
+		g.direction[e] = -direction;
+	}
+	return g;
+}
+
+}  // end of namespace udc
+
+#endif
@@ -0,0 +1,92 @@
+#include <cstdlib>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include "../asm/FastMSD.h"
+#include "../MSD.h"
+
+using namespace std;
+using namespace udc;
+
+
+// the default shape in parameters-iterate.txt (as run by iterate.bat)
+const unsigned int W = 11, H = 10, D = 10, MOL_POS_L = 5, MOL_POS_R = 5, TOP_L = 3, BOTTOM_L = 6, FRONT_R = 3, BACK_R = 6;
+
+unique_ptr<MSD> build(const MSD::Parameters &p, const Molecule::EdgeParameters &pEdge) {
+	unique_ptr<MSD> msd(new MSD(W, H, D, MSD::LINEAR_MOL, MOL_POS_L, MOL_POS_R, TOP_L, BOTTOM_L, FRONT_R, BACK_R));
+	msd->setParameters(p);
+	msd->setMolParameters(Molecule::NodeParameters(), pEdge);
+	msd->setSeed(0);
+	msd->randomize();
+	return msd;
+}
+
+// clock time of N iterations
+double run(MSD &msd, unsigned long long N) {
+	clock_t start = clock();
+	msd.metropolis(N);
+	return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+double run(FastMSD &fast, unsigned long long N) {
+	clock_t start = clock();
+	fast.metropolis(N);
+	return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+void benchmark(const char *name, const MSD::Parameters &p, const Molecule::EdgeParameters &pEdge, unsigned long long N) {
+	cout << "---------- " << name << " ----------\n";
+	{	unique_ptr<MSD> msd = build(p, pEdge);
+		double t = run(*msd, N);
+		cout << left << setw(28) << "MSD::metropolis:" << t << " seconds, U = " << msd->getResults().U << '\n';
+	}
+	for (int k = FastMSD::SCALAR; k <= FastMSD::AVX512; k++) {
+		if (!FastMSD::supports((FastMSD::Kernel) k))
+			continue;
+		for (int cached = 0; cached < 2; cached++) {
+			unique_ptr<MSD> msd = build(p, pEdge);
+			FastMSD fast(*msd);
+			fast.setKernel((FastMSD::Kernel) k);
+			fast.setCachedFields(cached != 0);
+			double t = run(fast, N);
+			string label = string("FastMSD (") + FastMSD::kernelName((FastMSD::Kernel) k) + (cached ? ", cached" : "") + "):";
+			cout << left << setw(28) << label << t << " seconds, U = " << fast.getResults().U << '\n';
+		}
+	}
+	cout << '\n';
+}
+
+int main(int argc, char *argv[]) {
+	const unsigned long long N = (argc > 1 ? atoll(argv[1]) : 10000000);
+	cout << "(N=" << N << ") Running...\n\n";
+
+	// parameters-iterate.txt: only J, and no flux
+	MSD::Parameters p;
+	p.kT = 0.1;
+	p.B = Vector::ZERO;
+	p.SL = p.SR = 1;
+	p.FL = p.FR = 0;
+	p.JL = p.JR = p.JmL = 1;
+	p.JmR = -1;
+	p.JLR = 0;
+	Molecule::EdgeParameters pEdge;
+	pEdge.Jm = 1;
+	benchmark("parameters-iterate.txt", p, pEdge, N);
+
+	// every term of the Hamiltonian
+	p.B = Vector(0.1, 0, 0);
+	p.FL = p.FR = 0.25;
+	p.Je0L = p.Je0R = 0.1;
+	p.Je1L = p.Je1R = p.Je1mL = p.Je1mR = p.Je1LR = 0.1;
+	p.JeeL = p.JeeR = p.JeemL = p.JeemR = p.JeeLR = 0.1;
+	p.bL = p.bR = p.bmL = p.bmR = p.bLR = 0.1;
+	p.AL = p.AR = Vector(0.1, 0, 0);
+	p.DL = p.DR = p.DmL = p.DmR = p.DLR = Vector(0, 0, 0.1);
+	pEdge.Je1m = pEdge.Jeem = pEdge.bm = 0.1;
+	pEdge.Dm = Vector(0, 0, 0.1);
+	benchmark("every term", p, pEdge, N);
+
+	return 0;
+}
@@ -0,0 +1,71 @@
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include "../asm/FastMSD.h"
+#include "../MSD.h"
+#include "../ThreadPool.h"
+
+using namespace std;
+using namespace udc;
+
+
+// the default shape in parameters-iterate.txt (as run by iterate.bat)
+const unsigned int W = 11, H = 10, D = 10, MOL_POS_L = 5, MOL_POS_R = 5, TOP_L = 3, BOTTOM_L = 6, FRONT_R = 3, BACK_R = 6;
+
+unique_ptr<MSD> build(double kT) {
+	unique_ptr<MSD> msd(new MSD(W, H, D, MSD::LINEAR_MOL, MOL_POS_L, MOL_POS_R, TOP_L, BOTTOM_L, FRONT_R, BACK_R));
+	MSD::Parameters p;
+	p.kT = kT;
+	p.B = Vector::ZERO;
+	p.SL = p.SR = 1;
+	p.FL = p.FR = 0;
+	p.JL = p.JR = p.JmL = 1;
+	p.JmR = -1;
+	p.JLR = 0;
+	msd->setParameters(p);
+	Molecule::EdgeParameters pEdge;
+	pEdge.Jm = 1;
+	msd->setMolParameters(Molecule::NodeParameters(), pEdge);
+	msd->setSeed(0);
+	msd->randomize();
+	return msd;
+}
+
+// wall clock time of N iterations (since the pool's threads run in parallel)
+double run(FastMSD &fast, unsigned long long N) {
+	auto start = chrono::steady_clock::now();
+	fast.metropolis(N);
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+void benchmark(double kT, unsigned long long N) {
+	cout << "---------- kT = " << kT << " ----------\n";
+	unique_ptr<MSD> msd = build(kT);
+	FastMSD serial(*msd);
+	double t = run(serial, N);
+	cout << left << setw(32) << "serial:" << t << " seconds, U = " << serial.getResults().U << '\n';
+	for (unsigned int threads : { 1, 2, 4 }) {
+		WorkStealingPool pool(threads);
+		for (unsigned int window : { 64, 256, 1024 }) {
+			FastMSD fast(*msd);
+			fast.setPool(&pool, window);
+			double t = run(fast, N);
+			string label = to_string(threads) + " threads, window " + to_string(window) + ":";
+			cout << left << setw(32) << label << t << " seconds, U = " << fast.getResults().U
+			     << (fast.getResults() == serial.getResults() ? " (identical)" : " (DIFFERENT)") << '\n';
+		}
+	}
+	cout << '\n';
+}
+
+int main(int argc, char *argv[]) {
+	const unsigned long long N = (argc > 1 ? atoll(argv[1]) : 2000000);
+	cout << "(N=" << N << ", " << thread::hardware_concurrency() << " cores) Running...\n\n";
+	benchmark(0.1, N);  // mostly rejected: long windows
+	benchmark(1, N);    // more trials with dU <= 0, which end a window early
+	return 0;
+}
@@ -0,0 +1,78 @@
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include "../asm/FastMSD.h"
+#include "../asm/IsingMSD.h"
+#include "../MSD.h"
+
+using namespace std;
+using namespace udc;
+
+
+// a linear molecule between two ferromagnets (W x H x D), with every spin +1 or -1 at random along y
+unique_ptr<MSD> build(unsigned int W, unsigned int H, unsigned int D, double kT) {
+	const unsigned int molPos = W / 2;
+	unique_ptr<MSD> msd(new MSD(W, H, D, MSD::LINEAR_MOL, molPos, molPos, H * 3 / 10, H * 6 / 10, D * 3 / 10, D * 6 / 10));
+	MSD::Parameters p;
+	p.kT = kT;
+	p.B = Vector(0, 0.1, 0);
+	p.SL = p.SR = 1;
+	p.FL = p.FR = 0;
+	p.JL = p.JR = p.JmL = 1;
+	p.JmR = -1;
+	p.JLR = 0;
+	msd->setParameters(p);
+	Molecule::NodeParameters pNode;
+	pNode.Fm = 0;
+	Molecule::EdgeParameters pEdge;
+	pEdge.Jm = 1;
+	msd->setMolParameters(pNode, pEdge);
+	msd->flippingAlgorithm = MSD::UP_DOWN_MODEL;
+	mt19937_64 prng(0);
+	for (auto iter = msd->begin(); iter != msd->end(); iter++)
+		msd->setLocalM(iter.getIndex(), Vector(0, prng() % 2 == 0 ? 1 : -1, 0), Vector::ZERO);
+	msd->setSeed(0);
+	return msd;
+}
+
+template <typename Engine> double run(Engine &engine, unsigned long long N) {
+	auto start = chrono::steady_clock::now();
+	engine.metropolis(N);
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+void report(const char *label, double t, double baseline, unsigned long long N, double U, unsigned int n) {
+	cout << left << setw(12) << label << setw(12) << t << setw(14) << 1e9 * t / N << setw(10) << baseline / t
+	     << U / n << '\n';
+}
+
+void benchmark(unsigned int W, unsigned int H, unsigned int D, double kT, unsigned long long sweeps) {
+	unique_ptr<MSD> msd = build(W, H, D, kT);
+	const unsigned int n = msd->getN();
+	const unsigned long long N = sweeps * n;
+	cout << "---------- " << W << "x" << H << "x" << D << " (n = " << n << "), kT = " << kT << ", N = " << N << " ----------\n";
+	FastMSD fast(*msd);
+	IsingMSD ising(*msd);
+	cout << "(IsingMSD: " << ising.getColors() << " colors)\n";
+	cout << left << setw(12) << "" << setw(12) << "seconds" << setw(14) << "ns/trial" << setw(10) << "speedup" << "U/n\n";
+	double tMSD = run(*msd, N);
+	report("MSD", tMSD, tMSD, N, msd->getResults().U, n);
+	double tFast = run(fast, N);
+	report("FastMSD", tFast, tMSD, N, fast.getResults().U, n);
+	double tIsing = run(ising, N);
+	report("IsingMSD", tIsing, tMSD, N, ising.getResults().U, n);
+	cout << '\n';
+}
+
+int main(int argc, char *argv[]) {
+	const unsigned long long sweeps = (argc > 1 ? atoll(argv[1]) : 200);
+	cout << "(" << sweeps << " sweeps: N = sweeps * n) Running...\n\n";
+	for (double kT : { 0.5, 2.0, 10.0 })
+		benchmark(11, 10, 10, kT, sweeps);  // the default shape in parameters-iterate.txt (as run by iterate.bat)
+	for (double kT : { 0.5, 2.0, 10.0 })
+		benchmark(64, 64, 64, kT, sweeps / 10);
+	return 0;
+}
@@ -2,18 +2,53 @@
 /*
  * Christopher D'Angelo
  * 4-9-2013
+ *
+ * Usage:
+ *   extract                              (asks for everything interactively)
+ *   extract INPUT OUTPUT VARS [FILTERS] [THREAD_COUNT] [SNAPSHOT]
+ *
+ *   INPUT         metropolis output: XML, or a column file (see ColumnFile.h)
+ *   OUTPUT        CSV file to write, or - for stdout (e.g. for pipelines)
+ *   VARS          comma separated variable names, e.g. kT,JmL,M_x
+ *   FILTERS       comma separated filters, e.g. "kT = 0.1, B_x>0" (may be empty)
+ *   THREAD_COUNT  number of threads used to parse XML (default: all cores)
+ *   SNAPSHOT      "snapshot" writes one row per atom (the VARS, then the <loc> attributes),
+ *                 or "none" (default)
  */
 
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <condition_variable>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
 #include <vector>
-#include "rapidxml.hpp"
+#include "ColumnFile.h"
+#include "MappedFile.h"
+#include "XMLTag.h"
 
 
 using namespace std;
-using namespace rapidxml;
+using udc::ColumnFileReader;
+using udc::MappedFile;
+using udc::XMLTag;
+using udc::findXMLTag;
+using udc::readXMLTag;
+
+
+// same order as the <loc> attributes (and the column file snapshots) written by metropolis
+const char * const LOC_ATTRIBUTES[] = { "x", "y", "z", "sx", "sy", "sz", "fx", "fy", "fz", "mx", "my", "mz" };
+const size_t LOC_ATTRIBUTE_COUNT = sizeof(LOC_ATTRIBUTES) / sizeof(LOC_ATTRIBUTES[0]);
+
+// status messages; sent to cerr instead when the data itself goes to stdout
+ostream *status = &cout;
 
 
 template <typename T> istream& askLine(const char *msg, T &var) {
@@ -26,33 +61,388 @@ struct Filter {
 	string varName;
 	enum ComparatorType { EQ, GT, LT, GE, LE, NE } cmpType;
 	double cmpValue;
+
+	bool passes(double value) const;
 };
 
+// NaN and +/-inf always pass, like a value that can't be read (istream >> never could read them)
+bool Filter::passes(double value) const {
+	if( !isfinite(value) )
+		return true;
+	switch( cmpType ) {
+		case EQ:  return value == cmpValue;
+		case GT:  return value > cmpValue;
+		case LT:  return value < cmpValue;
+		case GE:  return value >= cmpValue;
+		case LE:  return value <= cmpValue;
+		case NE:  return value != cmpValue;
+	}
+	return true;
+}
 
-int main() {
+/**
+ * Parses a filter, e.g. "B_x < 0" or "B_x<0".
+ * @return An error message, or an empty string on success.
+ */
+string parseFilter(const string &line, Filter &f) {
+	const size_t symStart = line.find_first_of("=<>!");
+	//varName
+	istringstream nameIss( line.substr(0, symStart) );
+	if( !(nameIss >> f.varName) )
+		return "Couldn't read variable name.";
+	//cmpType
+	if( symStart == string::npos )
+		return "Couldn't read comparator.";
+	const size_t symEnd = line.find_first_not_of("=<>!", symStart);
+	string sym = line.substr(symStart, symEnd - symStart);
+	if( sym == "=" || sym == "==" ) f.cmpType = Filter::EQ;
+	else if( sym == ">" )           f.cmpType = Filter::GT;
+	else if( sym == "<" )           f.cmpType = Filter::LT;
+	else if( sym == ">=" )          f.cmpType = Filter::GE;
+	else if( sym == "<=" )          f.cmpType = Filter::LE;
+	else if( sym == "!=" )          f.cmpType = Filter::NE;
+	else
+		return "Invalid comparator: " + sym;
+	//cmpVal
+	istringstream valueIss( symEnd == string::npos ? string() : line.substr(symEnd) );
+	if( !(valueIss >> f.cmpValue) )
+		return "Couldn't read numeric value.";
+	return "";
+}
 
-	xml_document<> doc;
-	{	//get input file
-		string inFilename;
-		askLine("Input File: ", inFilename);
-		ifstream inFile(inFilename);
-		//read input file and parse into xml
-		inFile.seekg(0, ios::end);
-		const unsigned int N = inFile.tellg();
-		inFile.seekg(0, ios::beg);
-		if( inFile.fail() ) {
-			cerr << "Error reading from input file: " << inFilename << endl;
-			return 1;
+// splits a comma separated list, skipping blank items
+vector<string> splitList(const string &list) {
+	vector<string> items;
+	istringstream iss(list);
+	string item;
+	while( getline(iss, item, ',') ) {
+		size_t first = item.find_first_not_of(" \t"), last = item.find_last_not_of(" \t");
+		if( first != string::npos )
+			items.push_back( item.substr(first, last - first + 1) );
+	}
+	return items;
+}
+
+
+// ---- Column files ----
+
+// keep[i] &= cmp(x[i], value) for the whole column; NaN and +/-inf always pass, like an unreadable XML value
+// (istream >> can't read them)
+template <typename Cmp> void scanColumn(const double *x, unsigned char *keep, size_t n, double value, Cmp cmp) {
+	for( size_t i = 0; i < n; i++ )
+		keep[i] &= static_cast<unsigned char>( cmp(x[i], value) | !isfinite(x[i]) );
+}
+
+void scanColumn(const double *x, unsigned char *keep, size_t n, const Filter &f) {
+	switch( f.cmpType ) {
+		case Filter::EQ:  scanColumn(x, keep, n, f.cmpValue, [](double a, double b) { return a == b; });  break;
+		case Filter::GT:  scanColumn(x, keep, n, f.cmpValue, [](double a, double b) { return a > b; });   break;
+		case Filter::LT:  scanColumn(x, keep, n, f.cmpValue, [](double a, double b) { return a < b; });   break;
+		case Filter::GE:  scanColumn(x, keep, n, f.cmpValue, [](double a, double b) { return a >= b; });  break;
+		case Filter::LE:  scanColumn(x, keep, n, f.cmpValue, [](double a, double b) { return a <= b; });  break;
+		case Filter::NE:  scanColumn(x, keep, n, f.cmpValue, [](double a, double b) { return a != b; });  break;
+	}
+}
+
+/**
+ * Filters and extracts the data from a metropolis column file (see ColumnFile.h).
+ * Each filter is a single pass over one memory mapped column,
+ * and only the selected columns of the selected rows are ever read after that.
+ */
+int extractColumns(const ColumnFileReader &in, const vector<string> &vars, const vector<Filter> &filters,
+                   bool withSnapshots, ostream &outFile) {
+	vector<const double *> varColumns;
+	for( auto varName = vars.begin(); varName != vars.end(); varName++ ) {
+		long c = in.find(*varName);
+		if( c < 0 ) {
+			cerr << "No such variable in column file: " << *varName << '\n';
+			return 3;
+		}
+		varColumns.push_back( in.column(c) );
+	}
+
+	//filter data
+	*status << "Please wait while your data is filtered...\n";
+	const size_t n = in.rows();
+	vector<unsigned char> keep(n, 1);
+	for( auto filter = filters.begin(); filter != filters.end(); filter++ ) {
+		long c = in.find(filter->varName);
+		if( c >= 0 )  // (same as XML) filters on unknown variables are ignored
+			scanColumn(in.column(c), keep.data(), n, *filter);
+	}
+
+	//print data
+	*status << "Thank you for your patience, while I finish writing your data to file...\n";
+	string buffer, line;
+	char num[32];
+	for( size_t i = 0; i < n; i++ ) {
+		if( !keep[i] )
+			continue;
+		line.clear();
+		for( size_t v = 0; v < varColumns.size(); v++ ) {
+			if( v > 0 )
+				line += ',';
+			line.append( num, to_chars(num, num + sizeof(num), varColumns[v][i], chars_format::general, 6).ptr );  // same as XML
+		}
+		if( !withSnapshots ) {
+			buffer += line;
+			buffer += '\n';
+		} else if( const double *snapshot = in.snapshot(i) ) {
+			for( uint64_t a = 0; a + LOC_ATTRIBUTE_COUNT <= in.getSnapshotSize(); a += LOC_ATTRIBUTE_COUNT ) {
+				buffer += line;
+				for( size_t k = 0; k < LOC_ATTRIBUTE_COUNT; k++ ) {
+					buffer += ',';
+					// same as XML: integer positions, then "%f" (i.e. std::to_string) for the vectors
+					buffer.append( num, k < 3 ? to_chars(num, num + sizeof(num), static_cast<long long>(snapshot[a + k])).ptr
+					                          : to_chars(num, num + sizeof(num), snapshot[a + k], chars_format::fixed, 6).ptr );
+				}
+				buffer += '\n';
+			}
+		}
+		if( buffer.size() >= (1 << 20) ) {
+			outFile.write( buffer.data(), buffer.size() );
+			buffer.clear();
+		}
+	}
+	outFile.write( buffer.data(), buffer.size() );
+	return 0;
+}
+
+
+// ---- XML ----
+
+// The XML is read straight out of the memory mapped file, one <data> element at a time,
+// instead of building a DOM of the whole file (see XMLTag.h).
+
+struct Query {
+	const vector<string> &vars;
+	const vector<Filter> &filters;
+	bool withSnapshots;
+};
+
+/**
+ * Filters and prints a single <data> element, starting at p (at "<data").
+ * Only the <var> children are read; the <snapshot> subtree is skipped unless it will be printed,
+ * and even then only after the filters have passed.
+ * @return A pointer just past "</data>", or end if the element is incomplete (e.g. a truncated file).
+ */
+const char* extractData(const char *p, const char *end, const Query &q, XMLTag &tag,
+                        vector< pair<string_view, string_view> > &dataVars, string &out) {
+	const string_view SNAPSHOT_END = "</snapshot>";
+	const char *snapshotStart = NULL, *snapshotEnd = NULL;
+	dataVars.clear();
+
+	p = readXMLTag(p, end, tag);
+	if( !tag.selfClosing ) {
+		while( true ) {
+			p = static_cast<const char *>( memchr(p, '<', end - p) );
+			if( p == NULL )
+				return end;
+			p = readXMLTag(p, end, tag);
+			if( p == end )
+				return end;
+			if( tag.name == "/data" )
+				break;
+			else if( tag.name == "var" )
+				dataVars.push_back( make_pair(tag.attribute("name"), tag.attribute("value")) );
+			else if( tag.name == "snapshot" && !tag.selfClosing ) {
+				size_t close = string_view(p, end - p).find(SNAPSHOT_END);
+				if( close == string_view::npos )
+					return end;
+				snapshotStart = p;
+				snapshotEnd = p + close;
+				p = snapshotEnd + SNAPSHOT_END.size();
+			}
+		}
+	}
+
+	//filter data
+	for( auto var = dataVars.begin(); var != dataVars.end(); var++ )
+		for( auto filter = q.filters.begin(); filter != q.filters.end(); filter++ )
+			if( var->first == filter->varName ) {
+				double value;
+				const char *first = var->second.data(), *last = first + var->second.size();
+				if( from_chars(first, last, value).ec == errc() && !filter->passes(value) )
+					return p;  // (an unreadable value passes)
+			}
+
+	//print data
+	const size_t rowStart = out.size();
+	for( size_t v = 0; v < q.vars.size(); v++ ) {
+		auto var = dataVars.begin();
+		while( var != dataVars.end() && var->first != q.vars[v] )
+			var++;
+		if( var == dataVars.end() ) {
+			out.resize(rowStart);  // missing variable: skip this <data>
+			return p;
+		}
+		if( v > 0 )
+			out += ',';
+		out += var->second;
+	}
+	if( !q.withSnapshots ) {
+		out += '\n';
+	} else {
+		const string line = out.substr(rowStart);
+		out.resize(rowStart);
+		for( const char *s = snapshotStart; s != NULL && (s = static_cast<const char *>(memchr(s, '<', snapshotEnd - s))) != NULL; ) {
+			s = readXMLTag(s, snapshotEnd, tag);
+			if( tag.name != "loc" )
+				continue;
+			out += line;
+			for( size_t k = 0; k < LOC_ATTRIBUTE_COUNT; k++ ) {
+				out += ',';
+				out += tag.attribute(LOC_ATTRIBUTES[k]);
+			}
+			out += '\n';
+		}
+	}
+	return p;
+}
+
+/**
+ * Filters and extracts the data from metropolis XML.
+ * The file is split into chunks at <data> boundaries, which are parsed in parallel,
+ * and the results are written in order as each chunk is finished.
+ */
+int extractXML(const MappedFile &in, const vector<string> &vars, const vector<Filter> &filters,
+               bool withSnapshots, unsigned int threadCount, ostream &outFile) {
+	const char *text = in.chars(), *end = text + in.size();
+	const char *firstData = findXMLTag("data", text, end, end);
+	if( string_view(text, firstData - text).find("<msd") == string_view::npos ) {
+		cerr << "Invalid XML tree structure. Missing the root node <msd>.\n";
+		return 3;
+	}
+
+	struct Chunk {
+		const char *begin, *end;  // every <data> that starts in [begin, end) belongs to this chunk
+		string out;
+		bool done;
+	};
+	const size_t CHUNK_MIN = 1 << 20, CHUNK_MAX = 64 << 20;
+	size_t chunkSize = (end - firstData) / (threadCount * 16);
+	chunkSize = chunkSize < CHUNK_MIN ? CHUNK_MIN : chunkSize > CHUNK_MAX ? CHUNK_MAX : chunkSize;
+	vector<Chunk> chunks;
+	for( const char *p = firstData; p < end; p += min<size_t>(chunkSize, end - p) )
+		chunks.push_back( Chunk{ p, p + min<size_t>(chunkSize, end - p), string(), false } );
+
+	*status << "Please wait while your data is filtered...\n";
+	const Query q = { vars, filters, withSnapshots };
+	atomic<size_t> nextChunk(0);
+	mutex doneMutex;
+	condition_variable doneCond;
+	vector<thread> threads;
+	for( unsigned int t = 0; t < threadCount && t < chunks.size(); t++ )
+		threads.push_back( thread([&]() {
+			XMLTag tag;
+			vector< pair<string_view, string_view> > dataVars;
+			for( size_t c; (c = nextChunk++) < chunks.size(); ) {
+				Chunk &chunk = chunks[c];
+				for( const char *p = findXMLTag("data", chunk.begin, chunk.end, end); p < chunk.end; ) {
+					p = extractData(p, end, q, tag, dataVars, chunk.out);
+					p = findXMLTag("data", p, chunk.end, end);
+				}
+				{
+					lock_guard<mutex> lock(doneMutex);
+					chunk.done = true;
+				}
+				doneCond.notify_all();
+			}
+		}) );
+
+	//print data (in order)
+	for( auto chunk = chunks.begin(); chunk != chunks.end(); chunk++ ) {
+		{
+			unique_lock<mutex> lock(doneMutex);
+			doneCond.wait(lock, [&]() { return chunk->done; });
 		}
-		char * buf = new char[N + 1];
-		inFile.read(buf, N);
-		buf[N] = '\0';
-		doc.parse<0>( doc.allocate_string(buf) );
-		delete buf;
+		outFile.write( chunk->out.data(), chunk->out.size() );
+		string().swap(chunk->out);
 	}
-	
+	for( auto t = threads.begin(); t != threads.end(); t++ )
+		t->join();
+	return 0;
+}
+
+
+// ---- main ----
+
+struct Input {
+	unique_ptr<ColumnFileReader> columnFile;  // iff the input is a column file
+	unique_ptr<MappedFile> xmlFile;           // otherwise
+};
+
+int openInput(const string &inFilename, Input &in) {
+	try {
+		if( ColumnFileReader::isColumnFile(inFilename) )
+			in.columnFile.reset( new ColumnFileReader(inFilename) );  // see extractColumns
+		else
+			in.xmlFile.reset( new MappedFile(inFilename) );  // see extractXML
+	} catch(const runtime_error &e) {
+		cerr << e.what() << '\n';
+		cerr << "Error reading from input file: " << inFilename << endl;
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+
+	Input in;
 	vector<string> vars;
-	{	//get variables (x, y1, y2, y3, ...)
+	vector<Filter> filters;
+	string outFilename;
+	unsigned int threadCount = thread::hardware_concurrency();
+	threadCount = threadCount > 1 ? threadCount : 1;
+	bool withSnapshots = false;
+
+	if( argc > 1 ) {
+		// command line mode (e.g. for scripts and pipelines)
+		if( argc <= 2 ) {
+			cerr << "Need an output file (or - for stdout).\n";
+			return -2;
+		} else if( argc <= 3 ) {
+			cerr << "Need a comma separated list of variables.\n";
+			return -3;
+		}
+		outFilename = argv[2];
+		vars = splitList(argv[3]);
+		if( argc > 4 )
+			for( const string &item : splitList(argv[4]) ) {
+				Filter f;
+				string err = parseFilter(item, f);
+				if( !err.empty() ) {
+					cerr << "Filter syntax error (" << item << "); " << err << '\n';
+					return -4;
+				}
+				filters.push_back(f);
+			}
+		if( argc > 5 ) {
+			istringstream iss(argv[5]);
+			if( !(iss >> threadCount) || threadCount < 1 ) {
+				cerr << "Invalid thread count: " << argv[5] << '\n';
+				return -5;
+			}
+		}
+		if( argc > 6 ) {
+			string snapshot(argv[6]);
+			if( snapshot != "snapshot" && snapshot != "none" ) {
+				cerr << "Invalid snapshot option (snapshot|none): " << argv[6] << '\n';
+				return -6;
+			}
+			withSnapshots = (snapshot == "snapshot");
+		}
+		if( int err = openInput(argv[1], in) )
+			return err;
+
+	} else {
+		//get input file
+		string inFilename;
+		askLine("Input File: ", inFilename);
+		if( int err = openInput(inFilename, in) )
+			return err;
+
+		//get variables (x, y1, y2, y3, ...)
 		cout << "Variables (in order), (enter a blank line afterwards to continue):\n";
 		string line;
 		while( askLine("> ", line) ){
@@ -63,126 +453,62 @@ int main() {
 			cout << "Ran out of input... Terminating.\n";
 			return 0;
 		}
-	}
-	
-	vector<Filter> filters;
-	{	//get filters
+
+		//get filters
 		cout << "Filters (e.g. B < 0), (enter a blank line afterwards to continue):\n";
-		string line;
 		while( askLine("> ", line) ) {
 			if( line == "" ) break;
-			istringstream iss(line);
 			Filter f;
-			//varName
-			if( !(iss >> f.varName) ) {
-				cout << "Filter syntax error; Couldn't read variable name.\n";
-				continue;
-			}
-			//cmpType
-			string sym;
-			if( !(iss >> sym) ) {
-				cout << "Filter syntax error; Couldn't read comparator.\n";
-				continue;
-			}
-			if( sym == "=" || sym == "==" ) f.cmpType = Filter::EQ;
-			else if( sym == ">" )           f.cmpType = Filter::GT;
-			else if( sym == "<" )           f.cmpType = Filter::LT;
-			else if( sym == ">=" )          f.cmpType = Filter::GE;
-			else if( sym == "<=" )          f.cmpType = Filter::LE;
-			else if( sym == "!=" )          f.cmpType = Filter::NE;
-			else {
-				cout << "Filter syntax error; Invalid comparator: " << sym << '\n';
+			string err = parseFilter(line, f);
+			if( !err.empty() ) {
+				cout << "Filter syntax error; " << err << '\n';
 				continue;
 			}
-			//cmpVal
-			if( !(iss >> f.cmpValue) ) {
-				cout << "Filter syntax error; Couldn't read numeric value.\n";
-			}
 			filters.push_back(f); //Got filter, push!
 		}
 		if( cin.fail() ) {
 			cout << "Ran out of input... Terminating.\n";
 			return 0;
 		}
+
+		//get output file
+		askLine("Output File: ", outFilename);
 	}
 
-	//get output file
-	string outFilename;
-	askLine("Output File: ", outFilename);
-	ofstream outFile(outFilename);
+	if( vars.empty() ) {
+		cout << "No variables specified... Terminating.\n";
+		return 0;
+	}
+
+	ofstream outFileStream;
+	ostream *outFile = &cout;
+	if( outFilename == "-" ) {
+		status = &cerr;
+	} else {
+		outFileStream.open(outFilename);
+		outFile = &outFileStream;
+	}
 	//print labels
 	for( auto varName = vars.begin(); varName != vars.end(); varName++ )
-		outFile << *varName << ',';
-	if( outFile.fail() ) {
+		*outFile << (varName == vars.begin() ? "" : ",") << *varName;
+	if( withSnapshots )
+		for( const char *attr : LOC_ATTRIBUTES )
+			*outFile << ',' << attr;
+	*outFile << '\n';
+	if( outFile->fail() ) {
 		cerr << "Error writing to output file: " << outFilename << endl;
 		return 2;
 	}
-	if( !outFile.seekp( outFile.tellp() - (streampos)1 ) ) {
-		//tellp() == 0 will set the failbit;
-		// this happens if neither above for-loop executes because 'ind' and 'dep' are empty
-		cout << "No variables specified... Terminating.\n";
-		return 0;
-	}
-	outFile << '\n';
-	
-	//filter data
-	cout << "Please wait while your data is filtered...\n";
-	vector<xml_node<>*> dataVec;
-	xml_node<> *root = doc.first_node("msd");
-	if( root == NULL ) {
-		cerr << "Invalid XML tree structure. Missing the root node <msd>.\n";
-		return 3;
-	}
-	for( xml_node<> *dataNode = root->first_node("data"); dataNode != NULL; dataNode = dataNode->next_sibling("data") ) {
-		bool shouldInclude = true;
-		for( xml_node<> *varNode = dataNode->first_node("var"); shouldInclude && varNode != NULL; varNode = varNode->next_sibling("var") )
-			for( auto filter = filters.begin(); shouldInclude && filter != filters.end(); filter++ )
-				if( varNode->first_attribute("name")->value() == filter->varName ) {
-					istringstream iss( varNode->first_attribute("value")->value() );
-					double value;
-					iss >> value;
-					shouldInclude = iss.fail() ||
-					              ( filter->cmpType == Filter::EQ ? value == filter->cmpValue :
-					                filter->cmpType == Filter::GT ? value > filter->cmpValue :
-								    filter->cmpType == Filter::LT ? value < filter->cmpValue :
-									filter->cmpType == Filter::GE ? value >= filter->cmpValue :
-									filter->cmpType == Filter::LE ? value <= filter->cmpValue :
-									filter->cmpType == Filter::NE ? value != filter->cmpValue :
-									true );
-				}
-		if( shouldInclude )
-			dataVec.push_back(dataNode);
-	}
-	
-	//-----------------
-	//-- TODO: Sort? --
-	//-----------------
-	
-	//print data
-	cout << "Thank you for your patience, while I finish writing your data to file...\n";
-	for( auto datum = dataVec.begin(); datum != dataVec.end(); datum++ ) {
-		xml_node<> *dataNode = *datum;
-		bool shouldPrint = true;
-		stringstream line;
-		for( auto varName = vars.begin(); varName != vars.end(); varName++ ) {
-			bool foundVar = false;
-			for( xml_node<> *varNode = dataNode->first_node("var"); varNode != NULL; varNode = varNode->next_sibling("var") ) {
-				if( *varName == varNode->first_attribute("name")->value() ) {
-					line << varNode->first_attribute("value")->value() << ',';
-					foundVar = true;
-					break;
-				}
-			}
-			if( !(shouldPrint = foundVar) )
-				break;
-		}
-		if( shouldPrint )
-			outFile << line.rdbuf();
-		outFile.seekp( outFile.tellp() - (streampos)1 );
-		outFile << '\n';
+
+	int err = in.columnFile ? extractColumns(*in.columnFile, vars, filters, withSnapshots, *outFile)
+	                        : extractXML(*in.xmlFile, vars, filters, withSnapshots, threadCount, *outFile);
+	outFile->flush();
+	if( err == 0 && outFile->fail() ) {
+		cerr << "Error writing to output file: " << outFilename << endl;
+		err = 2;
 	}
-	
-	cout << "Done.\n";
-	return 0;
-	
+	if( err == 0 )
+		*status << "Done.\n";
+	return err;
+
 }
@@ -10,8 +10,11 @@
 
 #include <fstream>
 #include <iostream>
+#include <sstream>
 #include <string>
 #include "MSD.h"
+#include "RecordSink.h"
+#include "ResultsWriter.h"
 
 using namespace std;
 using namespace udc;
@@ -98,7 +101,27 @@ int main(int argc, char *argv[]) {
 	} else
 		cout << "Defaulting to 'LINEAR'.\n";
 
-	ofstream file(argv[1]);
+	string sinkType = "memory";  // "memory" or "stats", optionally followed by ":<decimation>"
+	unsigned long long decimation = 1;
+	if (argc > 5) {
+		if (!parseRecordSinkSpec(argv[5], sinkType, decimation) || (sinkType != "memory" && sinkType != "stats")) {
+			cerr << "Unrecognized RECORD_SINK: " << argv[5] << '\n';
+			return 2;
+		}
+	} else
+		cout << "Defaulting to 'memory'.\n";
+
+	ResultsWriter::Format format = ResultsWriter::CSV;  // "csv", "csv-xyz", "binary", or "binary-xyz"
+	bool derived = true;  // false for the "-xyz" formats
+	if (argc > 6) {
+		if (!parseResultsFormat(argv[6], format, derived)) {
+			cerr << "Unrecognized FORMAT: " << argv[6] << '\n';
+			return 2;
+		}
+	} else
+		cout << "Defaulting to 'csv'.\n";
+
+	ofstream file(argv[1], format == ResultsWriter::BINARY ? ios::out | ios::binary : ios::out);
 	file.exceptions( ios::badbit | ios::failbit );
 	
 	//get parameters
@@ -200,40 +223,29 @@ int main(int argc, char *argv[]) {
 		msd.setMolProto(molProto);
 	else
 		msd.setMolParameters(p_node, p_edge);
+
+	// "memory": keep every record in msd.record, then compute the statistics from it.
+	// "stats": only keep the running sums needed for the statistics.
+	StatisticsRecordSink stats(msd);
+	VectorRecordSink memorySink(msd.record);
+	DecimatingRecordSink sink(sinkType == "stats" ? (MSD::RecordSink &) stats : memorySink, decimation);
+	msd.recordSink = &sink;
 	msd.flippingAlgorithm = arg2;
 	
 	try {
 		//print info/headings
-		file << "kT,,"
-			    "<M>_x,<M>_y,<M>_z,<M>_norm,<M>_theta,<M>_phi,,"
-				"<ML>_x,<ML>_y,<ML>_z,<ML>_norm,<ML>_theta,<ML>_phi,,"
-				"<MR>_x,<MR>_y,<MR>_z,<MR>_norm,<MR>_theta,<MR>_phi,,"
-			    "<Mm>_x,<Mm>_y,<Mm>_z,<Mm>_norm,<Mm>_theta,<Mm>_phi,,"
-				"<MS>_x,<MS>_y,<MS>_z,<MS>_norm,<MS>_theta,<MS>_phi,,"
-				"<MSL>_x,<MSL>_y,<MSL>_z,<MSL>_norm,<MSL>_theta,<MSL>_phi,,"
-				"<MSR>_x,<MSR>_y,<MSR>_z,<MSR>_norm,<MSR>_theta,<MSR>_phi,,"
-			    "<MSm>_x,<MSm>_y,<MSm>_z,<MSm>_norm,<MSm>_theta,<MSm>_phi,,"
-				"<MF>_x,<MF>_y,<MF>_z,<MF>_norm,<MF>_theta,<MF>_phi,,"
-				"<MFL>_x,<MFL>_y,<MFL>_z,<MFL>_norm,<MFL>_theta,<MFL>_phi,,"
-				"<MFR>_x,<MFR>_y,<MFR>_z,<MFR>_norm,<MFR>_theta,<MFR>_phi,,"
-			    "<MFm>_x,<MFm>_y,<MFm>_z,<MFm>_norm,<MFm>_theta,<MFm>_phi,,"
-				"<U>,<UL>,<UR>,<Um>,<UmL>,<UmR>,<ULR>,,"
-				"c,cL,cR,cm,cmL,cmR,cLR,,"
-				"x,xL,xR,xm,,"
-				"M_x,M_y,M_z,M_norm,M_theta,M_phi,,"
-				"ML_x,ML_y,ML_z,ML_norm,ML_theta,ML_phi,,"
-				"MR_x,MR_y,MR_z,MR_norm,MR_theta,MR_phi,,"
-				"Mm_x,Mm_y,Mm_z,Mm_norm,Mm_theta,Mm_phi,,"
-				"MS_x,MS_y,MS_z,MS_norm,MS_theta,MS_phi,,"
-				"MSL_x,MSL_y,MSL_z,MSL_norm,MSL_theta,MSL_phi,,"
-				"MSR_x,MSR_y,MSR_z,MSR_norm,MSR_theta,MSR_phi,,"
-				"MSm_x,MSm_y,MSm_z,MSm_norm,MSm_theta,MSm_phi,,"
-				"MF_x,MF_y,MF_z,MF_norm,MF_theta,MF_phi,,"
-				"MFL_x,MFL_y,MFL_z,MFL_norm,MFL_theta,MFL_phi,,"
-				"MFR_x,MFR_y,MFR_z,MFR_norm,MFR_theta,MFR_phi,,"
-				"MFm_x,MFm_y,MFm_z,MFm_norm,MFm_theta,MFm_phi,,"
-				"U,UL,UR,Um,UmL,UmR,ULR,"
-			 << ",width = " << msd.getWidth()
+		ResultsWriter writer(file, format, derived);
+		writer.columnName("kT");
+		writer.columnName("");
+		writer.resultsColumnNames("<", ">");
+		writer.columnName("");
+		for (const char *name : {"c", "cL", "cR", "cm", "cmL", "cmR", "cLR", "", "x", "xL", "xR", "xm", ""})
+			writer.columnName(name);
+		writer.resultsColumnNames();
+		writer.columnName("");
+
+		ostringstream info;
+		info << ",width = " << msd.getWidth()
 			 << ",height = " << msd.getHeight()
 			 << ",depth = " << msd.getDepth()
 			 << ",molPosL = " << msd.getMolPosL()
@@ -248,51 +260,54 @@ int main(int argc, char *argv[]) {
 			 << ",\"B = " << p.B << '"'
 			 << ",SL = " << p.SL
 			 << ",SR = " << p.SR;
-		if (!usingMMB)  file << ",Sm = " << p_node.Sm;
-		file << ",FL = " << p.FL
+		if (!usingMMB)  info << ",Sm = " << p_node.Sm;
+		info << ",FL = " << p.FL
 			 << ",FR = " << p.FR;
-		if (!usingMMB)  file << ",Fm = " << p_node.Fm;
-		file << ",JL = " << p.JL
+		if (!usingMMB)  info << ",Fm = " << p_node.Fm;
+		info << ",JL = " << p.JL
 			 << ",JR = " << p.JR;
-		if (!usingMMB)  file << ",Jm = " << p_edge.Jm;
-		file << ",JmL = " << p.JmL
+		if (!usingMMB)  info << ",Jm = " << p_edge.Jm;
+		info << ",JmL = " << p.JmL
 			 << ",JmR = " << p.JmR
 			 << ",JLR = " << p.JLR
 			 << ",Je0L = " << p.Je0L
 			 << ",Je0R = " << p.Je0R;
-		if (!usingMMB)  file << ",Je0m = " << p_node.Je0m;
-		file << ",Je1L = " << p.Je1L
+		if (!usingMMB)  info << ",Je0m = " << p_node.Je0m;
+		info << ",Je1L = " << p.Je1L
 			 << ",Je1R = " << p.Je1R;
-		if (!usingMMB)  file << ",Je1m = " << p_edge.Je1m;
-		file << ",Je1mL = " << p.Je1mL
+		if (!usingMMB)  info << ",Je1m = " << p_edge.Je1m;
+		info << ",Je1mL = " << p.Je1mL
 			 << ",Je1mR = " << p.Je1mR
 			 << ",Je1LR = " << p.Je1LR
 			 << ",JeeL = " << p.JeeL
 			 << ",JeeR = " << p.JeeR;
-		if (!usingMMB)  file << ",Jeem = " << p_edge.Jeem;
-		file << ",JeemL = " << p.JeemL
+		if (!usingMMB)  info << ",Jeem = " << p_edge.Jeem;
+		info << ",JeemL = " << p.JeemL
 			 << ",JeemR = " << p.JeemR
 			 << ",JeeLR = " << p.JeeLR
 			 << ",\"AL = " << p.AL << '"'
 			 << ",\"AR = " << p.AR << '"';
-		if (!usingMMB)  file << ",\"Am = " << p_node.Am << '"';
-		file << ",bL = " << p.bL
+		if (!usingMMB)  info << ",\"Am = " << p_node.Am << '"';
+		info << ",bL = " << p.bL
 			 << ",bR = " << p.bR;
-		if (!usingMMB)  file << ",bm = " << p_edge.bm;
-		file << ",bmL = " << p.bmL
+		if (!usingMMB)  info << ",bm = " << p_edge.bm;
+		info << ",bmL = " << p.bmL
 			 << ",bmR = " << p.bmR
 			 << ",bLR = " << p.bLR
 			 << ",\"DL = " << p.DL << '"'
 			 << ",\"DR = " << p.DR << '"';
-		if (!usingMMB)  file << ",\"Dm = " << p_edge.Dm << '"';
-		file << ",\"DmL = " << p.DmL << '"'
+		if (!usingMMB)  info << ",\"Dm = " << p_edge.Dm << '"';
+		info << ",\"DmL = " << p.DmL << '"'
 			 << ",\"DmR = " << p.DmR << '"'
 			 << ",\"DLR = " << p.DLR << '"'
 			 << ",molType = " << argv[4]
 			 << ",reset = " << argv[3]
+			 << ",recordSink = " << sinkType << ':' << decimation
 			 << ",seed = " << msd.getSeed()
-			 << ",,msd_version = " << UDC_MSD_VERSION
-			 << '\n';
+			 << ",format = " << (argc > 6 ? argv[6] : "csv")
+			 << ",,msd_version = " << UDC_MSD_VERSION;
+		writer.endHeader(info.str());
+		writer.flush();
 	
 		//run simulations
 		cout << "Starting simulation...\n";
@@ -301,65 +316,55 @@ int main(int argc, char *argv[]) {
 				msd.reinitialize();
 			else if( arg3 == RANDOMIZE )
 				msd.randomize();
-			msd.record.clear();
+			sink.clear();
 			
 			cout << "kT = " << p.kT << '\n';
 			msd.set_kT(p.kT);
 			msd.metropolis(t_eq);
 			msd.metropolis(simCount, freq);
+			if (sinkType == "memory") {
+				stats.clear();
+				for (const MSD::Results &r : msd.record)
+					stats.put(r);
+			}
 			
 			cout << "Saving data...\n";
 			MSD::Results r = msd.getResults();
-			Vector avgM   = msd.meanM();
-			Vector avgML  = msd.meanML();
-			Vector avgMR  = msd.meanMR();
-			Vector avgMm  = msd.meanMm();
-			Vector avgMS   = msd.meanMS();
-			Vector avgMSL  = msd.meanMSL();
-			Vector avgMSR  = msd.meanMSR();
-			Vector avgMSm  = msd.meanMSm();
-			Vector avgMF   = msd.meanMF();
-			Vector avgMFL  = msd.meanMFL();
-			Vector avgMFR  = msd.meanMFR();
-			Vector avgMFm  = msd.meanMFm();
-			double avgU   = msd.meanU();
-			double avgUL  = msd.meanUL();
-			double avgUR  = msd.meanUR();
-			double avgUm  = msd.meanUm();
-			double avgUmL = msd.meanUmL();
-			double avgUmR = msd.meanUmR();
-			double avgULR = msd.meanULR();
-			file << p.kT << ",,"
-				 << avgM.x  << ',' << avgM.y  << ',' << avgM.z  << ',' << avgM.norm()  << ',' << avgM.theta()  << ',' << avgM.phi()  << ",,"
-				 << avgML.x << ',' << avgML.y << ',' << avgML.z << ',' << avgML.norm() << ',' << avgML.theta() << ',' << avgML.phi() << ",,"
-				 << avgMR.x << ',' << avgMR.y << ',' << avgMR.z << ',' << avgMR.norm() << ',' << avgMR.theta() << ',' << avgMR.phi() << ",,"
-				 << avgMm.x << ',' << avgMm.y << ',' << avgMm.z << ',' << avgMm.norm() << ',' << avgMm.theta() << ',' << avgMm.phi() << ",,"
-				 << avgMS.x  << ',' << avgMS.y  << ',' << avgMS.z  << ',' << avgMS.norm()  << ',' << avgMS.theta()  << ',' << avgMS.phi()  << ",,"
-				 << avgMSL.x << ',' << avgMSL.y << ',' << avgMSL.z << ',' << avgMSL.norm() << ',' << avgMSL.theta() << ',' << avgMSL.phi() << ",,"
-				 << avgMSR.x << ',' << avgMSR.y << ',' << avgMSR.z << ',' << avgMSR.norm() << ',' << avgMSR.theta() << ',' << avgMSR.phi() << ",,"
-				 << avgMSm.x << ',' << avgMSm.y << ',' << avgMSm.z << ',' << avgMSm.norm() << ',' << avgMSm.theta() << ',' << avgMSm.phi() << ",,"
-				 << avgMF.x  << ',' << avgMF.y  << ',' << avgMF.z  << ',' << avgMF.norm()  << ',' << avgMF.theta()  << ',' << avgMF.phi()  << ",,"
-				 << avgMFL.x << ',' << avgMFL.y << ',' << avgMFL.z << ',' << avgMFL.norm() << ',' << avgMFL.theta() << ',' << avgMFL.phi() << ",,"
-				 << avgMFR.x << ',' << avgMFR.y << ',' << avgMFR.z << ',' << avgMFR.norm() << ',' << avgMFR.theta() << ',' << avgMFR.phi() << ",,"
-				 << avgMFm.x << ',' << avgMFm.y << ',' << avgMFm.z << ',' << avgMFm.norm() << ',' << avgMFm.theta() << ',' << avgMFm.phi() << ",,"
-				 << avgU << ',' << avgUL << ',' << avgUR << ',' << avgUm << ',' << avgUmL << ',' << avgUmR << ',' << avgULR << ",,"
-				 << msd.specificHeat()    << ',' << msd.specificHeat_L()  << ',' << msd.specificHeat_R()  << ',' << msd.specificHeat_m() << ','
-				 << msd.specificHeat_mL() << ',' << msd.specificHeat_mR() << ',' << msd.specificHeat_LR() << ",,"
-				 << msd.magneticSusceptibility()   << ',' << msd.magneticSusceptibility_L() << ','
-				 << msd.magneticSusceptibility_R() << ',' << msd.magneticSusceptibility_m() << ",,"
-				 << r.M.x  << ',' << r.M.y  << ',' << r.M.z  << ',' << r.M.norm()  << ',' << r.M.theta()  << ',' << r.M.phi()  << ",,"
-				 << r.ML.x << ',' << r.ML.y << ',' << r.ML.z << ',' << r.ML.norm() << ',' << r.ML.theta() << ',' << r.ML.phi() << ",,"
-				 << r.MR.x << ',' << r.MR.y << ',' << r.MR.z << ',' << r.MR.norm() << ',' << r.MR.theta() << ',' << r.MR.phi() << ",,"
-				 << r.Mm.x << ',' << r.Mm.y << ',' << r.Mm.z << ',' << r.Mm.norm() << ',' << r.Mm.theta() << ',' << r.Mm.phi() << ",,"
-				 << r.MS.x  << ',' << r.MS.y  << ',' << r.MS.z  << ',' << r.MS.norm()  << ',' << r.MS.theta()  << ',' << r.MS.phi()  << ",,"
-				 << r.MSL.x << ',' << r.MSL.y << ',' << r.MSL.z << ',' << r.MSL.norm() << ',' << r.MSL.theta() << ',' << r.MSL.phi() << ",,"
-				 << r.MSR.x << ',' << r.MSR.y << ',' << r.MSR.z << ',' << r.MSR.norm() << ',' << r.MSR.theta() << ',' << r.MSR.phi() << ",,"
-				 << r.MSm.x << ',' << r.MSm.y << ',' << r.MSm.z << ',' << r.MSm.norm() << ',' << r.MSm.theta() << ',' << r.MSm.phi() << ",,"
-				 << r.MF.x  << ',' << r.MF.y  << ',' << r.MF.z  << ',' << r.MF.norm()  << ',' << r.MF.theta()  << ',' << r.MF.phi()  << ",,"
-				 << r.MFL.x << ',' << r.MFL.y << ',' << r.MFL.z << ',' << r.MFL.norm() << ',' << r.MFL.theta() << ',' << r.MFL.phi() << ",,"
-				 << r.MFR.x << ',' << r.MFR.y << ',' << r.MFR.z << ',' << r.MFR.norm() << ',' << r.MFR.theta() << ',' << r.MFR.phi() << ",,"
-				 << r.MFm.x << ',' << r.MFm.y << ',' << r.MFm.z << ',' << r.MFm.norm() << ',' << r.MFm.theta() << ',' << r.MFm.phi() << ",,"
-				 << r.U << ',' << r.UL << ',' << r.UR << ',' << r.Um << ',' << r.UmL << ',' << r.UmR << ',' << r.ULR << '\n';
+			MSD::Results avg;
+			avg.M   = stats.meanM();
+			avg.ML  = stats.meanML();
+			avg.MR  = stats.meanMR();
+			avg.Mm  = stats.meanMm();
+			avg.MS  = stats.meanMS();
+			avg.MSL = stats.meanMSL();
+			avg.MSR = stats.meanMSR();
+			avg.MSm = stats.meanMSm();
+			avg.MF  = stats.meanMF();
+			avg.MFL = stats.meanMFL();
+			avg.MFR = stats.meanMFR();
+			avg.MFm = stats.meanMFm();
+			avg.U   = stats.meanU();
+			avg.UL  = stats.meanUL();
+			avg.UR  = stats.meanUR();
+			avg.Um  = stats.meanUm();
+			avg.UmL = stats.meanUmL();
+			avg.UmR = stats.meanUmR();
+			avg.ULR = stats.meanULR();
+			writer.value(p.kT);
+			writer.spacer();
+			writer.results(avg);
+			writer.spacer();
+			for (double c : {stats.specificHeat(), stats.specificHeat_L(), stats.specificHeat_R(), stats.specificHeat_m(),
+			                 stats.specificHeat_mL(), stats.specificHeat_mR(), stats.specificHeat_LR()})
+				writer.value(c);
+			writer.spacer();
+			for (double x : {stats.magneticSusceptibility(), stats.magneticSusceptibility_L(),
+			                 stats.magneticSusceptibility_R(), stats.magneticSusceptibility_m()})
+				writer.value(x);
+			writer.spacer();
+			writer.results(r);
+			writer.endRow();
+			writer.flush();
 		};
 		if (kT_inc > 0) {
 			for (p.kT = kT_min; p.kT <= kT_max; p.kT += kT_inc)
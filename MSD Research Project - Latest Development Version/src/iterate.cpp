@@ -14,7 +14,10 @@
 #include <string>
 #include <map>
 #include <limits>
+#include <memory>
 #include "MSD.h"
+#include "RecordSink.h"
+#include "ResultsWriter.h"
 
 using namespace std;
 using namespace udc;
@@ -83,7 +86,9 @@ int main(int argc, char *argv[]) {
 		MOL_TYPE = 3,
 		RANDOMIZE = 4,
 		SEED = 5,
-		INPUT_FILE = 6;
+		INPUT_FILE = 6,
+		RECORD_SINK = 7,  // "memory" (default) or "stream", optionally followed by ":<decimation>"
+		FORMAT = 8;  // "csv" (default), "csv-xyz", "binary", or "binary-xyz"
 
 	if( argc > OUT_FILE ) {
 		ifstream file(argv[OUT_FILE]);
@@ -135,6 +140,23 @@ int main(int argc, char *argv[]) {
 	} else
 		cout << "Defaulting to 'MOL_TYPE=LINEAR'.\n";
 
+	string sinkType = "memory";
+	unsigned long long decimation = 1;
+	if (argc > RECORD_SINK) {
+		if (!parseRecordSinkSpec(argv[RECORD_SINK], sinkType, decimation)
+				|| (sinkType != "memory" && sinkType != "stream")) {
+			cerr << "Unrecognized RECORD_SINK: " << argv[RECORD_SINK] << '\n';
+			return INVALID_PARAM_ERR;
+		}
+	}
+
+	ResultsWriter::Format format = ResultsWriter::CSV;
+	bool derived = true;  // include norm, theta, and phi columns?
+	if (argc > FORMAT && !parseResultsFormat(argv[FORMAT], format, derived)) {
+		cerr << "Unrecognized FORMAT: " << argv[FORMAT] << '\n';
+		return INVALID_PARAM_ERR;
+	}
+
 	map<string, string> params;
 	vector<Spin> spins;
 	if (argc > INPUT_FILE) {
@@ -197,6 +219,19 @@ int main(int argc, char *argv[]) {
 		cerr << "Couldn't open output file \"" << argv[1] << "\" for writing: " << e.what() << '\n';
 		return OUT_FILE_ERR;
 	}
+
+	// binary records go to their own file, since the CSV is still used for the header and snapshot
+	string binFileName = string(argv[OUT_FILE]) + ".bin";
+	ofstream binFile;
+	if (format == ResultsWriter::BINARY) {
+		binFile.exceptions( ios::badbit | ios::failbit );
+		try {
+			binFile.open(binFileName, ios::binary);
+		} catch(const ios::failure &e) {
+			cerr << "Couldn't open output file \"" << binFileName << "\" for writing: " << e.what() << '\n';
+			return OUT_FILE_ERR;
+		}
+	}
 	
 	//get parameters
 	unsigned int width, height, depth, molPosL, molPosR, topL, bottomL, frontR, backR;
@@ -204,6 +239,8 @@ int main(int argc, char *argv[]) {
 	MSD::Parameters p;
 	Molecule::NodeParameters p_node;  // used iff not usingMMB
 	Molecule::EdgeParameters p_edge;  // used iff not usingMMB
+	double dipolar = 0;  // optional long-range dipolar term. Off (0) unless given in the input file.
+	unsigned long long dipolarRefresh = 0;  // 0: once per sweep
 	
 	cin.exceptions( ios::badbit | ios::failbit | ios::eofbit );
 	try {
@@ -281,6 +318,8 @@ int main(int argc, char *argv[]) {
 		getParam(params, "DmR", p.DmR);
 		getParam(params, "DLR", p.DLR);
 		cout << '\n';
+		if (params.count("dipolar") > 0)  getParam(params, "dipolar", dipolar);
+		if (params.count("dipolarRefresh") > 0)  getParam(params, "dipolarRefresh", dipolarRefresh);
 	} catch(ios::failure &e) {
 		cerr << "Invalid parameter: " << e.what() << '\n';
 		return INVALID_PARAM_ERR;
@@ -304,6 +343,8 @@ int main(int argc, char *argv[]) {
 		msd.setMolProto(molProto);
 	else
 		msd.setMolParameters(p_node, p_edge);
+	if (dipolar != 0)
+		msd.setDipolar(dipolar, dipolarRefresh);
 
 	bool customSeed = (argc > SEED && string(argv[SEED]) != string("unique"));
 	if (customSeed) {
@@ -322,15 +363,15 @@ int main(int argc, char *argv[]) {
 
 	try {
 		//print info/headings
-		file << "t,,"
-		        "M_x,M_y,M_z,M_norm,M_theta,M_phi,,ML_x,ML_y,ML_z,ML_norm,ML_theta,ML_phi,,"
-				"MR_x,MR_y,MR_z,MR_norm,MR_theta,MR_phi,,Mm_x,Mm_y,Mm_z,Mm_norm,Mm_theta,Mm_phi,,"
-				"MS_x,MS_y,MS_z,MS_norm,MS_theta,MS_phi,,MSL_x,MSL_y,MSL_z,MSL_norm,MSL_theta,MSL_phi,,"
-				"MSR_x,MSR_y,MSR_z,MSR_norm,MSR_theta,MSR_phi,,MSm_x,MSm_y,MSm_z,MSm_norm,MSm_theta,MSm_phi,,"
-				"MF_x,MF_y,MF_z,MF_norm,MF_theta,MF_phi,,MFL_x,MFL_y,MFL_z,MFL_norm,MFL_theta,MFL_phi,,"
-				"MFR_x,MFR_y,MFR_z,MFR_norm,MFR_theta,MFR_phi,,MFm_x,MFm_y,MFm_z,MFm_norm,MFm_theta,MFm_phi,,"
-				"U,UL,UR,Um,UmL,UmR,ULR,,,x,y,z,m_x,m_y,m_z,s_x,s_y,s_z,f_x,f_y,f_z,,"
-			    ",width = " << msd.getWidth()
+		ResultsWriter writer(file, ResultsWriter::CSV, derived);
+		writer.recordColumnNames();
+		writer.spacers(2);
+		for (const char *name : {"x", "y", "z", "m_x", "m_y", "m_z", "s_x", "s_y", "s_z", "f_x", "f_y", "f_z"})
+			writer.columnName(name);
+		writer.spacers(2);
+
+		ostringstream info;
+		info << ",width = " << msd.getWidth()
 			 << ",height = " << msd.getHeight()
 			 << ",depth = " << msd.getDepth()
 			 << ",molPosL = " << msd.getMolPosL()
@@ -345,51 +386,71 @@ int main(int argc, char *argv[]) {
 			 << ",\"B = " << p.B << '"'
 			 << ",SL = " << p.SL
 			 << ",SR = " << p.SR;
-		if(!usingMMB)  file << ",Sm = " << p_node.Sm;
-		file << ",FL = " << p.FL
+		if(!usingMMB)  info << ",Sm = " << p_node.Sm;
+		info << ",FL = " << p.FL
 			 << ",FR = " << p.FR;
-		if (!usingMMB)  file << ",Fm = " << p_node.Fm;
-		file << ",JL = " << p.JL
+		if (!usingMMB)  info << ",Fm = " << p_node.Fm;
+		info << ",JL = " << p.JL
 			 << ",JR = " << p.JR;
-		if (!usingMMB)  file << ",Jm = " << p_edge.Jm;
-		file << ",JmL = " << p.JmL
+		if (!usingMMB)  info << ",Jm = " << p_edge.Jm;
+		info << ",JmL = " << p.JmL
 			 << ",JmR = " << p.JmR
 			 << ",JLR = " << p.JLR
 			 << ",Je0L = " << p.Je0L
 			 << ",Je0R = " << p.Je0R;
-		if (!usingMMB)  file << ",Je0m = " << p_node.Je0m;
-		file << ",Je1L = " << p.Je1L
+		if (!usingMMB)  info << ",Je0m = " << p_node.Je0m;
+		info << ",Je1L = " << p.Je1L
 			 << ",Je1R = " << p.Je1R;
-		if (!usingMMB)  file << ",Je1m = " << p_edge.Je1m;
-		file << ",Je1mL = " << p.Je1mL
+		if (!usingMMB)  info << ",Je1m = " << p_edge.Je1m;
+		info << ",Je1mL = " << p.Je1mL
 			 << ",Je1mR = " << p.Je1mR
 			 << ",Je1LR = " << p.Je1LR
 			 << ",JeeL = " << p.JeeL
 			 << ",JeeR = " << p.JeeR;
-		if (!usingMMB)  file << ",Jeem = " << p_edge.Jeem;
-		file << ",JeemL = " << p.JeemL
+		if (!usingMMB)  info << ",Jeem = " << p_edge.Jeem;
+		info << ",JeemL = " << p.JeemL
 			 << ",JeemR = " << p.JeemR
 			 << ",JeeLR = " << p.JeeLR
 			 << ",\"AL = " << p.AL << '"'
 			 << ",\"AR = " << p.AR << '"';
-		if (!usingMMB)  file << ",\"Am = " << p_node.Am << '"';
-		file << ",bL = " << p.bL
+		if (!usingMMB)  info << ",\"Am = " << p_node.Am << '"';
+		info << ",bL = " << p.bL
 			 << ",bR = " << p.bR;
-		if (!usingMMB)  file << ",bm = " << p_edge.bm;
-		file << ",bmL = " << p.bmL
+		if (!usingMMB)  info << ",bm = " << p_edge.bm;
+		info << ",bmL = " << p.bmL
 			 << ",bmR = " << p.bmR
 			 << ",bLR = " << p.bLR
 			 << ",\"DL = " << p.DL << '"'
 			 << ",\"DR = " << p.DR << '"';
-		if (!usingMMB)  file << ",\"Dm = " << p_edge.Dm << '"';
-		file << ",\"DmL = " << p.DmL << '"'
+		if (!usingMMB)  info << ",\"Dm = " << p_edge.Dm << '"';
+		info << ",\"DmL = " << p.DmL << '"'
 			 << ",\"DmR = " << p.DmR << '"'
-			 << ",\"DLR = " << p.DLR << '"'
-			 << ",molType = " << argv[MOL_TYPE]
+			 << ",\"DLR = " << p.DLR << '"';
+		if (dipolar != 0)  info << ",dipolar = " << dipolar << ",dipolarRefresh = " << dipolarRefresh;
+		info << ",molType = " << argv[MOL_TYPE]
 			 << ",randomize = " << argv[RANDOMIZE]
 			 << ",seed = " << msd.getSeed()
-			 << ",,msd_version = " << UDC_MSD_VERSION
-			 << '\n';
+			 << ",recordSink = " << sinkType << ':' << decimation
+			 << ",format = " << (argc > FORMAT ? argv[FORMAT] : "csv")
+			 << ",,msd_version = " << UDC_MSD_VERSION;
+		writer.endHeader(info.str());
+		writer.flush();  // since "file" may be used by fileSink
+		if (format == ResultsWriter::BINARY) {
+			ResultsWriter binWriter(binFile, ResultsWriter::BINARY, derived);
+			binWriter.recordColumnNames();
+			binWriter.endHeader(info.str());
+			binWriter.flush();
+		}
+
+		// "memory": store in msd.record, and write after the simulation (along side the snapshot in CSV).
+		// "stream": write records to the output file during the simulation.
+		//           In CSV, the snapshot will follow the records instead of being along side them.
+		VectorRecordSink memorySink(msd.record);
+		unique_ptr<AsyncFileRecordSink> fileSink;
+		if (sinkType == "stream")
+			fileSink.reset(new AsyncFileRecordSink(format == ResultsWriter::BINARY ? binFile : file, format, derived));
+		DecimatingRecordSink sink(fileSink ? (MSD::RecordSink &) *fileSink : memorySink, decimation);
+		msd.recordSink = &sink;
 	
 		//run simulations
 		cout << "Starting simulation...\n";
@@ -405,6 +466,16 @@ int main(int argc, char *argv[]) {
 			}
 		}
 		msd.metropolis(simCount, freq);
+		if (fileSink) {
+			fileSink->close();  // wait for all the streamed records to be written
+		} else if (format == ResultsWriter::BINARY) {
+			ResultsWriter binWriter(binFile, ResultsWriter::BINARY, derived);
+			for (const MSD::Results &r : msd.record) {
+				binWriter.record(r);
+				binWriter.endRow();
+			}
+			binWriter.flush();
+		}
 	
 		//print stability info
 		cout << "Saving data...\n";
@@ -475,45 +546,45 @@ int main(int argc, char *argv[]) {
 			++mmtLine;
 		};
 
-		for( auto iter = msd.record.begin(); iter != msd.record.end(); iter++ ) {
-			file << iter->t << ",,"
-			     << iter->M.x  << ',' << iter->M.y  << ',' << iter->M.z  << ',' << iter->M.norm()  << ',' << iter->M.theta()  << ',' << iter->M.phi()  << ",,"
-				 << iter->ML.x << ',' << iter->ML.y << ',' << iter->ML.z << ',' << iter->ML.norm() << ',' << iter->ML.theta() << ',' << iter->ML.phi() << ",,"
-				 << iter->MR.x << ',' << iter->MR.y << ',' << iter->MR.z << ',' << iter->MR.norm() << ',' << iter->MR.theta() << ',' << iter->MR.phi() << ",,"
-				 << iter->Mm.x << ',' << iter->Mm.y << ',' << iter->Mm.z << ',' << iter->Mm.norm() << ',' << iter->Mm.theta() << ',' << iter->Mm.phi() << ",,"
-				 << iter->MS.x  << ',' << iter->MS.y  << ',' << iter->MS.z  << ',' << iter->MS.norm()  << ',' << iter->MS.theta()  << ',' << iter->MS.phi()  << ",,"
-				 << iter->MSL.x << ',' << iter->MSL.y << ',' << iter->MSL.z << ',' << iter->MSL.norm() << ',' << iter->MSL.theta() << ',' << iter->MSL.phi() << ",,"
-				 << iter->MSR.x << ',' << iter->MSR.y << ',' << iter->MSR.z << ',' << iter->MSR.norm() << ',' << iter->MSR.theta() << ',' << iter->MSR.phi() << ",,"
-				 << iter->MSm.x << ',' << iter->MSm.y << ',' << iter->MSm.z << ',' << iter->MSm.norm() << ',' << iter->MSm.theta() << ',' << iter->MSm.phi() << ",,"
-				 << iter->MF.x  << ',' << iter->MF.y  << ',' << iter->MF.z  << ',' << iter->MF.norm()  << ',' << iter->MF.theta()  << ',' << iter->MF.phi()  << ",,"
-				 << iter->MFL.x << ',' << iter->MFL.y << ',' << iter->MFL.z << ',' << iter->MFL.norm() << ',' << iter->MFL.theta() << ',' << iter->MFL.phi() << ",,"
-				 << iter->MFR.x << ',' << iter->MFR.y << ',' << iter->MFR.z << ',' << iter->MFR.norm() << ',' << iter->MFR.theta() << ',' << iter->MFR.phi() << ",,"
-				 << iter->MFm.x << ',' << iter->MFm.y << ',' << iter->MFm.z << ',' << iter->MFm.norm() << ',' << iter->MFm.theta() << ',' << iter->MFm.phi() << ",,"
-			     << iter->U << ',' << iter->UL << ',' << iter->UR << ',' << iter->Um << ',' << iter->UmL << ',' << iter->UmR << ',' << iter->ULR << ",,,";
+		size_t csvRecordCount = (format == ResultsWriter::CSV ? msd.record.size() : 0);
+		for( size_t i = 0; i < csvRecordCount; i++ ) {
+			writer.record(msd.record[i]);
+			writer.spacers(2);
 			if( msdIter != msd.end() ) {
 				Vector m = msdIter.getLocalM(), s = msdIter.getSpin(), f = msdIter.getFlux();
-				file << msdIter.getX() << ',' << msdIter.getY() << ',' << msdIter.getZ() << ','
-				     << m.x << ',' << m.y << ',' << m.z << ','
-					 << s.x << ',' << s.y << ',' << s.z << ','
-					 << f.x << ',' << f.y << ',' << f.z;
+				writer.value(msdIter.getX());
+				writer.value(msdIter.getY());
+				writer.value(msdIter.getZ());
+				for (double d : {m.x, m.y, m.z, s.x, s.y, s.z, f.x, f.y, f.z})
+					writer.value(d);
 				++msdIter;
-			}
-			if (notDonePrintingMMT())
+			} else
+				writer.spacer();
+			if (notDonePrintingMMT()) {
+				writer.flush();
 				printMMT(msdIter == msd.end() ? 11 : 0);
-
-			file << '\n';
+			}
+			writer.endRow();
 		}
 		for( ; msdIter != msd.end(); ++msdIter ) {
 			Vector m = msdIter.getLocalM(), s = msdIter.getSpin(), f = msdIter.getFlux();
-			file << ",, ,,,,,,, ,,,,,,, ,,,,,,, ,,,,,,, ,,,,,,, ,,,,,,, ,,,,,,, ,,,,,,, ,,,,,,, ,,,,,,, ,,,,,,, ,,,,,,, ,,,,,,,,,"
-			     << msdIter.getX() << ',' << msdIter.getY() << ',' << msdIter.getZ() << ','
-			     << m.x << ',' << m.y << ',' << m.z << ','
-			     << s.x << ',' << s.y << ',' << s.z << ','
-			     << f.x << ',' << f.y << ',' << f.z;
-			if (notDonePrintingMMT())
+			// padding for missing data section
+			if (derived)
+				writer.text(",, ,,,,,,, ,,,,,,, ,,,,,,, ,,,,,,, ,,,,,,, ,,,,,,, ,,,,,,, ,,,,,,, ,,,,,,, ,,,,,,, ,,,,,,, ,,,,,,, ,,,,,,,,");  // (same as older versions)
+			else
+				writer.spacers(ResultsWriter::recordColumnCount(derived) + 2);
+			writer.value(msdIter.getX());
+			writer.value(msdIter.getY());
+			writer.value(msdIter.getZ());
+			for (double d : {m.x, m.y, m.z, s.x, s.y, s.z, f.x, f.y, f.z})
+				writer.value(d);
+			if (notDonePrintingMMT()) {
+				writer.flush();
 				printMMT(0);
-			file << '\n';
+			}
+			writer.endRow();
 		}
+		writer.flush();
 		while(notDonePrintingMMT()) {
 			printMMT(95 + 11);
 			file << '\n';
@@ -9,8 +9,10 @@
 
 #include <fstream>
 #include <iostream>
+#include <sstream>
 #include <string>
 #include "MSD.h"
+#include "ResultsWriter.h"
 
 using namespace std;
 using namespace udc;
@@ -78,8 +80,18 @@ int main(int argc, char *argv[]) {
 		}
 	} else
 		cout << "Defaulting to 'LINEAR'.\n";
+
+	ResultsWriter::Format format = ResultsWriter::CSV;  // "csv", "csv-xyz", "binary", or "binary-xyz"
+	bool derived = true;  // false for the "-xyz" formats
+	if (argc > 6) {
+		if (!parseResultsFormat(argv[6], format, derived)) {
+			cerr << "Unrecognized FORMAT: " << argv[6] << '\n';
+			return 2;
+		}
+	} else
+		cout << "Defaulting to 'csv'.\n";
 	
-	ofstream file(argv[1]);
+	ofstream file(argv[1], format == ResultsWriter::BINARY ? ios::out | ios::binary : ios::out);
 	file.exceptions( ios::badbit | ios::failbit );
 	
 	//get parameters
@@ -186,21 +198,15 @@ int main(int argc, char *argv[]) {
 	
 	try {
 		//print info/headings
-		file << "B_x,B_y,B_z,B_norm,,"
-				"M_x,M_y,M_z,M_norm,M_theta,M_phi,,"
-				"ML_x,ML_y,ML_z,ML_norm,ML_theta,ML_phi,,"
-				"MR_x,MR_y,MR_z,MR_norm,MR_theta,MR_phi,,"
-				"Mm_x,Mm_y,Mm_z,Mm_norm,Mm_theta,Mm_phi,,"
-				"MS_x,MS_y,MS_z,MS_norm,MS_theta,MS_phi,,"
-				"MSL_x,MSL_y,MSL_z,MSL_norm,MSL_theta,MSL_phi,,"
-				"MSR_x,MSR_y,MSR_z,MSR_norm,MSR_theta,MSR_phi,,"
-				"MSm_x,MSm_y,MSm_z,MSm_norm,MSm_theta,MSm_phi,,"
-				"MF_x,MF_y,MF_z,MF_norm,MF_theta,MF_phi,,"
-				"MFL_x,MFL_y,MFL_z,MFL_norm,MFL_theta,MFL_phi,,"
-				"MFR_x,MFR_y,MFR_z,MFR_norm,MFR_theta,MFR_phi,,"
-				"MFm_x,MFm_y,MFm_z,MFm_norm,MFm_theta,MFm_phi,,"
-				"U,UL,UR,Um,UmL,UmR,ULR,"
-			    ",width = " << msd.getWidth()
+		ResultsWriter writer(file, format, derived);
+		for (const char *name : {"B_x", "B_y", "B_z", "B_norm"})
+			writer.columnName(name);
+		writer.columnName("");
+		writer.resultsColumnNames();
+		writer.columnName("");
+
+		ostringstream info;
+		info << ",width = " << msd.getWidth()
 			 << ",height = " << msd.getHeight()
 			 << ",depth = " << msd.getDepth()
 			 << ",molPosL = " << msd.getMolPosL()
@@ -219,52 +225,53 @@ int main(int argc, char *argv[]) {
 			 << ",B_phi = " << B_phi
 			 << ",SL = " << p.SL
 			 << ",SR = " << p.SR;
-		if (!usingMMB)  file << ",Sm = " << p_node.Sm;
-		file << ",FL = " << p.FL
+		if (!usingMMB)  info << ",Sm = " << p_node.Sm;
+		info << ",FL = " << p.FL
 			 << ",FR = " << p.FR;
-		if (!usingMMB)  file << ",Fm = " << p_node.Fm;
-		file << ",JL = " << p.JL
+		if (!usingMMB)  info << ",Fm = " << p_node.Fm;
+		info << ",JL = " << p.JL
 			 << ",JR = " << p.JR;
-		if (!usingMMB)  file << ",Jm = " << p_edge.Jm;
-		file << ",JmL = " << p.JmL
+		if (!usingMMB)  info << ",Jm = " << p_edge.Jm;
+		info << ",JmL = " << p.JmL
 			 << ",JmR = " << p.JmR
 			 << ",JLR = " << p.JLR
 			 << ",Je0L = " << p.Je0L
 			 << ",Je0R = " << p.Je0R;
-		if (!usingMMB)  file << ",Je0m = " << p_node.Je0m;
-		file << ",Je1L = " << p.Je1L
+		if (!usingMMB)  info << ",Je0m = " << p_node.Je0m;
+		info << ",Je1L = " << p.Je1L
 			 << ",Je1R = " << p.Je1R;
-		if (!usingMMB)  file << ",Je1m = " << p_edge.Je1m;
-		file << ",Je1mL = " << p.Je1mL
+		if (!usingMMB)  info << ",Je1m = " << p_edge.Je1m;
+		info << ",Je1mL = " << p.Je1mL
 			 << ",Je1mR = " << p.Je1mR
 			 << ",Je1LR = " << p.Je1LR
 			 << ",JeeL = " << p.JeeL
 			 << ",JeeR = " << p.JeeR;
-		if (!usingMMB)  file << ",Jeem = " << p_edge.Jeem;
-		file << ",JeemL = " << p.JeemL
+		if (!usingMMB)  info << ",Jeem = " << p_edge.Jeem;
+		info << ",JeemL = " << p.JeemL
 			 << ",JeemR = " << p.JeemR
 			 << ",JeeLR = " << p.JeeLR
 			 << ",\"AL = " << p.AL << '"'
 			 << ",\"AR = " << p.AR << '"';
-		if (!usingMMB)  file << ",\"Am = " << p_node.Am << '"';
-		file << ",bL = " << p.bL
+		if (!usingMMB)  info << ",\"Am = " << p_node.Am << '"';
+		info << ",bL = " << p.bL
 			 << ",bR = " << p.bR;
-		if (!usingMMB)  file << ",bm = " << p_edge.bm;
-		file << ",bmL = " << p.bmL
+		if (!usingMMB)  info << ",bm = " << p_edge.bm;
+		info << ",bmL = " << p.bmL
 			 << ",bmR = " << p.bmR
 			 << ",bLR = " << p.bLR
 			 << ",\"DL = " << p.DL << '"'
 			 << ",\"DR = " << p.DR << '"';
-		if (!usingMMB)  file << ",\"Dm = " << p_edge.Dm << '"';
-		file << ",\"DmL = " << p.DmL << '"'
+		if (!usingMMB)  info << ",\"Dm = " << p_edge.Dm << '"';
+		info << ",\"DmL = " << p.DmL << '"'
 			 << ",\"DmR = " << p.DmR << '"'
 			 << ",\"DLR = " << p.DLR << '"'
 			 << ",molType = " << argv[5]
 			 << ",randomize = " << argv[3]
 			 << ",startWithMaxB = " << argv[4]
 			 << ",seed = " << msd.getSeed()
-			 << ",,msd_version = " << UDC_MSD_VERSION
-			 << '\n';
+			 << ",format = " << (argc > 6 ? argv[6] : "csv")
+			 << ",,msd_version = " << UDC_MSD_VERSION;
+		writer.endHeader(info.str());
 		
 		// convert from degrees to radians
 		B_theta *= PI / 180.0;
@@ -277,20 +284,11 @@ int main(int argc, char *argv[]) {
 			cout << "Saving data...\n";
 			
 			MSD::Results r = msd.getResults();
-			file << p.B.x  << ',' << p.B.y  << ',' << p.B.z  << ',' << p.B.norm()  << ",,"
-				 << r.M.x  << ',' << r.M.y  << ',' << r.M.z  << ',' << r.M.norm()  << ',' << r.M.theta()  << ',' << r.M.phi()  << ",,"
-				 << r.ML.x << ',' << r.ML.y << ',' << r.ML.z << ',' << r.ML.norm() << ',' << r.ML.theta() << ',' << r.ML.phi() << ",,"
-				 << r.MR.x << ',' << r.MR.y << ',' << r.MR.z << ',' << r.MR.norm() << ',' << r.MR.theta() << ',' << r.MR.phi() << ",,"
-				 << r.Mm.x << ',' << r.Mm.y << ',' << r.Mm.z << ',' << r.Mm.norm() << ',' << r.Mm.theta() << ',' << r.Mm.phi() << ",,"
-				 << r.MS.x  << ',' << r.MS.y  << ',' << r.MS.z  << ',' << r.MS.norm()  << ',' << r.MS.theta()  << ',' << r.MS.phi()  << ",,"
-				 << r.MSL.x << ',' << r.MSL.y << ',' << r.MSL.z << ',' << r.MSL.norm() << ',' << r.MSL.theta() << ',' << r.MSL.phi() << ",,"
-				 << r.MSR.x << ',' << r.MSR.y << ',' << r.MSR.z << ',' << r.MSR.norm() << ',' << r.MSR.theta() << ',' << r.MSR.phi() << ",,"
-				 << r.MSm.x << ',' << r.MSm.y << ',' << r.MSm.z << ',' << r.MSm.norm() << ',' << r.MSm.theta() << ',' << r.MSm.phi() << ",,"
-				 << r.MF.x  << ',' << r.MF.y  << ',' << r.MF.z  << ',' << r.MF.norm()  << ',' << r.MF.theta()  << ',' << r.MF.phi()  << ",,"
-				 << r.MFL.x << ',' << r.MFL.y << ',' << r.MFL.z << ',' << r.MFL.norm() << ',' << r.MFL.theta() << ',' << r.MFL.phi() << ",,"
-				 << r.MFR.x << ',' << r.MFR.y << ',' << r.MFR.z << ',' << r.MFR.norm() << ',' << r.MFR.theta() << ',' << r.MFR.phi() << ",,"
-				 << r.MFm.x << ',' << r.MFm.y << ',' << r.MFm.z << ',' << r.MFm.norm() << ',' << r.MFm.theta() << ',' << r.MFm.phi() << ",,"
-				 << r.U << ',' << r.UL << ',' << r.UR << ',' << r.Um << ',' << r.UmL << ',' << r.UmR << ',' << r.ULR << '\n';
+			for (double b : {p.B.x, p.B.y, p.B.z, p.B.norm()})
+				writer.value(b);
+			writer.spacer();
+			writer.results(r);
+			writer.endRow();
 		};
 		
 		unsigned long long simCount = 0L;
@@ -343,6 +341,7 @@ int main(int argc, char *argv[]) {
 			sim();
 			p.B += dB;
 		}
+		writer.flush();
 		
 	} catch(ios::failure &e) {
 		cerr << "Couldn't write to output file \"" << argv[1] << "\": " << e.what() << '\n';
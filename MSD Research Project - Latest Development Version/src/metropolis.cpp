@@ -7,6 +7,7 @@
  * @copyright Copyright (c) 2023
  */
 
+#include <charconv>
 #include <cstdlib>
 #include <ctime>
 #include <fstream>
@@ -23,6 +24,7 @@
 #include "rapidxml.hpp"
 #include "rapidxml_print.hpp"
 #include "MSD.h"
+#include "ColumnFile.h"
 
 
 using namespace std;
@@ -67,6 +69,16 @@ void recordVar( memory_pool<> &mem, xml_node<> &data, const char *type, const ch
 	data.append_node(var);
 }
 
+/**
+ * Rounds a value the same way recordVar() does when writing it to XML (i.e. 6 significant digits),
+ * so "kT = 0.3" can still be used as a filter on a column file parameter like 0.1 + 0.1 + 0.1.
+ */
+double roundAsRecorded(double value) {
+	char buf[32];
+	*to_chars(buf, buf + sizeof(buf) - 1, value, chars_format::general, 6).ptr = '\0';
+	return strtod(buf, NULL);
+}
+
 struct Atom {
 	unsigned int x, y, z;
 	Vector spin, flux, mag;
@@ -99,6 +111,148 @@ struct Info {
 	vector<Atom> atoms;
 };
 
+/**
+ * Calls f(type, name, value) for each parameter ("param") and result ("result") of a single
+ * simulation, in the order they are written to the output file.
+ */
+template <typename F> void forEachVar(const Info &info, F f) {
+	//record parameters
+	f( "param", "kT", info.parameters.kT );
+	f( "param", "B_x", info.parameters.B.x );
+	f( "param", "B_y", info.parameters.B.y );
+	f( "param", "B_z", info.parameters.B.z );
+	f( "param", "SL", info.parameters.SL );
+	f( "param", "SR", info.parameters.SR );
+	f( "param", "Sm", info.nodeParameters.Sm );
+	f( "param", "FL", info.parameters.FL );
+	f( "param", "FR", info.parameters.FR );
+	f( "param", "Fm", info.nodeParameters.Fm );
+	f( "param", "JL", info.parameters.JL );
+	f( "param", "JR", info.parameters.JR );
+	f( "param", "Jm", info.edgeParameters.Jm );
+	f( "param", "JmL", info.parameters.JmL );
+	f( "param", "JmR", info.parameters.JmR );
+	f( "param", "JLR", info.parameters.JLR );
+	f( "param", "Je0L", info.parameters.Je0L );
+	f( "param", "Je0R", info.parameters.Je0R );
+	f( "param", "Je0m", info.nodeParameters.Je0m );
+	f( "param", "Je1L", info.parameters.Je1L );
+	f( "param", "Je1R", info.parameters.Je1R );
+	f( "param", "Je1m", info.edgeParameters.Je1m );
+	f( "param", "Je1mL", info.parameters.Je1mL );
+	f( "param", "Je1mR", info.parameters.Je1mR );
+	f( "param", "Je1LR", info.parameters.Je1LR );
+	f( "param", "JeeL", info.parameters.JeeL );
+	f( "param", "JeeR", info.parameters.JeeR );
+	f( "param", "Jeem", info.edgeParameters.Jeem );
+	f( "param", "JeemL", info.parameters.JeemL );
+	f( "param", "JeemR", info.parameters.JeemR );
+	f( "param", "JeeLR", info.parameters.JeeLR );
+	f( "param", "bL", info.parameters.bL );
+	f( "param", "bR", info.parameters.bR );
+	f( "param", "bm", info.edgeParameters.bm );
+	f( "param", "bmL", info.parameters.bmL );
+	f( "param", "bmR", info.parameters.bmR );
+	f( "param", "bLR", info.parameters.bLR );
+	f( "param", "AL_x", info.parameters.AL.x );
+	f( "param", "AL_y", info.parameters.AL.y );
+	f( "param", "AL_z", info.parameters.AL.z );
+	f( "param", "AR_x", info.parameters.AR.x );
+	f( "param", "AR_y", info.parameters.AR.y );
+	f( "param", "AR_z", info.parameters.AR.z );
+	f( "param", "Am_x", info.nodeParameters.Am.x );
+	f( "param", "Am_y", info.nodeParameters.Am.y );
+	f( "param", "Am_z", info.nodeParameters.Am.z );
+	f( "param", "DL_x", info.parameters.DL.x );
+	f( "param", "DL_y", info.parameters.DL.y );
+	f( "param", "DL_z", info.parameters.DL.z );
+	f( "param", "DR_x", info.parameters.DR.x );
+	f( "param", "DR_y", info.parameters.DR.y );
+	f( "param", "DR_z", info.parameters.DR.z );
+	f( "param", "Dm_x", info.edgeParameters.Dm.x );
+	f( "param", "Dm_y", info.edgeParameters.Dm.y );
+	f( "param", "Dm_z", info.edgeParameters.Dm.z );
+	f( "param", "DmL_x", info.parameters.DmL.x );
+	f( "param", "DmL_y", info.parameters.DmL.y );
+	f( "param", "DmL_z", info.parameters.DmL.z );
+	f( "param", "DmR_x", info.parameters.DmR.x );
+	f( "param", "DmR_y", info.parameters.DmR.y );
+	f( "param", "DmR_z", info.parameters.DmR.z );
+	f( "param", "DLR_x", info.parameters.DLR.x );
+	f( "param", "DLR_y", info.parameters.DLR.y );
+	f( "param", "DLR_z", info.parameters.DLR.z );
+
+	//record results
+	f( "result", "M_x", info.results.M.x );
+	f( "result", "M_y", info.results.M.y );
+	f( "result", "M_z", info.results.M.z );
+	
+	f( "result", "ML_x", info.results.ML.x );
+	f( "result", "ML_y", info.results.ML.y );
+	f( "result", "ML_z", info.results.ML.z );
+	
+	f( "result", "MR_x", info.results.MR.x );
+	f( "result", "MR_y", info.results.MR.y );
+	f( "result", "MR_z", info.results.MR.z );
+	
+	f( "result", "Mm_x", info.results.Mm.x );
+	f( "result", "Mm_y", info.results.Mm.y );
+	f( "result", "Mm_z", info.results.Mm.z );
+
+	f( "result", "MS_x", info.results.MS.x );
+	f( "result", "MS_y", info.results.MS.y );
+	f( "result", "MS_z", info.results.MS.z );
+	
+	f( "result", "MSL_x", info.results.MSL.x );
+	f( "result", "MSL_y", info.results.MSL.y );
+	f( "result", "MSL_z", info.results.MSL.z );
+	
+	f( "result", "MSR_x", info.results.MSR.x );
+	f( "result", "MSR_y", info.results.MSR.y );
+	f( "result", "MSR_z", info.results.MSR.z );
+	
+	f( "result", "MSm_x", info.results.MSm.x );
+	f( "result", "MSm_y", info.results.MSm.y );
+	f( "result", "MSm_z", info.results.MSm.z );
+
+	f( "result", "MF_x", info.results.MF.x );
+	f( "result", "MF_y", info.results.MF.y );
+	f( "result", "MF_z", info.results.MF.z );
+	
+	f( "result", "MFL_x", info.results.MFL.x );
+	f( "result", "MFL_y", info.results.MFL.y );
+	f( "result", "MFL_z", info.results.MFL.z );
+	
+	f( "result", "MFR_x", info.results.MFR.x );
+	f( "result", "MFR_y", info.results.MFR.y );
+	f( "result", "MFR_z", info.results.MFR.z );
+	
+	f( "result", "MFm_x", info.results.MFm.x );
+	f( "result", "MFm_y", info.results.MFm.y );
+	f( "result", "MFm_z", info.results.MFm.z );
+	
+	f( "result", "U", info.results.U );
+	f( "result", "UL", info.results.UL );
+	f( "result", "UR", info.results.UR );
+	f( "result", "Um", info.results.Um );
+	f( "result", "UmL", info.results.UmL );
+	f( "result", "UmR", info.results.UmR );
+	f( "result", "ULR", info.results.ULR );
+	
+	f( "result", "c", info.c );
+	f( "result", "cL", info.cL );
+	f( "result", "cR", info.cR );
+	f( "result", "cm", info.cm );
+	f( "result", "cmL", info.cmL );
+	f( "result", "cmR", info.cmR );
+	f( "result", "cLR", info.cLR );
+	
+	f( "result", "x", info.x );
+	f( "result", "xL", info.xL );
+	f( "result", "xR", info.xR );
+	f( "result", "xm", info.xm );
+}
+
 Info algorithm(Info info) {
 	MSD msd( info.width, info.height, info.depth,
 			info.molType, info.molPosL, info.molPosR,
@@ -219,6 +373,18 @@ int main(int argc, char *argv[]) {
 			return -4;
 		}
 	}
+
+	// "xml" (default) or "columns" (see ColumnFile.h)
+	bool columnOutput = false;
+	if( argc > 7 ) {
+		string format(argv[7]);
+		if( format == "columns" )
+			columnOutput = true;
+		else if( format != "xml" ) {
+			cout << "Invalid output format: " << argv[7] << '\n';
+			return -10;
+		}
+	}
 	
 	MSD::FlippingAlgorithm flippingAlgorithm;
 	string s(argv[3]);
@@ -604,10 +770,36 @@ int main(int argc, char *argv[]) {
 			root->append_node(global);
 		}
 		
-		// output XML skeleton (version, global parameters, etc...)
-		fout.close();
-		fout.open( filename, ios::out | ios::trunc );
-		fout << doc << flush;
+		unique_ptr<ColumnFileWriter> columnFile;
+		if( columnOutput ) {
+			// one column per parameter and result; the global parameters are only kept as text
+			vector<string> names;
+			vector<char> kinds;
+			forEachVar(Info(), [&](const char *type, const char *name, double) {
+				names.push_back(name);
+				kinds.push_back(type[0]);
+			});
+			unsigned long long rowCount = 1;
+			for (const auto &x : iterLengths)
+				rowCount *= x.second;
+			ostringstream columnInfo;
+			columnInfo << "flippingAlgorithm=" << argv[3] << ",initMode=" << argv[4] << ",molType=" << argv[5];
+			for (const char *name : {"width", "height", "depth", "molPosL", "molPosR", "topL", "bottomL", "frontR", "backR", "t_eq", "simCount", "freq"})
+				columnInfo << ',' << name << '=' << p.at(name)[0];
+			columnInfo << ",msd_version=" << UDC_MSD_VERSION;
+			fout.close();
+			try {
+				columnFile.reset(new ColumnFileWriter(filename, names, kinds, rowCount, columnInfo.str()));
+			} catch(const ios::failure &e) {
+				cout << "(35) Error using output file: " << filename << '\n';
+				return 0x23;
+			}
+		} else {
+			// output XML skeleton (version, global parameters, etc...)
+			fout.close();
+			fout.open( filename, ios::out | ios::trunc );
+			fout << doc << flush;
+		}
 		
 		//report starting status
 		cout << completion << "% ";
@@ -627,176 +819,64 @@ int main(int argc, char *argv[]) {
 		
 		//define a lambda function
 		auto recordData = [&](const Info &info) {
-			ostringstream timeout;
-			timeout << time(NULL);
+			if( columnFile ) {
+				vector<double> row;
+				forEachVar(info, [&](const char *type, const char *, double value) {
+					row.push_back(type[0] == 'p' ? roundAsRecorded(value) : value);
+				});
+				vector<double> snapshot;  // same order as the XML <loc> attributes
+				snapshot.reserve(12 * info.atoms.size());
+				for (const Atom &atom : info.atoms)
+					for (double d : {(double) atom.x, (double) atom.y, (double) atom.z,
+					                 atom.spin.x, atom.spin.y, atom.spin.z,
+					                 atom.flux.x, atom.flux.y, atom.flux.z,
+					                 atom.mag.x, atom.mag.y, atom.mag.z})
+						snapshot.push_back(d);
+				try {
+					columnFile->append(&row[0], snapshot.empty() ? NULL : &snapshot[0], snapshot.size());
+				} catch(const ios::failure &e) {
+					fout.setstate(ios::failbit);  // reported below
+				}
+			} else {
+				ostringstream timeout;
+				timeout << time(NULL);
 			
-			xml_node<> *data = doc.allocate_node( node_element, "data", "" );
+				xml_node<> *data = doc.allocate_node( node_element, "data", "" );
 												
-			xml_node<> *date = doc.allocate_node( node_element, "date", "" );
-			date->append_attribute( doc.allocate_attribute("timestamp", doc.allocate_string( timeout.str().c_str() )) );
-			data->append_node(date);
-
-			//record parameters
-			recordVar( doc, *data, "param", "kT", info.parameters.kT );
-			recordVar( doc, *data, "param", "B_x", info.parameters.B.x );
-			recordVar( doc, *data, "param", "B_y", info.parameters.B.y );
-			recordVar( doc, *data, "param", "B_z", info.parameters.B.z );
-			recordVar( doc, *data, "param", "SL", info.parameters.SL );
-			recordVar( doc, *data, "param", "SR", info.parameters.SR );
-			recordVar( doc, *data, "param", "Sm", info.nodeParameters.Sm );
-			recordVar( doc, *data, "param", "FL", info.parameters.FL );
-			recordVar( doc, *data, "param", "FR", info.parameters.FR );
-			recordVar( doc, *data, "param", "Fm", info.nodeParameters.Fm );
-			recordVar( doc, *data, "param", "JL", info.parameters.JL );
-			recordVar( doc, *data, "param", "JR", info.parameters.JR );
-			recordVar( doc, *data, "param", "Jm", info.edgeParameters.Jm );
-			recordVar( doc, *data, "param", "JmL", info.parameters.JmL );
-			recordVar( doc, *data, "param", "JmR", info.parameters.JmR );
-			recordVar( doc, *data, "param", "JLR", info.parameters.JLR );
-			recordVar( doc, *data, "param", "Je0L", info.parameters.Je0L );
-			recordVar( doc, *data, "param", "Je0R", info.parameters.Je0R );
-			recordVar( doc, *data, "param", "Je0m", info.nodeParameters.Je0m );
-			recordVar( doc, *data, "param", "Je1L", info.parameters.Je1L );
-			recordVar( doc, *data, "param", "Je1R", info.parameters.Je1R );
-			recordVar( doc, *data, "param", "Je1m", info.edgeParameters.Je1m );
-			recordVar( doc, *data, "param", "Je1mL", info.parameters.Je1mL );
-			recordVar( doc, *data, "param", "Je1mR", info.parameters.Je1mR );
-			recordVar( doc, *data, "param", "Je1LR", info.parameters.Je1LR );
-			recordVar( doc, *data, "param", "JeeL", info.parameters.JeeL );
-			recordVar( doc, *data, "param", "JeeR", info.parameters.JeeR );
-			recordVar( doc, *data, "param", "Jeem", info.edgeParameters.Jeem );
-			recordVar( doc, *data, "param", "JeemL", info.parameters.JeemL );
-			recordVar( doc, *data, "param", "JeemR", info.parameters.JeemR );
-			recordVar( doc, *data, "param", "JeeLR", info.parameters.JeeLR );
-			recordVar( doc, *data, "param", "bL", info.parameters.bL );
-			recordVar( doc, *data, "param", "bR", info.parameters.bR );
-			recordVar( doc, *data, "param", "bm", info.edgeParameters.bm );
-			recordVar( doc, *data, "param", "bmL", info.parameters.bmL );
-			recordVar( doc, *data, "param", "bmR", info.parameters.bmR );
-			recordVar( doc, *data, "param", "bLR", info.parameters.bLR );
-			recordVar( doc, *data, "param", "AL_x", info.parameters.AL.x );
-			recordVar( doc, *data, "param", "AL_y", info.parameters.AL.y );
-			recordVar( doc, *data, "param", "AL_z", info.parameters.AL.z );
-			recordVar( doc, *data, "param", "AR_x", info.parameters.AR.x );
-			recordVar( doc, *data, "param", "AR_y", info.parameters.AR.y );
-			recordVar( doc, *data, "param", "AR_z", info.parameters.AR.z );
-			recordVar( doc, *data, "param", "Am_x", info.nodeParameters.Am.x );
-			recordVar( doc, *data, "param", "Am_y", info.nodeParameters.Am.y );
-			recordVar( doc, *data, "param", "Am_z", info.nodeParameters.Am.z );
-			recordVar( doc, *data, "param", "DL_x", info.parameters.DL.x );
-			recordVar( doc, *data, "param", "DL_y", info.parameters.DL.y );
-			recordVar( doc, *data, "param", "DL_z", info.parameters.DL.z );
-			recordVar( doc, *data, "param", "DR_x", info.parameters.DR.x );
-			recordVar( doc, *data, "param", "DR_y", info.parameters.DR.y );
-			recordVar( doc, *data, "param", "DR_z", info.parameters.DR.z );
-			recordVar( doc, *data, "param", "Dm_x", info.edgeParameters.Dm.x );
-			recordVar( doc, *data, "param", "Dm_y", info.edgeParameters.Dm.y );
-			recordVar( doc, *data, "param", "Dm_z", info.edgeParameters.Dm.z );
-			recordVar( doc, *data, "param", "DmL_x", info.parameters.DmL.x );
-			recordVar( doc, *data, "param", "DmL_y", info.parameters.DmL.y );
-			recordVar( doc, *data, "param", "DmL_z", info.parameters.DmL.z );
-			recordVar( doc, *data, "param", "DmR_x", info.parameters.DmR.x );
-			recordVar( doc, *data, "param", "DmR_y", info.parameters.DmR.y );
-			recordVar( doc, *data, "param", "DmR_z", info.parameters.DmR.z );
-			recordVar( doc, *data, "param", "DLR_x", info.parameters.DLR.x );
-			recordVar( doc, *data, "param", "DLR_y", info.parameters.DLR.y );
-			recordVar( doc, *data, "param", "DLR_z", info.parameters.DLR.z );
-
-			//record results
-			recordVar( doc, *data, "result", "M_x", info.results.M.x );
-			recordVar( doc, *data, "result", "M_y", info.results.M.y );
-			recordVar( doc, *data, "result", "M_z", info.results.M.z );
-			
-			recordVar( doc, *data, "result", "ML_x", info.results.ML.x );
-			recordVar( doc, *data, "result", "ML_y", info.results.ML.y );
-			recordVar( doc, *data, "result", "ML_z", info.results.ML.z );
-			
-			recordVar( doc, *data, "result", "MR_x", info.results.MR.x );
-			recordVar( doc, *data, "result", "MR_y", info.results.MR.y );
-			recordVar( doc, *data, "result", "MR_z", info.results.MR.z );
-			
-			recordVar( doc, *data, "result", "Mm_x", info.results.Mm.x );
-			recordVar( doc, *data, "result", "Mm_y", info.results.Mm.y );
-			recordVar( doc, *data, "result", "Mm_z", info.results.Mm.z );
+				xml_node<> *date = doc.allocate_node( node_element, "date", "" );
+				date->append_attribute( doc.allocate_attribute("timestamp", doc.allocate_string( timeout.str().c_str() )) );
+				data->append_node(date);
 
-			recordVar( doc, *data, "result", "MS_x", info.results.MS.x );
-			recordVar( doc, *data, "result", "MS_y", info.results.MS.y );
-			recordVar( doc, *data, "result", "MS_z", info.results.MS.z );
+				forEachVar(info, [&](const char *type, const char *name, double value) {
+					recordVar(doc, *data, type, name, value);
+				});
 			
-			recordVar( doc, *data, "result", "MSL_x", info.results.MSL.x );
-			recordVar( doc, *data, "result", "MSL_y", info.results.MSL.y );
-			recordVar( doc, *data, "result", "MSL_z", info.results.MSL.z );
-			
-			recordVar( doc, *data, "result", "MSR_x", info.results.MSR.x );
-			recordVar( doc, *data, "result", "MSR_y", info.results.MSR.y );
-			recordVar( doc, *data, "result", "MSR_z", info.results.MSR.z );
-			
-			recordVar( doc, *data, "result", "MSm_x", info.results.MSm.x );
-			recordVar( doc, *data, "result", "MSm_y", info.results.MSm.y );
-			recordVar( doc, *data, "result", "MSm_z", info.results.MSm.z );
+				// record atoms
+				xml_node<> *snapshot = doc.allocate_node( node_element, "snapshot", "" );
+				for (const Atom &atom : info.atoms) {
+					xml_node<> *atom_node = doc.allocate_node( node_element, "loc", "" );
+					atom_node->append_attribute( doc.allocate_attribute("x", doc.allocate_string( to_string(atom.x).c_str() )) );
+					atom_node->append_attribute( doc.allocate_attribute("y", doc.allocate_string( to_string(atom.y).c_str() )) );
+					atom_node->append_attribute( doc.allocate_attribute("z", doc.allocate_string( to_string(atom.z).c_str() )) );
+					atom_node->append_attribute( doc.allocate_attribute("sx", doc.allocate_string( to_string(atom.spin.x).c_str() )) );
+					atom_node->append_attribute( doc.allocate_attribute("sy", doc.allocate_string( to_string(atom.spin.y).c_str() )) );
+					atom_node->append_attribute( doc.allocate_attribute("sz", doc.allocate_string( to_string(atom.spin.z).c_str() )) );
+					atom_node->append_attribute( doc.allocate_attribute("fx", doc.allocate_string( to_string(atom.flux.x).c_str() )) );
+					atom_node->append_attribute( doc.allocate_attribute("fy", doc.allocate_string( to_string(atom.flux.y).c_str() )) );
+					atom_node->append_attribute( doc.allocate_attribute("fz", doc.allocate_string( to_string(atom.flux.z).c_str() )) );
+					atom_node->append_attribute( doc.allocate_attribute("mx", doc.allocate_string( to_string(atom.mag.x).c_str() )) );
+					atom_node->append_attribute( doc.allocate_attribute("my", doc.allocate_string( to_string(atom.mag.y).c_str() )) );
+					atom_node->append_attribute( doc.allocate_attribute("mz", doc.allocate_string( to_string(atom.mag.z).c_str() )) );
+					snapshot->append_node(atom_node);
+				}
+				data->append_node(snapshot);
 
-			recordVar( doc, *data, "result", "MF_x", info.results.MF.x );
-			recordVar( doc, *data, "result", "MF_y", info.results.MF.y );
-			recordVar( doc, *data, "result", "MF_z", info.results.MF.z );
-			
-			recordVar( doc, *data, "result", "MFL_x", info.results.MFL.x );
-			recordVar( doc, *data, "result", "MFL_y", info.results.MFL.y );
-			recordVar( doc, *data, "result", "MFL_z", info.results.MFL.z );
-			
-			recordVar( doc, *data, "result", "MFR_x", info.results.MFR.x );
-			recordVar( doc, *data, "result", "MFR_y", info.results.MFR.y );
-			recordVar( doc, *data, "result", "MFR_z", info.results.MFR.z );
-			
-			recordVar( doc, *data, "result", "MFm_x", info.results.MFm.x );
-			recordVar( doc, *data, "result", "MFm_y", info.results.MFm.y );
-			recordVar( doc, *data, "result", "MFm_z", info.results.MFm.z );
-			
-			recordVar( doc, *data, "result", "U", info.results.U );
-			recordVar( doc, *data, "result", "UL", info.results.UL );
-			recordVar( doc, *data, "result", "UR", info.results.UR );
-			recordVar( doc, *data, "result", "Um", info.results.Um );
-			recordVar( doc, *data, "result", "UmL", info.results.UmL );
-			recordVar( doc, *data, "result", "UmR", info.results.UmR );
-			recordVar( doc, *data, "result", "ULR", info.results.ULR );
+				root->append_node(data);
 			
-			recordVar( doc, *data, "result", "c", info.c );
-			recordVar( doc, *data, "result", "cL", info.cL );
-			recordVar( doc, *data, "result", "cR", info.cR );
-			recordVar( doc, *data, "result", "cm", info.cm );
-			recordVar( doc, *data, "result", "cmL", info.cmL );
-			recordVar( doc, *data, "result", "cmR", info.cmR );
-			recordVar( doc, *data, "result", "cLR", info.cLR );
-			
-			recordVar( doc, *data, "result", "x", info.x );
-			recordVar( doc, *data, "result", "xL", info.xL );
-			recordVar( doc, *data, "result", "xR", info.xR );
-			recordVar( doc, *data, "result", "xm", info.xm );
-			
-			// record atoms
-			xml_node<> *snapshot = doc.allocate_node( node_element, "snapshot", "" );
-			for (const Atom &atom : info.atoms) {
-				xml_node<> *atom_node = doc.allocate_node( node_element, "loc", "" );
-				atom_node->append_attribute( doc.allocate_attribute("x", doc.allocate_string( to_string(atom.x).c_str() )) );
-				atom_node->append_attribute( doc.allocate_attribute("y", doc.allocate_string( to_string(atom.y).c_str() )) );
-				atom_node->append_attribute( doc.allocate_attribute("z", doc.allocate_string( to_string(atom.z).c_str() )) );
-				atom_node->append_attribute( doc.allocate_attribute("sx", doc.allocate_string( to_string(atom.spin.x).c_str() )) );
-				atom_node->append_attribute( doc.allocate_attribute("sy", doc.allocate_string( to_string(atom.spin.y).c_str() )) );
-				atom_node->append_attribute( doc.allocate_attribute("sz", doc.allocate_string( to_string(atom.spin.z).c_str() )) );
-				atom_node->append_attribute( doc.allocate_attribute("fx", doc.allocate_string( to_string(atom.flux.x).c_str() )) );
-				atom_node->append_attribute( doc.allocate_attribute("fy", doc.allocate_string( to_string(atom.flux.y).c_str() )) );
-				atom_node->append_attribute( doc.allocate_attribute("fz", doc.allocate_string( to_string(atom.flux.z).c_str() )) );
-				atom_node->append_attribute( doc.allocate_attribute("mx", doc.allocate_string( to_string(atom.mag.x).c_str() )) );
-				atom_node->append_attribute( doc.allocate_attribute("my", doc.allocate_string( to_string(atom.mag.y).c_str() )) );
-				atom_node->append_attribute( doc.allocate_attribute("mz", doc.allocate_string( to_string(atom.mag.z).c_str() )) );
-				snapshot->append_node(atom_node);
+				fout.close();
+				fout.open( filename, ios::out | ios::trunc );
+				fout << doc << flush;
 			}
-			data->append_node(snapshot);
-
-			root->append_node(data);
-			
-			fout.close();
-			fout.open( filename, ios::out | ios::trunc );
-			fout << doc << flush;
 			
 			//report status
 			cout << (completion += step) << "% ";
@@ -1,7 +1,25 @@
+/*
+ * MFM (Magnetic Force Microscope) Aggregator
+ *
+ * Usage:
+ *   mfm_aggregator OUTPUT               (paste copied Excel data from an "iterate" output file)
+ *   mfm_aggregator OUTPUT INPUT...      (read the snapshots directly from each INPUT file)
+ *
+ * Each INPUT can be an "iterate" CSV file (one snapshot), or a "metropolis" output file:
+ * XML or a column file (one snapshot per simulation). Each snapshot is loaded into a dense 3D grid,
+ * and m, s, and f are averaged along each axis in a single pass. For every snapshot, the norm, x, y,
+ * and z components of each of those projections are written to OUTPUT (36 images in all).
+ */
+
 #include <fstream>
+#include <functional>
 #include <iostream>
-#include <map>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <vector>
+#include "ResultsWriter.h"
+#include "SnapshotReader.h"
 #include "Vector.h"
 
 
@@ -9,294 +27,199 @@ using namespace std;
 using namespace udc;
 
 
-template <typename T> struct OrderedTriplet {
-	T x, y, z;
-	
-	OrderedTriplet() {}
-	OrderedTriplet(T x, T y, T z) : x(x), y(y), z(z) {}
-	
-	bool operator ==(const OrderedTriplet &p) const { return x == p.x && y == p.y && z == p.z; }
-	bool operator !=(const OrderedTriplet &p) const { return !(*this == p); }
-	bool operator >(const OrderedTriplet &p) const { return (x > p.x) || (x == p.x && y > p.y) || (y == p.y && z > p.z); }
-	bool operator <(const OrderedTriplet &p) const { return (x < p.x) || (x == p.x && y < p.y) || (y == p.y && z < p.z); }
-	bool operator >=(const OrderedTriplet &p) const { return !(*this < p); }
-	bool operator <=(const OrderedTriplet &p) const { return !(*this > p); }
+struct Site {
+	Vector m, s, f;
+};
+
+const char * const FIELD_NAMES[] = { "m", "s", "f" };
+
+// a single snapshot, stored as a dense (width x height x depth) grid; missing atoms are all zero
+struct Grid {
+	unsigned int width, height, depth;
+	vector<Site> sites;  // index: (x * height + y) * depth + z
+
+	Grid(const vector<SnapshotAtom> &atoms);
+
+	const Site& at(unsigned int x, unsigned int y, unsigned int z) const { return sites[(x * height + y) * depth + z]; }
+};
+
+Grid::Grid(const vector<SnapshotAtom> &atoms) : width(0), height(0), depth(0) {
+	for( auto a = atoms.begin(); a != atoms.end(); a++ )
+		if( a->x >= 0 && a->y >= 0 && a->z >= 0 ) {
+			width = max(width, (unsigned int) a->x + 1);
+			height = max(height, (unsigned int) a->y + 1);
+			depth = max(depth, (unsigned int) a->z + 1);
+		}
+	sites.resize( (size_t) width * height * depth );
+	for( auto a = atoms.begin(); a != atoms.end(); a++ )
+		if( a->x >= 0 && a->y >= 0 && a->z >= 0 )
+			sites[((size_t) a->x * height + a->y) * depth + a->z] = Site{ a->m, a->s, a->f };
+}
+
+// sums of m, s, and f along each axis (divide by the length of that axis for the average)
+struct Projections {
+	vector<Vector> alongX[3];  // index: y * depth + z
+	vector<Vector> alongY[3];  // index: x * depth + z
+	vector<Vector> alongZ[3];  // index: x * height + y
+
+	Projections(const Grid &grid, unsigned int threadCount);
 };
 
+/*
+ * One pass over the grid. Each thread takes a slab of x values: the y and z projections of a slab
+ * don't overlap with any other slab's, but the x projection does, so each thread sums that one
+ * privately and they are added together (in order) at the end.
+ */
+Projections::Projections(const Grid &grid, unsigned int threadCount) {
+	const unsigned int W = grid.width, H = grid.height, D = grid.depth;
+	for( int f = 0; f < 3; f++ ) {
+		alongX[f].assign( (size_t) H * D, Vector::ZERO );
+		alongY[f].assign( (size_t) W * D, Vector::ZERO );
+		alongZ[f].assign( (size_t) W * H, Vector::ZERO );
+	}
+	threadCount = max(1u, min(threadCount, W));
+	vector< vector<Vector> > partialX(threadCount, vector<Vector>(3 * (size_t) H * D, Vector::ZERO));
+
+	auto project = [&](unsigned int t) {
+		vector<Vector> &px = partialX[t];
+		for( unsigned int x = W * t / threadCount; x < W * (t + 1) / threadCount; x++ )
+			for( unsigned int y = 0; y < H; y++ )
+				for( unsigned int z = 0; z < D; z++ ) {
+					const Site &site = grid.at(x, y, z);
+					const Vector *v[3] = { &site.m, &site.s, &site.f };
+					for( int f = 0; f < 3; f++ ) {
+						px[f * H * D + y * D + z] += *v[f];
+						alongY[f][x * D + z] += *v[f];
+						alongZ[f][x * H + y] += *v[f];
+					}
+				}
+	};
+	vector<thread> threads;
+	for( unsigned int t = 1; t < threadCount; t++ )
+		threads.push_back( thread(project, t) );
+	project(0);
+	for( auto t = threads.begin(); t != threads.end(); t++ )
+		t->join();
+
+	for( unsigned int t = 0; t < threadCount; t++ )
+		for( int f = 0; f < 3; f++ )
+			for( size_t i = 0; i < (size_t) H * D; i++ )
+				alongX[f][i] += partialX[t][f * H * D + i];
+}
+
+
+// ---- Output ----
+
+// writes one image: a title row, a row of column labels, then one row per row label
+void writeImage(ResultsWriter &out, const string &title, const vector<unsigned int> &cols, const vector<unsigned int> &rows,
+                const function<double(unsigned int, unsigned int)> &value) {
+	out.text('"' + title + '"');
+	out.spacers(2);
+	for( unsigned int c : cols )
+		out.value(c);
+	out.endRow();
+	for( unsigned int r : rows ) {
+		out.spacers(2);
+		out.value(r);
+		for( unsigned int c : cols )
+			out.value( value(r, c) );
+		out.endRow();
+	}
+	out.endRow();
+}
+
+void writeSeparator(ResultsWriter &out) {
+	out.text("--------------------------------------------------------------------------------");
+	for( int i = 0; i < 4; i++ )
+		out.endRow();
+}
+
+void writeProjections(ResultsWriter &out, const Grid &grid, const Projections &p) {
+	const unsigned int W = grid.width, H = grid.height, D = grid.depth;
+	vector<unsigned int> xs, ys, zs, reverseZs;
+	for( unsigned int x = 0; x < W; x++ ) xs.push_back(x);
+	for( unsigned int y = 0; y < H; y++ ) ys.push_back(y);
+	for( unsigned int z = 0; z < D; z++ ) zs.push_back(z);
+	reverseZs.assign(zs.rbegin(), zs.rend());
+
+	// (norm, x, y, z) of a projected Vector
+	const char * const COMPONENTS[] = { "norm", "x", "y", "z" };
+	auto component = [](const Vector &v, int c) {
+		return c == 0 ? v.norm() : c == 1 ? v.x : c == 2 ? v.y : v.z;
+	};
+
+	for( int f = 0; f < 3; f++ ) {
+		const string field = FIELD_NAMES[f];
+		for( int c = 0; c < 4; c++ )
+			writeImage(out, field + '_' + COMPONENTS[c] + ", orientation: x-axis, horizontal: -z, vertical: y", reverseZs, ys,
+				[&](unsigned int y, unsigned int z) { return component(p.alongX[f][y * D + z], c) / W; });
+		writeSeparator(out);
+		for( int c = 0; c < 4; c++ )
+			writeImage(out, field + '_' + COMPONENTS[c] + ", orientation: y-axis, horizontal: x, vertical: -z", xs, reverseZs,
+				[&](unsigned int z, unsigned int x) { return component(p.alongY[f][x * D + z], c) / H; });
+		writeSeparator(out);
+		for( int c = 0; c < 4; c++ )
+			writeImage(out, field + '_' + COMPONENTS[c] + ", orientation: z-axis, horizontal: x, vertical: y", xs, ys,
+				[&](unsigned int y, unsigned int x) { return component(p.alongZ[f][x * H + y], c) / D; });
+		if( f < 2 )
+			writeSeparator(out);
+	}
+}
+
+
 int main(int argc, char *argv[]) {
 	if( argc <= 1 ) {
 		cout << "Please provide an output file.\n";
 		return 1;
 	}
-	
-	int molPosL, molPosR;
-	cout << "molPosL = ";
-	cin >> molPosL;
-	cout << "molPosR = ";
-	cin >> molPosR;
-	
-	map<const OrderedTriplet<int>, Vector> m_map;
-	map<const OrderedTriplet<int>, Vector> s_map;
-	map<const OrderedTriplet<int>, Vector> f_map;
-	int maxX = 0, maxY = 0, maxZ = 0;
-	
-	cout << "Please paste copied Excel data from 'iterate' output file. Then press Ctrl-Z to start the aggregation process.\n> ";
-	while(true) {
-		OrderedTriplet<int> loc;
-		Vector m;
-		Vector s;
-		Vector f;
-		
-		cin >> loc.x >> loc.y >> loc.z;
-		cin >> m.x >> m.y >> m.z;
-		cin >> s.x >> s.y >> s.z;
-		cin >> f.x >> f.y >> f.z;
-		
-		if( cin.eof() ) {
-			break;
-		}
-		
-		if( cin.fail() ) {
-			// ignore bad lines of data. Could be the header.
-			cin.clear();
-			getline( cin, string() );
-			continue;
-		}
-		
-		m_map[loc] = m;
-		s_map[loc] = s;
-		f_map[loc] = f;
-		if( loc.x > maxX )
-			maxX = loc.x;
-		if( loc.y > maxY )
-			maxY = loc.y;
-		if( loc.z > maxZ )
-			maxZ = loc.z;
-	}
-	
-	// aggregate and output data
+	unsigned int threadCount = thread::hardware_concurrency();
+	threadCount = threadCount > 1 ? threadCount : 1;
+
 	ofstream file( argv[1] );
-	
-	// x-axis orientation
-	{	file << "\"m_norm, orientation: x-axis, horizontal: -z, vertical: y\",,";
-		OrderedTriplet<int> loc;
-		for( loc.z = maxZ; loc.z >= 0; loc.z-- )
-			file << ',' << loc.z;
-		file << '\n';
-		for( loc.y = 0; loc.y <= maxY; loc.y++ ) {
-			file << ",," << loc.y;
-			for( loc.z = maxZ; loc.z >= 0; loc.z-- ) {
-				Vector m = Vector::ZERO;
-				for( loc.x = 0; loc.x <= maxX; loc.x++ )
-					m += m_map[loc];
-				file << ',' << (m.norm() / (maxX + 1));
-			}
-			file << '\n';
-		}
-		file << '\n';
+	if( !file ) {
+		cerr << "Couldn't open output file: " << argv[1] << '\n';
+		return 2;
 	}
-	
-	{	file << "\"m_x, orientation: x-axis, horizontal: -z, vertical: y\",,";
-		OrderedTriplet<int> loc;
-		for( loc.z = maxZ; loc.z >= 0; loc.z-- )
-			file << ',' << loc.z;
-		file << '\n';
-		for( loc.y = 0; loc.y <= maxY; loc.y++ ) {
-			file << ",," << loc.y;
-			for( loc.z = maxZ; loc.z >= 0; loc.z-- ) {
-				double m_x = 0;
-				for( loc.x = 0; loc.x <= maxX; loc.x++ )
-					m_x += m_map[loc].x;
-				file << ',' << (m_x / (maxX + 1));
-			}
-			file << '\n';
-		}
-		file << '\n';
-	}
-	
-	{	file << "\"m_y, orientation: x-axis, horizontal: -z, vertical: y\",,";
-		OrderedTriplet<int> loc;
-		for( loc.z = maxZ; loc.z >= 0; loc.z-- )
-			file << ',' << loc.z;
-		file << '\n';
-		for( loc.y = 0; loc.y <= maxY; loc.y++ ) {
-			file << ",," << loc.y;
-			for( loc.z = maxZ; loc.z >= 0; loc.z-- ) {
-				double m_y = 0;
-				for( loc.x = 0; loc.x <= maxX; loc.x++ )
-					m_y += m_map[loc].y;
-				file << ',' << (m_y / (maxX + 1));
-			}
-			file << '\n';
-		}
-		file << '\n';
-	}
-	
-	{	file << "\"m_z, orientation: x-axis, horizontal: -z, vertical: y\",,";
-		OrderedTriplet<int> loc;
-		for( loc.z = maxZ; loc.z >= 0; loc.z-- )
-			file << ',' << loc.z;
-		file << '\n';
-		for( loc.y = 0; loc.y <= maxY; loc.y++ ) {
-			file << ",," << loc.y;
-			for( loc.z = maxZ; loc.z >= 0; loc.z-- ) {
-				double m_z = 0;
-				for( loc.x = 0; loc.x <= maxX; loc.x++ )
-					m_z += m_map[loc].z;
-				file << ',' << (m_z / (maxX + 1));
-			}
-			file << '\n';
-		}
-		file << '\n';
-	}
-	file << "--------------------------------------------------------------------------------\n\n\n\n";
-	
-	// y-axis orientation
-	{	file << "\"m_norm, orientation: y-axis, horizontal: x, vertical: -z\",,";
-		OrderedTriplet<int> loc;
-		for( loc.x = 0; loc.x <= maxX; loc.x++ )
-			file << ',' << loc.x;
-		file << '\n';
-		for( loc.z = maxZ; loc.z >= 0; loc.z-- ) {
-			file << ",," << loc.z;
-			for( loc.x = 0; loc.x <= maxX; loc.x++ ) {
-				Vector m = Vector::ZERO;
-				for( loc.y = 0; loc.y <= maxX; loc.y++ )
-					m += m_map[loc];
-				file << ',' << (m.norm() / (maxY + 1));
-			}
-			file << '\n';
-		}
-		file << '\n';
-	}
-	
-	{	file << "\"m_x, orientation: y-axis, horizontal: x, vertical: -z\",,";
-		OrderedTriplet<int> loc;
-		for( loc.x = 0; loc.x <= maxX; loc.x++ )
-			file << ',' << loc.x;
-		file << '\n';
-		for( loc.z = maxZ; loc.z >= 0; loc.z-- ) {
-			file << ",," << loc.z;
-			for( loc.x = 0; loc.x <= maxX; loc.x++ ) {
-				double m_x = 0;
-				for( loc.y = 0; loc.y <= maxX; loc.y++ )
-					m_x += m_map[loc].x;
-				file << ',' << (m_x / (maxY + 1));
-			}
-			file << '\n';
-		}
-		file << '\n';
-	}
-	
-	{	file << "\"m_y, orientation: y-axis, horizontal: x, vertical: -z\",,";
-		OrderedTriplet<int> loc;
-		for( loc.x = 0; loc.x <= maxX; loc.x++ )
-			file << ',' << loc.x;
-		file << '\n';
-		for( loc.z = maxZ; loc.z >= 0; loc.z-- ) {
-			file << ",," << loc.z;
-			for( loc.x = 0; loc.x <= maxX; loc.x++ ) {
-				double m_y = 0;
-				for( loc.y = 0; loc.y <= maxX; loc.y++ )
-					m_y += m_map[loc].y;
-				file << ',' << (m_y / (maxY + 1));
-			}
-			file << '\n';
+	ResultsWriter out(file);
+	size_t snapshotCount = 0;
+	SnapshotHandler aggregate = [&](const string &label, const vector<SnapshotAtom> &atoms) {
+		Grid grid(atoms);
+		if( !label.empty() ) {
+			out.text('"' + label + '"');
+			out.endRow();
+			out.endRow();
 		}
-		file << '\n';
-	}
-	
-	{	file << "\"m_z, orientation: y-axis, horizontal: x, vertical: -z\",,";
-		OrderedTriplet<int> loc;
-		for( loc.x = 0; loc.x <= maxX; loc.x++ )
-			file << ',' << loc.x;
-		file << '\n';
-		for( loc.z = maxZ; loc.z >= 0; loc.z-- ) {
-			file << ",," << loc.z;
-			for( loc.x = 0; loc.x <= maxX; loc.x++ ) {
-				double m_z = 0;
-				for( loc.y = 0; loc.y <= maxX; loc.y++ )
-					m_z += m_map[loc].z;
-				file << ',' << (m_z / (maxY + 1));
-			}
-			file << '\n';
-		}
-		file << '\n';
-	}
-	file << "--------------------------------------------------------------------------------\n\n\n\n";
-	
-	// z-axis orientation
-	{	file << "\"m_norm, orientation: z-axis, horizontal: x, vertical: y\",,";
-		OrderedTriplet<int> loc;
-		for( loc.x = 0; loc.x <= maxX; loc.x++ )
-			file << ',' << loc.x;
-		file << '\n';
-		for( loc.y = 0; loc.y <= maxY; loc.y++ ){
-			file << ",," << loc.z;
-			for( loc.x = 0; loc.x <= maxX; loc.x++ ) {
-				Vector m = Vector::ZERO;
-				for( loc.z = 0; loc.z <= maxZ; loc.z++ )
-					m += m_map[loc];
-				file << ',' << (m.norm() / (maxZ + 1));
-			}
-			file << '\n';
-		}
-		file << '\n';
-	}
-	
-	{	file << "\"m_x, orientation: z-axis, horizontal: x, vertical: y\",,";
-		OrderedTriplet<int> loc;
-		for( loc.x = 0; loc.x <= maxX; loc.x++ )
-			file << ',' << loc.x;
-		file << '\n';
-		for( loc.y = 0; loc.y <= maxY; loc.y++ ){
-			file << ",," << loc.z;
-			for( loc.x = 0; loc.x <= maxX; loc.x++ ) {
-				double m_x = 0;
-				for( loc.z = 0; loc.z <= maxZ; loc.z++ )
-					m_x += m_map[loc].x;
-				file << ',' << (m_x / (maxZ + 1));
-			}
-			file << '\n';
-		}
-		file << '\n';
-	}
-	
-	{	file << "\"m_y, orientation: z-axis, horizontal: x, vertical: y\",,";
-		OrderedTriplet<int> loc;
-		for( loc.x = 0; loc.x <= maxX; loc.x++ )
-			file << ',' << loc.x;
-		file << '\n';
-		for( loc.y = 0; loc.y <= maxY; loc.y++ ){
-			file << ",," << loc.z;
-			for( loc.x = 0; loc.x <= maxX; loc.x++ ) {
-				double m_y = 0;
-				for( loc.z = 0; loc.z <= maxZ; loc.z++ )
-					m_y += m_map[loc].y;
-				file << ',' << (m_y / (maxZ + 1));
+		writeProjections(out, grid, Projections(grid, threadCount));
+		if( !label.empty() )
+			writeSeparator(out);
+		snapshotCount++;
+	};
+
+	if( argc <= 2 ) {
+		int molPosL, molPosR;
+		cout << "molPosL = ";
+		cin >> molPosL;
+		cout << "molPosR = ";
+		cin >> molPosR;
+
+		cout << "Please paste copied Excel data from 'iterate' output file. Then press Ctrl-Z to start the aggregation process.\n> ";
+		readPastedSnapshot(cin, aggregate);
+	} else {
+		for( int i = 2; i < argc; i++ ) {
+			try {
+				readSnapshots(argv[i], aggregate);
+			} catch(const runtime_error &e) {
+				cerr << e.what() << '\n';
+				return 3;
 			}
-			file << '\n';
 		}
-		file << '\n';
+		cout << "Aggregated " << snapshotCount << " snapshot(s).\n";
 	}
-	
-	{	file << "\"m_z, orientation: z-axis, horizontal: x, vertical: y\",,";
-		OrderedTriplet<int> loc;
-		for( loc.x = 0; loc.x <= maxX; loc.x++ )
-			file << ',' << loc.x;
-		file << '\n';
-		for( loc.y = 0; loc.y <= maxY; loc.y++ ){
-			file << ",," << loc.z;
-			for( loc.x = 0; loc.x <= maxX; loc.x++ ) {
-				double m_z = 0;
-				for( loc.z = 0; loc.z <= maxZ; loc.z++ )
-					m_z += m_map[loc].z;
-				file << ',' << (m_z / (maxZ + 1));
-			}
-			file << '\n';
-		}
-		file << '\n';
+
+	out.flush();
+	if( !file ) {
+		cerr << "Couldn't write to output file: " << argv[1] << '\n';
+		return 2;
 	}
-	
 	return 0;
-}
\ No newline at end of file
+}
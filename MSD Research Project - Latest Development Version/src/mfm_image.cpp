@@ -0,0 +1,138 @@
+/*
+ * MFM (Magnetic Force Microscope) Image
+ *
+ * Usage:
+ *   mfm_image OUTPUT LIFT QUANTITY [INPUT...]
+ *
+ *   LIFT      height of the tip above the device's z = depth - 1 face (in lattice units, > 0)
+ *   QUANTITY  dHz (the stray field gradient dH_z/dz: usual MFM contrast) or Hz (the stray field H_z)
+ *   INPUT     "iterate" CSV file (one snapshot), or "metropolis" XML or column file (one snapshot per
+ *             simulation). With no INPUT, copied Excel data from an "iterate" output file is read from stdin.
+ *
+ * Writes one simulated MFM image (horizontal: x, vertical: y) per snapshot, in order,
+ * so a batch of snapshots (e.g. a field sweep) can be rendered as a movie. See MFM.h.
+ */
+
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "MFM.h"
+#include "ResultsWriter.h"
+#include "SnapshotReader.h"
+
+
+using namespace std;
+using namespace udc;
+
+
+int main(int argc, char *argv[]) {
+	if( argc <= 1 ) {
+		cout << "Please provide an output file.\n";
+		return 1;
+	} else if( argc <= 2 ) {
+		cout << "Please provide the tip's lift height.\n";
+		return 1;
+	} else if( argc <= 3 ) {
+		cout << "Please provide the quantity to image: dHz or Hz.\n";
+		return 1;
+	}
+
+	double lift;
+	{	istringstream iss(argv[2]);
+		if( !(iss >> lift) || !(lift > 0) ) {
+			cerr << "Invalid lift height (must be > 0): " << argv[2] << '\n';
+			return 1;
+		}
+	}
+	MFMImager::Quantity quantity;
+	string title;
+	if( string(argv[3]) == "dHz" ) {
+		quantity = MFMImager::DH_Z_DZ;
+		title = "dH_z/dz";
+	} else if( string(argv[3]) == "Hz" ) {
+		quantity = MFMImager::H_Z;
+		title = "H_z";
+	} else {
+		cerr << "Invalid quantity (dHz or Hz): " << argv[3] << '\n';
+		return 1;
+	}
+	{	ostringstream oss;
+		oss << title << ", lift = " << lift << ", horizontal: x, vertical: y";
+		title = oss.str();
+	}
+
+	ofstream file( argv[1] );
+	if( !file ) {
+		cerr << "Couldn't open output file: " << argv[1] << '\n';
+		return 2;
+	}
+	ResultsWriter out(file);
+
+	unique_ptr<MFMImager> imager;  // reused (along with its kernels) as long as the device size doesn't change
+	vector<Vector> moments;
+	vector<double> image;
+	size_t snapshotCount = 0;
+	SnapshotHandler render = [&](const string &label, const vector<SnapshotAtom> &atoms) {
+		unsigned int width = 0, height = 0, depth = 0;
+		for( auto a = atoms.begin(); a != atoms.end(); a++ )
+			if( a->x >= 0 && a->y >= 0 && a->z >= 0 ) {
+				width = max(width, (unsigned int) a->x + 1);
+				height = max(height, (unsigned int) a->y + 1);
+				depth = max(depth, (unsigned int) a->z + 1);
+			}
+		if( width == 0 )
+			return;  // no atoms
+		if( !imager || imager->getWidth() != width || imager->getHeight() != height || imager->getDepth() != depth )
+			imager.reset( new MFMImager(width, height, depth, lift, quantity) );
+
+		moments.assign( (size_t) width * height * depth, Vector::ZERO );
+		for( auto a = atoms.begin(); a != atoms.end(); a++ )
+			if( a->x >= 0 && a->y >= 0 && a->z >= 0 )
+				moments[((size_t) a->z * height + a->y) * width + a->x] = a->m;
+		imager->image(&moments[0], image);
+
+		if( !label.empty() ) {
+			out.text('"' + label + '"');
+			out.endRow();
+		}
+		out.text('"' + title + '"');
+		out.spacers(2);
+		for( unsigned int x = 0; x < width; x++ )
+			out.value(x);
+		out.endRow();
+		for( unsigned int y = 0; y < height; y++ ) {
+			out.spacers(2);
+			out.value(y);
+			for( unsigned int x = 0; x < width; x++ )
+				out.value( image[y * width + x] );
+			out.endRow();
+		}
+		out.endRow();
+		snapshotCount++;
+	};
+
+	try {
+		if( argc <= 4 ) {
+			cout << "Please paste copied Excel data from 'iterate' output file. Then press Ctrl-Z to start.\n> ";
+			readPastedSnapshot(cin, render);
+		} else {
+			for( int i = 4; i < argc; i++ )
+				readSnapshots(argv[i], render);
+		}
+	} catch(const runtime_error &e) {
+		cerr << e.what() << '\n';
+		return 3;
+	}
+	cout << "Rendered " << snapshotCount << " image(s).\n";
+
+	out.flush();
+	if( !file ) {
+		cerr << "Couldn't write to output file: " << argv[1] << '\n';
+		return 2;
+	}
+	return 0;
+}
@@ -1,18 +1,22 @@
 package msd_server;
 
 import java.io.BufferedReader;
+import java.io.File;
 import java.io.IOException;
 import java.io.InputStreamReader;
 import java.io.PrintWriter;
+import java.net.Socket;
 import java.util.AbstractList;
 import java.util.ArrayList;
 import java.util.List;
 
 public class MSDWorker implements AutoCloseable {
-	private Process proc;
+	private Process proc;  // either a worker sub-process,
+	private Socket socket;  // or a connection to msd_service
+	private final Object lock = new Object();  // one command at a time
 	private BufferedReader in;  // streams for python sub-process
 	private PrintWriter out;  // streams for python sub-process
-	private BufferedReader err;  // streams for python sub-process
+	private BufferedReader err;  // streams for python sub-process (null for msd_service)
 	private boolean shutdown = false;
 	// TODO: remember to change  "record" to a different object on reset/reinitialize
 	// so the old view doesn't get affected or locked
@@ -37,12 +41,18 @@ public class MSDWorker implements AutoCloseable {
 	 * @throws IOException
 	 */
 	public MSDWorker(String args) throws IOException {
-		proc = new ProcessBuilder("python", "src/msd_server/MSDWorker.py").start();
-		System.out.println("Worker pid=" + proc.pid());  // DEBUG
-		in = new BufferedReader(new InputStreamReader(proc.getInputStream()));
-		out = new PrintWriter(proc.getOutputStream(), true);
-		err = new BufferedReader(new InputStreamReader(proc.getErrorStream()));
-		errLogReader.start();  // TODO: not currently using errLog, turn off?
+		socket = connectService();
+		if (socket != null) {
+			in = new BufferedReader(new InputStreamReader(socket.getInputStream()));
+			out = new PrintWriter(socket.getOutputStream(), true);
+		} else {
+			proc = workerProcess().start();
+			System.out.println("Worker pid=" + proc.pid());  // DEBUG
+			in = new BufferedReader(new InputStreamReader(proc.getInputStream()));
+			out = new PrintWriter(proc.getOutputStream(), true);
+			err = new BufferedReader(new InputStreamReader(proc.getErrorStream()));
+			errLogReader.start();  // TODO: not currently using errLog, turn off?
+		}
 
 		args = collapse(args);
 		out.println(args);
@@ -50,14 +60,48 @@ public class MSDWorker implements AutoCloseable {
 	}
 
 	/**
-	 * Blocks while python sub-process is running.
+	 * A connection to msd_service (src/msd_service.cpp) if the "msd.service" system property
+	 * is set (e.g. -Dmsd.service=localhost:8083) and it's running, otherwise null.
+	 * msd_service runs many simulations in one process, with the same protocol as the workers.
+	 */
+	private static Socket connectService() {
+		String service = System.getProperty("msd.service");
+		if (service == null || service.isEmpty())
+			return null;
+		try {
+			int colon = service.lastIndexOf(':');
+			String host = colon < 0 ? service : service.substring(0, colon);
+			int port = colon < 0 ? 8083 : Integer.parseInt(service.substring(colon + 1));
+			Socket socket = new Socket(host, port);
+			socket.setTcpNoDelay(true);
+			return socket;
+		} catch(IOException | NumberFormatException ex) {
+			System.err.println("Unable to connect to msd_service at " + service + ", using a worker process instead: " + ex);
+			return null;
+		}
+	}
+
+	/**
+	 * The native worker (src/msd_worker.cpp) if it has been built,
+	 * otherwise the python worker (src/msd_server/MSDWorker.py).
+	 * Both use the same protocol.
+	 */
+	private static ProcessBuilder workerProcess() {
+		for (String exe : new String[] { "bin/msd_worker.exe", "bin/msd_worker" })
+			if (new File(exe).canExecute())
+				return new ProcessBuilder(exe);
+		return new ProcessBuilder("python", "src/msd_server/MSDWorker.py");
+	}
+
+	/**
+	 * Blocks while worker sub-process is running.
 	 * 
 	 * @param args Compact JSON string containing: <br>
 	 * 	<code>{ simCount, freq, dkT, dB }</code>
 	 */
 	public void run(String args) throws IOException {
 		args = collapse(args);
-		synchronized(proc) {
+		synchronized(lock) {
 			out.println("RUN");
 			out.println(args);
 			// TODO: record.ensureCapacity(...)
@@ -84,7 +128,7 @@ public class MSDWorker implements AutoCloseable {
 	}
 
 	public String getState(String args) throws IOException {
-		synchronized(proc) {
+		synchronized(lock) {
 			out.println("GET");
 			out.println(args);
 			return requireLine();
@@ -101,7 +145,7 @@ public class MSDWorker implements AutoCloseable {
 	 */
 	public void setParameters(String parameters) throws IOException {
 		parameters = collapse(parameters);
-		synchronized(proc) {
+		synchronized(lock) {
 			out.println("SET");
 			out.println(parameters);
 			confirmResponse("DONE");
@@ -109,7 +153,7 @@ public class MSDWorker implements AutoCloseable {
 	}
 
 	public String reset(String args) throws IOException {
-		synchronized(proc) {
+		synchronized(lock) {
 			out.println("RESET");
 			out.println(args);
 			clearRecord();
@@ -123,7 +167,7 @@ public class MSDWorker implements AutoCloseable {
 
 	public void exit() throws IOException {
 		cancel();  // flag signals the run() method in case a simulation is running
-		synchronized(proc) {
+		synchronized(lock) {
 			out.println("EXIT");
 			confirmResponse("GOODBYE");
 		}
@@ -140,10 +184,14 @@ public class MSDWorker implements AutoCloseable {
 		try {
 			out.close();
 			in.close();
-			err.close();
+			if (err != null)
+				err.close();
 		} finally {
 			errLogReader.interrupt();
-			proc.destroy();
+			if (socket != null)
+				socket.close();
+			if (proc != null)
+				proc.destroy();
 		}
 	}
 
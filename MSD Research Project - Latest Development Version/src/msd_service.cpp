@@ -0,0 +1,130 @@
+/*
+ * MSD Service
+ *
+ * Usage:
+ *   msd_service [PORT] [THREADS] [SLICE_MS]
+ *
+ * Runs many simulations for msd_server in one process: each connection to 127.0.0.1:PORT (default 8083)
+ * is one simulation, with exactly the same line-based protocol as msd_worker (see msd_worker.cpp).
+ * Start msd_server with -Dmsd.service=localhost:PORT to use it instead of a msd_worker process per
+ * simulation (see src/msd_server/MSDWorker.java).
+ *
+ * Every RUN is split into slices of about SLICE_MS milliseconds (default 10), which share a pool of
+ * THREADS threads (default: one per core). So any number of simulations share the cores fairly, and a
+ * CANCEL (or a closed connection) stops a run within one slice. The results are the same as msd_worker's.
+ */
+
+#include <csignal>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include "Socket.h"
+#include "ThreadPool.h"
+#include "WorkerProtocol.h"
+
+
+using namespace std;
+using namespace udc;
+using namespace udc::worker;
+
+
+struct Connection {
+	Socket socket;
+	unique_ptr<Session> session;
+};
+
+// Reads the connection's input until it closes or the session ends. Runs on its own thread.
+void serve(shared_ptr<Connection> c, WorkStealingPool &pool, double sliceTime) {
+	Connection &conn = *c;
+	weak_ptr<Connection> weak = c;  // the session must not keep its own connection alive
+
+	// only called with the session's lock, so lines aren't interleaved
+	auto output = [&conn](const string &line) {
+		try {
+			conn.socket.writeLine(line);
+		} catch(const SocketException &) {
+			conn.socket.shutdown();  // the client is gone: readLine (below) ends the session
+		}
+	};
+
+	auto schedule = [weak, &pool](Session::Task task) {
+		shared_ptr<Connection> c = weak.lock();
+		if( !c )
+			return;
+		pool.submit([c, task]() {
+			try {
+				task();
+			} catch(const exception &ex) {
+				cerr << ex.what() << endl;
+				c->session->close();
+				c->socket.shutdown();
+			}
+		});
+	};
+
+	conn.session.reset(new Session(output, schedule, sliceTime));
+	try {
+		string line;
+		while( conn.socket.readLine(line) )
+			if( !conn.session->onLine(line) )
+				break;
+	} catch(const exception &ex) {
+		cerr << ex.what() << endl;
+	}
+	conn.session->close();
+	conn.socket.shutdown();
+	// the socket is closed once the last slice (if one is still running) lets go of the connection
+}
+
+int main(int argc, char *argv[]) {
+	unsigned short port = 8083;
+	unsigned int threadCount = 0;
+	double sliceMs = 10;
+
+	if( argc > 1 ) {
+		istringstream iss(argv[1]);
+		if( !(iss >> port) || port == 0 ) {
+			cerr << "Invalid port: " << argv[1] << '\n';
+			return 1;
+		}
+	}
+	if( argc > 2 ) {
+		istringstream iss(argv[2]);
+		if( !(iss >> threadCount) ) {
+			cerr << "Invalid number of threads: " << argv[2] << '\n';
+			return 1;
+		}
+	}
+	if( argc > 3 ) {
+		istringstream iss(argv[3]);
+		if( !(iss >> sliceMs) || !(sliceMs > 0) ) {
+			cerr << "Invalid slice time (must be > 0): " << argv[3] << '\n';
+			return 1;
+		}
+	}
+
+#ifdef SIGPIPE
+	signal(SIGPIPE, SIG_IGN);  // a closed connection is handled where it's written to
+#endif
+
+	try {
+		Socket::startup();
+		Socket server = Socket::listenLocal(port);
+		WorkStealingPool pool(threadCount);
+		cout << "Listening on 127.0.0.1:" << port << " with " << pool.size() << " threads" << endl;
+
+		while( true ) {
+			shared_ptr<Connection> c(new Connection());
+			c->socket = server.accept();
+			thread(serve, c, ref(pool), sliceMs / 1000).detach();
+		}
+
+	} catch(const exception &ex) {
+		cerr << ex.what() << endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,68 @@
+/*
+ * MSD Worker
+ *
+ * Usage:
+ *   msd_worker
+ *
+ * Runs one simulation for msd_server (see src/msd_server/MSDWorker.java). A native replacement for
+ * src/msd_server/MSDWorker.py, with the same line-based protocol on stdin/stdout:
+ *
+ *   1. One line of JSON: init args (width, height, depth, molType, molPosL, molPosR, topL, bottomL, frontR,
+ *      backR), config (seed, randomize, flippingAlgorithm, format), and MSD and mol. parameters.
+ *      Responds with READY.
+ *   2. Any number of commands (case-insensitive), each followed by one line of JSON:
+ *        SET {parameters}                   -> DONE
+ *        RUN {simCount, freq, dkT, dB}      -> the initial state, and a state after every "freq" iterations.
+ *                                              Each state must be answered with CANCEL or anything else
+ *                                              (e.g. CONTINUE). Then DONE.
+ *        GET ["results", "parameters", "seed", "msd", "mol"]  -> the state (all of it if the list is empty)
+ *        RESET {randomize, reseed, seed}    -> {"seed": ...}
+ *        FORMAT "json" | "binary" | "delta" -> DONE
+ *        EXIT (no JSON)                     -> GOODBYE
+ *
+ * FORMAT (also an init option) chooses how the per-atom part of each state is sent. "json" (default) is the
+ * same as MSDWorker.py: "msd": [{"index", "pos", "spin", "flux", "localM"}, ...]. "binary" replaces it with
+ * "msdFrame": a base64 full frame (see StateFrame.h). "delta" replaces it with "msdDelta": a base64 delta frame
+ * of only the atoms which changed since the previous state was sent (all of them the first time), so states
+ * must be applied in order.
+ */
+
+#include <cstdio>
+#include <exception>
+#include <iostream>
+#include <string>
+#include "WorkerProtocol.h"
+
+
+using namespace std;
+using namespace udc;
+using namespace udc::worker;
+
+
+void writeLine(const string &line) {
+	fwrite(line.data(), 1, line.size(), stdout);
+	fputc('\n', stdout);
+	fflush(stdout);
+}
+
+
+int main(int argc, char *argv[]) {
+	ios::sync_with_stdio(false);
+	try {
+		// each RUN chunk runs right away, as one task, before the next line is read
+		Session session(writeLine, [](Session::Task task) { task(); });
+		string line;
+		while( getline(cin, line) ) {
+			if( !line.empty() && line.back() == '\r' )
+				line.pop_back();
+			if( !session.onLine(line) )
+				break;
+		}
+		// stdin closed: proceed with shutdown
+
+	} catch(const exception &ex) {
+		cerr << ex.what() << endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,67 @@
+import sys
+import os
+import time
+import numpy as np
+
+# import MSD library from correct path: ~/lib/python
+MSD_LIB_PATH = os.path.join(os.path.realpath(os.path.dirname(__file__)), "../../lib/python")
+sys.path.append(MSD_LIB_PATH)
+from MSD import *
+
+
+# Compares the bulk (NumPy) accessors with the per-atom iterator.
+def main():
+	msd = MSD(11, 10, 10, molPosL = 5, molPosR = 5, topL = 3, bottomL = 6, frontR = 3, backR = 6)
+	msd.setParameters(MSD.Parameters(FL = 0.5, FR = 0.5))
+	msd.setMolParameters(Molecule.NodeParameters(Fm = 0.25))
+	msd.randomize()
+	msd.metropolis(20000, 1000)
+
+	atoms = [(a.index, a.pos, tuple(a.spin), tuple(a.flux), tuple(a.localM)) for a in msd]
+	inRegion = {
+		MSD.ALL: lambda x: True,
+		MSD.FM_L: lambda x: x < msd.molPosL,
+		MSD.FM_R: lambda x: x > msd.molPosR,
+		MSD.MOL: lambda x: msd.molPosL <= x <= msd.molPosR
+	}
+	for region, test in inRegion.items():
+		expected = [a for a in atoms if test(a[1][0])]
+		state = msd.getState(region)
+		assert msd.getRegionSize(region) == len(expected)
+		assert list(msd.getIndices(region)) == [a[0] for a in expected]
+		assert [tuple(p) for p in msd.getPositions(region)] == [a[1] for a in expected]
+		for col, (i, get) in enumerate([(2, msd.getSpins), (3, msd.getFluxes), (4, msd.getLocalMs)]):
+			values = np.array([a[i] for a in expected]).reshape(-1, 3)
+			assert np.array_equal(get(region), values)
+			assert np.array_equal(state[:, 3 * col : 3 * col + 3], values)
+
+	# views are zero-copy, so they stay up-to-date
+	spins, fluxes = msd.viewSpins(), msd.viewFluxes()
+	msd.metropolis(1000)
+	assert spins.shape == (msd.n, 3)
+	indices = msd.getIndices()
+	for region in (MSD.FM_L, MSD.FM_R):
+		rows = np.searchsorted(indices, msd.getIndices(region))
+		assert np.array_equal(spins[rows], msd.getSpins(region))
+		assert np.array_equal(fluxes[rows], msd.getFluxes(region))
+	assert not spins[np.searchsorted(indices, msd.getIndices(MSD.MOL))].any()
+
+	record = msd.getRecordArray()
+	assert len(record) == len(msd.record)
+	for r, expected in zip(record, msd.record):
+		assert r["t"] == expected.t and r["U"] == expected.U and tuple(r["M"]) == tuple(expected.M)
+
+	big = MSD(100, 100, 100)
+	big.randomize()
+	start = time.time()
+	big.getState()
+	bulkTime = time.time() - start
+	start = time.time()
+	[(a.spin, a.flux, a.localM) for a in big]
+	iterTime = time.time() - start
+	print(f"{big.n} atoms: getState() {bulkTime:.3f} s, iterator {iterTime:.3f} s")
+
+	print("Done. (Passed)")
+
+if __name__ == "__main__":
+	main()
@@ -0,0 +1,133 @@
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include "../AsyncRun.h"
+#include "../MSD.h"
+#include "test-util.h"
+
+using namespace std;
+using namespace udc;
+using namespace udc::test;
+
+const unsigned int numIter = 50;
+
+// an identical MSD, in the same state
+shared_ptr<MSD> twin(const MSD &msd) {
+	unsigned int molPosL, molPosR, topL, bottomL, frontR, backR;
+	msd.getMolPos(molPosL, molPosR);
+	msd.getInnerBounds(topL, bottomL, frontR, backR);
+	shared_ptr<MSD> t = make_shared<MSD>(msd.getWidth(), msd.getHeight(), msd.getDepth(), molPosL, molPosR, topL, bottomL, frontR, backR);
+	t->setParameters(msd.getParameters());
+	t->setMolProto(msd.getMolProto());
+	return t;
+}
+
+void reset(MSD &msd, unsigned long seed) {
+	msd.setSeed(seed);
+	msd.reinitialize(false);
+	msd.randomize(false);
+	msd.record.clear();
+}
+
+bool sameState(const MSD &a, const MSD &b) {
+	for (MSD::Iterator i = a.begin(); i != a.end(); ++i)
+		if (i.getSpin() != b.getSpin(i.getIndex()) || i.getFlux() != b.getFlux(i.getIndex()))
+			return false;
+	MSD::Results ra = a.getResults(), rb = b.getResults();
+	return memcmp(&ra, &rb, sizeof(MSD::Results)) == 0;  // Note: Results may contain NaN
+}
+
+struct ThrowingSink : MSD::RecordSink {
+	void put(const MSD::Results &) {
+		throw runtime_error("ThrowingSink");
+	}
+};
+
+int main(int argc, char *argv[]) {
+	Random rng;
+
+	for (unsigned int n = 0; n < numIter; n++) {
+		shared_ptr<MSD> msd = rng.randMSD(8);
+		shared_ptr<MSD> expected = twin(*msd);
+		unsigned long seed = (unsigned long) rng.randI(1000000);
+		unsigned long long N = rng.randI(5 * AsyncRun::SLICE);
+		unsigned long long freq = rng.randI(2) == 0 ? 0 : 1 + rng.randI(2 * AsyncRun::SLICE);
+
+		// same results (and record) as one call to metropolis
+		reset(*msd, seed);
+		reset(*expected, seed);
+		expected->metropolis(N, freq);
+		{
+			AsyncRun run(*msd, N, freq);
+			if (run.wait() != AsyncRun::DONE || run.getDone() != N) {
+				cout << "Run didn't finish: n = " << n << ", done = " << run.getDone() << '\n';
+				return 1;
+			}
+			MSD::Results r = run.getResults(), last = msd->getResults();
+			if (memcmp(&r, &last, sizeof(MSD::Results)) != 0) {
+				cout << "Final results weren't published: n = " << n << '\n';
+				return 1;
+			}
+		}
+		if (!sameState(*msd, *expected)) {
+			cout << "Different state than metropolis(N, freq): n = " << n << ", N = " << N << ", freq = " << freq << '\n';
+			return 1;
+		}
+		if (msd->record.size() != expected->record.size()
+		 || (!msd->record.empty() && memcmp(msd->record.data(), expected->record.data(), msd->record.size() * sizeof(MSD::Results)) != 0)) {
+			cout << "Different record than metropolis(N, freq): n = " << n << ", N = " << N << ", freq = " << freq << '\n';
+			return 1;
+		}
+
+		// progress is published while running, and cancel stops it early
+		reset(*msd, seed);
+		{
+			AsyncRun run(*msd, (unsigned long long) -1, 1 + rng.randI(1000));
+			unsigned long long last = 0;
+			while (run.getDone() < 3 * AsyncRun::SLICE) {
+				unsigned long long done = run.getDone();
+				MSD::Results r = run.getResults();
+				if (done < last || r.t > run.getDone() || run.getStatus() != AsyncRun::RUNNING) {
+					cout << "Invalid progress: n = " << n << ", done = " << done << ", t = " << r.t << '\n';
+					return 1;
+				}
+				last = done;
+				this_thread::yield();
+			}
+			run.cancel();
+			if (run.wait() != AsyncRun::CANCELLED || run.getResults().t != run.getDone() || msd->getResults().t != run.getDone()) {
+				cout << "Cancel failed: n = " << n << ", done = " << run.getDone() << '\n';
+				return 1;
+			}
+		}
+
+		// a run whose RecordSink throws FAILED, and wait() rethrows it once
+		{
+			ThrowingSink sink;
+			msd->recordSink = &sink;
+			AsyncRun run(*msd, 2 * AsyncRun::SLICE, AsyncRun::SLICE);
+			bool thrown = false;
+			try {
+				run.wait();
+			} catch (const runtime_error &) {
+				thrown = true;
+			}
+			if (!thrown || run.getStatus() != AsyncRun::FAILED || run.wait() != AsyncRun::FAILED) {
+				cout << "Failed run not reported: n = " << n << '\n';
+				return 1;
+			}
+			msd->recordSink = NULL;
+		}
+
+		// destroying a running AsyncRun cancels it
+		{
+			AsyncRun run(*msd, (unsigned long long) -1);
+		}
+	}
+
+	cout << "Done. (Passed)\n";
+	return 0;
+}
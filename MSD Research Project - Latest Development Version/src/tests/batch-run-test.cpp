@@ -0,0 +1,116 @@
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include "../BatchRun.h"
+#include "../MSD.h"
+#include "test-util.h"
+
+using namespace std;
+using namespace udc;
+using namespace udc::test;
+
+const unsigned int numIter = 10;
+const unsigned int batchSize = 12;
+
+const MSD::MolProtoFactory BAD_MOL = [](unsigned int) -> MSD::MolProto {
+	throw runtime_error("BAD_MOL");
+};
+
+BatchConfig randConfig(Random &rng) {
+	shared_ptr<MSD> msd = rng.randMSD(6);  // for its (valid) dimensions
+	BatchConfig config;
+	config.width = msd->getWidth();
+	config.height = msd->getHeight();
+	config.depth = msd->getDepth();
+	msd->getMolPos(config.molPosL, config.molPosR);
+	msd->getInnerBounds(config.topL, config.bottomL, config.frontR, config.backR);
+	config.molType = rng.randI(2) == 0 ? NULL : &MSD::CIRCULAR_MOL;
+	config.flippingAlgorithm = rng.randI(2) == 0 ? NULL : &MSD::UP_DOWN_MODEL;
+	config.parameters = rng.randP();
+	config.nodeParameters = rng.randPNode();
+	config.edgeParameters = rng.randPEdge();
+	config.seed = (unsigned long) rng.randI(1000000);
+	config.randomize = rng.randI(2) == 0;
+	config.t_eq = rng.randI(2000);
+	config.simCount = rng.randI(5000);
+	config.freq = rng.randI(3) == 0 ? 0 : 1 + rng.randI(500);
+	return config;
+}
+
+// the same steps as runBatchConfig, written out
+BatchResult expected(const BatchConfig &config) {
+	MSD msd(config.width, config.height, config.depth,
+			config.molType == NULL ? MSD::LINEAR_MOL : *config.molType, config.molPosL, config.molPosR,
+			config.topL, config.bottomL, config.frontR, config.backR);
+	msd.setParameters(config.parameters);
+	msd.setMolParameters(config.nodeParameters, config.edgeParameters);
+	if (config.flippingAlgorithm != NULL)
+		msd.flippingAlgorithm = *config.flippingAlgorithm;
+	msd.setSeed(config.seed);
+	if (config.randomize)
+		msd.randomize(false);
+	else
+		msd.reinitialize(false);
+	msd.metropolis(config.t_eq);
+	msd.metropolis(config.simCount, config.freq);
+
+	BatchResult r = BatchResult();
+	r.results = msd.getResults();
+	r.c = msd.specificHeat();
+	r.cL = msd.specificHeat_L();
+	r.cR = msd.specificHeat_R();
+	r.cm = msd.specificHeat_m();
+	r.cmL = msd.specificHeat_mL();
+	r.cmR = msd.specificHeat_mR();
+	r.cLR = msd.specificHeat_LR();
+	r.x = msd.magneticSusceptibility();
+	r.xL = msd.magneticSusceptibility_L();
+	r.xR = msd.magneticSusceptibility_R();
+	r.xm = msd.magneticSusceptibility_m();
+	return r;
+}
+
+// Note: BatchResult may contain NaN, and padding (zeroed by BatchResult())
+bool same(const BatchResult &a, const BatchResult &b) {
+	return memcmp(&a, &b, sizeof(BatchResult)) == 0;
+}
+
+int main(int argc, char *argv[]) {
+	Random rng;
+
+	for (unsigned int n = 0; n < numIter; n++) {
+		vector<BatchConfig> configs;
+		for (unsigned int i = 0; i < batchSize; i++)
+			configs.push_back(randConfig(rng));
+		unsigned int bad = rng.randI(batchSize);
+		configs[bad].molType = &BAD_MOL;
+		configs[bad].molPosL = configs[bad].molPosR = 0;  // so that there is a molecule
+
+		// the same results, whatever the number of threads
+		for (unsigned int threadCount : {1u, 3u, 0u}) {
+			vector<BatchResult> results(batchSize);
+			runBatch(configs.data(), results.data(), configs.size(), threadCount);
+			for (unsigned int i = 0; i < batchSize; i++) {
+				if (i == bad) {
+					BatchResult failed = BatchResult();
+					failed.failed = true;
+					if (!same(results[i], failed)) {
+						cout << "Invalid config didn't fail: n = " << n << ", i = " << i << '\n';
+						return 1;
+					}
+				} else if (!same(results[i], expected(configs[i]))) {
+					cout << "Different result than running it alone: n = " << n << ", i = " << i
+					     << ", threadCount = " << threadCount << '\n';
+					return 1;
+				}
+			}
+		}
+	}
+
+	runBatch(NULL, NULL, 0);  // nothing to do
+
+	cout << "Done. (Passed)\n";
+	return 0;
+}
@@ -0,0 +1,135 @@
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <vector>
+#include "../MSD.h"
+#include "../StateFrame.h"
+#include "test-util.h"
+
+using namespace std;
+using namespace udc;
+using namespace udc::test;
+
+const unsigned int numIter = 50;
+
+typedef map< unsigned int, pair<Vector, Vector> > State;  // index -> (spin, flux)
+
+State getState(const MSD &msd) {
+	State state;
+	for (MSD::Iterator i = msd.begin(); i != msd.end(); ++i)
+		state[i.getIndex()] = make_pair(i.getSpin(), i.getFlux());
+	return state;
+}
+
+// Applies the atoms in a delta frame to state, and returns the frame's token. Returns 0 if the frame is invalid.
+unsigned long long applyDelta(const vector<unsigned char> &frame, State &state, const MSD &msd) {
+	uint32_t header[3];
+	uint64_t token;
+	if (frame.size() < DELTA_FRAME_HEADER_SIZE || memcmp(frame.data(), "MSDD", 4) != 0)
+		return 0;
+	memcpy(header, frame.data() + 4, sizeof(header));
+	memcpy(&token, frame.data() + 16, sizeof(token));
+	const size_t n = header[1];
+	if (header[0] != 1 || frame.size() != deltaFrameSize(n))
+		return 0;
+	const unsigned char *vectors = frame.data() + DELTA_FRAME_HEADER_SIZE;
+	const unsigned char *indices = vectors + n * 6 * sizeof(float);
+	for (size_t i = 0; i < n; i++) {
+		float v[6];
+		uint32_t a;
+		memcpy(v, vectors + i * sizeof(v), sizeof(v));
+		memcpy(&a, indices + i * sizeof(a), sizeof(a));
+		// float precision in the frame; the exact values are used for the comparisons below
+		if ((Vector(v[0], v[1], v[2]) - msd.getSpin(a)).norm() > 1e-5 * (1 + msd.getSpin(a).norm())
+		 || (Vector(v[3], v[4], v[5]) - msd.getFlux(a)).norm() > 1e-5 * (1 + msd.getFlux(a).norm()))
+			return 0;
+		state[a] = make_pair(msd.getSpin(a), msd.getFlux(a));
+	}
+	return token;
+}
+
+// Sends a delta frame since "token" and applies it; the result must exactly match the MSD.
+bool sync(MSD &msd, unsigned long long &token, State &state, const char *what, unsigned int n) {
+	vector<unsigned int> changed;
+	msd.getChangedSince(token, changed);
+	vector<unsigned char> frame(deltaFrameSize(changed.size()));
+	encodeDeltaFrame(msd, changed, msd.nextChangeFrame(), frame.data());
+	unsigned long long next = applyDelta(frame, state, msd);
+	if (next == 0 || next <= token) {
+		cout << "Invalid delta frame after " << what << ": n = " << n << '\n';
+		return false;
+	}
+	token = next;
+	if (state != getState(msd)) {
+		cout << "Missed a change after " << what << ": n = " << n << '\n';
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char *argv[]) {
+	Random rng;
+
+	for (unsigned int n = 0; n < numIter; n++) {
+		shared_ptr<MSD> msd = rng.randMSD(9);
+		msd->randomize();
+		MSD::Parameters p = msd->getParameters();
+		p.kT = 0.01 + rng.rand();
+		msd->setParameters(p);
+
+		msd->setChangeTracking(true);
+		unsigned long long token = 0;
+		State state;  // what the "client" has
+		if (!sync(*msd, token, state, "enabling", n))
+			return 1;
+
+		// nothing changed
+		vector<unsigned int> changed;
+		msd->getChangedSince(token, changed);
+		if (!changed.empty()) {
+			cout << "Changes reported without any changes: n = " << n << '\n';
+			return 1;
+		}
+
+		// metropolis: only accepted flips
+		msd->metropolis(msd->getN() / 2 + 1);
+		msd->getChangedSince(token, changed);
+		State before = state;
+		if (!sync(*msd, token, state, "metropolis", n))
+			return 1;
+		for (unsigned int a : changed)
+			if (before[a] == state[a]) {
+				cout << "Rejected flip reported as a change: n = " << n << ", a = " << a << '\n';
+				return 1;
+			}
+
+		// setLocalM, and rescaling by the parameters and the molecule
+		MSD::Iterator i = msd->begin();
+		msd->setLocalM(i.getIndex(), i.getSpin() * -1, i.getFlux());
+		if (!sync(*msd, token, state, "setLocalM", n))
+			return 1;
+		p.SL += 0.5;
+		p.FR += 0.25;
+		msd->setParameters(p);
+		if (!sync(*msd, token, state, "setParameters", n))
+			return 1;
+		msd->setMolParameters(rng.randPNode(), rng.randPEdge());
+		if (!sync(*msd, token, state, "setMolParameters", n))
+			return 1;
+		msd->reinitialize();
+		if (!sync(*msd, token, state, "reinitialize", n))
+			return 1;
+
+		// an old token still sees everything since then
+		unsigned long long old = token;
+		msd->metropolis(10);
+		msd->nextChangeFrame();
+		msd->metropolis(10);
+		State expected = state;
+		if (!sync(*msd, old, expected, "two frames", n))
+			return 1;
+	}
+
+	cout << "Done. (Passed)\n";
+	return 0;
+}
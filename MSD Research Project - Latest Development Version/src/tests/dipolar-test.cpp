@@ -0,0 +1,127 @@
+#include <cmath>
+#include <iostream>
+#include <vector>
+#include "../MSD.h"
+#include "../Dipolar.h"
+#include "test-util.h"
+
+using namespace std;
+using namespace udc;
+using namespace udc::test;
+
+const unsigned int numIter = 50;
+const double maxError = 1e-9;
+
+bool isFM(const MSD &msd, unsigned int x) {
+	return x < msd.getMolPosL() || x > msd.getMolPosR();
+}
+
+// O(N^2) direct sum of the field at every FM atom, for comparison with DipolarField's FFT convolution
+vector<Vector> directField(const MSD &msd) {
+	vector<Vector> field((size_t) msd.getWidth() * msd.getHeight() * msd.getDepth(), Vector::ZERO);
+	double t[6];
+	for (MSD::Iterator i = msd.begin(); i != msd.end(); ++i) {
+		if (!isFM(msd, i.getX()))
+			continue;
+		Vector &H = field[i.getIndex()];
+		for (MSD::Iterator j = msd.begin(); j != msd.end(); ++j) {
+			if (!isFM(msd, j.getX()))
+				continue;
+			DipolarField::dipoleTensor((double) i.getX() - j.getX(), (double) i.getY() - j.getY(), (double) i.getZ() - j.getZ(), t);
+			Vector m = j.getLocalM();
+			H.x += t[0] * m.x + t[3] * m.y + t[4] * m.z;
+			H.y += t[3] * m.x + t[1] * m.y + t[5] * m.z;
+			H.z += t[4] * m.x + t[5] * m.y + t[2] * m.z;
+		}
+	}
+	return field;
+}
+
+// relative to the larger of 1 and |expected|
+bool close(double actual, double expected) {
+	return abs(actual - expected) <= maxError * max(1.0, abs(expected));
+}
+
+int main(int argc, char *argv[]) {
+	Random rng;
+
+	for (unsigned int n = 0; n < numIter; n++) {
+		shared_ptr<MSD> msd = rng.randMSD(7);
+		msd->randomize();
+		unsigned int width, height, depth;
+		msd->getDimensions(width, height, depth);
+		const double D = 0.1 + rng.rand();
+
+		// energy without the dipolar term
+		double U0 = msd->getResults().U;
+		double UL0 = msd->getResults().UL;
+		double UR0 = msd->getResults().UR;
+		msd->setDipolar(D);
+
+		// the field, compared to the direct sum
+		vector<Vector> expected = directField(*msd);
+		double maxField = 1, maxDiff = 0;
+		for (MSD::Iterator i = msd->begin(); i != msd->end(); ++i) {
+			if (!isFM(*msd, i.getX()))
+				continue;  // (H is also computed at the mol., but isn't used)
+			maxField = max(maxField, expected[i.getIndex()].norm());
+			maxDiff = max(maxDiff, (msd->getDipolarField(i.getIndex()) - expected[i.getIndex()]).norm());
+		}
+		if (maxDiff > maxError * maxField) {
+			cout << "FFT field differs from the direct sum: n = " << n << ", size = " << width << 'x' << height << 'x' << depth
+			     << ", error = " << maxDiff << '\n';
+			return 1;
+		}
+
+		// the energy: -(D / 2) sum m_i * H_i, split by region
+		double UL = 0, UR = 0;
+		for (MSD::Iterator i = msd->begin(); i != msd->end(); ++i) {
+			double u = -0.5 * D * (i.getLocalM() * expected[i.getIndex()]);
+			if (i.getX() < msd->getMolPosL())
+				UL += u;
+			else if (i.getX() > msd->getMolPosR())
+				UR += u;
+		}
+		MSD::Results r = msd->getResults();
+		if (!close(r.UL - UL0, UL) || !close(r.UR - UR0, UR) || !close(r.U - U0, UL + UR)) {
+			cout << "Wrong dipolar energy: n = " << n << ", (UL, UR) = (" << r.UL - UL0 << ", " << r.UR - UR0
+			     << "), expected (" << UL << ", " << UR << ")\n";
+			return 1;
+		}
+
+		// a single change using the cached field is exact, so a refresh shouldn't change the energy
+		for (MSD::Iterator i = msd->begin(); i != msd->end(); ++i)
+			if (isFM(*msd, i.getX())) {
+				msd->setLocalM(i.getIndex(), msd->getSpin(i.getIndex()) * -1, msd->getFlux(i.getIndex()));
+				break;
+			}
+		double U1 = msd->getResults().U;
+		msd->refreshDipolar();
+		if (!close(msd->getResults().U, U1)) {
+			cout << "Incremental dipolar energy is wrong: n = " << n << ", U = " << U1 << ", expected " << msd->getResults().U << '\n';
+			return 1;
+		}
+
+		// after metropolis (accepted and reverted flips, periodic refreshes) and a final refresh,
+		// U should match a full recalculation
+		msd->setDipolar(D, 1 + (unsigned long long) (rng.rand() * 2 * msd->getN()));
+		msd->metropolis(5 * msd->getN() + 3);
+		msd->refreshDipolar();
+		double U2 = msd->getResults().U;
+		msd->setParameters(msd->getParameters());
+		if (!close(U2, msd->getResults().U)) {
+			cout << "Dipolar energy drifted after metropolis: n = " << n << ", U = " << U2 << ", expected " << msd->getResults().U << '\n';
+			return 1;
+		}
+
+		// turning it off again
+		msd->setDipolar(0);
+		if (msd->getDipolarField(0) != Vector::ZERO) {
+			cout << "Dipolar field not cleared: n = " << n << '\n';
+			return 1;
+		}
+	}
+
+	cout << "Done. (Passed)\n";
+	return 0;
+}
@@ -0,0 +1,284 @@
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include "../asm/FastMSD.h"
+#include "../MSD.h"
+#include "../PackedVector.h"
+#include "../ThreadPool.h"
+#include "test-util.h"
+
+using namespace std;
+using namespace udc;
+using namespace udc::test;
+
+const unsigned int numIter = 40;
+const unsigned long long numSteps = 20000;
+
+// Built with UDC_FLOAT_STATE, FastMSD rounds states to float, so it can't follow MSD's simulation:
+// then each kernel is only compared with the others
+const bool floatState = sizeof(StateVector::Scalar) != sizeof(double);
+const double tolerance = floatState ? 1e-5 : 1e-9;
+
+// everything needed to build the same (randomized) MSD again
+struct Config {
+	shared_ptr<MSD> dims;  // a random MSD, for its (valid) dimensions and parameters
+	const MSD::MolProtoFactory *molType;
+	Molecule::NodeParameters nodeParameters;
+	Molecule::EdgeParameters edgeParameters;
+	bool upDown;
+	unsigned long seed;
+	unsigned int zeroTerms;  // FastMSD::Terms whose coefficients are all 0
+};
+
+Config randConfig(Random &rng) {
+	Config c;
+	c.dims = rng.randMSD(8);
+	c.molType = rng.randI(2) == 0 ? &MSD::LINEAR_MOL : &MSD::CIRCULAR_MOL;
+	c.nodeParameters = rng.randPNode();
+	c.edgeParameters = rng.randPEdge();
+	c.upDown = rng.randI(2) == 0;
+	c.seed = (unsigned long) rng.randI(1000000);
+	c.zeroTerms = rng.randI(2) == 0 ? rng.randI(FastMSD::ALL_TERMS + 1) : 0;
+	return c;
+}
+
+shared_ptr<MSD> build(const Config &c) {
+	unsigned int molPosL, molPosR, topL, bottomL, frontR, backR;
+	c.dims->getMolPos(molPosL, molPosR);
+	c.dims->getInnerBounds(topL, bottomL, frontR, backR);
+	shared_ptr<MSD> msd = make_shared<MSD>(c.dims->getWidth(), c.dims->getHeight(), c.dims->getDepth(),
+			*c.molType, molPosL, molPosR, topL, bottomL, frontR, backR);
+	MSD::Parameters p = c.dims->getParameters();
+	Molecule::NodeParameters np = c.nodeParameters;
+	Molecule::EdgeParameters ep = c.edgeParameters;
+	if (c.zeroTerms & FastMSD::TERM_J)
+		p.JL = p.JR = p.JmL = p.JmR = p.JLR = ep.Jm = 0;
+	if (c.zeroTerms & FastMSD::TERM_JE)
+		p.Je1L = p.Je1R = p.Je1mL = p.Je1mR = p.Je1LR = p.JeeL = p.JeeR = p.JeemL = p.JeemR = p.JeeLR = ep.Je1m = ep.Jeem = 0;
+	if (c.zeroTerms & FastMSD::TERM_BIQUADRATIC)
+		p.bL = p.bR = p.bmL = p.bmR = p.bLR = ep.bm = 0;
+	if (c.zeroTerms & FastMSD::TERM_DMI)
+		p.DL = p.DR = p.DmL = p.DmR = p.DLR = ep.Dm = Vector::ZERO;
+	if (c.zeroTerms & FastMSD::TERM_FLUX)
+		p.FL = p.FR = np.Fm = 0;
+	if (c.zeroTerms & FastMSD::TERM_ANISOTROPY)
+		p.AL = p.AR = np.Am = Vector::ZERO;
+	if (c.zeroTerms & FastMSD::TERM_JE0)
+		p.Je0L = p.Je0R = np.Je0m = 0;
+	msd->setParameters(p);
+	msd->setMolParameters(np, ep);
+	if (c.upDown)
+		msd->flippingAlgorithm = MSD::UP_DOWN_MODEL;
+	msd->setSeed(c.seed);
+	msd->randomize(false);
+	msd->setSeed(c.seed + 1);  // so metropolis doesn't replay randomize's random numbers (and propose the same states)
+	return msd;
+}
+
+bool near(double a, double b, double scale) {
+	return abs(a - b) <= tolerance * (1 + scale);
+}
+
+bool near(const Vector &a, const Vector &b, double scale) {
+	return near(a.x, b.x, scale) && near(a.y, b.y, scale) && near(a.z, b.z, scale);
+}
+
+// scale: roughly the largest magnitude summed into any of the Results
+bool same(const MSD::Results &a, const MSD::Results &b, double scale) {
+	return a.t == b.t
+		&& near(a.M, b.M, scale) && near(a.ML, b.ML, scale) && near(a.MR, b.MR, scale) && near(a.Mm, b.Mm, scale)
+		&& near(a.MS, b.MS, scale) && near(a.MSL, b.MSL, scale) && near(a.MSR, b.MSR, scale) && near(a.MSm, b.MSm, scale)
+		&& near(a.MF, b.MF, scale) && near(a.MFL, b.MFL, scale) && near(a.MFR, b.MFR, scale) && near(a.MFm, b.MFm, scale)
+		&& near(a.U, b.U, scale) && near(a.UL, b.UL, scale) && near(a.UR, b.UR, scale) && near(a.Um, b.Um, scale)
+		&& near(a.UmL, b.UmL, scale) && near(a.UmR, b.UmR, scale) && near(a.ULR, b.ULR, scale);
+}
+
+int main(int argc, char *argv[]) {
+	Random rng;
+	WorkStealingPool pool(4);
+
+	for (int k = FastMSD::SCALAR; k <= FastMSD::AVX512; k++)
+		cout << FastMSD::kernelName((FastMSD::Kernel) k) << ": "
+		     << (FastMSD::supports((FastMSD::Kernel) k) ? "supported" : "not supported") << '\n';
+
+	for (unsigned int n = 0; n < numIter; n++) {
+		Config config = randConfig(rng);
+		shared_ptr<MSD> msd = build(config);
+		double scale = 100.0 * msd->getN();
+
+		// the same sites and energy
+		{	FastMSD fast(*msd);
+			if (fast.getN() != msd->getN()) {
+				cout << "Wrong number of sites: n = " << n << '\n';
+				return 1;
+			}
+			unsigned int i = 0;
+			for (MSD::Iterator iter = msd->begin(); iter != msd->end(); ++iter, ++i)
+				if (fast.getIndex(i) != iter.getIndex()
+						|| fast.getSpin(i) != StateVector::round(iter.getSpin()) || fast.getFlux(i) != StateVector::round(iter.getFlux())) {
+					cout << "Different site: n = " << n << ", i = " << i << '\n';
+					return 1;
+				}
+			if (!same(fast.computeResults(), msd->getResults(), scale)) {
+				cout << "Different energy from scratch: n = " << n << '\n';
+				return 1;
+			}
+		}
+
+		// the same simulation (given the same seed), with every kernel
+		MSD::Results reference[2];  // (of the first kernel)
+		Vector B = rng.randV();
+		for (int k = FastMSD::SCALAR; k <= FastMSD::AVX512; k++) {
+			if (!FastMSD::supports((FastMSD::Kernel) k))
+				continue;
+			shared_ptr<MSD> copy = build(config);
+			FastMSD fast(*copy);
+			fast.setKernel((FastMSD::Kernel) k);
+			copy->setSeed(copy->getSeed());  // restart its random numbers, as FastMSD did
+
+			copy->metropolis(numSteps);
+			fast.metropolis(numSteps);
+			if (k == FastMSD::SCALAR)
+				reference[0] = fast.getResults();
+			if ((!floatState && !same(fast.getResults(), copy->getResults(), scale)) || !same(fast.getResults(), reference[0], scale)) {
+				cout << "Different results: n = " << n << ", kernel = " << FastMSD::kernelName((FastMSD::Kernel) k) << '\n';
+				return 1;
+			}
+			if (!same(fast.computeResults(), fast.getResults(), scale)) {
+				cout << "Results drifted: n = " << n << ", kernel = " << FastMSD::kernelName((FastMSD::Kernel) k) << '\n';
+				return 1;
+			}
+
+			copy->setB(B);
+			fast.setB(B);
+			copy->metropolis(numSteps, 1000);
+			fast.metropolis(numSteps, 1000);
+			if (k == FastMSD::SCALAR)
+				reference[1] = fast.getResults();
+			if (fast.record.size() != copy->record.size() || (!floatState && !same(fast.getResults(), copy->getResults(), scale))
+					|| !same(fast.getResults(), reference[1], scale)) {
+				cout << "Different results after setB: n = " << n << ", kernel = " << FastMSD::kernelName((FastMSD::Kernel) k) << '\n';
+				return 1;
+			}
+		}
+
+		// leaving out the terms that are 0 changes nothing: exactly the same simulation as the general kernel
+		for (int k = FastMSD::SCALAR; k <= FastMSD::AVX512; k++) {
+			if (!FastMSD::supports((FastMSD::Kernel) k))
+				continue;
+			FastMSD fast(*msd), general(*msd);
+			fast.setKernel((FastMSD::Kernel) k);
+			general.setKernel((FastMSD::Kernel) k);
+			general.setSpecialized(false);
+			if ((fast.getTerms() & config.zeroTerms) != 0 || general.getTerms() != FastMSD::ALL_TERMS) {
+				cout << "Wrong terms: n = " << n << ", zeroTerms = " << config.zeroTerms << ", terms = " << fast.getTerms() << '\n';
+				return 1;
+			}
+			fast.metropolis(numSteps);
+			general.metropolis(numSteps);
+			fast.setB(B);
+			general.setB(B);
+			fast.metropolis(numSteps, 1000);
+			general.metropolis(numSteps, 1000);
+			if (fast.getResults() != general.getResults() || fast.record != general.record) {
+				cout << "Specialized kernel differs: n = " << n << ", kernel = " << FastMSD::kernelName((FastMSD::Kernel) k) << '\n';
+				return 1;
+			}
+
+			// a flux, where there were none
+			Vector s = rng.randV(), f = rng.randV();
+			fast.setLocalM(0, s, f);
+			general.setLocalM(0, s, f);
+			fast.metropolis(numSteps);
+			general.metropolis(numSteps);
+			if ((fast.getTerms() & FastMSD::TERM_FLUX) == 0 || fast.getResults() != general.getResults()) {
+				cout << "Specialized kernel differs after setLocalM: n = " << n << ", kernel = " << FastMSD::kernelName((FastMSD::Kernel) k) << '\n';
+				return 1;
+			}
+		}
+
+		// the same simulation, whichever order the nodes are stored in
+		for (FastMSD::Ordering o : { FastMSD::MORTON_ORDER, FastMSD::HILBERT_ORDER }) {
+			FastMSD fast(*msd), ordered(*msd, o);
+			fast.metropolis(numSteps);
+			ordered.metropolis(numSteps);
+			unsigned int i = rng.randI(fast.getN());
+			Vector s = rng.randV(), f = rng.randV();
+			fast.setLocalM(i, s, f);
+			ordered.setLocalM(i, s, f);
+			fast.metropolis(numSteps);
+			ordered.metropolis(numSteps);
+			// (with UDC_FLOAT_STATE, the starting Results are summed from scratch, in a different order)
+			if (floatState ? !same(ordered.getResults(), fast.getResults(), scale) : ordered.getResults() != fast.getResults()) {
+				cout << "Different results when ordered: n = " << n << ", ordering = " << o << '\n';
+				return 1;
+			}
+			for (unsigned int i = 0; i < fast.getN(); i++)
+				if (ordered.getIndex(i) != fast.getIndex(i) || ordered.getSpin(i) != fast.getSpin(i) || ordered.getFlux(i) != fast.getFlux(i)) {
+					cout << "Different site when ordered: n = " << n << ", ordering = " << o << ", i = " << i << '\n';
+					return 1;
+				}
+		}
+
+		// cached effective fields: the same simulation, up to rounding
+		{	FastMSD fast(*msd), cached(*msd);
+			cached.setCachedFields(true);
+			fast.metropolis(numSteps);
+			cached.metropolis(numSteps);
+			cached.setLocalM(0, rng.randV(), rng.randV());
+			fast.setLocalM(0, cached.getSpin(0), cached.getFlux(0));
+			fast.setB(B);
+			cached.setB(B);
+			fast.metropolis(numSteps);
+			cached.metropolis(numSteps);
+			if (!same(cached.getResults(), fast.getResults(), scale) || !same(cached.computeResults(), cached.getResults(), scale)) {
+				cout << "Different results with cached fields: n = " << n << '\n';
+				return 1;
+			}
+		}
+		// speculative parallel metropolis: exactly the same simulation, and random numbers, as the serial one
+		{	FastMSD fast(*msd), parallel(*msd);
+			bool cached = rng.randI(2) == 0;
+			fast.setCachedFields(cached);
+			parallel.setCachedFields(cached);
+			if (rng.randI(4) == 0) {
+				// a flippingAlgorithm FastMSD doesn't know (so the flips aren't drawn ahead in parallel)
+				fast.flippingAlgorithm = parallel.flippingAlgorithm = [](const Vector &spin, function<double()> rand) {
+					return MSD::CONTINUOUS_SPIN_MODEL(spin, rand);
+				};
+			}
+			parallel.setPool(&pool, rng.randI(1, 300));
+			fast.metropolis(numSteps);
+			parallel.metropolis(numSteps);
+			fast.setB(B);
+			parallel.setB(B);
+			fast.metropolis(numSteps, 1000);
+			parallel.metropolis(numSteps, 1000);
+			parallel.setPool(NULL);  // continuing serially, from where the last window stopped drawing
+			fast.metropolis(1000);
+			parallel.metropolis(1000);
+			if (parallel.getResults() != fast.getResults() || parallel.record != fast.record) {
+				cout << "Different results in parallel: n = " << n << ", window = " << parallel.getWindow() << '\n';
+				return 1;
+			}
+			for (unsigned int i = 0; i < fast.getN(); i++)
+				if (parallel.getSpin(i) != fast.getSpin(i) || parallel.getFlux(i) != fast.getFlux(i)) {
+					cout << "Different site in parallel: n = " << n << ", i = " << i << '\n';
+					return 1;
+				}
+		}
+	}
+
+	// the MSD's dipolar field isn't supported
+	{	shared_ptr<MSD> msd = rng.randMSD(4);
+		msd->setDipolar(0.5);
+		try {
+			FastMSD fast(*msd);
+			cout << "Dipolar field was accepted\n";
+			return 1;
+		} catch (const invalid_argument &) {}
+	}
+
+	cout << "Done. (Passed)\n";
+	return 0;
+}
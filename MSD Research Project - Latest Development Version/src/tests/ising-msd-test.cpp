@@ -0,0 +1,183 @@
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include "../asm/IsingMSD.h"
+#include "../MSD.h"
+#include "test-util.h"
+
+using namespace std;
+using namespace udc;
+using namespace udc::test;
+
+const unsigned int numIter = 40;
+const double tolerance = 1e-9;
+
+bool near(double a, double b, double scale) {
+	return abs(a - b) <= tolerance * (1 + scale);
+}
+
+bool near(const Vector &a, const Vector &b, double scale) {
+	return (a - b).norm() <= tolerance * (1 + scale);
+}
+
+bool near(const MSD::Results &a, const MSD::Results &b, double scale) {
+	return near(a.U, b.U, 100 * scale) && near(a.UL, b.UL, 100 * scale) && near(a.UR, b.UR, 100 * scale)
+		&& near(a.Um, b.Um, 100 * scale) && near(a.UmL, b.UmL, 100 * scale) && near(a.UmR, b.UmR, 100 * scale)
+		&& near(a.ULR, b.ULR, 100 * scale) && near(a.M, b.M, scale) && near(a.ML, b.ML, scale)
+		&& near(a.MR, b.MR, scale) && near(a.Mm, b.Mm, scale) && near(a.MS, b.MS, scale);
+}
+
+// a random MSD (UP_DOWN_MODEL, without flux) whose spins are +S or -S along a random axis
+shared_ptr<MSD> randIsingMSD(Random &rng, unsigned int max_dim) {
+	shared_ptr<MSD> dims = rng.randMSD(max_dim);
+	unsigned int molPosL, molPosR, topL, bottomL, frontR, backR;
+	dims->getMolPos(molPosL, molPosR);
+	dims->getInnerBounds(topL, bottomL, frontR, backR);
+	shared_ptr<MSD> msd = make_shared<MSD>(dims->getWidth(), dims->getHeight(), dims->getDepth(),
+			rng.randI(2) == 0 ? MSD::LINEAR_MOL : MSD::CIRCULAR_MOL, molPosL, molPosR, topL, bottomL, frontR, backR);
+	MSD::Parameters p = dims->getParameters();
+	p.FL = p.FR = 0;
+	p.JL -= 0.5;  // (some antiferromagnetic bonds too)
+	p.JmR -= 0.5;
+	Molecule::NodeParameters np = rng.randPNode();
+	np.Fm = 0;
+	msd->setParameters(p);
+	msd->setMolParameters(np, rng.randPEdge());
+	msd->flippingAlgorithm = MSD::UP_DOWN_MODEL;
+	msd->setSeed((unsigned long) rng.randI(1000000));
+
+	Vector axis = rng.randV().normalize();
+	for (auto iter = msd->begin(); iter != msd->end(); iter++) {
+		double S = msd->getSpin(iter.getIndex()).norm();
+		msd->setLocalM(iter.getIndex(), (rng.randI(2) == 0 ? S : -S) * axis, Vector::ZERO);
+	}
+	return msd;
+}
+
+// gives the MSD the IsingMSD's state
+void copyState(const IsingMSD &ising, MSD &msd) {
+	for (unsigned int i = 0; i < ising.getN(); i++)
+		msd.setLocalM(ising.getIndex(i), ising.getSpin(i), Vector::ZERO);
+}
+
+int main(int argc, char *argv[]) {
+	Random rng;
+
+	// Results: the same as the MSD's, before and after runs (multi-spin coded, and not)
+	for (unsigned int n = 0; n < numIter; n++) {
+		shared_ptr<MSD> msd = randIsingMSD(rng, 8);
+		IsingMSD ising(*msd);
+		const double scale = ising.getN();
+		if (!near(ising.getResults(), msd->getResults(), scale) || !near(ising.computeResults(), msd->getResults(), scale)) {
+			cout << "Different initial Results than MSD's: n = " << n << '\n';
+			return 1;
+		}
+		for (unsigned int i = 0; i < ising.getN(); i++)
+			if (!near(ising.getSpin(i), msd->getSpin(ising.getIndex(i)), 1) || ising.getFlux(i) != Vector::ZERO) {
+				cout << "Different state than MSD's: n = " << n << ", node = " << i << '\n';
+				return 1;
+			}
+
+		unsigned long long t = msd->getResults().t;
+		for (unsigned int run = 0; run < 3; run++) {
+			unsigned long long N = rng.randI(1, 20 * ising.getN() + 2);
+			ising.metropolis(N);
+			t += N;
+			if (ising.getResults().t != t) {
+				cout << "Wrong t: n = " << n << '\n';
+				return 1;
+			}
+			copyState(ising, *msd);
+			if (!near(ising.getResults(), msd->getResults(), scale) || !near(ising.getResults(), ising.computeResults(), scale)) {
+				cout << "Results drifted: n = " << n << ", run = " << run << '\n';
+				return 1;
+			}
+			if (run == 0) {
+				Vector B = rng.randV();
+				ising.setB(B);
+				msd->setB(B);
+				ising.set_kT(rng.rand());
+			} else if (run == 1) {
+				ising.randomize();
+			}
+		}
+	}
+
+	// statistics: long runs average the same as the exact Boltzmann distribution (from every state) on small systems
+	for (unsigned int n = 0; n < 6; n++) {
+		shared_ptr<MSD> msd;
+		do {
+			msd = randIsingMSD(rng, 3);
+		} while (msd->getN() > 12);
+		IsingMSD ising(*msd);
+		ising.set_kT(0.5 + rng.rand());
+		const unsigned int N = ising.getN();
+
+		double Z = 0, exactU = 0, exactM = 0;
+		for (unsigned long long state = 0; state < (1ull << N); state++) {
+			for (unsigned int i = 0; i < N; i++)
+				if ((ising.getSigma(i) < 0) != ((state >> i & 1) != 0))
+					ising.flip(i);
+			const MSD::Results r = ising.getResults();
+			const double weight = exp(-r.U / ising.get_kT());
+			Z += weight;
+			exactU += weight * r.U;
+			exactM += weight * (r.M * ising.getAxis());
+		}
+		exactU /= Z;
+		exactM /= Z;
+
+		double U = 0, M = 0, scale = 0;
+		const unsigned long long samples = 400000;
+		ising.metropolis(100 * N);
+		for (unsigned long long k = 0; k < samples; k++) {
+			ising.metropolis(N);
+			const MSD::Results r = ising.getResults();
+			U += r.U;
+			M += r.M * ising.getAxis();
+		}
+		U /= samples;
+		M /= samples;
+		for (unsigned int i = 0; i < N; i++)
+			scale += ising.getSpin(i).norm();
+		if (abs(U - exactU) > 0.02 * (1 + abs(exactU)) || abs(M - exactM) > 0.02 * (1 + scale)) {
+			cout << "Wrong equilibrium: n = " << n << ", <U> = " << U << " (exactly " << exactU << "), <M> = "
+			     << M << " (exactly " << exactM << ")\n";
+			return 1;
+		}
+	}
+
+	// what IsingMSD can't simulate
+	{	shared_ptr<MSD> msd;
+		do {
+			msd = randIsingMSD(rng, 4);
+		} while (msd->getN() < 2);
+		msd->setLocalM(msd->begin().getIndex(), Vector(1, 1, 1), Vector::ZERO);
+		msd->setLocalM((++msd->begin()).getIndex(), Vector(1, -1, 0), Vector::ZERO);
+		try {
+			IsingMSD ising(*msd);
+			cout << "Spins along different axes accepted\n";
+			return 1;
+		} catch (const invalid_argument &) {}
+
+		msd = randIsingMSD(rng, 4);
+		msd->setLocalM(msd->begin().getIndex(), msd->getSpin(msd->begin().getIndex()), Vector(0.5, 0, 0));
+		try {
+			IsingMSD ising(*msd);
+			cout << "Flux accepted\n";
+			return 1;
+		} catch (const invalid_argument &) {}
+
+		msd = randIsingMSD(rng, 4);
+		msd->setDipolar(1);
+		try {
+			IsingMSD ising(*msd);
+			cout << "Dipolar field accepted\n";
+			return 1;
+		} catch (const invalid_argument &) {}
+	}
+
+	cout << "Done. (Passed)\n";
+	return 0;
+}
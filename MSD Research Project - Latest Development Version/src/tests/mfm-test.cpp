@@ -0,0 +1,74 @@
+#include <cmath>
+#include <iostream>
+#include <vector>
+#include "../MSD.h"
+#include "../MFM.h"
+#include "test-util.h"
+
+using namespace std;
+using namespace udc;
+using namespace udc::test;
+
+const unsigned int numIter = 50;
+
+// O(N^2) direct sum, for comparison with MFMImager's FFT convolution
+vector<double> directImage(const vector<Vector> &moments, unsigned int width, unsigned int height, unsigned int depth,
+                           double lift, MFMImager::Quantity quantity) {
+	vector<double> image((size_t) width * height, 0.0);
+	double k[3];
+	for (unsigned int v = 0; v < height; v++)
+		for (unsigned int u = 0; u < width; u++)
+			for (unsigned int z = 0; z < depth; z++)
+				for (unsigned int y = 0; y < height; y++)
+					for (unsigned int x = 0; x < width; x++) {
+						const Vector &m = moments[((size_t) z * height + y) * width + x];
+						MFMImager::dipoleKernel((double) u - x, (double) v - y, (depth - 1 - z) + lift, quantity, k);
+						image[v * width + u] += k[0] * m.x + k[1] * m.y + k[2] * m.z;
+					}
+	return image;
+}
+
+// max |a - b|, relative to the largest value in b
+double relativeError(const vector<double> &a, const vector<double> &b) {
+	double maxDiff = 0, maxValue = 1e-300;
+	for (size_t i = 0; i < b.size(); i++) {
+		maxDiff = max(maxDiff, abs(a[i] - b[i]));
+		maxValue = max(maxValue, abs(b[i]));
+	}
+	return maxDiff / maxValue;
+}
+
+int main(int argc, char *argv[]) {
+	Random rng;
+
+	for (unsigned int n = 0; n < numIter; n++) {
+		shared_ptr<MSD> msd = rng.randMSD(9);
+		msd->randomize();
+		unsigned int width, height, depth;
+		msd->getDimensions(width, height, depth);
+		double lift = 0.25 + 3 * rng.rand();
+
+		vector<Vector> moments((size_t) width * height * depth, Vector::ZERO);
+		for (MSD::Iterator iter = msd->begin(); iter != msd->end(); ++iter)
+			moments[((size_t) iter.getZ() * height + iter.getY()) * width + iter.getX()] = iter.getLocalM();
+
+		for (bool gradient : {true, false}) {
+			vector<double> fftImage = msd->mfmImage(lift, gradient);
+			vector<double> expected = directImage(moments, width, height, depth, lift, gradient ? MFMImager::DH_Z_DZ : MFMImager::H_Z);
+			if (fftImage.size() != expected.size()) {
+				cout << "Wrong image size: n = " << n << '\n';
+				return 1;
+			}
+			double err = relativeError(fftImage, expected);
+			if (err > 1e-9) {
+				cout << "FFT image differs from the direct sum: n = " << n << ", gradient = " << gradient
+				     << ", size = " << width << 'x' << height << 'x' << depth << ", lift = " << lift
+				     << ", relative error = " << err << '\n';
+				return 1;
+			}
+		}
+	}
+
+	cout << "Done. (Passed)\n";
+	return 0;
+}
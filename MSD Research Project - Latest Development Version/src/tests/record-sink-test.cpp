@@ -0,0 +1,181 @@
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../MSD.h"
+#include "../RecordSink.h"
+#include "test-util.h"
+
+using namespace std;
+using namespace udc;
+using namespace udc::test;
+
+const unsigned int numIter = 50;
+
+// sends each Results to all of the given sinks
+class TeeRecordSink : public MSD::RecordSink {
+ private:
+	vector<MSD::RecordSink *> sinks;
+
+ public:
+	TeeRecordSink(initializer_list<MSD::RecordSink *> sinks) : sinks(sinks) {}
+
+	void put(const MSD::Results &r) {
+		for (MSD::RecordSink *sink : sinks)
+			sink->put(r);
+	}
+};
+
+// exactly equal, or both NaN (e.g. for an empty region)
+bool same(double x, double y) {
+	return x == y || (std::isnan(x) && std::isnan(y));
+}
+
+bool same(const Vector &u, const Vector &v) {
+	return same(u.x, v.x) && same(u.y, v.y) && same(u.z, v.z);
+}
+
+// StatisticsRecordSink must give the exact same answers as the MSD methods using MSD::record
+bool cmpStats(const MSD &msd, const StatisticsRecordSink &stats) {
+	bool passed = true;
+	auto check = [&](bool isSame, const char *name) {
+		if (!isSame) {
+			cout << "StatisticsRecordSink::" << name << "() differs from MSD::" << name << "()\n";
+			passed = false;
+		}
+	};
+	check(same(msd.specificHeat(), stats.specificHeat()), "specificHeat");
+	check(same(msd.specificHeat_L(), stats.specificHeat_L()), "specificHeat_L");
+	check(same(msd.specificHeat_R(), stats.specificHeat_R()), "specificHeat_R");
+	check(same(msd.specificHeat_m(), stats.specificHeat_m()), "specificHeat_m");
+	check(same(msd.specificHeat_mL(), stats.specificHeat_mL()), "specificHeat_mL");
+	check(same(msd.specificHeat_mR(), stats.specificHeat_mR()), "specificHeat_mR");
+	check(same(msd.specificHeat_LR(), stats.specificHeat_LR()), "specificHeat_LR");
+	check(same(msd.magneticSusceptibility(), stats.magneticSusceptibility()), "magneticSusceptibility");
+	check(same(msd.magneticSusceptibility_L(), stats.magneticSusceptibility_L()), "magneticSusceptibility_L");
+	check(same(msd.magneticSusceptibility_R(), stats.magneticSusceptibility_R()), "magneticSusceptibility_R");
+	check(same(msd.magneticSusceptibility_m(), stats.magneticSusceptibility_m()), "magneticSusceptibility_m");
+	check(same(msd.meanM(), stats.meanM()), "meanM");
+	check(same(msd.meanML(), stats.meanML()), "meanML");
+	check(same(msd.meanMR(), stats.meanMR()), "meanMR");
+	check(same(msd.meanMm(), stats.meanMm()), "meanMm");
+	check(same(msd.meanMS(), stats.meanMS()), "meanMS");
+	check(same(msd.meanMSL(), stats.meanMSL()), "meanMSL");
+	check(same(msd.meanMSR(), stats.meanMSR()), "meanMSR");
+	check(same(msd.meanMSm(), stats.meanMSm()), "meanMSm");
+	check(same(msd.meanMF(), stats.meanMF()), "meanMF");
+	check(same(msd.meanMFL(), stats.meanMFL()), "meanMFL");
+	check(same(msd.meanMFR(), stats.meanMFR()), "meanMFR");
+	check(same(msd.meanMFm(), stats.meanMFm()), "meanMFm");
+	check(same(msd.meanU(), stats.meanU()), "meanU");
+	check(same(msd.meanUL(), stats.meanUL()), "meanUL");
+	check(same(msd.meanUR(), stats.meanUR()), "meanUR");
+	check(same(msd.meanUm(), stats.meanUm()), "meanUm");
+	check(same(msd.meanUmL(), stats.meanUmL()), "meanUmL");
+	check(same(msd.meanUmR(), stats.meanUmR()), "meanUmR");
+	check(same(msd.meanULR(), stats.meanULR()), "meanULR");
+	return passed;
+}
+
+int main(int argc, char *argv[]) {
+	Random rng;
+
+	// parseRecordSinkSpec: the decimation must be a whole, positive integer (in particular, "-1" mustn't wrap around)
+	{
+		string type;
+		unsigned long long decimation;
+		if (!parseRecordSinkSpec("memory", type, decimation) || type != "memory" || decimation != 1
+				|| !parseRecordSinkSpec("stream:10", type, decimation) || type != "stream" || decimation != 10) {
+			cout << "(parseRecordSinkSpec) Valid spec rejected\n";
+			return 1;
+		}
+		for (const char *spec : {"decimate:-1", "stream:0", "stream:", "stream:10x", "stream: 10", "stream:+10",
+				"stream:99999999999999999999"})
+			if (parseRecordSinkSpec(spec, type, decimation)) {
+				cout << "(parseRecordSinkSpec) Invalid spec accepted: " << spec << '\n';
+				return 1;
+			}
+	}
+
+	for (unsigned int n = 0; n < numIter; n++) {
+		shared_ptr<MSD> msd = rng.randMSD(10);
+		unsigned long long N = 1000 + rng.randI(10000);
+		unsigned long long freq = 1 + rng.randI(100);
+		unsigned long long factor = 1 + rng.randI(10);
+
+		// one run, sent to every kind of sink at once
+		// (Note: repeated runs aren't bit-for-bit reproducible because of accumulated rounding in MSD::Results)
+		vector<MSD::Results> record, decimated;
+		VectorRecordSink vectorSink(record);
+		VectorRecordSink decimatedVectorSink(decimated);
+		DecimatingRecordSink decimator(decimatedVectorSink, factor);
+		StatisticsRecordSink stats(*msd);
+		ostringstream csv, bin, expectedCsv;
+		AsyncFileRecordSink csvSink(csv, ResultsWriter::CSV, true, 1 + rng.randI(16));
+		AsyncFileRecordSink binSink(bin, ResultsWriter::BINARY);
+		TeeRecordSink tee({&vectorSink, &decimator, &stats, &csvSink, &binSink});
+		msd->recordSink = &tee;
+		msd->metropolis(N, freq);
+		msd->recordSink = NULL;
+		csvSink.close();
+		binSink.close();
+
+		if (stats.size() != record.size() || msd->record.size() != 0) {
+			cout << "(stats) Wrong number of records: n = " << n << ", " << stats.size() << " != " << record.size() << '\n';
+			return 1;
+		}
+		msd->record = record;
+		if (!cmpStats(*msd, stats)) {
+			cout << "(stats) Failed: n = " << n << '\n';
+			return 1;
+		}
+
+		if (decimated.size() != (record.size() + factor - 1) / factor) {
+			cout << "(decimate) Wrong number of records: n = " << n << '\n';
+			return 1;
+		}
+		for (size_t i = 0; i < decimated.size(); i++)
+			if (memcmp(&decimated[i], &record[i * factor], sizeof(MSD::Results)) != 0) {  // Note: Results may contain NaN
+				cout << "(decimate) Wrong record: n = " << n << ", i = " << i << '\n';
+				return 1;
+			}
+
+		for (const MSD::Results &r : record) {
+			expectedCsv << r.t << ",,";
+			for (const Vector &v : {r.M, r.ML, r.MR, r.Mm, r.MS, r.MSL, r.MSR, r.MSm, r.MF, r.MFL, r.MFR, r.MFm})
+				expectedCsv << v.x << ',' << v.y << ',' << v.z << ',' << v.norm() << ',' << v.theta() << ',' << v.phi() << ",,";
+			expectedCsv << r.U << ',' << r.UL << ',' << r.UR << ',' << r.Um << ',' << r.UmL << ',' << r.UmR << ',' << r.ULR << '\n';
+		}
+		if (csv.str() != expectedCsv.str()) {
+			cout << "(csv) Output differs: n = " << n << '\n';
+			return 1;
+		}
+		// (binary) no header, just rows of t, then (x, y, z, norm, theta, phi) * 12, then 7 energies
+		const size_t binaryColumns = 1 + 12 * 6 + 7;
+		string b = bin.str();
+		if (b.size() != record.size() * binaryColumns * sizeof(double)) {
+			cout << "(binary) Wrong size: n = " << n << '\n';
+			return 1;
+		}
+		const unsigned char *buffer = reinterpret_cast<const unsigned char *>(b.data());
+		for (const MSD::Results &r : record) {
+			double t;
+			Vector M;
+			bread(t, buffer);
+			bread(M.x, buffer);
+			bread(M.y, buffer);
+			bread(M.z, buffer);
+			buffer += (binaryColumns - 4) * sizeof(double);
+			if (t != r.t || !same(M, r.M)) {
+				cout << "(binary) Wrong record: n = " << n << ", t = " << r.t << '\n';
+				return 1;
+			}
+		}
+	}
+
+	cout << "Done. (Passed)\n";
+	return 0;
+}
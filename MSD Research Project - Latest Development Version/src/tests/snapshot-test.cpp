@@ -0,0 +1,113 @@
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "../AsyncRun.h"
+#include "../MSD.h"
+#include "../Snapshot.h"
+#include "test-util.h"
+
+using namespace std;
+using namespace udc;
+using namespace udc::test;
+
+const unsigned int numIter = 20;
+const unsigned long long numPublished = 200000;
+const unsigned int numReaders = 3;
+
+// every element is the same value: a torn read would mix two values
+struct Block {
+	vector<unsigned long long> values;
+};
+
+// one writer and a few readers of a TripleBuffer: every read must be a whole, and newer, value
+bool testTripleBuffer() {
+	TripleBuffer<Block> buffer;
+	atomic<bool> failed(false);
+	atomic<bool> writing(true);
+
+	vector<thread> readers;
+	for (unsigned int r = 0; r < numReaders; r++)
+		readers.emplace_back([&]() {
+			Block b;
+			unsigned long long last = 0;
+			while (writing || last < numPublished) {
+				if (!buffer.read(b))
+					continue;
+				unsigned long long v = b.values[0];
+				for (unsigned long long x : b.values)
+					if (x != v) {
+						cout << "Torn read: " << x << " != " << v << '\n';
+						failed = true;
+						return;
+					}
+				if (v < last) {
+					cout << "Older value read: " << v << " < " << last << '\n';
+					failed = true;
+					return;
+				}
+				last = v;
+			}
+		});
+
+	for (unsigned long long v = 1; v <= numPublished; v++) {
+		Block &b = buffer.write();
+		b.values.assign(1 + v % 64, v);
+		buffer.publish();
+	}
+	writing = false;
+	for (thread &t : readers)
+		t.join();
+	return !failed;
+}
+
+int main(int argc, char *argv[]) {
+	if (!testTripleBuffer())
+		return 1;
+
+	// snapshots of a running simulation: each one consistent with itself
+	Random rng;
+	for (unsigned int n = 0; n < numIter; n++) {
+		shared_ptr<MSD> msd = rng.randMSD(10);
+		msd->randomize();
+		vector<unsigned int> indices;
+		for (MSD::Iterator i = msd->begin(); i != msd->end(); ++i)
+			indices.push_back(i.getIndex());
+
+		AsyncRun run(*msd, (unsigned long long) -1);
+		MSDSnapshot s;
+		if (run.getSnapshot(s)) {
+			cout << "Snapshot without setSnapshots: n = " << n << '\n';
+			return 1;
+		}
+		run.setSnapshots(true);
+		unsigned long long lastT = 0;
+		unsigned int count = 0;
+		while (count < 5) {
+			if (!run.getSnapshot(s) || s.results.t < AsyncRun::SLICE * (count + 1))
+				continue;
+			if (s.results.t < lastT || s.indices != indices || s.spins.size() != indices.size() || s.fluxes.size() != indices.size()) {
+				cout << "Invalid snapshot: n = " << n << ", t = " << s.results.t << '\n';
+				return 1;
+			}
+			Vector MS = Vector::ZERO, MF = Vector::ZERO;
+			for (size_t i = 0; i < indices.size(); i++) {
+				MS += s.spins[i];
+				MF += s.fluxes[i];
+			}
+			double tolerance = 1e-6 * (1 + indices.size());
+			if ((MS - s.results.MS).norm() > tolerance || (MF - s.results.MF).norm() > tolerance) {
+				cout << "Snapshot's results don't match its spins and fluxes: n = " << n << ", t = " << s.results.t << '\n';
+				return 1;
+			}
+			lastT = s.results.t;
+			count++;
+		}
+		run.cancel();
+		run.wait();
+	}
+
+	cout << "Done. (Passed)\n";
+	return 0;
+}
@@ -0,0 +1,226 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <utility>
+#include <vector>
+#include "../asm/FastMSD.h"
+#include "../asm/Topology.h"
+#include "../MSD.h"
+#include "test-util.h"
+
+using namespace std;
+using namespace udc;
+using namespace udc::test;
+
+const unsigned int numIter = 20;
+
+// (neighbor, edge class, direction) of each node, sorted
+vector<vector<tuple<unsigned int, unsigned int, double>>> adjacency(const FastMSD::Graph &g) {
+	vector<vector<tuple<unsigned int, unsigned int, double>>> adj(g.indices.size());
+	for (unsigned int i = 0; i < g.indices.size(); i++) {
+		for (unsigned int e = g.offsets[i]; e < g.offsets[i + 1]; e++)
+			adj[i].emplace_back(g.neighbors[e], g.edgeClass[e], g.direction[e]);
+		sort(adj[i].begin(), adj[i].end());
+	}
+	return adj;
+}
+
+unsigned int maxDegree(const FastMSD::Graph &g, unsigned int &count) {
+	unsigned int max = 0;
+	count = 0;
+	for (unsigned int i = 0; i < g.indices.size(); i++) {
+		unsigned int d = g.offsets[i + 1] - g.offsets[i];
+		if (d > max) {
+			max = d;
+			count = 0;
+		}
+		if (d == max)
+			count++;
+	}
+	return max;
+}
+
+FastMSD::NodeClass randNodeClass(Random &rng, FastMSD::Region region) {
+	return { region, rng.rand(), rng.rand(), rng.randV() };
+}
+
+FastMSD::EdgeClass randEdgeClass(Random &rng, FastMSD::Bond bond) {
+	return { bond, rng.rand(), rng.rand(), rng.rand(), rng.rand(), rng.randV() };
+}
+
+// a random state, then a run: the Results must stay consistent with the state
+bool consistent(const FastMSD::Graph &g, Random &rng) {
+	FastMSD fast(g, rng.rand(), rng.randV());
+	for (unsigned int i = 0; i < fast.getN(); i++)
+		fast.setLocalM(i, rng.randV(), rng.randV());
+	fast.metropolis(5000);
+	MSD::Results a = fast.getResults(), b = fast.computeResults();
+	return abs(a.U - b.U) <= 1e-9 * (1 + 100.0 * fast.getN()) && (a.M - b.M).norm() <= 1e-9 * (1 + fast.getN());
+}
+
+int main(int argc, char *argv[]) {
+	Random rng;
+
+	// simple cubic: the same graph as an MSD that is all FM_L
+	for (unsigned int n = 0; n < numIter; n++) {
+		unsigned int width = rng.randI(1, 8), height = rng.randI(1, 8), depth = rng.randI(1, 8);
+		MSD msd(width, height, depth, width, width, 0, height - 1, 0, depth - 1);
+		MSD::Parameters p = rng.randP();
+		msd.setParameters(p);
+
+		Topology t;
+		unsigned int L = t.addNodeClass({ FastMSD::FM_L, p.FL, p.Je0L, p.AL });
+		unsigned int JL = t.addEdgeClass({ FastMSD::BOND_L, p.JL, p.Je1L, p.JeeL, p.bL, p.DL });
+		t.addLattice(Topology::SIMPLE_CUBIC, 1, width, height, depth, L, JL);
+
+		FastMSD::Graph expected = FastMSD::Graph::fromMSD(msd), g = t.build();
+		if (g.indices != expected.indices || adjacency(g) != adjacency(expected)) {
+			cout << "Different simple cubic graph than MSD's: n = " << n << '\n';
+			return 1;
+		}
+		FastMSD a(msd), b(g, p.kT, p.B);
+		for (unsigned int i = 0; i < a.getN(); i++) {
+			Vector s = rng.randV(), f = rng.randV();
+			a.setLocalM(i, s, f);
+			b.setLocalM(i, s, f);
+		}
+		if (abs(a.computeResults().U - b.computeResults().U) > 1e-9 * (1 + 100.0 * a.getN())) {
+			cout << "Different simple cubic energy than MSD's: n = " << n << '\n';
+			return 1;
+		}
+	}
+
+	// coordination numbers: bcc 8, fcc 12, hcp 12 (inside the block)
+	const pair<Topology::Lattice, unsigned int> lattices[] = {
+		{ Topology::SIMPLE_CUBIC, 6 }, { Topology::BCC, 8 }, { Topology::FCC, 12 }, { Topology::HCP, 12 }
+	};
+	for (auto l : lattices) {
+		Topology t;
+		unsigned int node = t.addNodeClass(randNodeClass(rng, FastMSD::FM_L));
+		unsigned int edge = t.addEdgeClass(randEdgeClass(rng, FastMSD::BOND_L));
+		double a = 0.5 + rng.rand();
+		t.addLattice(l.first, a, 5, 5, 5, node, edge, rng.randV());
+		FastMSD::Graph g = t.build();
+		unsigned int count;
+		if (maxDegree(g, count) != l.second || count == 0) {
+			cout << "Wrong coordination number: lattice = " << l.first << '\n';
+			return 1;
+		}
+		for (unsigned int i = 0; i < g.indices.size(); i++)
+			for (unsigned int e = g.offsets[i]; e < g.offsets[i + 1]; e++)
+				if (abs(t.getPosition(i).distance(t.getPosition(g.neighbors[e])) - Topology::nearestNeighbor(l.first, a)) > 1e-9) {
+					cout << "Bond isn't between nearest neighbors: lattice = " << l.first << '\n';
+					return 1;
+				}
+		if (!consistent(g, rng)) {
+			cout << "Results drifted: lattice = " << l.first << '\n';
+			return 1;
+		}
+	}
+
+	// multilayer: two simple cubic layers make one thicker layer, with one interface bond per column
+	{	Topology t;
+		unsigned int L = t.addNodeClass(randNodeClass(rng, FastMSD::FM_L));
+		unsigned int R = t.addNodeClass(randNodeClass(rng, FastMSD::FM_R));
+		unsigned int JL = t.addEdgeClass(randEdgeClass(rng, FastMSD::BOND_L));
+		unsigned int JR = t.addEdgeClass(randEdgeClass(rng, FastMSD::BOND_R));
+		unsigned int JLR = t.addEdgeClass(randEdgeClass(rng, FastMSD::BOND_LR));
+		vector<Topology::Layer> layers = {
+			{ Topology::SIMPLE_CUBIC, 1, 3, L, JL, 0, 0 },
+			{ Topology::SIMPLE_CUBIC, 1, 2, R, JR, JLR, 0 },
+			{ Topology::FCC, 1, 2, L, JL, JLR, 0 }
+		};
+		vector<Topology::Range> ranges = t.addMultilayer(layers, 4, 4);
+		FastMSD::Graph g = t.build();
+
+		// bonds (each counted from its lower site) within the two simple cubic layers, and between each pair of layers
+		unsigned int scBonds = 0, interface[2] = { 0, 0 };
+		for (unsigned int i = 0; i < g.indices.size(); i++)
+			for (unsigned int e = g.offsets[i]; e < g.offsets[i + 1]; e++) {
+				unsigned int j = g.neighbors[e];
+				if (j < i)
+					continue;
+				if (j < ranges[1].end)
+					scBonds++;
+				if (g.edgeClass[e] == JLR)
+					interface[i < ranges[0].end ? 0 : 1]++;
+			}
+		if (ranges.size() != 3 || ranges[1].begin != 16 * 3 || ranges[1].end != 16 * 5 || ranges[2].end != 16 * 5 + 4 * 16 * 2
+				|| scBonds != 3 * 4 * 5 + 4 * 3 * 5 + 4 * 4 * 4 || interface[0] != 16 || interface[1] != 16) {
+			cout << "Wrong multilayer\n";
+			return 1;
+		}
+		if (!consistent(g, rng)) {
+			cout << "Results drifted: multilayer\n";
+			return 1;
+		}
+	}
+
+	// orderings: a permutation of the nodes, and along a Hilbert curve, each node is next to the one before it
+	for (unsigned int side : { 1, 2, 4, 8 }) {
+		Topology t;
+		unsigned int node = t.addNodeClass(randNodeClass(rng, FastMSD::FM_L));
+		unsigned int edge = t.addEdgeClass(randEdgeClass(rng, FastMSD::BOND_L));
+		double a = 0.5 + rng.rand();
+		t.addLattice(Topology::SIMPLE_CUBIC, a, side, side, side, node, edge, rng.randV());
+		FastMSD::Graph g = t.build();
+		for (FastMSD::Ordering o : { FastMSD::MORTON_ORDER, FastMSD::HILBERT_ORDER }) {
+			vector<unsigned int> order = g.order(o), sorted = order;
+			sort(sorted.begin(), sorted.end());
+			for (unsigned int i = 0; i < sorted.size(); i++)
+				if (sorted[i] != i) {
+					cout << "Ordering isn't a permutation: ordering = " << o << ", side = " << side << '\n';
+					return 1;
+				}
+			if (o == FastMSD::HILBERT_ORDER)
+				for (unsigned int k = 1; k < order.size(); k++)
+					if (abs(t.getPosition(order[k]).distance(t.getPosition(order[k - 1])) - a) > 1e-9) {
+						cout << "Hilbert curve jumps: side = " << side << ", k = " << k << '\n';
+						return 1;
+					}
+			FastMSD::Graph p = g.permuted(order);
+			if (adjacency(p).size() != g.indices.size() || !consistent(p, rng)) {
+				cout << "Results drifted: ordering = " << o << ", side = " << side << '\n';
+				return 1;
+			}
+		}
+	}
+
+	// mesh: a triangle (with comments), then bad input
+	{	Topology t;
+		t.addNodeClass(randNodeClass(rng, FastMSD::MOL));
+		t.addEdgeClass(randEdgeClass(rng, FastMSD::BOND_M));
+		istringstream sites("# x y z class\n0 0 0 0\n1 0 0 0\n\n0.5 0.8 0 0  # top\n"), bonds("0 1 0\n1 2 0\n2 0 0\n");
+		Topology::Range r = t.readMesh(sites, bonds);
+		FastMSD::Graph g = t.build();
+		if (r.begin != 0 || r.end != 3 || t.bondCount() != 3 || g.offsets != vector<unsigned int>({ 0, 2, 4, 6 })) {
+			cout << "Wrong mesh\n";
+			return 1;
+		}
+		if (!consistent(g, rng)) {
+			cout << "Results drifted: mesh\n";
+			return 1;
+		}
+		const char *bad[][2] = {
+			{ "0 0 0\n", "" },           // missing class
+			{ "0 0 0 1\n", "" },         // no such class
+			{ "0 0 0 0 7\n", "" },       // extra field
+			{ "0 0 0 0\n", "0 1 0\n" },  // no such site
+			{ "0 0 0 0\n", "0 0 3\n" },  // no such edge class
+			{ "0 0 0 0\n", "0 0 0\n" }   // bonded to itself
+		};
+		for (auto b : bad) {
+			istringstream sites(b[0]), bonds(b[1]);
+			try {
+				t.readMesh(sites, bonds);
+				cout << "Bad mesh accepted: " << b[0] << " / " << b[1] << '\n';
+				return 1;
+			} catch (const invalid_argument &) {}
+		}
+	}
+
+	cout << "Done. (Passed)\n";
+	return 0;
+}